@@ -65,6 +65,7 @@
 #define PORT_maxRxAckPrepare                10    //  305us (measured  83us)
 #define PORT_maxRxDataPrepare               33    // 1007us (measured  84us)
 #define PORT_maxTxAckPrepare                22    //  305us (measured 219us)
+#define PORT_maxTxDataPreparePreloaded      33    // 1007us (frame already in the TXFIFO, not measured)
 // radio speed related
 #define PORT_delayTx                        7     //  214us (measured 219us)
 #define PORT_delayRx                        0     //    0us (can not measure)
@@ -74,6 +75,36 @@
 
 #define SYNC_ACCURACY                       1     // ticks
 
+//===== non-volatile memory
+
+#define PORT_NVMEM_PAGE_SIZE                2048  // bytes, FLASH_ERASE_SIZE
+#define PORT_NVMEM_NUM_PAGES                4     // right below the CCA page
+#define PORT_NVMEM_ERASE_US                 20000 // the CPU stalls while a page is erased
+#define PORT_NVMEM_WRITE_US                 20    // and while each 4-byte word is programmed
+
+//===== radio
+
+#define BOARD_RADIO_KEEPS_TXBUFFER          1     // TXFIFO is kept through ISRFOFF and PM0 sleep, see prepareNextData()
+
+//===== AES engine
+
+#define BOARD_CRYPTOENGINE_ENABLED          1     // AES-CCM* in hardware, see cryptoengine.h
+
+//===== energy accounting, currents in uA (see energy.h)
+
+// CC2538 datasheet, radio figures with the CPU idle
+#define PORT_CURRENT_SLEEP                  1     // PM2, sleep timer running
+#define PORT_CURRENT_CPU                    7000  // active at 32MHz
+#define PORT_CURRENT_RADIO_IDLE             2000  // 32MHz crystal running, radio on
+#define PORT_CURRENT_RADIO_RX               20000 // listening or receiving
+#define PORT_CURRENT_RADIO_TX               {     /* dBm and uA, 34mA at +7dBm and 24mA at 0dBm, the rest interpolated */ \
+   {   7,34000}, {   5,31000}, {   3,28000}, {   1,25500}, \
+   {   0,24000}, {  -1,23500}, {  -3,23000}, {  -5,22500}, \
+   {  -7,22000}, {  -9,21500}, { -11,21000}, { -13,20500}, \
+   { -15,20000}, { -24,19000}, \
+}
+#define PORT_BATTERY_CAPACITY               2500  // mAh, 2xAA
+
 //=========================== typedef  ========================================
 
 //=========================== variables =======================================
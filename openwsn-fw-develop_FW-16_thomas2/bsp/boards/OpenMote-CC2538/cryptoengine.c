@@ -0,0 +1,82 @@
+/**
+ * Description: CC2538-specific definition of the "cryptoengine" bsp module.
+ */
+
+#include "board_info.h"
+#include "cryptoengine.h"
+#include "sys_ctrl.h"
+#include "aes.h"
+#include "ccm.h"
+
+//=========================== defines =========================================
+
+#define CRYPTOENGINE_CCM_L          2     // bytes of the length field, 13-byte nonce
+#define CRYPTOENGINE_MAX_MIC_LEN    16
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+//=========================== public ==========================================
+
+void cryptoengine_init(void) {
+   // board_init() gates the AES engine's clock, it is not needed in sleep
+   SysCtrlPeripheralEnable(SYS_CTRL_PERIPH_AES);
+}
+
+/**
+\brief Load a 128-bit key in one of the KEY_AREA_0..KEY_AREA_7 slots.
+*/
+bool cryptoengine_loadKey(uint8_t keySlot, uint8_t* key) {
+   return AESLoadKey(key,keySlot)==AES_SUCCESS;
+}
+
+/**
+\brief Authenticate a and m, and encrypt m in place.
+
+The MIC is written right after m, so there must be micLength bytes of room
+there. m is only encrypted if lenM is not 0.
+*/
+bool cryptoengine_aesCcmEncrypt(uint8_t* a, uint8_t lenA,
+                                uint8_t* m, uint8_t lenM,
+                                uint8_t* nonce,
+                                uint8_t  keySlot,
+                                uint8_t  micLength) {
+   uint8_t mic[CRYPTOENGINE_MAX_MIC_LEN];
+   uint8_t i;
+   
+   if (CCMAuthEncryptStart(lenM>0,micLength,nonce,m,lenM,a,lenA,keySlot,mic,CRYPTOENGINE_CCM_L,0)!=AES_SUCCESS) {
+      return false;
+   }
+   // the engine takes a few us per block, polling is cheaper than an interrupt
+   while (CCMAuthEncryptCheckResult()==0);
+   if (CCMAuthEncryptGetResult(micLength,lenM,mic)!=AES_SUCCESS) {
+      return false;
+   }
+   for (i=0;i<micLength;i++) {
+      m[lenM+i] = mic[i];
+   }
+   return true;
+}
+
+/**
+\brief Decrypt c in place, and check the MIC in its last micLength bytes.
+
+\returns FALSE if the MIC does not match, in which case c is garbage.
+*/
+bool cryptoengine_aesCcmDecrypt(uint8_t* a, uint8_t lenA,
+                                uint8_t* c, uint8_t lenC,
+                                uint8_t* nonce,
+                                uint8_t  keySlot,
+                                uint8_t  micLength) {
+   uint8_t mic[CRYPTOENGINE_MAX_MIC_LEN];
+   
+   if (CCMInvAuthDecryptStart(lenC>micLength,micLength,nonce,c,lenC,a,lenA,keySlot,mic,CRYPTOENGINE_CCM_L,0)!=AES_SUCCESS) {
+      return false;
+   }
+   while (CCMInvAuthDecryptCheckResult()==0);
+   // also fails with CCM_AUTHENTICATION_FAILED if the MIC does not match
+   return CCMInvAuthDecryptGetResult(micLength,c,lenC,mic)==AES_SUCCESS;
+}
+
+//=========================== private =========================================
@@ -0,0 +1,65 @@
+/**
+ * Description: CC2538-specific definition of the "nvmem" bsp module.
+ */
+
+#include <string.h>
+
+#include "board_info.h"
+#include "nvmem.h"
+#include "flash.h"
+
+//=========================== defines =========================================
+
+// PORT_NVMEM_NUM_PAGES pages right below the page holding the CCA
+#define NVMEM_BASE_ADDRESS          ( 0x0027F800 - PORT_NVMEM_NUM_PAGES*FLASH_ERASE_SIZE )
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+//=========================== public ==========================================
+
+void nvmem_init(void) {
+   // nothing to do, the flash controller is ready after reset
+}
+
+void nvmem_erasePage(uint8_t page) {
+   if (page>=PORT_NVMEM_NUM_PAGES) {
+      return;
+   }
+
+   // the CPU stalls while the page is erased, since it executes from flash,
+   // for PORT_NVMEM_ERASE_US
+   FlashMainPageErase(NVMEM_BASE_ADDRESS+page*FLASH_ERASE_SIZE);
+}
+
+void nvmem_write(uint16_t address, uint8_t* buf, uint16_t len) {
+   uint32_t words[16];
+   uint16_t chunk;
+
+   if (address+len>PORT_NVMEM_NUM_PAGES*PORT_NVMEM_PAGE_SIZE) {
+      return;
+   }
+
+   // the flash controller programs aligned 32-bit words, buf may not be aligned
+   while (len>0) {
+      chunk = len<sizeof(words) ? len : sizeof(words);
+      memcpy(words,buf,chunk);
+      FlashMainPageProgram(words,NVMEM_BASE_ADDRESS+address,chunk);
+      address += chunk;
+      buf     += chunk;
+      len     -= chunk;
+   }
+}
+
+void nvmem_read(uint16_t address, uint8_t* buf, uint16_t len) {
+   if (address+len>PORT_NVMEM_NUM_PAGES*PORT_NVMEM_PAGE_SIZE) {
+      memset(buf,0xff,len);
+      return;
+   }
+
+   // the flash is memory-mapped
+   memcpy(buf,(uint8_t*)(NVMEM_BASE_ADDRESS+address),len);
+}
+
+//=========================== private =========================================
@@ -44,6 +44,29 @@ typedef struct {
 
 radio_vars_t radio_vars;
 
+typedef struct {
+   uint8_t                   txPower;  // value of the TXPOWER register
+   int8_t                    power;    // resulting output power, in dBm
+} radio_txPowerLevel_t;
+
+// from the datasheet, highest power first
+static const radio_txPowerLevel_t radio_txPowerLevels[] = {
+   {0xFF,  7},
+   {0xED,  5},
+   {0xD5,  3},
+   {0xC5,  1},
+   {0xB6,  0},
+   {0xB0, -1},
+   {0xA1, -3},
+   {0x91, -5},
+   {0x88, -7},
+   {0x72, -9},
+   {0x62,-11},
+   {0x58,-13},
+   {0x42,-15},
+   {0x00,-24},
+};
+
 //=========================== prototypes ======================================
 
 void     enable_radio_interrupts(void);
@@ -230,6 +253,27 @@ void radio_setFrequency(uint8_t frequency) {
    radio_vars.state = RADIOSTATE_FREQUENCY_SET;
 }
 
+/**
+\brief Set the power the next frames are transmitted at.
+
+Picks the lowest level not below the requested power, or the highest level.
+
+\param[in] power The requested output power, in dBm.
+*/
+void radio_setTxPower(int8_t power) {
+   uint8_t i;
+   
+   i = 0;
+   while (
+         i+1<sizeof(radio_txPowerLevels)/sizeof(radio_txPowerLevel_t) &&
+         radio_txPowerLevels[i+1].power>=power
+      ) {
+      i++;
+   }
+   
+   HWREG(RFCORE_XREG_TXPOWER) = radio_txPowerLevels[i].txPower;
+}
+
 void radio_rfOn() {
    //radio_on();
 }
@@ -346,6 +390,18 @@ void radio_rxNow() {
    while(!((HWREG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_RX_ACTIVE)));
 }
 
+/**
+\brief Read the first bytes of the frame being received.
+
+Reading RFDATA removes the bytes from the RX FIFO, so the frame is only read
+once complete.
+
+\returns 0, no bytes are read.
+*/
+uint8_t radio_peekReceivedFrame(uint8_t* bufRead, uint8_t maxBufLen) {
+   return 0;
+}
+
 void radio_getReceivedFrame(uint8_t* pBufRead,
                             uint8_t* pLenRead,
                             uint8_t  maxBufLen,
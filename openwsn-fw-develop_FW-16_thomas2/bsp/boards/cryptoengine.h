@@ -0,0 +1,51 @@
+#ifndef __CRYPTOENGINE_H
+#define __CRYPTOENGINE_H
+
+/**
+\addtogroup BSP
+\{
+\addtogroup cryptoengine
+\{
+
+\brief Cross-platform declaration "cryptoengine" bsp module.
+
+Optional hardware offload of AES-CCM*, for boards with an AES engine. A board
+which implements it defines BOARD_CRYPTOENGINE_ENABLED in its board_info.h;
+the stack then uses it instead of its software AES.
+
+Keys are loaded once into one of the engine's key slots, and referred to by
+that slot afterwards. The nonce is 13 bytes long (CCM* with L=2). Data is
+encrypted or decrypted in place.
+*/
+
+#include <stdint.h>
+#include "toolchain_defs.h"
+#include "board_info.h"
+
+//=========================== define ==========================================
+
+//=========================== typedef =========================================
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+void cryptoengine_init(void);
+bool cryptoengine_loadKey(uint8_t keySlot, uint8_t* key);
+bool cryptoengine_aesCcmEncrypt(uint8_t* a, uint8_t lenA,
+                                uint8_t* m, uint8_t lenM,
+                                uint8_t* nonce,
+                                uint8_t  keySlot,
+                                uint8_t  micLength);
+bool cryptoengine_aesCcmDecrypt(uint8_t* a, uint8_t lenA,
+                                uint8_t* c, uint8_t lenC,
+                                uint8_t* nonce,
+                                uint8_t  keySlot,
+                                uint8_t  micLength);
+
+/**
+\}
+\}
+*/
+
+#endif
@@ -25,6 +25,12 @@ typedef struct {
 
 radio_vars_t radio_vars;
 
+// output power in dBm for each value of the TX_PWR field, from the datasheet,
+// rounded down
+static const int8_t radio_txPowerLevels[16] = {
+   3, 2, 2, 1, 1, 0, 0, -1, -2, -3, -4, -5, -7, -9, -12, -17
+};
+
 //=========================== prototypes ======================================
 
 #define radio_internalWriteReg(R,V) R = V
@@ -123,6 +129,25 @@ void radio_setFrequency(uint8_t frequency) {
    radio_vars.state = RADIOSTATE_FREQUENCY_SET;
 }
 
+/**
+\brief Set the power the next frames are transmitted at.
+
+Picks the lowest level not below the requested power, or the highest level.
+
+\param[in] power The requested output power, in dBm.
+*/
+void radio_setTxPower(int8_t power) {
+   uint8_t i;
+   
+   i = 0;
+   while (i+1<sizeof(radio_txPowerLevels) && radio_txPowerLevels[i+1]>=power) {
+      i++;
+   }
+   
+   // the other bits of the register are left untouched
+   radio_internalWriteReg(PHY_TX_PWR,(radio_internalReadReg(PHY_TX_PWR) & 0xf0) | i);
+}
+
 void radio_rfOn() {
    PRR1 &= ~_BV(PRTRX24);
 }
@@ -214,6 +239,26 @@ void radio_rxNow() {
    // nothing to do
 }
 
+/**
+\brief Read the first bytes of the frame being received.
+
+The frame buffer is memory-mapped and can be read while the radio is still
+filling it.
+
+\returns The number of bytes written to bufRead.
+*/
+uint8_t radio_peekReceivedFrame(uint8_t* bufRead, uint8_t maxBufLen) {
+   uint8_t len;
+   
+   len = maxBufLen;
+   if (len>TST_RX_LENGTH) {
+      len = TST_RX_LENGTH;
+   }
+   memcpy(bufRead,&TRXFBST,len);
+   
+   return len;
+}
+
 void radio_getReceivedFrame(uint8_t* pBufRead,
                             uint8_t* pLenRead,
                             uint8_t  maxBufLen,
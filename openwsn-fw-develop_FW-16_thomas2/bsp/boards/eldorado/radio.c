@@ -149,6 +149,16 @@ void radio_setFrequency(uint8_t frequency) {
    radio_spiWriteReg(LO1_NUM_ADDR,frequency-11);//in this radio they index the channels from 0 to 15
 }
 
+/**
+\brief Set the power the next frames are transmitted at.
+
+Not supported by this radio, which always transmits at its reset power.
+
+\param[in] power The requested output power, in dBm.
+*/
+void radio_setTxPower(int8_t power) {
+}
+
 void radio_rfOn() {
    //poipoi
    //to leave doze mode, assert ATTN then deassert it
@@ -210,6 +220,17 @@ void radio_rxNow() {
    // nothing to do
 }
 
+/**
+\brief Read the first bytes of the frame being received.
+
+Not supported by this radio.
+
+\returns 0, no bytes are read.
+*/
+uint8_t radio_peekReceivedFrame(uint8_t* bufRead, uint8_t maxBufLen) {
+   return 0;
+}
+
 void radio_getReceivedFrame(uint8_t* bufRead,
                             uint8_t* lenRead,
                             uint8_t  maxBufLen,
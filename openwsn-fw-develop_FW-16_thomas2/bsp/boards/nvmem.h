@@ -0,0 +1,44 @@
+#ifndef __NVMEM_H
+#define __NVMEM_H
+
+/**
+\addtogroup BSP
+\{
+\addtogroup nvmem
+\{
+
+\brief Cross-platform declaration "nvmem" bsp module.
+
+The non-volatile memory is a small area of PORT_NVMEM_NUM_PAGES pages of
+PORT_NVMEM_PAGE_SIZE bytes each, addressed from 0. It behaves like NOR flash:
+an erased byte reads 0xff, and writing can only clear bits, so a location must
+be erased (one page at a time) before it is written again. The address and
+length passed to nvmem_write() must both be multiples of 4 bytes.
+
+The CPU may stall, with interrupts held off, for PORT_NVMEM_ERASE_US while a
+page is erased and PORT_NVMEM_WRITE_US for each 4-byte word written. Callers
+only erase or write when nothing else needs the CPU for that long.
+*/
+
+#include <stdint.h>
+#include "board_info.h"
+
+//=========================== define ==========================================
+
+//=========================== typedef =========================================
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+void nvmem_init(void);
+void nvmem_erasePage(uint8_t page);
+void nvmem_write(uint16_t address, uint8_t* buf, uint16_t len);
+void nvmem_read(uint16_t address, uint8_t* buf, uint16_t len);
+
+/**
+\}
+\}
+*/
+
+#endif
@@ -61,6 +61,26 @@
 
 #define SYNC_ACCURACY                       1 // when using openmoteSTM, change to 2
 
+//===== non-volatile memory
+
+#define PORT_NVMEM_PAGE_SIZE                2048  // bytes, erased as a whole
+#define PORT_NVMEM_NUM_PAGES                4
+#define PORT_NVMEM_ERASE_US                 0     // the simulated memory takes no time
+#define PORT_NVMEM_WRITE_US                 0
+
+//===== energy accounting, currents in uA (see energy.h)
+
+// the simulated motes are accounted for as TelosB motes
+#define PORT_CURRENT_SLEEP                  6
+#define PORT_CURRENT_CPU                    1800
+#define PORT_CURRENT_RADIO_IDLE             426
+#define PORT_CURRENT_RADIO_RX               18800
+#define PORT_CURRENT_RADIO_TX               { \
+   {   0,17400}, {  -1,16500}, {  -3,15200}, {  -5,13900}, \
+   {  -7,12500}, { -10,11200}, { -15, 9900}, { -25, 8500}, \
+}
+#define PORT_BATTERY_CAPACITY               2500  // mAh, 2xAA
+
 //=========================== typedef  ========================================
 
 //=========================== variables =======================================
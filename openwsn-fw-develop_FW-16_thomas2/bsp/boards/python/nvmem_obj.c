@@ -0,0 +1,148 @@
+/**
+\brief Python-specific definition of the "nvmem" bsp module.
+
+The non-volatile memory of each emulated mote is a file in the current
+directory, named after the mote's EUI64, so it survives the simulation being
+stopped and restarted.
+*/
+
+#include <stdio.h>
+#include "nvmem_obj.h"
+#include "eui64_obj.h"
+
+//=========================== defines =========================================
+
+#define NVMEM_SIZE (PORT_NVMEM_PAGE_SIZE*PORT_NVMEM_NUM_PAGES)
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+FILE* nvmem_open(OpenMote* self);
+
+//=========================== public ==========================================
+
+void nvmem_init(OpenMote* self) {
+   FILE*      f;
+
+#ifdef TRACE_ON
+   printf("C@0x%x: nvmem_init()... \n",self);
+#endif
+
+   // create the backing file, if needed
+   f = nvmem_open(self);
+   if (f!=NULL) {
+      fclose(f);
+   }
+
+#ifdef TRACE_ON
+   printf("C@0x%x: ...done.\n",self);
+#endif
+}
+
+void nvmem_erasePage(OpenMote* self, uint8_t page) {
+   FILE*      f;
+   uint8_t    erased[PORT_NVMEM_PAGE_SIZE];
+
+   if (page>=PORT_NVMEM_NUM_PAGES) {
+      return;
+   }
+
+   f = nvmem_open(self);
+   if (f==NULL) {
+      return;
+   }
+   memset(erased,0xff,sizeof(erased));
+   fseek(f,page*PORT_NVMEM_PAGE_SIZE,SEEK_SET);
+   fwrite(erased,1,sizeof(erased),f);
+   fclose(f);
+}
+
+void nvmem_write(OpenMote* self, uint16_t address, uint8_t* buf, uint16_t len) {
+   FILE*      f;
+   uint8_t    current[PORT_NVMEM_PAGE_SIZE];
+   uint16_t   chunk;
+   uint16_t   i;
+
+   if (address+len>NVMEM_SIZE) {
+      return;
+   }
+
+   f = nvmem_open(self);
+   if (f==NULL) {
+      return;
+   }
+   while (len>0) {
+      chunk = len<sizeof(current) ? len : sizeof(current);
+
+      // like flash, writing can only clear bits
+      fseek(f,address,SEEK_SET);
+      fread(current,1,chunk,f);
+      for (i=0;i<chunk;i++) {
+         current[i] &= buf[i];
+      }
+      fseek(f,address,SEEK_SET);
+      fwrite(current,1,chunk,f);
+
+      address += chunk;
+      buf     += chunk;
+      len     -= chunk;
+   }
+   fclose(f);
+}
+
+void nvmem_read(OpenMote* self, uint16_t address, uint8_t* buf, uint16_t len) {
+   FILE*      f;
+
+   memset(buf,0xff,len);
+   if (address+len>NVMEM_SIZE) {
+      return;
+   }
+
+   f = nvmem_open(self);
+   if (f==NULL) {
+      return;
+   }
+   fseek(f,address,SEEK_SET);
+   fread(buf,1,len,f);
+   fclose(f);
+}
+
+//=========================== private =========================================
+
+/**
+\brief Open this mote's backing file, creating it fully erased if needed.
+
+\returns The open file, or NULL if it cannot be opened.
+*/
+FILE* nvmem_open(OpenMote* self) {
+   FILE*      f;
+   char       filename[32];
+   uint8_t    eui64[8];
+   uint8_t    erased[PORT_NVMEM_PAGE_SIZE];
+   uint8_t    i;
+
+   eui64_get(self,eui64);
+   sprintf(
+      filename,
+      "nvmem_%02x%02x%02x%02x%02x%02x%02x%02x.bin",
+      eui64[0],eui64[1],eui64[2],eui64[3],
+      eui64[4],eui64[5],eui64[6],eui64[7]
+   );
+
+   f = fopen(filename,"r+b");
+   if (f!=NULL) {
+      return f;
+   }
+
+   f = fopen(filename,"w+b");
+   if (f==NULL) {
+      printf("[CRITICAL] nvmem could not create %s\r\n",filename);
+      return NULL;
+   }
+   memset(erased,0xff,sizeof(erased));
+   for (i=0;i<PORT_NVMEM_NUM_PAGES;i++) {
+      fwrite(erased,1,sizeof(erased),f);
+   }
+   return f;
+}
@@ -13,13 +13,16 @@
 // OpenWSN
 #include "openserial_obj.h"
 #include "opentimers_obj.h"
+#include "energy_obj.h"
 #include "scheduler_obj.h"
 #include "IEEE802154E_obj.h"
+#include "IEEE802154_security_obj.h"
 #include "adaptive_sync_obj.h"
 #include "neighbors_obj.h"
 #include "processIE_obj.h"
 #include "sixtop_obj.h"
 #include "schedule_obj.h"
+#include "openbridge_obj.h"
 #include "icmpv6echo_obj.h"
 #include "icmpv6rpl_obj.h"
 #include "opencoap_obj.h"
@@ -27,6 +30,7 @@
 #include "idmanager_obj.h"
 #include "openqueue_obj.h"
 #include "openrandom_obj.h"
+#include "persist_obj.h"
 // applications
 #include "c6t_obj.h"
 #include "cexample_obj.h"
@@ -140,6 +144,8 @@ enum {
    MOTE_NOTIF_uart_writeCircularBuffer_FASTSIM,
    MOTE_NOTIF_uart_writeBufferByLen_FASTSIM,
    MOTE_NOTIF_uart_readByte,
+   // radio, after the others not to renumber them
+   MOTE_NOTIF_radio_setTxPower,
    // last
    MOTE_NOTIF_LAST
 };
@@ -191,6 +197,7 @@ struct OpenMote {
    opencoap_vars_t      opencoap_vars;
    tcp_vars_t           tcp_vars;
    // l3
+   openbridge_vars_t    openbridge_vars;
    // l2b
    sixtop_vars_t        sixtop_vars;
    neighbors_vars_t     neighbors_vars;
@@ -200,13 +207,16 @@ struct OpenMote {
    ieee154e_vars_t      ieee154e_vars;
    ieee154e_stats_t     ieee154e_stats;
    ieee154e_dbg_t       ieee154e_dbg;
+   ieee802154_security_vars_t ieee802154_security_vars;
    // cross-layer
    idmanager_vars_t     idmanager_vars;
    openqueue_vars_t     openqueue_vars;
+   persist_vars_t       persist_vars;
    // drivers
    opentimers_vars_t    opentimers_vars;
    random_vars_t        random_vars;
    openserial_vars_t    openserial_vars;
+   energy_vars_t        energy_vars;
    // kernel
    scheduler_vars_t     scheduler_vars;
    scheduler_dbg_t      scheduler_dbg;
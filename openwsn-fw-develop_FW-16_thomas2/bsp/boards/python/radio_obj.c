@@ -245,6 +245,34 @@ void radio_setFrequency(OpenMote* self, uint8_t frequency) {
 #endif
 }
 
+void radio_setTxPower(OpenMote* self, int8_t power) {
+   PyObject*   result;
+   PyObject*   arglist;
+   
+#ifdef TRACE_ON
+   printf("C@0x%x: radio_setTxPower(power=%d)... \n",self,power);
+#endif
+   
+   // the simulator may not model the transmit power
+   if (self->callback[MOTE_NOTIF_radio_setTxPower]==NULL) {
+      return;
+   }
+   
+   // forward to Python
+   arglist    = Py_BuildValue("(i)",power);
+   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radio_setTxPower],arglist);
+   if (result == NULL) {
+      printf("[CRITICAL] radio_setTxPower() returned NULL\r\n");
+      return;
+   }
+   Py_DECREF(result);
+   Py_DECREF(arglist);
+   
+#ifdef TRACE_ON
+   printf("C@0x%x: ...done.\n",self);
+#endif
+}
+
 void radio_rfOn(OpenMote* self) {
    PyObject*   result;
    
@@ -402,6 +430,51 @@ void radio_rxNow(OpenMote* self) {
 #endif
 }
 
+uint8_t radio_peekReceivedFrame(OpenMote* self, uint8_t* bufRead, uint8_t maxBufLen) {
+   PyObject*  result;
+   PyObject*  item;
+   PyObject*  subitem;
+   uint8_t    lenRead;
+   uint8_t    i;
+   
+#ifdef TRACE_ON
+   printf("C@0x%x: radio_peekReceivedFrame()... \n",self);
+#endif
+   
+   // the simulated radio has the whole frame from its start, ask for it as
+   // for a complete one. If the simulator refuses, this is not an error: the
+   // frame is then only read once complete.
+   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radio_getReceivedFrame],NULL);
+   if (result == NULL) {
+      PyErr_Clear();
+      return 0;
+   }
+   if (!PySequence_Check(result) || PyTuple_Size(result)!=4) {
+      Py_DECREF(result);
+      return 0;
+   }
+   
+   // only keep the first bytes of rxBuffer
+   item       = PyTuple_GetItem(result,0);
+   lenRead    = maxBufLen;
+   if (PyList_Size(item)<lenRead) {
+      lenRead = PyList_Size(item);
+   }
+   for (i=0;i<lenRead;i++) {
+      subitem    = PyList_GetItem(item,i);
+      bufRead[i] = (uint8_t)PyInt_AsLong(subitem);
+   }
+   
+   // dispose of returned value
+   Py_DECREF(result);
+   
+#ifdef TRACE_ON
+   printf("C@0x%x: ...got %d bytes.\n",self,lenRead);
+#endif
+   
+   return lenRead;
+}
+
 void radio_getReceivedFrame(OpenMote* self,
                              uint8_t* pBufRead,
                              uint8_t* pLenRead,
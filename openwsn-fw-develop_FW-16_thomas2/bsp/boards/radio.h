@@ -63,6 +63,7 @@ void     radio_setTimerPeriod(PORT_TIMER_WIDTH period);
 PORT_TIMER_WIDTH radio_getTimerPeriod(void);
 // RF admin
 void     radio_setFrequency(uint8_t frequency);
+void     radio_setTxPower(int8_t power);
 void     radio_rfOn(void);
 void     radio_rfOff(void);
 // TX
@@ -78,6 +79,7 @@ void     radio_getReceivedFrame(uint8_t* bufRead,
                                  int8_t* rssi,
                                 uint8_t* lqi,
                                    bool* crc);
+uint8_t  radio_peekReceivedFrame(uint8_t* bufRead, uint8_t maxBufLen);
 
 // interrupt handlers
 kick_scheduler_t   radio_isr(void);
@@ -63,6 +63,7 @@ to this board.
 #define PORT_maxRxAckPrepare                20    //   610us (measured  474us)
 #define PORT_maxRxDataPrepare               33    //  1000us (measured  477us)
 #define PORT_maxTxAckPrepare                40    //   792us (measured  746us)- cannot be bigger than 28.. is the limit for telosb as actvitiy_rt5 is executed almost there.
+#define PORT_maxTxDataPreparePreloaded      40    //  1221us (frame already in the TXFIFO, not measured)
 
 // radio speed related
 #define PORT_delayTx                        12    //   366us (measured  352us)
@@ -72,6 +73,22 @@ to this board.
 
 #define SYNC_ACCURACY                       1     // ticks
 
+//===== radio
+
+#define BOARD_RADIO_KEEPS_TXBUFFER          1     // CC2420 TXFIFO is kept through SRFOFF and sleep, see prepareNextData()
+
+//===== energy accounting, currents in uA (see energy.h)
+
+#define PORT_CURRENT_SLEEP                  6     // MSP430 in LPM3, CC2420 voltage regulator off
+#define PORT_CURRENT_CPU                    1800  // MSP430 active at 4MHz
+#define PORT_CURRENT_RADIO_IDLE             426   // CC2420 oscillator running
+#define PORT_CURRENT_RADIO_RX               18800 // CC2420 listening or receiving
+#define PORT_CURRENT_RADIO_TX               {     /* CC2420, dBm and uA, highest power first */ \
+   {   0,17400}, {  -1,16500}, {  -3,15200}, {  -5,13900}, \
+   {  -7,12500}, { -10,11200}, { -15, 9900}, { -25, 8500}, \
+}
+#define PORT_BATTERY_CAPACITY               2500  // mAh, 2xAA
+
 //=========================== variables =======================================
 
 // The variables below are used by CoAP's registration engine.
@@ -63,6 +63,7 @@ to this board.
 #define PORT_maxRxAckPrepare                20    //   610us (measured  474us)
 #define PORT_maxRxDataPrepare               33    //  1000us (measured  477us)
 #define PORT_maxTxAckPrepare                40    //   792us (measured  746us)- cannot be bigger than 28.. is the limit for telosb as actvitiy_rt5 is executed almost there.
+#define PORT_maxTxDataPreparePreloaded      40    //  1221us (frame already in the TXFIFO, not measured)
 
 // radio speed related
 #define PORT_delayTx                        12    //   366us (measured  352us)
@@ -72,6 +73,10 @@ to this board.
 
 #define SYNC_ACCURACY                       1     // ticks
 
+//===== radio
+
+#define BOARD_RADIO_KEEPS_TXBUFFER          1     // CC2420 TXFIFO is kept through SRFOFF and sleep, see prepareNextData()
+
 //=========================== variables =======================================
 
 // The variables below are used by CoAP's registration engine.
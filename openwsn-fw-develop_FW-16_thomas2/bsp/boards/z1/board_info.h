@@ -65,6 +65,7 @@ to return the board's description.
 #define PORT_maxRxAckPrepare                20    //  305us (measured  83us)
 #define PORT_maxRxDataPrepare               33    // 1007us (measured  84us)
 #define PORT_maxTxAckPrepare                40    //  305us (measured 219us)
+#define PORT_maxTxDataPreparePreloaded      33    // 1007us (frame already in the TXFIFO, not measured)
 // radio speed related
 #define PORT_delayTx                        12     //  214us (measured 219us)
 #define PORT_delayRx                        0     //    0us (can not measure)
@@ -74,6 +75,10 @@ to return the board's description.
 
 #define SYNC_ACCURACY                       1     // ticks
 
+//===== radio
+
+#define BOARD_RADIO_KEEPS_TXBUFFER          1     // CC2420 TXFIFO is kept through SRFOFF and sleep, see prepareNextData()
+
 //=========================== typedef  ========================================
 
 //=========================== variables =======================================
@@ -52,6 +52,12 @@ typedef struct {
 
 radio_vars_t radio_vars;
 
+// output power in dBm for each value of the TX_PWR field, from the datasheet,
+// rounded down
+static const int8_t radio_txPowerLevels[16] = {
+   4, 3, 3, 3, 2, 2, 1, 0, -1, -2, -3, -4, -6, -8, -12, -17
+};
+
 //=========================== prototypes ======================================
 
 void    radio_spiWriteReg(uint8_t reg_addr, uint8_t reg_setting);
@@ -148,6 +154,25 @@ void radio_setFrequency(uint8_t frequency) {
    radio_vars.state = RADIOSTATE_FREQUENCY_SET;
 }
 
+/**
+\brief Set the power the next frames are transmitted at.
+
+Picks the lowest level not below the requested power, or the highest level.
+
+\param[in] power The requested output power, in dBm.
+*/
+void radio_setTxPower(int8_t power) {
+   uint8_t i;
+   
+   i = 0;
+   while (i+1<sizeof(radio_txPowerLevels) && radio_txPowerLevels[i+1]>=power) {
+      i++;
+   }
+   
+   // the other bits of the register are left untouched
+   radio_spiWriteReg(RG_PHY_TX_PWR,(radio_spiReadReg(RG_PHY_TX_PWR) & 0xf0) | i);
+}
+
 void radio_rfOn() {
    PORT_PIN_RADIO_RESET_LOW();
 }
@@ -245,6 +270,65 @@ void radio_rxNow() {
    // nothing to do
 }
 
+/**
+\brief Read the first bytes of the frame being received.
+
+The frame buffer can be read while the radio is still filling it, and reading
+it does not remove anything from it.
+
+\returns The number of bytes written to bufRead.
+*/
+uint8_t radio_peekReceivedFrame(uint8_t* bufRead, uint8_t maxBufLen) {
+   // when reading the frame buffer over SPI, you get the following:
+   // - *[1B]     dummy byte because of SPI
+   // - *[1B]     length byte
+   // -  [0-125B] packet
+   uint8_t spi_tx_buffer[16];
+   uint8_t spi_rx_buffer[2];
+   uint8_t len;
+   
+   spi_tx_buffer[0] = 0x20;
+   
+   // 2 first bytes
+   spi_txrx(spi_tx_buffer,
+            2,
+            SPI_BUFFER,
+            spi_rx_buffer,
+            sizeof(spi_rx_buffer),
+            SPI_FIRST,
+            SPI_NOTLAST);
+   
+   len = maxBufLen;
+   if (len>sizeof(spi_tx_buffer)) {
+      len = sizeof(spi_tx_buffer);
+   }
+   if (len>spi_rx_buffer[1]) {
+      len = spi_rx_buffer[1];
+   }
+   
+   if (len>0) {
+      // first bytes of the packet
+      spi_txrx(spi_tx_buffer,
+               len,
+               SPI_BUFFER,
+               bufRead,
+               len,
+               SPI_NOTFIRST,
+               SPI_LAST);
+   } else {
+      // read a just byte to close spi
+      spi_txrx(spi_tx_buffer,
+               1,
+               SPI_BUFFER,
+               spi_rx_buffer,
+               sizeof(spi_rx_buffer),
+               SPI_NOTFIRST,
+               SPI_LAST);
+   }
+   
+   return len;
+}
+
 void radio_getReceivedFrame(uint8_t* pBufRead,
                             uint8_t* pLenRead,
                             uint8_t  maxBufLen,
@@ -230,6 +230,16 @@ void radio_setFrequency(uint8_t frequency) {
   
 }
 
+/**
+\brief Set the power the next frames are transmitted at.
+
+Not supported by this driver, which keeps the power of the PATABLE at reset.
+
+\param[in] power The requested output power, in dBm.
+*/
+void radio_setTxPower(int8_t power) {
+}
+
 void radio_rfOn() {
   // crystal oscillator already on
 }
@@ -313,6 +323,18 @@ void radio_rxNow() {
   // nothing to do, the radio is already listening.
 }
 
+/**
+\brief Read the first bytes of the frame being received.
+
+Reading the RXFIFO removes the bytes from it, so the frame is only read once
+complete.
+
+\returns 0, no bytes are read.
+*/
+uint8_t radio_peekReceivedFrame(uint8_t* bufRead, uint8_t maxBufLen) {
+   return 0;
+}
+
 void radio_getReceivedFrame(uint8_t* bufRead,
                             uint8_t* lenRead,
                             uint8_t maxBufLen,
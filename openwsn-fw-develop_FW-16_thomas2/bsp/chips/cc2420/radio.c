@@ -22,6 +22,23 @@ typedef struct {
 
 radio_vars_t radio_vars;
 
+typedef struct {
+   uint8_t         paLevel;            // PA_LEVEL field of the TXCTRL register
+   int8_t          power;              // resulting output power, in dBm
+} radio_txPowerLevel_t;
+
+// from the datasheet, highest power first
+static const radio_txPowerLevel_t radio_txPowerLevels[] = {
+   {31,  0},
+   {27, -1},
+   {23, -3},
+   {19, -5},
+   {15, -7},
+   {11,-10},
+   { 7,-15},
+   { 3,-25},
+};
+
 //=========================== prototypes ======================================
 
 void radio_spiStrobe     (uint8_t strobe, cc2420_status_t* statusRead);
@@ -181,6 +198,40 @@ void radio_setFrequency(uint8_t frequency) {
    radio_vars.state = RADIOSTATE_FREQUENCY_SET;
 }
 
+/**
+\brief Set the power the next frames are transmitted at.
+
+Picks the lowest level not below the requested power, or the highest level.
+
+\param[in] power The requested output power, in dBm.
+*/
+void radio_setTxPower(int8_t power) {
+   cc2420_TXCTRL_reg_t cc2420_TXCTRL_reg;
+   uint8_t             i;
+   
+   i = 0;
+   while (
+         i+1<sizeof(radio_txPowerLevels)/sizeof(radio_txPowerLevel_t) &&
+         radio_txPowerLevels[i+1].power>=power
+      ) {
+      i++;
+   }
+   
+   // same fields as in radio_reset(), the register is written as a whole
+   cc2420_TXCTRL_reg.PA_LEVEL               = radio_txPowerLevels[i].paLevel;
+   cc2420_TXCTRL_reg.reserved_w1            = 1;
+   cc2420_TXCTRL_reg.PA_CURRENT             = 3;
+   cc2420_TXCTRL_reg.TXMIX_CURRENT          = 0;
+   cc2420_TXCTRL_reg.TXMIX_CAP_ARRAY        = 0;
+   cc2420_TXCTRL_reg.TX_TURNAROUND          = 0;
+   cc2420_TXCTRL_reg.TXMIXBUF_CUR           = 2;
+   radio_spiWriteReg(
+      CC2420_TXCTRL_ADDR,
+      &radio_vars.radioStatusByte,
+      *(uint16_t*)&cc2420_TXCTRL_reg
+   );
+}
+
 void radio_rfOn(void) {   
    radio_spiStrobe(CC2420_SXOSCON, &radio_vars.radioStatusByte);
    while (radio_vars.radioStatusByte.xosc16m_stable==0) {
@@ -265,6 +316,18 @@ void radio_rxNow(void) {
    // nothing to do, the radio is already listening.
 }
 
+/**
+\brief Read the first bytes of the frame being received.
+
+Reading the RXFIFO removes the bytes from it, so the frame is only read once
+complete.
+
+\returns 0, no bytes are read.
+*/
+uint8_t radio_peekReceivedFrame(uint8_t* bufRead, uint8_t maxBufLen) {
+   return 0;
+}
+
 void radio_getReceivedFrame(
       uint8_t* bufRead,
       uint8_t* lenRead,
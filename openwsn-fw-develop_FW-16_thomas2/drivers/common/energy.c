@@ -0,0 +1,251 @@
+/**
+\brief Definition of the "energy" driver.
+
+The time spent in each state is integrated in radio timer ticks. Every time the
+radio or the CPU changes state, the ticks elapsed since the last change are
+added to the counter of the state being left. When a slot ends, the rest of it
+is added, and counting starts over from 0, as the radio timer does.
+
+The average current is the sleep floor, plus the current of each state weighted
+by the fraction of time spent in it. Once the counters pass
+ENERGY_WINDOW_LIMIT, they are all halved, so the average follows the recent
+activity of the mote, as the duty cycle accounting of the MAC does.
+*/
+
+#include "opendefs.h"
+#include "energy.h"
+#include "radio.h"
+#include "openserial.h"
+
+//=========================== defines =========================================
+
+#define ENERGY_NUMTXLEVELS        (sizeof(energy_txCurrents)/sizeof(energy_txCurrent_t))
+
+//=========================== variables =======================================
+
+energy_vars_t energy_vars;
+
+static const energy_txCurrent_t energy_txCurrents[] = PORT_CURRENT_RADIO_TX;
+
+//=========================== prototypes ======================================
+
+void energy_accountTicks(PORT_TIMER_WIDTH now);
+
+//=========================== public ==========================================
+
+void energy_init() {
+   memset(&energy_vars,0,sizeof(energy_vars_t));
+   
+   // the CPU is running the code which called this function
+   energy_vars.cpuNesting    = 1;
+   energy_vars.radioState    = ENERGY_RADIO_OFF;
+   energy_vars.lastEvent     = radio_getTimerValue();
+}
+
+/**
+\brief Indicates the radio timer just wrapped, at the end of a slot.
+
+\param[in] period The period of the radio timer which just ended.
+*/
+void energy_indicateNewPeriod(PORT_TIMER_WIDTH period) {
+   INTERRUPT_DECLARATION();
+   
+   DISABLE_INTERRUPTS();
+   energy_accountTicks(period);
+   energy_vars.lastEvent     = 0;
+   ENABLE_INTERRUPTS();
+}
+
+/**
+\brief Indicates the CPU is running, for the scheduler or an interrupt.
+
+Calls nest: the CPU is only accounted for as sleeping once each call has been
+matched by a call to energy_cpuExit().
+*/
+void energy_cpuEnter() {
+   INTERRUPT_DECLARATION();
+   
+   DISABLE_INTERRUPTS();
+   energy_accountTicks(radio_getTimerValue());
+   energy_vars.cpuNesting++;
+   ENABLE_INTERRUPTS();
+}
+
+/**
+\brief Indicates the CPU is done, and goes back to sleep unless still needed.
+*/
+void energy_cpuExit() {
+   INTERRUPT_DECLARATION();
+   
+   DISABLE_INTERRUPTS();
+   energy_accountTicks(radio_getTimerValue());
+   if (energy_vars.cpuNesting>0) {
+      energy_vars.cpuNesting--;
+   }
+   ENABLE_INTERRUPTS();
+}
+
+/**
+\brief Indicates the radio was just put in a different state.
+
+\param[in] state The new state of the radio, one of ENERGY_RADIO_*.
+*/
+void energy_radioState(uint8_t state) {
+   INTERRUPT_DECLARATION();
+   
+   if (state==energy_vars.radioState) {
+      return;
+   }
+   DISABLE_INTERRUPTS();
+   energy_accountTicks(radio_getTimerValue());
+   energy_vars.radioState    = state;
+   ENABLE_INTERRUPTS();
+}
+
+/**
+\brief Indicates the power the radio transmits at from now on.
+
+As the radio drivers do, the lowest level of the table at or above the
+requested power is used.
+
+\param[in] power The transmit power, in dBm.
+*/
+void energy_radioTxPower(int8_t power) {
+   uint8_t i;
+   INTERRUPT_DECLARATION();
+   
+   i = ENERGY_NUMTXLEVELS;
+   if (i>ENERGY_MAXTXLEVELS) {
+      i = ENERGY_MAXTXLEVELS;
+   }
+   while (i>1 && energy_txCurrents[i-1].power<power) {
+      i--;
+   }
+   i--;
+   if (i==energy_vars.txLevel) {
+      return;
+   }
+   DISABLE_INTERRUPTS();
+   if (energy_vars.radioState==ENERGY_RADIO_TX) {
+      energy_accountTicks(radio_getTimerValue());
+   }
+   energy_vars.txLevel       = i;
+   ENABLE_INTERRUPTS();
+}
+
+/**
+\brief Compute the average current, and what it means for the battery.
+
+The counters are shifted right until the total fits in 16 bits, so the share of
+each state, current times ticks, fits in 32 bits.
+
+\param[out] status Where to write the average currents and battery projection.
+*/
+void energy_getStatus(energy_status_t* status) {
+   energy_vars_t vars;
+   uint32_t      total;
+   uint32_t      current;
+   uint8_t       shift;
+   uint8_t       i;
+   INTERRUPT_DECLARATION();
+   
+   DISABLE_INTERRUPTS();
+   memcpy(&vars,&energy_vars,sizeof(energy_vars_t));
+   ENABLE_INTERRUPTS();
+   
+   memset(status,0,sizeof(energy_status_t));
+   
+   shift = 0;
+   while ((vars.ticksTotal>>shift)>0xffff) {
+      shift++;
+   }
+   total = vars.ticksTotal>>shift;
+   
+   if (total>0) {
+      status->currentCpu       = (uint32_t)PORT_CURRENT_CPU*(vars.ticksCpu>>shift)/total;
+      status->currentRadioIdle = (uint32_t)PORT_CURRENT_RADIO_IDLE*(vars.ticksIdle>>shift)/total;
+      status->currentRadioRx   = (uint32_t)PORT_CURRENT_RADIO_RX*(vars.ticksRx>>shift)/total;
+      for (i=0;i<ENERGY_NUMTXLEVELS && i<ENERGY_MAXTXLEVELS;i++) {
+         status->currentRadioTx += (uint32_t)energy_txCurrents[i].current*(vars.ticksTx[i]>>shift)/total;
+      }
+   }
+   
+   current = (uint32_t)PORT_CURRENT_SLEEP       +
+             status->currentCpu                 +
+             status->currentRadioIdle           +
+             status->currentRadioRx             +
+             status->currentRadioTx;
+   if (current>0xffff) {
+      current = 0xffff;
+   }
+   status->current       = (uint16_t)current;
+   
+   // 1uA during 1h is 3600uC
+   status->chargePerHour = current*3600;
+   if (current>0) {
+      status->lifetime   = (uint32_t)PORT_BATTERY_CAPACITY*1000/current;
+   } else {
+      status->lifetime   = 0xffffffff;
+   }
+}
+
+/**
+\brief Trigger this module to print status information, over serial.
+
+debugPrint_* functions are used by the openserial module to continuously print
+status information about several modules in the OpenWSN stack.
+
+\returns TRUE if this function printed something, FALSE otherwise.
+*/
+bool debugPrint_energy() {
+   energy_status_t output;
+   
+   energy_getStatus(&output);
+   return openserial_printStatusDelta(STATUS_ENERGY,NULL,(uint8_t*)&output,sizeof(output));
+}
+
+//=========================== private =========================================
+
+/**
+\brief Add the ticks elapsed since the last event to the current states.
+
+Called with interrupts disabled.
+
+\param[in] now The current value of the radio timer.
+*/
+void energy_accountTicks(PORT_TIMER_WIDTH now) {
+   PORT_TIMER_WIDTH elapsed;
+   uint8_t          i;
+   
+   // the timer may have been adjusted by the synchronization since
+   elapsed = (now>energy_vars.lastEvent)?now-energy_vars.lastEvent:0;
+   energy_vars.lastEvent     = now;
+   
+   energy_vars.ticksTotal   += elapsed;
+   if (energy_vars.cpuNesting>0) {
+      energy_vars.ticksCpu  += elapsed;
+   }
+   switch (energy_vars.radioState) {
+      case ENERGY_RADIO_IDLE:
+         energy_vars.ticksIdle += elapsed;
+         break;
+      case ENERGY_RADIO_RX:
+         energy_vars.ticksRx   += elapsed;
+         break;
+      case ENERGY_RADIO_TX:
+         energy_vars.ticksTx[energy_vars.txLevel] += elapsed;
+         break;
+      default:
+         break;
+   }
+   
+   if (energy_vars.ticksTotal>ENERGY_WINDOW_LIMIT) {
+      energy_vars.ticksTotal  /= 2;
+      energy_vars.ticksCpu    /= 2;
+      energy_vars.ticksIdle   /= 2;
+      energy_vars.ticksRx     /= 2;
+      for (i=0;i<ENERGY_MAXTXLEVELS;i++) {
+         energy_vars.ticksTx[i] /= 2;
+      }
+   }
+}
@@ -0,0 +1,102 @@
+/**
+\brief Declaration of the "energy" driver.
+
+Accounts for the charge drawn by the mote, from the time spent in each state of
+the radio (off, idle, listening, transmitting at each power level) and of the
+CPU (active or sleeping), weighted by the current the board draws in that
+state. The currents are taken from board_info.h; a board which does not define
+them is accounted for with the TelosB numbers.
+
+Time is read from the radio timer. The MAC tells this module when a slot starts
+and whenever it changes the state of the radio; the scheduler tells it when the
+CPU goes to sleep and wakes up.
+*/
+
+#ifndef __ENERGY_H
+#define __ENERGY_H
+
+#include "opendefs.h"
+
+/**
+\addtogroup drivers
+\{
+\addtogroup Energy
+\{
+*/
+
+//=========================== define ==========================================
+
+#define ENERGY_MAXTXLEVELS        16
+#define ENERGY_WINDOW_LIMIT       0x10000000 // ticks, the counters are halved past this (~2h at 32kHz)
+
+//===== default currents (TelosB), in uA
+
+#ifndef PORT_CURRENT_SLEEP
+#define PORT_CURRENT_SLEEP        6          // MSP430 in LPM3, CC2420 voltage regulator off
+#define PORT_CURRENT_CPU          1800       // MSP430 active at 4MHz
+#define PORT_CURRENT_RADIO_IDLE   426        // CC2420 oscillator running
+#define PORT_CURRENT_RADIO_RX     18800      // CC2420 listening or receiving
+#define PORT_CURRENT_RADIO_TX     {          /* CC2420, dBm and uA, highest power first */ \
+   {   0,17400}, {  -1,16500}, {  -3,15200}, {  -5,13900}, \
+   {  -7,12500}, { -10,11200}, { -15, 9900}, { -25, 8500}, \
+}
+#define PORT_BATTERY_CAPACITY     2500       // mAh, 2xAA
+#endif
+
+//=========================== typedef =========================================
+
+enum {
+   ENERGY_RADIO_OFF               = 0,
+   ENERGY_RADIO_IDLE              = 1,       // on, neither listening nor transmitting
+   ENERGY_RADIO_RX                = 2,
+   ENERGY_RADIO_TX                = 3,
+};
+
+typedef struct {
+   int8_t               power;               // dBm
+   uint16_t             current;             // uA
+} energy_txCurrent_t;
+
+BEGIN_PACK
+typedef struct {
+   uint32_t             chargePerHour;       // uC drawn per hour, at the average current
+   uint32_t             lifetime;            // hours left on a full battery, at that rate
+   uint16_t             current;             // uA, average, including the sleep floor
+   uint16_t             currentCpu;          // uA, share of the CPU
+   uint16_t             currentRadioIdle;    // uA, share of the radio when idle
+   uint16_t             currentRadioRx;      // uA, share of the radio when listening
+   uint16_t             currentRadioTx;      // uA, share of the radio when transmitting
+} energy_status_t;
+END_PACK
+
+//=========================== module variables ================================
+
+typedef struct {
+   uint32_t             ticksTotal;          // accounted for, since boot or the last halving
+   uint32_t             ticksCpu;            // CPU active
+   uint32_t             ticksIdle;           // radio idle
+   uint32_t             ticksRx;             // radio listening
+   uint32_t             ticksTx[ENERGY_MAXTXLEVELS]; // radio transmitting, per power level
+   PORT_TIMER_WIDTH     lastEvent;           // radio timer value when last accounted for
+   uint8_t              cpuNesting;          // number of reasons the CPU is awake
+   uint8_t              radioState;          // ENERGY_RADIO_*
+   uint8_t              txLevel;             // index in the table of TX currents
+} energy_vars_t;
+
+//=========================== prototypes ======================================
+
+void energy_init(void);
+void energy_indicateNewPeriod(PORT_TIMER_WIDTH period);
+void energy_cpuEnter(void);
+void energy_cpuExit(void);
+void energy_radioState(uint8_t state);
+void energy_radioTxPower(int8_t power);
+void energy_getStatus(energy_status_t* status);
+bool debugPrint_energy(void);
+
+/**
+\}
+\}
+*/
+
+#endif
@@ -1,6 +1,10 @@
 /**
 \brief Definition of the "openserial" driver.
 
+Besides the byte-wise CRC iteration, this module offers bulk routines which
+process whole buffers in a single pass: spans of bytes which need no escaping
+are found through a precomputed bitmap, and copied in one go.
+
 \author Min Ting <tingm417@gmail.com>, October 2012.
 \author Fabien Chraim <chraim@eecs.berkeley.edu>, October 2012.
 */
@@ -17,4 +21,101 @@ uint16_t crcIteration(uint16_t crc, uint8_t byte) {
    return (crc >> 8) ^ fcstab[(crc ^ byte) & 0xff];
 }
 
+/**
+\brief Iterate the CRC over a whole buffer.
+*/
+uint16_t openhdlc_crc(uint16_t crc, uint8_t* buf, uint8_t len) {
+   while (len>0) {
+      crc = (crc >> 8) ^ fcstab[(crc ^ *buf++) & 0xff];
+      len--;
+   }
+   return crc;
+}
+
+/**
+\brief Copy the leading bytes of a buffer which need no unescaping.
+
+Copying stops at the first HDLC_FLAG or HDLC_ESCAPE, or after len bytes; the
+CRC is iterated over the bytes copied, in the same pass.
+
+\param[out]    dst Where to copy the bytes to.
+\param[in,out] crc CRC of the frame.
+\param[in]     src The received (escaped) bytes.
+\param[in]     len Maximum number of bytes to copy.
+
+\returns The number of bytes copied.
+*/
+uint8_t openhdlc_decodeRun(uint8_t* dst, uint16_t* crc, uint8_t* src, uint8_t len) {
+   uint16_t c;
+   uint8_t  run;
+   
+   c = *crc;
+   for (run=0;run<len;run++) {
+      if (HDLC_NEEDS_ESCAPE(src[run])) {
+         break;
+      }
+      c = (c >> 8) ^ fcstab[(c ^ src[run]) & 0xff];
+   }
+   memcpy(dst,src,run);
+   *crc = c;
+   
+   return run;
+}
+
+/**
+\brief Escape a buffer into a 256-byte circular buffer, updating the CRC.
+
+Spans of bytes which need no escaping are copied in one go; the write index
+wraps around by itself since the circular buffer is exactly 256 bytes long.
+
+\param[in]     ring The 256-byte circular buffer to write to.
+\param[in]     idxW Index in ring of the first byte to write.
+\param[in,out] crc  CRC of the frame, iterated over the unescaped bytes.
+\param[in]     buf  The bytes to escape.
+\param[in]     len  Number of bytes in buf.
+
+\returns The index in ring following the last byte written.
+*/
+uint8_t openhdlc_encode(uint8_t* ring, uint8_t idxW, uint16_t* crc,
+                        uint8_t* buf, uint8_t len) {
+   uint16_t c;
+   uint8_t  run;
+   uint16_t chunk;
+   
+   c = *crc;
+   while (len>0) {
+      // find the span which needs no escaping, iterating the CRC over it
+      for (run=0;run<len;run++) {
+         if (HDLC_NEEDS_ESCAPE(buf[run])) {
+            break;
+         }
+         c = (c >> 8) ^ fcstab[(c ^ buf[run]) & 0xff];
+      }
+      
+      // copy that span, in 2 chunks if it wraps around
+      if (run>0) {
+         chunk = 256-idxW;
+         if (chunk>run) {
+            chunk = run;
+         }
+         memcpy(&ring[idxW],buf,chunk);
+         memcpy(&ring[0],&buf[chunk],run-chunk);
+         idxW += run;
+         buf  += run;
+         len  -= run;
+      }
+      
+      // escape the byte which ended the span
+      if (len>0) {
+         c = (c >> 8) ^ fcstab[(c ^ *buf) & 0xff];
+         ring[idxW++] = HDLC_ESCAPE;
+         ring[idxW++] = *buf++ ^ HDLC_ESCAPE_MASK;
+         len--;
+      }
+   }
+   *crc = c;
+   
+   return idxW;
+}
+
 //=========================== private =========================================
@@ -61,11 +61,26 @@ static const uint16_t fcstab[256] = {
    0x7bc7, 0x6a4e, 0x58d5, 0x495c, 0x3de3, 0x2c6a, 0x1ef1, 0x0f78
 };
 
+//this bitmap flags the bytes which need escaping (HDLC_FLAG and HDLC_ESCAPE)
+static const uint8_t hdlcEscapeMap[32] = {
+   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60,
+   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+#define HDLC_NEEDS_ESCAPE(b) ((hdlcEscapeMap[(uint8_t)(b)>>3]>>((b)&0x07))&0x01)
+
 //=========================== typedef =========================================
 
 //=========================== prototypes ======================================
 
 uint16_t crcIteration(uint16_t crc, uint8_t byte);
+uint16_t openhdlc_crc(uint16_t crc, uint8_t* buf, uint8_t len);
+uint8_t  openhdlc_decodeRun(uint8_t* dst, uint16_t* crc, uint8_t* src,
+                            uint8_t len);
+uint8_t  openhdlc_encode(uint8_t* ring, uint8_t idxW, uint16_t* crc,
+                         uint8_t* buf, uint8_t len);
 
 /**
 \}
@@ -1,6 +1,29 @@
 /**
 \brief Definition of the "openserial" driver.
 
+The serial link is full-duplex: bytes are received and transmitted under
+interrupt at any time, independently of the TSCH slot structure. Outgoing
+frames are appended to a circular output buffer which the TX interrupt drains.
+The RX interrupt only appends the bytes it receives to a raw input buffer;
+task_openserialInput() decodes them into a ring of complete frames and handles
+those. The request frames sent to the PC carry the number of free slots in that
+ring, i.e. how many frames the PC may send.
+
+HDLC encoding and decoding work on whole buffers (see openhdlc): spans of bytes
+which need no escaping are copied in one go, and the CRC is computed over them
+in a single pass.
+
+Status records are only sent when they changed since they were last sent, with
+a periodic keyframe at which every record is sent once more. Suppression is per
+record, not per field: a record in which anything changed is sent whole, so the
+PC decodes it as before. The PC chooses which status elements it wants, and how
+often a record may be sent.
+
+Info and error frames are aggregated per (component, error code): the first
+occurrence is sent right away when the rate limit allows it, later ones are
+counted and flushed as summaries at a bounded rate, so data and status frames
+keep their bandwidth during fault storms. Critical frames are always sent.
+
 \author Fabien Chraim <chraim@eecs.berkeley.edu>, March 2012.
 */
 
@@ -18,6 +41,8 @@
 #include "uart.h"
 #include "opentimers.h"
 #include "openhdlc.h"
+#include "scheduler.h"
+#include "energy.h"
 
 //=========================== variables =======================================
 
@@ -33,10 +58,28 @@ owerror_t openserial_printInfoErrorCritical(
    errorparameter_t arg2
 );
 // HDLC output
-void outputHdlcOpen(void);
+uint16_t outputHdlcLength(uint8_t* buf, uint8_t len);
+bool outputHdlcOpen(uint16_t len);
 void outputHdlcWrite(uint8_t b);
+void outputHdlcWriteBuf(uint8_t* buf, uint8_t len);
 void outputHdlcClose(void);
+void outputRequestFrame(void);
+void outputStartTx(void);
+// status
+bool printStatusElement(uint8_t statusElement);
+void inputSubscribeStatus(uint8_t* buf, uint8_t bufLen);
+// errors
+bool errorAggregate(
+   uint8_t          severity,
+   uint8_t          calling_component,
+   uint8_t          error_code,
+   errorparameter_t arg1,
+   errorparameter_t arg2
+);
+void errorFlush(void);
+bool outputErrorSummary(openserial_errorEntry_t* entry);
 // HDLC input
+void inputHdlcDecode(void);
 void inputHdlcOpen(void);
 void inputHdlcWrite(uint8_t b);
 void inputHdlcClose(void);
@@ -44,60 +87,127 @@ void inputHdlcClose(void);
 //=========================== public ==========================================
 
 void openserial_init() {
-   uint16_t crc;
    
    // reset variable
    memset(&openserial_vars,0,sizeof(openserial_vars_t));
    
    // admin
-   openserial_vars.mode                = MODE_OFF;
    openserial_vars.debugPrintCounter   = 0;
    
+   // status, the PC gets everything until it subscribes
+   openserial_vars.statusSubscribed    = (1<<STATUS_MAX)-1;
+   openserial_vars.statusPeriod        = 1;
+   openserial_vars.statusPeriodCounter = 0;
+   openserial_vars.statusKeyframeCounter = 0;
+   openserial_vars.statusEpoch         = 0;
+   
+   // errors
+   openserial_vars.errorTokens         = SERIAL_ERROR_MAXTOKENS;
+   openserial_vars.errorFlushCounter   = 0;
+   openserial_vars.errorFlushIdx       = 0;
+   openserial_vars.errorNumLost        = 0;
+   
    // input
-   openserial_vars.reqFrame[0]         = HDLC_FLAG;
-   openserial_vars.reqFrame[1]         = SERFRAME_MOTE2PC_REQUEST;
-   crc = HDLC_CRCINIT;
-   crc = crcIteration(crc,openserial_vars.reqFrame[1]);
-   crc = ~crc;
-   openserial_vars.reqFrame[2]         = (crc>>0)&0xff;
-   openserial_vars.reqFrame[3]         = (crc>>8)&0xff;
-   openserial_vars.reqFrame[4]         = HDLC_FLAG;
-   openserial_vars.reqFrameIdx         = 0;
    openserial_vars.lastRxByte          = HDLC_FLAG;
    openserial_vars.busyReceiving       = FALSE;
    openserial_vars.inputEscaping       = FALSE;
-   openserial_vars.inputBufFill        = 0;
+   openserial_vars.inputFrameIdxW      = 0;
+   openserial_vars.inputFrameIdxR      = 0;
+   openserial_vars.inputNumFrames      = 0;
    
    // ouput
-   openserial_vars.outputBufFilled     = FALSE;
+   openserial_vars.outputBusy          = FALSE;
    openserial_vars.outputBufIdxR       = 0;
    openserial_vars.outputBufIdxW       = 0;
    
    // set callbacks
    uart_setCallbacks(isr_openserial_tx,
                      isr_openserial_rx);
+   
+   // both directions stay enabled from now on
+   uart_clearTxInterrupts();
+   uart_clearRxInterrupts();      // clear possible pending interrupts
+   uart_enableInterrupts();       // Enable USCI_A1 TX & RX interrupt
+   
+   // tell the PC I'm ready to receive
+   outputRequestFrame();
 }
 
 owerror_t openserial_printStatus(uint8_t statusElement,uint8_t* buffer, uint8_t length) {
-   uint8_t i;
+   uint8_t  header[4];
+   uint8_t  outputBufIdxW;
+   uint16_t len;
    INTERRUPT_DECLARATION();
    
+   header[0] = SERFRAME_MOTE2PC_STATUS;
+   header[1] = idmanager_getMyID(ADDR_16B)->addr_16b[0];
+   header[2] = idmanager_getMyID(ADDR_16B)->addr_16b[1];
+   header[3] = statusElement;
+   len       = outputHdlcLength(header,sizeof(header))+outputHdlcLength(buffer,length);
+   
    DISABLE_INTERRUPTS();
-   openserial_vars.outputBufFilled  = TRUE;
-   outputHdlcOpen();
-   outputHdlcWrite(SERFRAME_MOTE2PC_STATUS);
-   outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[0]);
-   outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[1]);
-   outputHdlcWrite(statusElement);
-   for (i=0;i<length;i++){
-      outputHdlcWrite(buffer[i]);
+   outputBufIdxW = openserial_vars.outputBufIdxW;
+   if (outputHdlcOpen(len)==FALSE) {
+      ENABLE_INTERRUPTS();
+      return E_FAIL;
    }
+   outputHdlcWriteBuf(header,sizeof(header));
+   outputHdlcWriteBuf(buffer,length);
    outputHdlcClose();
+   openserial_vars.statusStats.numRecords++;
+   openserial_vars.statusStats.numBytes += (uint8_t)(openserial_vars.outputBufIdxW-outputBufIdxW);
+   outputStartTx();
    ENABLE_INTERRUPTS();
    
    return E_SUCCESS;
 }
 
+/**
+\brief Print a status record, unless it is the same as the one last sent.
+
+Records are compared through a 16-bit signature (the HDLC CRC) rather than a
+copy, so a module only needs to keep 2 bytes per record. This is why a changed
+record is sent whole: which of its fields changed is not known. The keyframe
+epoch is part of the signature: after a keyframe, every record looks changed and
+is sent once more.
+
+\param[in]     statusElement The STATUS_* element the record belongs to.
+\param[in,out] signature     Signature of the last record sent, updated when
+   this one is sent. NULL for elements with a single record, openserial then
+   keeps it.
+\param[in]     buffer        The record.
+\param[in]     length        Number of bytes in the record.
+
+\returns TRUE if the record was printed, FALSE if it was suppressed or did not
+   fit in the output buffer.
+*/
+bool openserial_printStatusDelta(uint8_t statusElement, uint16_t* signature,
+                              uint8_t* buffer, uint8_t length) {
+   uint16_t newSignature;
+   
+   if (signature==NULL) {
+      signature = &openserial_vars.statusSignature[statusElement];
+   }
+   
+   // compute the signature of the record
+   newSignature = crcIteration(HDLC_CRCINIT,openserial_vars.statusEpoch);
+   if ((SERIAL_STATUS_KEYFRAMEONLY & (1<<statusElement))==0) {
+      newSignature = openhdlc_crc(newSignature,buffer,length);
+   }
+   
+   if (newSignature==*signature) {
+      // the PC already knows this record
+      return FALSE;
+   }
+   
+   if (openserial_printStatus(statusElement,buffer,length)!=E_SUCCESS) {
+      // dropped, the record is still owed to the PC
+      return FALSE;
+   }
+   *signature = newSignature;
+   return TRUE;
+}
+
 owerror_t openserial_printInfoErrorCritical(
       char             severity,
       uint8_t          calling_component,
@@ -105,49 +215,61 @@ owerror_t openserial_printInfoErrorCritical(
       errorparameter_t arg1,
       errorparameter_t arg2
    ) {
+   uint8_t   frame[9];
+   owerror_t outcome;
    INTERRUPT_DECLARATION();
    
+   frame[0] = severity;
+   frame[1] = idmanager_getMyID(ADDR_16B)->addr_16b[0];
+   frame[2] = idmanager_getMyID(ADDR_16B)->addr_16b[1];
+   frame[3] = calling_component;
+   frame[4] = error_code;
+   frame[5] = (uint8_t)((arg1 & 0xff00)>>8);
+   frame[6] = (uint8_t) (arg1 & 0x00ff);
+   frame[7] = (uint8_t)((arg2 & 0xff00)>>8);
+   frame[8] = (uint8_t) (arg2 & 0x00ff);
+   
+   outcome  = E_SUCCESS;
    DISABLE_INTERRUPTS();
-   openserial_vars.outputBufFilled  = TRUE;
-   outputHdlcOpen();
-   outputHdlcWrite(severity);
-   outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[0]);
-   outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[1]);
-   outputHdlcWrite(calling_component);
-   outputHdlcWrite(error_code);
-   outputHdlcWrite((uint8_t)((arg1 & 0xff00)>>8));
-   outputHdlcWrite((uint8_t) (arg1 & 0x00ff));
-   outputHdlcWrite((uint8_t)((arg2 & 0xff00)>>8));
-   outputHdlcWrite((uint8_t) (arg2 & 0x00ff));
-   outputHdlcClose();
+   if (
+         severity==SERFRAME_MOTE2PC_CRITICAL ||
+         errorAggregate(severity,calling_component,error_code,arg1,arg2)==TRUE
+      ) {
+      if (outputHdlcOpen(outputHdlcLength(frame,sizeof(frame)))==TRUE) {
+         outputHdlcWriteBuf(frame,sizeof(frame));
+         outputHdlcClose();
+         outputStartTx();
+      } else {
+         outcome = E_FAIL;
+      }
+   }
    ENABLE_INTERRUPTS();
    
-   return E_SUCCESS;
+   return outcome;
 }
 
 owerror_t openserial_printData(uint8_t* buffer, uint8_t length) {
-   uint8_t  i;
-   uint8_t  asn[5];
+   uint8_t  header[8];
+   uint16_t len;
    INTERRUPT_DECLARATION();
    
+   header[0] = SERFRAME_MOTE2PC_DATA;
+   header[1] = idmanager_getMyID(ADDR_16B)->addr_16b[1];
+   header[2] = idmanager_getMyID(ADDR_16B)->addr_16b[0];
+   
    // retrieve ASN
-   ieee154e_getAsn(asn);// byte01,byte23,byte4
+   ieee154e_getAsn(&header[3]);// byte01,byte23,byte4
+   len       = outputHdlcLength(header,sizeof(header))+outputHdlcLength(buffer,length);
    
    DISABLE_INTERRUPTS();
-   openserial_vars.outputBufFilled  = TRUE;
-   outputHdlcOpen();
-   outputHdlcWrite(SERFRAME_MOTE2PC_DATA);
-   outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[1]);
-   outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[0]);
-   outputHdlcWrite(asn[0]);
-   outputHdlcWrite(asn[1]);
-   outputHdlcWrite(asn[2]);
-   outputHdlcWrite(asn[3]);
-   outputHdlcWrite(asn[4]);
-   for (i=0;i<length;i++){
-      outputHdlcWrite(buffer[i]);
+   if (outputHdlcOpen(len)==FALSE) {
+      ENABLE_INTERRUPTS();
+      return E_FAIL;
    }
+   outputHdlcWriteBuf(header,sizeof(header));
+   outputHdlcWriteBuf(buffer,length);
    outputHdlcClose();
+   outputStartTx();
    ENABLE_INTERRUPTS();
    
    return E_SUCCESS;
@@ -200,25 +322,38 @@ owerror_t openserial_printCritical(uint8_t calling_component, uint8_t error_code
    );
 }
 
+/**
+\brief Number of data bytes in the oldest frame received over serial.
+
+\returns The number of bytes following the command byte, 0 if there is no frame.
+*/
 uint8_t openserial_getNumDataBytes() {
    uint8_t inputBufFill;
    INTERRUPT_DECLARATION();
    
    DISABLE_INTERRUPTS();
-   inputBufFill = openserial_vars.inputBufFill;
+   if (openserial_vars.inputNumFrames==0) {
+      inputBufFill = 1;
+   } else {
+      inputBufFill = openserial_vars.inputFrames[openserial_vars.inputFrameIdxR].fill;
+   }
    ENABLE_INTERRUPTS();
 
    return inputBufFill-1; // removing the command byte
 }
 
+/**
+\brief Copy the data bytes of the oldest frame received over serial.
+
+The frame stays in the input ring until task_openserialInput() is done with it,
+so the data can be copied straight to its final location (e.g. a packet
+buffer).
+*/
 uint8_t openserial_getInputBuffer(uint8_t* bufferToWrite, uint8_t maxNumBytes) {
    uint8_t numBytesWritten;
    uint8_t inputBufFill;
-   INTERRUPT_DECLARATION();
    
-   DISABLE_INTERRUPTS();
-   inputBufFill = openserial_vars.inputBufFill;
-   ENABLE_INTERRUPTS();
+   inputBufFill = openserial_getNumDataBytes()+1;
    
    if (maxNumBytes<inputBufFill-1) {
       openserial_printError(COMPONENT_OPENSERIAL,ERR_GETDATA_ASKS_TOO_FEW_BYTES,
@@ -227,157 +362,133 @@ uint8_t openserial_getInputBuffer(uint8_t* bufferToWrite, uint8_t maxNumBytes) {
       numBytesWritten = 0;
    } else {
       numBytesWritten = inputBufFill-1;
-      memcpy(bufferToWrite,&(openserial_vars.inputBuf[1]),numBytesWritten);
+      // frames are only written in task context, no need to lock
+      memcpy(
+         bufferToWrite,
+         &(openserial_vars.inputFrames[openserial_vars.inputFrameIdxR].buf[1]),
+         numBytesWritten
+      );
    }
    
    return numBytesWritten;
 }
 
-void openserial_startInput() {
+/**
+\brief Print the next changed status record over serial.
+
+Called by the MAC layer when it has no radio activity. Status frames only fill
+idle time on the serial line; they are sent as soon as the TX interrupt has
+drained what was written before.
+
+Each call is an opportunity to print one record. Subscribed elements are
+visited round-robin, starting after the one last printed, until one of them
+has a record which changed; nothing is printed when none did.
+*/
+void openserial_triggerDebugPrint() {
+   openserial_triggerDebugPrintSlots(1);
+}
+
+/**
+\brief Offer a run of idle slots at once to print status and errors.
+
+Called by the MAC layer when it sleeps through idle slots rather than waking
+up at each of them. Keyframes, error flushes and the subscribed status rate
+are all counted in slots, so they keep their pace; the records owed are
+printed back-to-back, up to SERIAL_STATUS_MAXBURST.
+
+\param[in] numSlots Number of idle slots offered.
+*/
+void openserial_triggerDebugPrintSlots(uint16_t numSlots) {
+   uint8_t  i;
+   uint8_t  statusElement;
+   bool     subscribed;
+   uint16_t counter;
+   uint8_t  numPrints;
    INTERRUPT_DECLARATION();
    
-   if (openserial_vars.inputBufFill>0) {
-      openserial_printError(COMPONENT_OPENSERIAL,ERR_INPUTBUFFER_LENGTH,
-                            (errorparameter_t)openserial_vars.inputBufFill,
-                            (errorparameter_t)0);
-      DISABLE_INTERRUPTS();
-      openserial_vars.inputBufFill=0;
-      ENABLE_INTERRUPTS();
-   }
+   DISABLE_INTERRUPTS();
+   openserial_vars.statusStats.numOpportunities += numSlots;
    
-   uart_clearTxInterrupts();
-   uart_clearRxInterrupts();      // clear possible pending interrupts
-   uart_enableInterrupts();       // Enable USCI_A1 TX & RX interrupt
+   // errors get their share first
+   counter   = openserial_vars.errorFlushCounter+numSlots;
+   numPrints = (counter/SERIAL_ERROR_FLUSH_PERIOD>SERIAL_ERROR_MAXTOKENS)?
+               SERIAL_ERROR_MAXTOKENS:counter/SERIAL_ERROR_FLUSH_PERIOD;
+   openserial_vars.errorFlushCounter = counter%SERIAL_ERROR_FLUSH_PERIOD;
+   while (numPrints>0) {
+      errorFlush();
+      numPrints--;
+   }
    
-   DISABLE_INTERRUPTS();
-   openserial_vars.busyReceiving  = FALSE;
-   openserial_vars.mode           = MODE_INPUT;
-   openserial_vars.reqFrameIdx    = 0;
-#ifdef FASTSIM
-   uart_writeBufferByLen_FASTSIM(
-      openserial_vars.reqFrame,
-      sizeof(openserial_vars.reqFrame)
-   );
-   openserial_vars.reqFrameIdx = sizeof(openserial_vars.reqFrame);
-#else
-   uart_writeByte(openserial_vars.reqFrame[openserial_vars.reqFrameIdx]);
-#endif
-   ENABLE_INTERRUPTS();
-}
-
-void openserial_startOutput() {
-   //schedule a task to get new status in the output buffer
-   uint8_t debugPrintCounter;
+   // periodically start a keyframe
+   openserial_vars.statusKeyframeCounter += numSlots;
+   if (openserial_vars.statusKeyframeCounter>=SERIAL_STATUS_KEYFRAME_PERIOD) {
+      openserial_vars.statusKeyframeCounter %= SERIAL_STATUS_KEYFRAME_PERIOD;
+      openserial_vars.statusEpoch++;
+      
+      // the PC only sends frames after a request, repeat it in case it was lost
+      outputRequestFrame();
+   }
    
-   INTERRUPT_DECLARATION();
-   DISABLE_INTERRUPTS();
-   openserial_vars.debugPrintCounter = (openserial_vars.debugPrintCounter+1)%STATUS_MAX;
-   debugPrintCounter = openserial_vars.debugPrintCounter;
+   // pace the records at the rate the PC subscribed to
+   counter   = openserial_vars.statusPeriodCounter+numSlots;
+   numPrints = (counter/openserial_vars.statusPeriod>SERIAL_STATUS_MAXBURST)?
+               SERIAL_STATUS_MAXBURST:counter/openserial_vars.statusPeriod;
+   openserial_vars.statusPeriodCounter = counter%openserial_vars.statusPeriod;
    ENABLE_INTERRUPTS();
    
    // print debug information
-   switch (debugPrintCounter) {
-      case STATUS_ISSYNC:
-         if (debugPrint_isSync()==TRUE) {
-            break;
-         }
-      case STATUS_ID:
-         if (debugPrint_id()==TRUE) {
-            break;
-         }
-      case STATUS_DAGRANK:
-         if (debugPrint_myDAGrank()==TRUE) {
-            break;
-         }
-      case STATUS_OUTBUFFERINDEXES:
-         if (debugPrint_outBufferIndexes()==TRUE) {
-            break;
-         }
-      case STATUS_ASN:
-         if (debugPrint_asn()==TRUE) {
-            break;
-         }
-      case STATUS_MACSTATS:
-         if (debugPrint_macStats()==TRUE) {
-            break;
-         }
-      case STATUS_SCHEDULE:
-         if(debugPrint_schedule()==TRUE) {
-            break;
-         }
-      case STATUS_BACKOFF:
-         if(debugPrint_backoff()==TRUE) {
-            break;
-         }
-      case STATUS_QUEUE:
-         if(debugPrint_queue()==TRUE) {
-            break;
-         }
-      case STATUS_NEIGHBORS:
-         if (debugPrint_neighbors()==TRUE) {
-            break;
-         }
-      case STATUS_KAPERIOD:
-         if (debugPrint_kaPeriod()==TRUE) {
-            break;
-         }
-      default:
+   while (numPrints>0) {
+      for (i=0;i<STATUS_MAX;i++) {
          DISABLE_INTERRUPTS();
-         openserial_vars.debugPrintCounter=0;
+         openserial_vars.debugPrintCounter = (openserial_vars.debugPrintCounter+1)%STATUS_MAX;
+         statusElement = openserial_vars.debugPrintCounter;
+         subscribed    = (openserial_vars.statusSubscribed & (1<<statusElement))!=0;
          ENABLE_INTERRUPTS();
+         
+         if (subscribed==TRUE && printStatusElement(statusElement)==TRUE) {
+            break;
+         }
+      }
+      if (i==STATUS_MAX) {
+         // nothing changed
+         break;
+      }
+      numPrints--;
    }
-   
-   // flush buffer
-   uart_clearTxInterrupts();
-   uart_clearRxInterrupts();          // clear possible pending interrupts
-   uart_enableInterrupts();           // Enable USCI_A1 TX & RX interrupt
-   DISABLE_INTERRUPTS();
-   openserial_vars.mode=MODE_OUTPUT;
-   if (openserial_vars.outputBufFilled) {
-#ifdef FASTSIM
-      uart_writeCircularBuffer_FASTSIM(
-         openserial_vars.outputBuf,
-         &openserial_vars.outputBufIdxR,
-         &openserial_vars.outputBufIdxW
-      );
-#else
-      uart_writeByte(openserial_vars.outputBuf[openserial_vars.outputBufIdxR++]);
-#endif
-   } else {
-      openserial_stop();
-   }
-   ENABLE_INTERRUPTS();
 }
 
-void openserial_stop() {
+/**
+\brief Decode and handle the frames the RX interrupt has received.
+
+Runs in task context, so neither the HDLC decoding nor the upper layers
+building and queuing packets hold up the radio interrupts. Frames are handled
+oldest first; each one is released once its handler returns, which makes room
+to decode the next ones.
+*/
+void task_openserialInput() {
    uint8_t inputBufFill;
    uint8_t cmdByte;
-   bool busyReceiving;
+   openserial_inputFrame_t* frame;
    INTERRUPT_DECLARATION();
    
    DISABLE_INTERRUPTS();
-   busyReceiving = openserial_vars.busyReceiving;
-   inputBufFill = openserial_vars.inputBufFill;
+   openserial_vars.inputTaskPending = FALSE;
    ENABLE_INTERRUPTS();
    
-   // disable USCI_A1 TX & RX interrupt
-   uart_disableInterrupts();
-   
-   DISABLE_INTERRUPTS();
-   openserial_vars.mode=MODE_OFF;
-   ENABLE_INTERRUPTS();
-   //the inputBuffer has to be reset if it is not reset where the data is read.
-   //or the function openserial_getInputBuffer is called (which resets the buffer)
-   if (busyReceiving==TRUE){
-      openserial_printError(COMPONENT_OPENSERIAL,ERR_BUSY_RECEIVING,
-                                  (errorparameter_t)0,
-                                  (errorparameter_t)inputBufFill);
-   }
-   
-   if (busyReceiving == FALSE && inputBufFill>0) {
+   while (1) {
+      // decode what the RX interrupt received, as far as the ring allows
+      inputHdlcDecode();
+      
       DISABLE_INTERRUPTS();
-      cmdByte = openserial_vars.inputBuf[0];
+      if (openserial_vars.inputNumFrames==0) {
+         ENABLE_INTERRUPTS();
+         break;
+      }
+      frame         = &openserial_vars.inputFrames[openserial_vars.inputFrameIdxR];
+      inputBufFill  = frame->fill;
+      cmdByte       = frame->buf[0];
       ENABLE_INTERRUPTS();
+      
       switch (cmdByte) {
          case SERFRAME_PC2MOTE_SETROOT:
             idmanager_triggerAboutRoot();
@@ -386,24 +497,28 @@ void openserial_stop() {
             openbridge_triggerData();
             break;
          case SERFRAME_PC2MOTE_TRIGGERSERIALECHO:
-            //echo function must reset input buffer after reading the data.
-            openserial_echo(&openserial_vars.inputBuf[1],inputBufFill-1);
+            openserial_echo(&frame->buf[1],inputBufFill-1);
             break;   
+         case SERFRAME_PC2MOTE_SUBSCRIBESTATUS:
+            inputSubscribeStatus(&frame->buf[1],inputBufFill-1);
+            break;
          default:
             openserial_printError(COMPONENT_OPENSERIAL,ERR_UNSUPPORTED_COMMAND,
                                   (errorparameter_t)cmdByte,
                                   (errorparameter_t)0);
-            //reset here as it is not being reset in any other callback
-            DISABLE_INTERRUPTS();
-            openserial_vars.inputBufFill = 0;
-            ENABLE_INTERRUPTS();
             break;
       }
+      
+      // release the frame
+      DISABLE_INTERRUPTS();
+      openserial_vars.inputFrameIdxR = (openserial_vars.inputFrameIdxR+1)%SERIAL_INPUT_NUMFRAMES;
+      openserial_vars.inputNumFrames--;
+      ENABLE_INTERRUPTS();
    }
    
+   // give the freed slots back to the PC
    DISABLE_INTERRUPTS();
-   openserial_vars.inputBufFill  = 0;
-   openserial_vars.busyReceiving = FALSE;
+   outputRequestFrame();
    ENABLE_INTERRUPTS();
 }
 
@@ -422,24 +537,339 @@ bool debugPrint_outBufferIndexes() {
    temp_buffer[0] = openserial_vars.outputBufIdxW;
    temp_buffer[1] = openserial_vars.outputBufIdxR;
    ENABLE_INTERRUPTS();
-   openserial_printStatus(STATUS_OUTBUFFERINDEXES,(uint8_t*)temp_buffer,sizeof(temp_buffer));
-   return TRUE;
+   return openserial_printStatusDelta(STATUS_OUTBUFFERINDEXES,NULL,(uint8_t*)temp_buffer,sizeof(temp_buffer));
+}
+
+/**
+\brief Trigger this module to print status information, over serial.
+
+debugPrint_* functions are used by the openserial module to continuously print
+status information about several modules in the OpenWSN stack.
+
+The counters are stamped with the current ASN, so the PC can compute the status
+bytes sent per minute, and the bytes saved by only sending changed records:
+(numOpportunities-numRecords) times the average record size.
+
+\returns TRUE if this function printed something, FALSE otherwise.
+*/
+bool debugPrint_serialStats() {
+   openserial_statusStats_t output;
+   INTERRUPT_DECLARATION();
+   
+   DISABLE_INTERRUPTS();
+   memcpy(&output,&openserial_vars.statusStats,sizeof(openserial_statusStats_t));
+   ENABLE_INTERRUPTS();
+   ieee154e_getAsn(output.asn);
+   
+   return openserial_printStatusDelta(STATUS_SERIALSTATS,NULL,(uint8_t*)&output,sizeof(output));
 }
 
 //=========================== private =========================================
 
+//===== status
+
+/**
+\brief Call the debugPrint_* function of a status element.
+
+\returns TRUE if a record was printed, FALSE otherwise.
+*/
+bool printStatusElement(uint8_t statusElement) {
+   switch (statusElement) {
+      case STATUS_ISSYNC:
+         return debugPrint_isSync();
+      case STATUS_ID:
+         return debugPrint_id();
+      case STATUS_DAGRANK:
+         return debugPrint_myDAGrank();
+      case STATUS_OUTBUFFERINDEXES:
+         return debugPrint_outBufferIndexes();
+      case STATUS_ASN:
+         return debugPrint_asn();
+      case STATUS_MACSTATS:
+         return debugPrint_macStats();
+      case STATUS_SCHEDULE:
+         return debugPrint_schedule();
+      case STATUS_BACKOFF:
+         return debugPrint_backoff();
+      case STATUS_QUEUE:
+         return debugPrint_queue();
+      case STATUS_NEIGHBORS:
+         return debugPrint_neighbors();
+      case STATUS_KAPERIOD:
+         return debugPrint_kaPeriod();
+      case STATUS_BRIDGESTATS:
+         return debugPrint_bridgeStats();
+      case STATUS_SERIALSTATS:
+         return debugPrint_serialStats();
+      case STATUS_ENERGY:
+         return debugPrint_energy();
+      default:
+         return FALSE;
+   }
+}
+
+/**
+\brief Handle a status subscription from the PC.
+
+The payload is the bitmap of the wanted status elements (2B, LSB first),
+followed by the number of print opportunities per record (1B, 0 means 1).
+Subscribing starts a keyframe, so the PC gets a full picture of the newly
+subscribed elements.
+*/
+void inputSubscribeStatus(uint8_t* buf, uint8_t bufLen) {
+   INTERRUPT_DECLARATION();
+   
+   if (bufLen!=3) {
+      openserial_printError(COMPONENT_OPENSERIAL,ERR_INPUTBUFFER_LENGTH,
+                            (errorparameter_t)bufLen,
+                            (errorparameter_t)0);
+      return;
+   }
+   
+   DISABLE_INTERRUPTS();
+   openserial_vars.statusSubscribed      = ((uint16_t)buf[1]<<8) | buf[0];
+   openserial_vars.statusPeriod          = buf[2];
+   if (openserial_vars.statusPeriod==0) {
+      openserial_vars.statusPeriod       = 1;
+   }
+   openserial_vars.statusPeriodCounter   = 0;
+   openserial_vars.statusKeyframeCounter = 0;
+   openserial_vars.statusEpoch++;
+   ENABLE_INTERRUPTS();
+}
+
+//===== errors
+
+/**
+\brief Account for an info or error occurrence in the aggregation table.
+
+\note Called with interrupts disabled.
+
+\returns TRUE if the occurrence should be sent right away, FALSE if it is
+   left for a later summary.
+*/
+bool errorAggregate(
+      uint8_t          severity,
+      uint8_t          calling_component,
+      uint8_t          error_code,
+      errorparameter_t arg1,
+      errorparameter_t arg2
+   ) {
+   openserial_errorEntry_t* entry;
+   uint8_t                  i;
+   
+   // look for this (component, error code)
+   for (i=0;i<SERIAL_ERROR_TABLE_SIZE;i++) {
+      entry = &openserial_vars.errorTable[i];
+      if (
+            entry->severity!=0                   &&
+            entry->component==calling_component  &&
+            entry->errorCode==error_code
+         ) {
+         // seen before, only count it
+         if (entry->count==0) {
+            entry->firstArg1 = arg1;
+            entry->firstArg2 = arg2;
+         }
+         if (entry->count<0xffff) {
+            entry->count++;
+         }
+         entry->lastArg1     = arg1;
+         entry->lastArg2     = arg2;
+         if (entry->count>=SERIAL_ERROR_BURST_THRESHOLD) {
+            entry->burst     = TRUE;
+         }
+         return FALSE;
+      }
+   }
+   
+   // new (component, error code), take an entry with nothing left to report
+   for (i=0;i<SERIAL_ERROR_TABLE_SIZE;i++) {
+      if (openserial_vars.errorTable[i].count==0) {
+         break;
+      }
+   }
+   if (i==SERIAL_ERROR_TABLE_SIZE) {
+      if (openserial_vars.errorNumLost<0xffff) {
+         openserial_vars.errorNumLost++;
+      }
+      return FALSE;
+   }
+   entry                     = &openserial_vars.errorTable[i];
+   entry->severity           = severity;
+   entry->component          = calling_component;
+   entry->errorCode          = error_code;
+   entry->burst              = FALSE;
+   entry->firstArg1          = arg1;
+   entry->firstArg2          = arg2;
+   entry->lastArg1           = arg1;
+   entry->lastArg2           = arg2;
+   
+   // the first occurrence goes out right away, if the rate allows it
+   if (openserial_vars.errorTokens>0) {
+      openserial_vars.errorTokens--;
+      entry->count           = 0;
+      return TRUE;
+   }
+   entry->count              = 1;
+   return FALSE;
+}
+
+/**
+\brief Send one aggregated error summary, at a bounded rate.
+
+Called once every SERIAL_ERROR_FLUSH_PERIOD status print opportunities. Each
+call gives one token back and sends one summary: a bursting error first, else
+the next error with occurrences not reported yet, else the number of lost
+occurrences.
+
+\note Called with interrupts disabled.
+*/
+void errorFlush() {
+   openserial_errorEntry_t* entry;
+   openserial_errorEntry_t  lost;
+   uint8_t                  i;
+   
+   if (openserial_vars.errorTokens<SERIAL_ERROR_MAXTOKENS) {
+      openserial_vars.errorTokens++;
+   }
+   
+   // bursting errors first
+   entry = NULL;
+   for (i=0;i<SERIAL_ERROR_TABLE_SIZE;i++) {
+      if (openserial_vars.errorTable[i].count>0 && openserial_vars.errorTable[i].burst==TRUE) {
+         entry = &openserial_vars.errorTable[i];
+         break;
+      }
+   }
+   
+   // then round-robin through the others
+   if (entry==NULL) {
+      for (i=0;i<SERIAL_ERROR_TABLE_SIZE;i++) {
+         openserial_vars.errorFlushIdx = (openserial_vars.errorFlushIdx+1)%SERIAL_ERROR_TABLE_SIZE;
+         if (openserial_vars.errorTable[openserial_vars.errorFlushIdx].count>0) {
+            entry = &openserial_vars.errorTable[openserial_vars.errorFlushIdx];
+            break;
+         }
+      }
+   }
+   
+   if (entry!=NULL) {
+      if (outputErrorSummary(entry)==FALSE) {
+         // the occurrences are reported at the next flush
+         return;
+      }
+      entry->count = 0;
+      entry->burst = FALSE;
+   } else if (openserial_vars.errorNumLost>0) {
+      memset(&lost,0,sizeof(openserial_errorEntry_t));
+      lost.severity  = SERFRAME_MOTE2PC_ERROR;
+      lost.component = COMPONENT_OPENSERIAL;
+      lost.errorCode = ERR_ERRORTABLE_FULL;
+      lost.count     = 1;
+      lost.firstArg1 = openserial_vars.errorNumLost;
+      lost.lastArg1  = openserial_vars.errorNumLost;
+      if (outputErrorSummary(&lost)==FALSE) {
+         return;
+      }
+      openserial_vars.errorNumLost = 0;
+   } else {
+      return;
+   }
+   openserial_vars.errorTokens--;
+}
+
+/**
+\brief Write an aggregated error summary frame.
+
+The frame holds the severity, component and error code, a burst flag, the
+number of occurrences (2B) and the arguments of the first and last of them.
+
+\returns TRUE if the frame was written, FALSE if it did not fit in the output
+   buffer.
+*/
+bool outputErrorSummary(openserial_errorEntry_t* entry) {
+   uint8_t frame[17];
+   
+   frame[0]  = SERFRAME_MOTE2PC_ERRORSUMMARY;
+   frame[1]  = idmanager_getMyID(ADDR_16B)->addr_16b[0];
+   frame[2]  = idmanager_getMyID(ADDR_16B)->addr_16b[1];
+   frame[3]  = entry->severity;
+   frame[4]  = entry->component;
+   frame[5]  = entry->errorCode;
+   frame[6]  = entry->burst;
+   frame[7]  = (uint8_t)((entry->count & 0xff00)>>8);
+   frame[8]  = (uint8_t) (entry->count & 0x00ff);
+   frame[9]  = (uint8_t)((entry->firstArg1 & 0xff00)>>8);
+   frame[10] = (uint8_t) (entry->firstArg1 & 0x00ff);
+   frame[11] = (uint8_t)((entry->firstArg2 & 0xff00)>>8);
+   frame[12] = (uint8_t) (entry->firstArg2 & 0x00ff);
+   frame[13] = (uint8_t)((entry->lastArg1 & 0xff00)>>8);
+   frame[14] = (uint8_t) (entry->lastArg1 & 0x00ff);
+   frame[15] = (uint8_t)((entry->lastArg2 & 0xff00)>>8);
+   frame[16] = (uint8_t) (entry->lastArg2 & 0x00ff);
+   
+   if (outputHdlcOpen(outputHdlcLength(frame,sizeof(frame)))==FALSE) {
+      return FALSE;
+   }
+   outputHdlcWriteBuf(frame,sizeof(frame));
+   outputHdlcClose();
+   outputStartTx();
+   return TRUE;
+}
+
 //===== hdlc (output)
 
 /**
-\brief Start an HDLC frame in the output buffer.
+\brief Number of bytes a buffer takes in an HDLC frame, once escaped.
+*/
+uint16_t outputHdlcLength(uint8_t* buf, uint8_t len) {
+   uint16_t escapedLen;
+   
+   escapedLen = len;
+   while (len>0) {
+      if (HDLC_NEEDS_ESCAPE(*buf)) {
+         escapedLen++;
+      }
+      buf++;
+      len--;
+   }
+   return escapedLen;
+}
+
+/**
+\brief Start an HDLC frame in the output buffer, if the whole frame fits.
+
+Writing past the read index would overwrite frames which are still queued, and
+the PC would receive them corrupted. A frame which does not fit is dropped
+instead, and counted.
+
+\note Called with interrupts disabled.
+
+\param[in] len Number of bytes of the content of the frame, once escaped (see
+   outputHdlcLength()).
+
+\returns TRUE if the frame was started, FALSE if it was dropped.
 */
-port_INLINE void outputHdlcOpen() {
+port_INLINE bool outputHdlcOpen(uint16_t len) {
+   uint8_t room;
+   
+   // one entry stays free, equal indexes mean the buffer is empty
+   room = (uint8_t)(openserial_vars.outputBufIdxR-openserial_vars.outputBufIdxW-1);
+   if (len+SERIAL_HDLC_OVERHEAD>room) {
+      openserial_vars.statusStats.numDropped++;
+      return FALSE;
+   }
+   
    // initialize the value of the CRC
    openserial_vars.outputCrc                          = HDLC_CRCINIT;
    
    // write the opening HDLC flag
    openserial_vars.outputBuf[openserial_vars.outputBufIdxW++]     = HDLC_FLAG;
+   
+   return TRUE;
 }
+
 /**
 \brief Add a byte to the outgoing HDLC frame being built.
 */
@@ -449,7 +879,7 @@ port_INLINE void outputHdlcWrite(uint8_t b) {
    openserial_vars.outputCrc = crcIteration(openserial_vars.outputCrc,b);
    
    // add byte to buffer
-   if (b==HDLC_FLAG || b==HDLC_ESCAPE) {
+   if (HDLC_NEEDS_ESCAPE(b)) {
       openserial_vars.outputBuf[openserial_vars.outputBufIdxW++]  = HDLC_ESCAPE;
       b                                               = b^HDLC_ESCAPE_MASK;
    }
@@ -457,6 +887,18 @@ port_INLINE void outputHdlcWrite(uint8_t b) {
    
 }
 /**
+\brief Add a buffer to the outgoing HDLC frame being built, in a single pass.
+*/
+port_INLINE void outputHdlcWriteBuf(uint8_t* buf, uint8_t len) {
+   openserial_vars.outputBufIdxW = openhdlc_encode(
+      openserial_vars.outputBuf,
+      openserial_vars.outputBufIdxW,
+      &openserial_vars.outputCrc,
+      buf,
+      len
+   );
+}
+/**
 \brief Finalize the outgoing HDLC frame.
 */
 port_INLINE void outputHdlcClose() {
@@ -472,55 +914,246 @@ port_INLINE void outputHdlcClose() {
    // write the closing HDLC flag
    openserial_vars.outputBuf[openserial_vars.outputBufIdxW++]   = HDLC_FLAG;
 }
+/**
+\brief Write a request frame, asking the PC for its next frames.
+
+The request carries the number of frames the input ring can still accept
+(credits). The PC sends at most that many frames before waiting for the next
+request.
+*/
+port_INLINE void outputRequestFrame() {
+   uint8_t credits;
+   
+   credits = SERIAL_INPUT_NUMFRAMES-openserial_vars.inputNumFrames;
+   if (openserial_vars.busyReceiving==TRUE) {
+      credits--;
+   }
+   if (credits==0) {
+      return;
+   }
+   
+   if (outputHdlcOpen(outputHdlcLength(&credits,1)+1)==FALSE) {
+      // asked again at the next keyframe
+      return;
+   }
+   outputHdlcWrite(SERFRAME_MOTE2PC_REQUEST);
+   outputHdlcWrite(credits);
+   outputHdlcClose();
+   outputStartTx();
+}
+/**
+\brief Start draining the output buffer, unless already doing so.
+
+The TX interrupt keeps draining the buffer until it is empty, this only needs to
+send the first byte.
+*/
+port_INLINE void outputStartTx() {
+   if (openserial_vars.outputBusy==TRUE ||
+       openserial_vars.outputBufIdxW==openserial_vars.outputBufIdxR) {
+      return;
+   }
+#ifdef FASTSIM
+   uart_writeCircularBuffer_FASTSIM(
+      openserial_vars.outputBuf,
+      &openserial_vars.outputBufIdxR,
+      &openserial_vars.outputBufIdxW
+   );
+#else
+   openserial_vars.outputBusy = TRUE;
+   uart_writeByte(openserial_vars.outputBuf[openserial_vars.outputBufIdxR++]);
+#endif
+}
 
 //===== hdlc (input)
 
 /**
-\brief Start an HDLC frame in the input buffer.
+\brief Decode the bytes the RX interrupt received into the input ring.
+
+Bytes are taken from the raw input buffer in contiguous spans; within a frame,
+spans of bytes which need no unescaping are copied in one go. Decoding stops
+when a new frame starts while the input ring is full: its bytes stay in the
+raw buffer until task_openserialInput() has released a frame.
+
+\note Runs in task context, with interrupts enabled; the RX interrupt only
+   moves the write index of the raw buffer.
+*/
+void inputHdlcDecode() {
+   uint8_t  rawIdxW;
+   uint8_t  rawIdxR;
+   bool     rawOverflow;
+   uint8_t* raw;
+   openserial_inputFrame_t* frame;
+   uint8_t  len;
+   uint8_t  b;
+   uint8_t  room;
+   uint8_t  inputBufFill;
+   uint8_t  numFrames;
+   INTERRUPT_DECLARATION();
+   
+   DISABLE_INTERRUPTS();
+   rawIdxW                          = openserial_vars.inputRawIdxW;
+   rawOverflow                      = openserial_vars.inputRawOverflow;
+   openserial_vars.inputRawOverflow = FALSE;
+   ENABLE_INTERRUPTS();
+   
+   if (rawOverflow==TRUE) {
+      // bytes were lost, the frame they belong to fails its CRC
+      openserial_printError(COMPONENT_OPENSERIAL,ERR_INPUT_BUFFER_OVERFLOW,
+                            (errorparameter_t)1,
+                            (errorparameter_t)0);
+   }
+   
+   rawIdxR = openserial_vars.inputRawIdxR;
+   while (rawIdxR!=rawIdxW) {
+      raw = &openserial_vars.inputRawBuf[rawIdxR];
+      b   = raw[0];
+      
+      if (openserial_vars.busyReceiving==FALSE) {
+         if (openserial_vars.lastRxByte==HDLC_FLAG && b!=HDLC_FLAG) {
+            // start of frame
+            
+            if (openserial_vars.inputNumFrames==SERIAL_INPUT_NUMFRAMES) {
+               // no free slot in the input ring, wait for one
+               break;
+            }
+            
+            // I'm now receiving, the byte is decoded as part of the frame
+            openserial_vars.busyReceiving = TRUE;
+            inputHdlcOpen();
+            continue;
+         }
+         // between frames
+         openserial_vars.lastRxByte = b;
+         rawIdxR++;
+         continue;
+      }
+      
+      if (b==HDLC_FLAG) {
+         // end of frame
+         
+         inputBufFill = openserial_vars.inputFrames[openserial_vars.inputFrameIdxW].fill;
+         numFrames    = openserial_vars.inputNumFrames;
+         inputHdlcClose();
+         
+         openserial_vars.busyReceiving = FALSE;
+         
+         if (openserial_vars.inputNumFrames==numFrames) {
+            // invalid HDLC frame
+            openserial_printError(COMPONENT_OPENSERIAL,ERR_WRONG_CRC_INPUT,
+                                  (errorparameter_t)inputBufFill,
+                                  (errorparameter_t)0);
+         }
+         openserial_vars.lastRxByte = b;
+         rawIdxR++;
+         continue;
+      }
+      
+      // middle of frame
+      
+      if (b==HDLC_ESCAPE) {
+         openserial_vars.inputEscaping = TRUE;
+         openserial_vars.lastRxByte    = b;
+         rawIdxR++;
+         continue;
+      }
+      
+      frame = &openserial_vars.inputFrames[openserial_vars.inputFrameIdxW];
+      if (frame->fill==SERIAL_INPUT_FRAME_SIZE) {
+         // input buffer overflow
+         openserial_printError(COMPONENT_OPENSERIAL,ERR_INPUT_BUFFER_OVERFLOW,
+                               (errorparameter_t)0,
+                               (errorparameter_t)0);
+         frame->fill                   = 0;
+         openserial_vars.busyReceiving = FALSE;
+         openserial_vars.lastRxByte    = b;
+         rawIdxR++;
+         continue;
+      }
+      
+      if (openserial_vars.inputEscaping==TRUE) {
+         // a single escaped byte
+         openserial_vars.inputEscaping = FALSE;
+         inputHdlcWrite(b^HDLC_ESCAPE_MASK);
+         len = 1;
+      } else {
+         // copy the span up to the end of the raw buffer (or its wrap-around),
+         // the end of the frame, or the next byte to unescape
+         if (rawIdxW>rawIdxR) {
+            len = rawIdxW-rawIdxR;
+         } else {
+            len = (uint8_t)(0-rawIdxR);
+         }
+         room = SERIAL_INPUT_FRAME_SIZE-frame->fill;
+         if (len>room) {
+            len = room;
+         }
+         len = openhdlc_decodeRun(
+            &frame->buf[frame->fill],
+            &openserial_vars.inputCrc,
+            raw,
+            len
+         );
+         frame->fill += len;
+      }
+      
+      // none of the bytes consumed is a flag
+      openserial_vars.lastRxByte = b;
+      rawIdxR += len;
+   }
+   openserial_vars.inputRawIdxR = rawIdxR;
+}
+/**
+\brief Start an HDLC frame in the next free slot of the input ring.
 */
 port_INLINE void inputHdlcOpen() {
-   // reset the input buffer index
-   openserial_vars.inputBufFill                       = 0;
+   // reset the fill level of the frame
+   openserial_vars.inputFrames[openserial_vars.inputFrameIdxW].fill = 0;
    
    // initialize the value of the CRC
    openserial_vars.inputCrc                           = HDLC_CRCINIT;
+   openserial_vars.inputEscaping                      = FALSE;
 }
 /**
-\brief Add a byte to the incoming HDLC frame.
+\brief Add a single unescaped byte to the incoming HDLC frame.
+
+\note The caller makes sure it fits in the frame.
 */
 port_INLINE void inputHdlcWrite(uint8_t b) {
-   if (b==HDLC_ESCAPE) {
-      openserial_vars.inputEscaping = TRUE;
-   } else {
-      if (openserial_vars.inputEscaping==TRUE) {
-         b                             = b^HDLC_ESCAPE_MASK;
-         openserial_vars.inputEscaping = FALSE;
-      }
-      
-      // add byte to input buffer
-      openserial_vars.inputBuf[openserial_vars.inputBufFill] = b;
-      openserial_vars.inputBufFill++;
-      
-      // iterate through CRC calculator
-      openserial_vars.inputCrc = crcIteration(openserial_vars.inputCrc,b);
-   }
+   openserial_inputFrame_t* frame;
+   
+   // add byte to input frame
+   frame = &openserial_vars.inputFrames[openserial_vars.inputFrameIdxW];
+   frame->buf[frame->fill] = b;
+   frame->fill++;
+   
+   // iterate through CRC calculator
+   openserial_vars.inputCrc = crcIteration(openserial_vars.inputCrc,b);
 }
 /**
 \brief Finalize the incoming HDLC frame.
+
+A valid frame is committed to the input ring, an invalid one is dropped.
 */
 port_INLINE void inputHdlcClose() {
+   openserial_inputFrame_t* frame;
+   
+   frame = &openserial_vars.inputFrames[openserial_vars.inputFrameIdxW];
    
    // verify the validity of the frame
-   if (openserial_vars.inputCrc==HDLC_CRCGOOD) {
+   if (openserial_vars.inputCrc==HDLC_CRCGOOD && frame->fill>2) {
       // the CRC is correct
       
       // remove the CRC from the input buffer
-      openserial_vars.inputBufFill    -= 2;
+      frame->fill                     -= 2;
+      
+      // commit the frame
+      openserial_vars.inputFrameIdxW   = (openserial_vars.inputFrameIdxW+1)%SERIAL_INPUT_NUMFRAMES;
+      openserial_vars.inputNumFrames++;
    } else {
       // the CRC is incorrect
       
       // drop the incoming fram
-      openserial_vars.inputBufFill     = 0;
+      frame->fill                      = 0;
    }
 }
 
@@ -528,109 +1161,46 @@ port_INLINE void inputHdlcClose() {
 
 //executed in ISR, called from scheduler.c
 void isr_openserial_tx() {
-   switch (openserial_vars.mode) {
-      case MODE_INPUT:
-         openserial_vars.reqFrameIdx++;
-         if (openserial_vars.reqFrameIdx<sizeof(openserial_vars.reqFrame)) {
-            uart_writeByte(openserial_vars.reqFrame[openserial_vars.reqFrameIdx]);
-         }
-         break;
-      case MODE_OUTPUT:
-         if (openserial_vars.outputBufIdxW==openserial_vars.outputBufIdxR) {
-            openserial_vars.outputBufFilled = FALSE;
-         }
-         if (openserial_vars.outputBufFilled) {
-            uart_writeByte(openserial_vars.outputBuf[openserial_vars.outputBufIdxR++]);
-         }
-         break;
-      case MODE_OFF:
-      default:
-         break;
+   if (openserial_vars.outputBufIdxW==openserial_vars.outputBufIdxR) {
+      // nothing left to send, next print restarts the transmission
+      openserial_vars.outputBusy = FALSE;
+   } else {
+      uart_writeByte(openserial_vars.outputBuf[openserial_vars.outputBufIdxR++]);
    }
 }
 
 // executed in ISR, called from scheduler.c
 void isr_openserial_rx() {
    uint8_t rxbyte;
-   uint8_t inputBufFill;
-   
-   // stop if I'm not in input mode
-   if (openserial_vars.mode!=MODE_INPUT) {
-      return;
-   }
+   uint8_t rawFill;
    
    // read byte just received
    rxbyte = uart_readByte();
-   //keep lenght
-   inputBufFill=openserial_vars.inputBufFill;
-   
-   if        (
-                openserial_vars.busyReceiving==FALSE  &&
-                openserial_vars.lastRxByte==HDLC_FLAG &&
-                rxbyte!=HDLC_FLAG
-              ) {
-      // start of frame
-      
-      // I'm now receiving
-      openserial_vars.busyReceiving         = TRUE;
-      
-      // create the HDLC frame
-      inputHdlcOpen();
-      
-      // add the byte just received
-      inputHdlcWrite(rxbyte);
-   } else if (
-                openserial_vars.busyReceiving==TRUE   &&
-                rxbyte!=HDLC_FLAG
-             ) {
-      // middle of frame
-      
-      // add the byte just received
-      inputHdlcWrite(rxbyte);
-      if (openserial_vars.inputBufFill+1>SERIAL_INPUT_BUFFER_SIZE){
-         // input buffer overflow
-         openserial_printError(COMPONENT_OPENSERIAL,ERR_INPUT_BUFFER_OVERFLOW,
-                               (errorparameter_t)0,
-                               (errorparameter_t)0);
-         openserial_vars.inputBufFill       = 0;
-         openserial_vars.busyReceiving      = FALSE;
-         openserial_stop();
-      }
-   } else if (
-                openserial_vars.busyReceiving==TRUE   &&
-                rxbyte==HDLC_FLAG
-              ) {
-         // end of frame
-         
-         // finalize the HDLC frame
-         inputHdlcClose();
-         
-         if (openserial_vars.inputBufFill==0){
-            // invalid HDLC frame
-            openserial_printError(COMPONENT_OPENSERIAL,ERR_WRONG_CRC_INPUT,
-                                  (errorparameter_t)inputBufFill,
-                                  (errorparameter_t)0);
-         
-         }
-         
-         openserial_vars.busyReceiving      = FALSE;
-         openserial_stop();
+   
+   if ((uint8_t)(openserial_vars.inputRawIdxW+1)==openserial_vars.inputRawIdxR) {
+      // raw input buffer full, drop the byte
+      openserial_vars.inputRawOverflow = TRUE;
+   } else {
+      openserial_vars.inputRawBuf[openserial_vars.inputRawIdxW++] = rxbyte;
    }
    
-   openserial_vars.lastRxByte = rxbyte;
+   // decode at the end of each frame, or before the raw buffer fills up
+   rawFill = openserial_vars.inputRawIdxW-openserial_vars.inputRawIdxR;
+   if (
+         openserial_vars.inputTaskPending==FALSE &&
+         (rxbyte==HDLC_FLAG || rawFill>=SERIAL_INPUT_RAW_SIZE/2)
+      ) {
+      openserial_vars.inputTaskPending = TRUE;
+      scheduler_push_task(task_openserialInput,TASKPRIO_OPENSERIAL);
+   }
 }
 
 //======== SERIAL ECHO =============
 
 void openserial_echo(uint8_t* buf, uint8_t bufLen){
-   INTERRUPT_DECLARATION();
    // echo back what you received
    openserial_printData(
       buf,
       bufLen
    );
-   
-    DISABLE_INTERRUPTS();
-    openserial_vars.inputBufFill = 0;
-    ENABLE_INTERRUPTS();
 }
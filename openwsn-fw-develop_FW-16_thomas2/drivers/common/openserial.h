@@ -27,19 +27,100 @@
 #define SERIAL_OUTPUT_BUFFER_SIZE 256 // leave at 256!
 
 /**
-\brief Number of bytes of the serial input buffer, in bytes.
+\brief Bytes an HDLC frame takes in the output buffer, on top of its content.
+
+The opening and closing flags, and the 2 bytes of CRC, both escaped in the worst
+case.
+*/
+#define SERIAL_HDLC_OVERHEAD      6
+
+/**
+\brief Number of bytes of the raw serial input buffer, in bytes.
+
+The RX interrupt only appends the bytes it receives to this buffer; they are
+HDLC-decoded in task context.
+
+\warning should be exactly 256 so wrap-around on the index does not require
+         the use of a slow modulo operator.
+*/
+#define SERIAL_INPUT_RAW_SIZE     256 // leave at 256!
+
+/**
+\brief Maximum size of a frame received over serial, in bytes.
+
+Includes the command byte and the 2-byte HDLC CRC; large enough for a bridged
+packet (8B next hop followed by an IPv6 packet which fits in a 802.15.4 frame).
 
 \warning Do not pick a number greater than 255, since its filling level is
          encoded by a single byte in the code.
 */
-#define SERIAL_INPUT_BUFFER_SIZE  200
+#define SERIAL_INPUT_FRAME_SIZE   128
+
+/**
+\brief Number of frames the serial input ring can hold.
+
+Frames are received back-to-back into this ring while earlier ones are being
+handled. Each free slot is a credit advertised to the PC.
+*/
+#define SERIAL_INPUT_NUMFRAMES    3
+
+/**
+\brief Number of status print opportunities between two keyframes.
+
+At a keyframe, every status record is sent once more, whether it changed or
+not, so the PC can (re)build its full picture of the mote.
+*/
+#define SERIAL_STATUS_KEYFRAME_PERIOD 256
+
+/**
+\brief Maximum number of status records printed for a run of idle slots.
+
+When the MAC sleeps through several idle slots, it offers them all at once.
+The records they are worth are printed back-to-back, up to this bound.
+*/
+#define SERIAL_STATUS_MAXBURST        4
+
+/**
+\brief Status elements which are only sent at keyframes.
+
+These are counters and clocks which change at (almost) every slot; the PC only
+uses them to compute rates, sending them at every change would keep the serial
+line busy for nothing.
+*/
+#define SERIAL_STATUS_KEYFRAMEONLY ( \
+   (1<<STATUS_OUTBUFFERINDEXES) | \
+   (1<<STATUS_ASN)              | \
+   (1<<STATUS_MACSTATS)         | \
+   (1<<STATUS_BRIDGESTATS)      | \
+   (1<<STATUS_SERIALSTATS)      | \
+   (1<<STATUS_ENERGY)             \
+)
+
+/**
+\brief Number of different (component, error code) pairs aggregated at a time.
+*/
+#define SERIAL_ERROR_TABLE_SIZE       8
+
+/**
+\brief Number of status print opportunities between two error flushes.
 
-/// Modes of the openserial module.
-enum {
-   MODE_OFF    = 0, ///< The module is off, no serial activity.
-   MODE_INPUT  = 1, ///< The serial is listening or receiving bytes.
-   MODE_OUTPUT = 2  ///< The serial is transmitting bytes.
-};
+At each flush, at most one aggregated error summary is sent, and one more
+error may be sent right away. This bounds the bandwidth used by errors during
+fault storms.
+*/
+#define SERIAL_ERROR_FLUSH_PERIOD     8
+
+/**
+\brief Maximum number of errors which can be sent right away, back-to-back.
+*/
+#define SERIAL_ERROR_MAXTOKENS        4
+
+/**
+\brief Occurrences between two flushes from which an error is a burst.
+
+Bursting errors are flushed first, and flagged in their summary.
+*/
+#define SERIAL_ERROR_BURST_THRESHOLD  16
 
 // frames sent mote->PC
 #define SERFRAME_MOTE2PC_DATA               ((uint8_t)'D')
@@ -47,32 +128,79 @@ enum {
 #define SERFRAME_MOTE2PC_INFO               ((uint8_t)'I')
 #define SERFRAME_MOTE2PC_ERROR              ((uint8_t)'E')
 #define SERFRAME_MOTE2PC_CRITICAL           ((uint8_t)'C')
-#define SERFRAME_MOTE2PC_REQUEST            ((uint8_t)'R')
+#define SERFRAME_MOTE2PC_REQUEST            ((uint8_t)'R') // followed by credits (1B)
+#define SERFRAME_MOTE2PC_ERRORSUMMARY       ((uint8_t)'A')
 
 // frames sent PC->mote
 #define SERFRAME_PC2MOTE_SETROOT            ((uint8_t)'R')
 #define SERFRAME_PC2MOTE_DATA               ((uint8_t)'D')
 #define SERFRAME_PC2MOTE_TRIGGERSERIALECHO  ((uint8_t)'S')
+#define SERFRAME_PC2MOTE_SUBSCRIBESTATUS    ((uint8_t)'T') // followed by element mask (2B, LSB first) and period (1B)
 
 //=========================== typedef =========================================
 
+typedef struct {
+   uint8_t    fill;
+   uint8_t    buf[SERIAL_INPUT_FRAME_SIZE];
+} openserial_inputFrame_t;
+
+typedef struct {
+   uint8_t          severity;     // SERFRAME_MOTE2PC_INFO or _ERROR, 0 if unused
+   uint8_t          component;
+   uint8_t          errorCode;
+   bool             burst;
+   uint16_t         count;        // occurrences not reported yet
+   errorparameter_t firstArg1;
+   errorparameter_t firstArg2;
+   errorparameter_t lastArg1;
+   errorparameter_t lastArg2;
+} openserial_errorEntry_t;
+
+BEGIN_PACK
+typedef struct {
+   uint32_t   numOpportunities;  // times the MAC offered to print a status record
+   uint32_t   numRecords;        // status records actually printed
+   uint32_t   numBytes;          // bytes these records took in the output buffer
+   uint32_t   numDropped;        // frames of any type dropped, the output buffer being full
+   uint8_t    asn[5];
+} openserial_statusStats_t;
+END_PACK
+
 //=========================== module variables ================================
 
 typedef struct {
    // admin
-   uint8_t    mode;
    uint8_t    debugPrintCounter;
+   // status
+   uint16_t   statusSubscribed;  // bitmap of the status elements the PC wants
+   uint8_t    statusPeriod;      // print opportunities per status record
+   uint8_t    statusPeriodCounter;
+   uint16_t   statusKeyframeCounter;
+   uint8_t    statusEpoch;       // incremented at each keyframe
+   uint16_t   statusSignature[STATUS_MAX]; // of the last record sent, per element
+   openserial_statusStats_t statusStats;
+   // errors
+   openserial_errorEntry_t errorTable[SERIAL_ERROR_TABLE_SIZE];
+   uint8_t    errorTokens;
+   uint8_t    errorFlushCounter;
+   uint8_t    errorFlushIdx;
+   uint16_t   errorNumLost;      // occurrences which found no room in the table
    // input
-   uint8_t    reqFrame[1+1+2+1]; // flag (1B), command (2B), CRC (2B), flag (1B)
-   uint8_t    reqFrameIdx;
+   bool       inputTaskPending;  // task_openserialInput() pushed, not run yet
+   bool       inputRawOverflow;  // bytes were dropped from the raw buffer
+   uint8_t    inputRawIdxW;
+   uint8_t    inputRawIdxR;
+   uint8_t    inputRawBuf[SERIAL_INPUT_RAW_SIZE];
    uint8_t    lastRxByte;
    bool       busyReceiving;
    bool       inputEscaping;
    uint16_t   inputCrc;
-   uint8_t    inputBufFill;
-   uint8_t    inputBuf[SERIAL_INPUT_BUFFER_SIZE];
+   uint8_t    inputFrameIdxW;    // frame being received
+   uint8_t    inputFrameIdxR;    // oldest frame not handled yet
+   uint8_t    inputNumFrames;    // number of complete frames in the ring
+   openserial_inputFrame_t inputFrames[SERIAL_INPUT_NUMFRAMES];
    // output
-   bool       outputBufFilled;
+   bool       outputBusy;
    uint16_t   outputCrc;
    uint8_t    outputBufIdxW;
    uint8_t    outputBufIdxR;
@@ -83,6 +211,8 @@ typedef struct {
 
 void    openserial_init(void);
 owerror_t openserial_printStatus(uint8_t statusElement, uint8_t* buffer, uint8_t length);
+bool    openserial_printStatusDelta(uint8_t statusElement, uint16_t* signature,
+                              uint8_t* buffer, uint8_t length);
 owerror_t openserial_printInfo(uint8_t calling_component, uint8_t error_code,
                               errorparameter_t arg1,
                               errorparameter_t arg2);
@@ -95,11 +225,12 @@ owerror_t openserial_printCritical(uint8_t calling_component, uint8_t error_code
 owerror_t openserial_printData(uint8_t* buffer, uint8_t length);
 uint8_t openserial_getNumDataBytes(void);
 uint8_t openserial_getInputBuffer(uint8_t* bufferToWrite, uint8_t maxNumBytes);
-void    openserial_startInput(void);
-void    openserial_startOutput(void);
-void    openserial_stop(void);
+void    openserial_triggerDebugPrint(void);
+void    openserial_triggerDebugPrintSlots(uint16_t numSlots);
 bool    debugPrint_outBufferIndexes(void);
+bool    debugPrint_serialStats(void);
 void    openserial_echo(uint8_t* but, uint8_t bufLen);
+void    task_openserialInput(void);
 
 // interrupt handlers
 void    isr_openserial_rx(void);
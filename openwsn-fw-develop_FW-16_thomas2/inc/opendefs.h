@@ -35,6 +35,9 @@ static const uint8_t infoStackName[] = "OpenWSN ";
 #define LENGTH_ADDR64b  8
 #define LENGTH_ADDR128b 16
 
+// maximum number of IEs parsed in a received frame
+#define MAXNUMIES       4
+
 
 enum {
    E_SUCCESS                           = 0,
@@ -87,6 +90,14 @@ enum {
    WKP_UDP_ECHO                        =     7,
 };
 
+// traffic classes, the most urgent first
+enum {
+   TRAFFIC_CLASS_CONTROL               = 0, // network control: EBs, KAs, 6P, RPL, ACKs
+   TRAFFIC_CLASS_ALARM                 = 1, // urgent application data, sent first but sharing the entries of normal data
+   TRAFFIC_CLASS_NORMAL                = 2, // application data, the default
+   TRAFFIC_CLASS_BULK                  = 3, // application data which can wait
+};
+
 //status elements
 enum {
    STATUS_ISSYNC                       =  0,
@@ -100,7 +111,10 @@ enum {
    STATUS_QUEUE                        =  8,
    STATUS_NEIGHBORS                    =  9,
    STATUS_KAPERIOD                     = 10,
-   STATUS_MAX                          = 11,
+   STATUS_BRIDGESTATS                  = 11,
+   STATUS_SERIALSTATS                  = 12,
+   STATUS_ENERGY                       = 13,
+   STATUS_MAX                          = 14,
 };
 
 //component identifiers
@@ -155,6 +169,10 @@ enum {
    COMPONENT_TECHO                     = 0x20,
    COMPONENT_TOHLONE                   = 0x21,
    COMPONENT_UECHO                     = 0x22,
+   // cross-layers (cont.)
+   COMPONENT_PERSIST                   = 0x23,
+   // MAClow (cont.)
+   COMPONENT_IEEE802154_SECURITY       = 0x24,
 };
 
 /**
@@ -228,6 +246,20 @@ enum {
    ERR_INVALIDPACKETFROMRADIO          = 0x37, // invalid packet frome radio, length {1} (code location {0})
    ERR_BUSY_RECEIVING                  = 0x38, // busy receiving when stop of serial activity, buffer input length {1} (code location {0})
    ERR_WRONG_CRC_INPUT                 = 0x39, // wrong CRC in input Buffer (input length {0})
+   ERR_ERRORTABLE_FULL                 = 0x3a, // error aggregation table full, occurrences lost={0}
+   // persist
+   ERR_PERSIST_RESTORED                = 0x3b, // restored {0} cells and {1} neighbors from non-volatile memory
+   // short addresses
+   ERR_SHORTADDR_ASSIGNED              = 0x3c, // got short address {0} at depth {1}
+   ERR_SHORTADDR_CONFLICT              = 0x3d, // short address {0} also advertised by a neighbor, dropped
+   // link-layer security
+   ERR_SECURITY_UNSECURED              = 0x3e, // unsecured frame of type {0} from a neighbor ending in {1} dropped
+   ERR_SECURITY_UNKNOWN_KEY            = 0x3f, // no key with index {0} (key identifier mode {1})
+   ERR_SECURITY_AUTH_FAILED            = 0x40, // frame failed authentication, frame counter {0} (code location {1})
+   ERR_SECURITY_REPLAY                 = 0x41, // replayed frame counter {0} from a neighbor ending in {1}
+   // queue management
+   ERR_PACKET_EXPIRED                  = 0x42, // packet of class {0} past its deadline dropped (code location {1})
+   ERR_PACKET_EVICTED                  = 0x43, // queue full, packet of class {0} dropped for one of class {1}
 };
 
 //=========================== typedef =========================================
@@ -258,12 +290,22 @@ typedef struct {                                 // always written big endian, i
 } open_addr_t;
 END_PACK
 
+typedef struct {                                 // a received IE, its content is read in place
+   uint8_t  id;                                  // MLME sub-IE ID, or element ID of a header IE
+   uint8_t  offset;                              // offset of the content from the start of the IE list
+   uint8_t  length;                              // length in bytes of the content
+} ie_descriptor_t;
+
 typedef struct {
    //admin
    uint8_t       creator;                        // the component which called getFreePacketBuffer()
    uint8_t       owner;                          // the component which currently owns the entry
    uint8_t*      payload;                        // pointer to the start of the payload within 'packet'
    uint8_t       length;                         // length in bytes of the payload
+   uint8_t       trafficClass;                   // TRAFFIC_CLASS_*, the MAC sends the most urgent class first
+   uint16_t      allocSeqNum;                    // stamped when allocated, the MAC sends the oldest of a class first
+   bool          hasDeadline;                    // the packet is dropped once 'deadline' has passed
+   asn_t         deadline;                       // last ASN at which the packet is worth sending
    //l4
    uint8_t       l4_protocol;                    // l4 protocol to be used
    bool          l4_protocol_compressed;         // is the l4 protocol header compressed?
@@ -280,6 +322,7 @@ typedef struct {
    uint8_t       l2_frameType;                   // beacon, data, ack, cmd
    uint8_t       l2_dsn;                         // sequence number of the received frame
    uint8_t       l2_retriesLeft;                 // number Tx retries left before packet dropped (dropped when hits 0)
+   uint16_t      l2_responseTimeout;             // in ms: how long a leaf listens in shared cells after sending it, 0 if no response is expected
    uint8_t       l2_numTxAttempts;               // number Tx attempts
    asn_t         l2_asn;                         // at what ASN the packet was Tx'ed or Rx'ed
    uint8_t*      l2_payload;                     // pointer to the start of the payload of l2 (used for MAC to fill in ASN in ADV)
@@ -289,9 +332,16 @@ typedef struct {
    uint8_t*      l2_ASNpayload;                  // pointer to the ASN in EB
    uint8_t       l2_joinPriority;                // the join priority received in EB
    bool          l2_IEListPresent;               //did have IE field?
+   uint8_t       l2_IEListLength;                // length in bytes of the IE list, once parsed
+   uint8_t       l2_numIEs;                      // number of IEs in l2_IEs
+   ie_descriptor_t l2_IEs[MAXNUMIES];            // the IEs found when parsing the IE list
    bool          l2_joinPriorityPresent;
+   uint8_t       l2_securityLevel;               // IEEE802.15.4 security level, 0 if the frame is not secured
+   uint8_t       l2_keyIndex;                    // index of the key securing the frame
+   uint32_t      l2_frameCounter;                // frame counter of the secured frame
+   uint8_t       l2_headerLength;                // length of the received MAC header, authenticated with the payload
    //l1 (drivers)
-   uint8_t       l1_txPower;                     // power for packet to Tx at
+   int8_t        l1_txPower;                     // power for packet to Tx at, in dBm
    int8_t        l1_rssi;                        // RSSI of received packet
    uint8_t       l1_lqi;                         // LQI of received packet
    bool          l1_crc;                         // did received packet pass CRC check?
@@ -9,6 +9,7 @@
 #include "board.h"
 #include "debugpins.h"
 #include "leds.h"
+#include "energy.h"
 
 //=========================== variables =======================================
 
@@ -53,7 +54,9 @@ void scheduler_start() {
          scheduler_dbg.numTasksCur--;
       }
       debugpins_task_clr();
+      energy_cpuExit();
       board_sleep();
+      energy_cpuEnter();
       debugpins_task_set();                      // IAR should halt here if nothing to do
    }
 }
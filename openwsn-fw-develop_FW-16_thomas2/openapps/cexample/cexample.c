@@ -19,6 +19,8 @@
 
 /// inter-packet period (in ms)
 #define CEXAMPLEPERIOD  10000
+/// lifetime of a reading (in slots), stale once the next one is taken
+#define CEXAMPLELIFETIME 667
 #define PAYLOADLEN      62
 
 const uint8_t cexample_path0[] = "ex";
@@ -137,6 +139,7 @@ void cexample_task_cb() {
    pkt->l4_destination_port       = WKP_UDP_COAP;
    pkt->l3_destinationAdd.type    = ADDR_128B;
    memcpy(&pkt->l3_destinationAdd.addr_128b[0],&ipAddr_motesEecs,16);
+   openqueue_setLifetime(pkt,CEXAMPLELIFETIME);
    
    // send
    outcome = opencoap_send(
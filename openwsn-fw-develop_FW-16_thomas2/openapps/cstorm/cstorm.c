@@ -164,7 +164,7 @@ void cstorm_task_cb() {
    // if you get here, send a packet
    
    // get a packet
-   pkt = openqueue_getFreePacketBuffer(COMPONENT_CSTORM);
+   pkt = openqueue_getFreePacketBufferOfClass(COMPONENT_CSTORM,TRAFFIC_CLASS_BULK);
    if (pkt==NULL) {
       openserial_printError(COMPONENT_CSTORM,ERR_NO_FREE_PACKET_BUFFER,
                             (errorparameter_t)0,
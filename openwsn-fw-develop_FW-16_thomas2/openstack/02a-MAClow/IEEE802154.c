@@ -4,11 +4,23 @@
 #include "idmanager.h"
 #include "openserial.h"
 #include "topology.h"
+#include "neighbors.h"
 
 //=========================== variables =======================================
 
 //=========================== prototypes ======================================
 
+void getPanIdPresence(uint8_t frameVersion,
+                      bool    panIDCompression,
+                      uint8_t destType,
+                      uint8_t srcType,
+                      bool*   destPanIdPresent,
+                      bool*   srcPanIdPresent);
+bool isMyEui64(uint8_t* buf, uint8_t len);
+void prependAuxiliarySecurityHeader(OpenQueueEntry_t* msg);
+bool retrieveAuxiliarySecurityHeader(OpenQueueEntry_t*      msg,
+                                     ieee802154_header_iht* ieee802514_header);
+
 //=========================== public ==========================================
 
 /**
@@ -16,10 +28,25 @@
 
 Note that we are writing the field from the end of the header to the beginning.
 
+Both addresses are short if nextHop is my preferred parent or one of my
+children, and the short addresses are in use between us. Otherwise, the source
+address is my EUI64, and the destination address is nextHop.
+
+Frames to a neighbor which advertised NEIGHBOR_CAP_COMPACT_HEADER use the
+IEEE802.15.4-2015 field elision: an ACK carries no address, no PAN ID and no
+sequence number, as it is sent right after the frame it acknowledges; a frame
+between two EUI64s carries no PAN ID. The other frames, including EBs and
+broadcasts, keep the format all motes understand.
+
+If securityEnabled, the auxiliary security header is written from the
+l2_securityLevel, l2_keyIndex and l2_frameCounter fields of msg. The frame is
+only secured (MIC and encryption) afterwards, see IEEE802154_security.h.
+
 \param[in,out] msg              The message to append the header to.
 \param[in]     frameType        Type of IEEE802.15.4 frame.
 \param[in]     ielistpresent    Is the IE list present
-\param[in]     frameVersion     IEEE802.15.4 frame version.
+\param[in]     frameVersion     IEEE802.15.4 frame version, IEEE154_FRAMEVERSION
+   if fields are elided.
 \param[in]     securityEnabled  Is security enabled on this frame?
 \param[in]     sequenceNumber   Sequence number of this frame.
 \param[in]     nextHop          Address of the next hop
@@ -31,41 +58,75 @@ void ieee802154_prependHeader(OpenQueueEntry_t* msg,
                               bool              securityEnabled,
                               uint8_t           sequenceNumber,
                               open_addr_t*      nextHop) {
-   uint8_t temp_8b;
+   uint8_t     temp_8b;
+   open_addr_t nextHopShort;
+   bool        useShort;
+   bool        compact;
+   bool        noAddress;
+   bool        noPanId;
    
    //General IEs here (those that are carried in all packets) -- None by now.
    
-   // previousHop address (always 64-bit)
-   packetfunctions_writeAddress(msg,idmanager_getMyID(ADDR_64B),OW_LITTLE_ENDIAN);
-   // nextHop address
-   if (packetfunctions_isBroadcastMulticast(nextHop)) {
-      //broadcast address is always 16-bit
-      packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
-      *((uint8_t*)(msg->payload)) = 0xFF;
-      packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
-      *((uint8_t*)(msg->payload)) = 0xFF;
-   } else {
-      switch (nextHop->type) {
-         case ADDR_16B:
-         case ADDR_64B:
-            packetfunctions_writeAddress(msg,nextHop,OW_LITTLE_ENDIAN);
-            break;
-         default:
-            openserial_printCritical(COMPONENT_IEEE802154,ERR_WRONG_ADDR_TYPE,
-                                  (errorparameter_t)nextHop->type,
-                                  (errorparameter_t)1);
+   // auxiliary security header
+   if (securityEnabled) {
+      prependAuxiliarySecurityHeader(msg);
+   }
+   
+   useShort  = nextHop->type==ADDR_64B && neighbors_getShortAddress(nextHop,&nextHopShort);
+   compact   = frameType!=IEEE154_TYPE_BEACON && nextHop->type==ADDR_64B && neighbors_supportsCompactHeader(nextHop);
+   noAddress = compact && frameType==IEEE154_TYPE_ACK;
+   noPanId   = compact && (noAddress || useShort==FALSE);
+   if (compact) {
+      // the PAN ID presence of IEEE802.15.4-2015 only applies to its frames
+      frameVersion = IEEE154_FRAMEVERSION;
+   }
+   
+   if (noAddress==FALSE) {
+      // previousHop address
+      if (useShort) {
+         packetfunctions_writeAddress(msg,idmanager_getMyShortAddress(),OW_LITTLE_ENDIAN);
+      } else {
+         packetfunctions_writeAddress(msg,idmanager_getMyID(ADDR_64B),OW_LITTLE_ENDIAN);
+      }
+      // nextHop address
+      if (useShort) {
+         packetfunctions_writeAddress(msg,&nextHopShort,OW_LITTLE_ENDIAN);
+      } else if (packetfunctions_isBroadcastMulticast(nextHop)) {
+         //broadcast address is always 16-bit
+         packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+         *((uint8_t*)(msg->payload)) = 0xFF;
+         packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+         *((uint8_t*)(msg->payload)) = 0xFF;
+      } else {
+         switch (nextHop->type) {
+            case ADDR_16B:
+            case ADDR_64B:
+               packetfunctions_writeAddress(msg,nextHop,OW_LITTLE_ENDIAN);
+               break;
+            default:
+               openserial_printCritical(COMPONENT_IEEE802154,ERR_WRONG_ADDR_TYPE,
+                                     (errorparameter_t)nextHop->type,
+                                     (errorparameter_t)1);
+         }
+         
       }
-      
    }
    // destpan
-   packetfunctions_writeAddress(msg,idmanager_getMyID(ADDR_PANID),OW_LITTLE_ENDIAN);
+   if (noPanId==FALSE) {
+      packetfunctions_writeAddress(msg,idmanager_getMyID(ADDR_PANID),OW_LITTLE_ENDIAN);
+   }
    //dsn
-   packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
-   *((uint8_t*)(msg->payload)) = sequenceNumber;
+   if (noAddress==FALSE) {
+      packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+      *((uint8_t*)(msg->payload)) = sequenceNumber;
+   }
    //fcf (2nd byte)
    packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
    temp_8b              = 0;
-   if (packetfunctions_isBroadcastMulticast(nextHop)) {
+   if (noAddress) {
+      temp_8b          |= IEEE154_SEQNUM_SUPPRESSED       << IEEE154_FCF_SEQNUM_SUPPRESSION;
+      temp_8b          |= IEEE154_ADDR_NONE               << IEEE154_FCF_DEST_ADDR_MODE;
+   } else if (useShort || packetfunctions_isBroadcastMulticast(nextHop)) {
       temp_8b          |= IEEE154_ADDR_SHORT              << IEEE154_FCF_DEST_ADDR_MODE;
    } else {
       switch (nextHop->type) {
@@ -78,7 +139,13 @@ void ieee802154_prependHeader(OpenQueueEntry_t* msg,
          // no need for a default, since it would have been caught above.
       }
    }
-   temp_8b             |= IEEE154_ADDR_EXT                << IEEE154_FCF_SRC_ADDR_MODE;
+   if (noAddress) {
+      temp_8b          |= IEEE154_ADDR_NONE               << IEEE154_FCF_SRC_ADDR_MODE;
+   } else if (useShort) {
+      temp_8b          |= IEEE154_ADDR_SHORT              << IEEE154_FCF_SRC_ADDR_MODE;
+   } else {
+      temp_8b          |= IEEE154_ADDR_EXT                << IEEE154_FCF_SRC_ADDR_MODE;
+   }
    //poipoi xv IE list present
    temp_8b             |= ielistpresent                   << IEEE154_FCF_IELIST_PRESENT;
    temp_8b             |= frameVersion                    << IEEE154_FCF_FRAME_VERSION;
@@ -95,7 +162,12 @@ void ieee802154_prependHeader(OpenQueueEntry_t* msg,
    } else {
       temp_8b          |= IEEE154_ACK_YES_ACK_REQ         << IEEE154_FCF_ACK_REQ;
    }
-   temp_8b             |= IEEE154_PANID_COMPRESSED        << IEEE154_FCF_INTRAPAN;
+   if (noAddress) {
+      // without any address, a compressed PAN ID would mean a PAN ID is present
+      temp_8b          |= IEEE154_PANID_UNCOMPRESSED      << IEEE154_FCF_INTRAPAN;
+   } else {
+      temp_8b          |= IEEE154_PANID_COMPRESSED        << IEEE154_FCF_INTRAPAN;
+   }
    *((uint8_t*)(msg->payload)) = temp_8b;
 }
 
@@ -104,18 +176,34 @@ void ieee802154_prependHeader(OpenQueueEntry_t* msg,
 
 Note We are writing the fields from the begnning of the header to the end.
 
+A short source address is replaced by the EUI64 of the neighbor using it; the
+header is not valid if no neighbor does.
+
+The PAN IDs present are those of IEEE802.15.4-2015 for its frames, and of
+IEEE802.15.4-2006 otherwise. The only exception is a IEEE802.15.4-2015 frame
+between two EUI64s with a compressed PAN ID: motes which don't elide fields
+still put a PAN ID in it, so it is only considered elided if my EUI64 is right
+after the sequence number.
+
+The auxiliary security header is parsed into the security fields of
+ieee802514_header, and counted in its length. A secured frame is not valid if
+this mote is built without L2_SECURITY_ACTIVE, as it could not be read.
+
 \param[in,out] msg            The message just received.
 \param[out] ieee802514_header The internal header to write the data to.
 */
 void ieee802154_retrieveHeader(OpenQueueEntry_t*      msg,
                                ieee802154_header_iht* ieee802514_header) {
    uint8_t temp_8b;
+   bool    destPanIdPresent;
+   bool    srcPanIdPresent;
    
    // by default, let's assume the header is not valid, in case we leave this
    // function because the packet ends up being shorter than the header.
    ieee802514_header->valid=FALSE;
    
    ieee802514_header->headerLength = 0;
+   ieee802514_header->srcShort     = FALSE;
    // fcf, byte 1
    if (ieee802514_header->headerLength>msg->length) { return; } // no more to read!
    temp_8b = *((uint8_t*)(msg->payload)+ieee802514_header->headerLength);
@@ -131,10 +219,17 @@ void ieee802154_retrieveHeader(OpenQueueEntry_t*      msg,
    //poipoi xv IE list present
    ieee802514_header->ieListPresent  = (temp_8b >> IEEE154_FCF_IELIST_PRESENT     ) & 0x01;//1b
    ieee802514_header->frameVersion   = (temp_8b >> IEEE154_FCF_FRAME_VERSION      ) & 0x03;//2b
+   ieee802514_header->dsnSuppressed  = (temp_8b >> IEEE154_FCF_SEQNUM_SUPPRESSION ) & 0x01;//1b
 
    if (ieee802514_header->ieListPresent==TRUE && ieee802514_header->frameVersion!=IEEE154_FRAMEVERSION){
        return; //invalid packet accordint to p.64 IEEE15.4e
    }
+   if (ieee802514_header->dsnSuppressed==TRUE && ieee802514_header->frameVersion!=IEEE154_FRAMEVERSION){
+       return; // reserved bit before IEEE802.15.4-2015
+   }
+   if (ieee802514_header->dsnSuppressed==TRUE && ieee802514_header->ackRequested==TRUE){
+       return; // a retransmission could not be told from a new frame
+   }
    
    switch ( (temp_8b >> IEEE154_FCF_DEST_ADDR_MODE ) & 0x03 ) {
       case IEEE154_ADDR_NONE:
@@ -170,16 +265,41 @@ void ieee802154_retrieveHeader(OpenQueueEntry_t*      msg,
    }
    ieee802514_header->headerLength += 1;
    // sequenceNumber
-   if (ieee802514_header->headerLength>msg->length) { return; } // no more to read!
-   ieee802514_header->dsn  = *((uint8_t*)(msg->payload)+ieee802514_header->headerLength);
-   ieee802514_header->headerLength += 1;
+   if (ieee802514_header->dsnSuppressed==TRUE) {
+      ieee802514_header->dsn  = 0;
+   } else {
+      if (ieee802514_header->headerLength>msg->length) { return; } // no more to read!
+      ieee802514_header->dsn  = *((uint8_t*)(msg->payload)+ieee802514_header->headerLength);
+      ieee802514_header->headerLength += 1;
+   }
    // panID
-   if (ieee802514_header->headerLength>msg->length) { return; } // no more to read!
-   packetfunctions_readAddress(((uint8_t*)(msg->payload)+ieee802514_header->headerLength),
-                               ADDR_PANID,
-                               &ieee802514_header->panid,
-                               OW_LITTLE_ENDIAN);
-   ieee802514_header->headerLength += 2;
+   getPanIdPresence(
+      ieee802514_header->frameVersion,
+      ieee802514_header->panIDCompression,
+      ieee802514_header->dest.type,
+      ieee802514_header->src.type,
+      &destPanIdPresent,
+      &srcPanIdPresent
+   );
+   if (
+         ieee802514_header->frameVersion==IEEE154_FRAMEVERSION       &&
+         ieee802514_header->panIDCompression==TRUE                   &&
+         ieee802514_header->dest.type==ADDR_64B                      &&
+         ieee802514_header->src.type==ADDR_64B                       &&
+         isMyEui64((uint8_t*)(msg->payload)+ieee802514_header->headerLength,
+                   msg->length-ieee802514_header->headerLength)==FALSE
+      ) {
+      destPanIdPresent = TRUE;
+   }
+   ieee802514_header->panid.type = ADDR_NONE;
+   if (destPanIdPresent==TRUE || srcPanIdPresent==TRUE) {
+      if (ieee802514_header->headerLength>msg->length) { return; } // no more to read!
+      packetfunctions_readAddress(((uint8_t*)(msg->payload)+ieee802514_header->headerLength),
+                                  ADDR_PANID,
+                                  &ieee802514_header->panid,
+                                  OW_LITTLE_ENDIAN);
+      ieee802514_header->headerLength += 2;
+   }
    // dest
    if (ieee802514_header->headerLength>msg->length) { return; } // no more to read!
    switch (ieee802514_header->dest.type) {
@@ -205,6 +325,11 @@ void ieee802154_retrieveHeader(OpenQueueEntry_t*      msg,
          break;
       // no need for a default, since case would have been caught above
    }
+   // source panID, when both are present (the same as the destination's in my PAN)
+   if (destPanIdPresent==TRUE && srcPanIdPresent==TRUE) {
+      ieee802514_header->headerLength += 2;
+      if (ieee802514_header->headerLength>msg->length) {  return; } // no more to read!
+   }
    //src
    switch (ieee802514_header->src.type) {
       case ADDR_NONE:
@@ -216,6 +341,11 @@ void ieee802154_retrieveHeader(OpenQueueEntry_t*      msg,
                                      OW_LITTLE_ENDIAN);
          ieee802514_header->headerLength += 2;
          if (ieee802514_header->headerLength>msg->length) {  return; } // no more to read!
+         // the rest of the stack only knows neighbors by their EUI64
+         if (neighbors_indicateRxShortAddress(&ieee802514_header->src,&ieee802514_header->src)==FALSE) {
+            return;
+         }
+         ieee802514_header->srcShort = TRUE;
          break;
       case ADDR_64B:
          packetfunctions_readAddress(((uint8_t*)(msg->payload)+ieee802514_header->headerLength),
@@ -228,6 +358,21 @@ void ieee802154_retrieveHeader(OpenQueueEntry_t*      msg,
       // no need for a default, since case would have been caught above
    }
    
+   // auxiliary security header
+   ieee802514_header->securityLevel = IEEE154_ASH_SLF_TYPE_NOSEC;
+   ieee802514_header->keyIdMode     = IEEE154_ASH_KEYIDMODE_IMPLICIT;
+   ieee802514_header->keyIndex      = 0;
+   ieee802514_header->frameCounter  = 0;
+   if (ieee802514_header->securityEnabled==TRUE) {
+#ifdef L2_SECURITY_ACTIVE
+      if (retrieveAuxiliarySecurityHeader(msg,ieee802514_header)==FALSE) {
+         return;
+      }
+#else
+      return;
+#endif
+   }
+   
    if (ieee802514_header->ieListPresent==TRUE && ieee802514_header->frameVersion!=IEEE154_FRAMEVERSION){
        return; //invalid packet accordint to p.64 IEEE15.4e
    }
@@ -241,4 +386,247 @@ void ieee802154_retrieveHeader(OpenQueueEntry_t*      msg,
    ieee802514_header->valid=TRUE;
 }
 
+/**
+\brief Retrieve the destination of a frame from its first bytes only.
+
+Used to decide whether a frame is worth receiving before it is complete.
+
+\param[in]  header The first bytes of the frame, starting with the FCF.
+\param[in]  len    Number of bytes in header.
+\param[out] panid  The destination PAN ID, of type ADDR_NONE if elided.
+\param[out] dest   The destination address, of type ADDR_NONE if the frame
+   has none.
+
+\returns TRUE if header holds the whole destination, FALSE otherwise.
+*/
+bool ieee802154_retrieveDestination(uint8_t*     header,
+                                    uint8_t      len,
+                                    open_addr_t* panid,
+                                    open_addr_t* dest) {
+   uint8_t headerLength;
+   uint8_t frameVersion;
+   uint8_t srcType;
+   bool    panIDCompression;
+   bool    destPanIdPresent;
+   bool    srcPanIdPresent;
+   
+   // fcf (2B), sequenceNumber (1B)
+   if (len<2) { return FALSE; } // no more to read!
+   frameVersion     = (header[1] >> IEEE154_FCF_FRAME_VERSION) & 0x03;
+   panIDCompression = (header[0] >> IEEE154_FCF_INTRAPAN     ) & 0x01;
+   headerLength = 3;
+   if (((header[1] >> IEEE154_FCF_SEQNUM_SUPPRESSION) & 0x01)==IEEE154_SEQNUM_SUPPRESSED) {
+      headerLength = 2;
+   }
+   switch ( (header[1] >> IEEE154_FCF_DEST_ADDR_MODE ) & 0x03 ) {
+      case IEEE154_ADDR_NONE:
+         dest->type = ADDR_NONE;
+         break;
+      case IEEE154_ADDR_SHORT:
+         dest->type = ADDR_16B;
+         break;
+      case IEEE154_ADDR_EXT:
+         dest->type = ADDR_64B;
+         break;
+      default:
+         return FALSE;
+   }
+   switch ( (header[1] >> IEEE154_FCF_SRC_ADDR_MODE ) & 0x03 ) {
+      case IEEE154_ADDR_SHORT:
+         srcType = ADDR_16B;
+         break;
+      case IEEE154_ADDR_EXT:
+         srcType = ADDR_64B;
+         break;
+      default:
+         srcType = ADDR_NONE;
+         break;
+   }
+   // panID, see ieee802154_retrieveHeader()
+   getPanIdPresence(frameVersion,panIDCompression,dest->type,srcType,&destPanIdPresent,&srcPanIdPresent);
+   if (
+         frameVersion==IEEE154_FRAMEVERSION                          &&
+         panIDCompression==TRUE                                      &&
+         dest->type==ADDR_64B                                        &&
+         srcType==ADDR_64B                                           &&
+         isMyEui64(header+headerLength,len-headerLength)==FALSE
+      ) {
+      destPanIdPresent = TRUE;
+   }
+   panid->type = ADDR_NONE;
+   if (destPanIdPresent==TRUE) {
+      if (headerLength+2>len) { return FALSE; } // no more to read!
+      packetfunctions_readAddress(header+headerLength,
+                                  ADDR_PANID,
+                                  panid,
+                                  OW_LITTLE_ENDIAN);
+      headerLength += 2;
+   }
+   // dest
+   switch (dest->type) {
+      case ADDR_16B:
+         if (headerLength+2>len) { return FALSE; } // no more to read!
+         packetfunctions_readAddress(header+headerLength,
+                                     ADDR_16B,
+                                     dest,
+                                     OW_LITTLE_ENDIAN);
+         break;
+      case ADDR_64B:
+         if (headerLength+8>len) { return FALSE; } // no more to read!
+         packetfunctions_readAddress(header+headerLength,
+                                     ADDR_64B,
+                                     dest,
+                                     OW_LITTLE_ENDIAN);
+         break;
+      default:
+         break;
+   }
+   return TRUE;
+}
+
 //=========================== private =========================================
+
+/**
+\brief Tell which PAN IDs a frame carries, from its frame control field.
+
+\param[in]  frameVersion     IEEE802.15.4 frame version of the frame.
+\param[in]  panIDCompression Whether the PAN ID Compression bit is set.
+\param[in]  destType         Type of the destination address, ADDR_NONE if none.
+\param[in]  srcType          Type of the source address, ADDR_NONE if none.
+\param[out] destPanIdPresent Whether the destination PAN ID is present.
+\param[out] srcPanIdPresent  Whether the source PAN ID is present.
+*/
+void getPanIdPresence(uint8_t frameVersion,
+                      bool    panIDCompression,
+                      uint8_t destType,
+                      uint8_t srcType,
+                      bool*   destPanIdPresent,
+                      bool*   srcPanIdPresent) {
+   if (frameVersion!=IEEE154_FRAMEVERSION) {
+      // IEEE802.15.4-2006: the source PAN ID is compressed into the destination's
+      *destPanIdPresent = destType!=ADDR_NONE;
+      *srcPanIdPresent  = srcType!=ADDR_NONE && (destType==ADDR_NONE || panIDCompression==FALSE);
+      return;
+   }
+   
+   // IEEE802.15.4-2015, table 7-2
+   if (destType==ADDR_NONE || srcType==ADDR_NONE) {
+      // a single PAN ID, present if compressed only without any address
+      *destPanIdPresent = (destType!=ADDR_NONE && panIDCompression==FALSE) ||
+                          (destType==ADDR_NONE && srcType==ADDR_NONE && panIDCompression==TRUE);
+      *srcPanIdPresent  = destType==ADDR_NONE && srcType!=ADDR_NONE && panIDCompression==FALSE;
+   } else if (destType==ADDR_64B && srcType==ADDR_64B) {
+      *destPanIdPresent = panIDCompression==FALSE;
+      *srcPanIdPresent  = FALSE;
+   } else {
+      *destPanIdPresent = TRUE;
+      *srcPanIdPresent  = panIDCompression==FALSE;
+   }
+}
+
+/**
+\brief Tell whether a buffer starts with my EUI64, written little endian.
+
+\param[in] buf The buffer.
+\param[in] len Number of bytes in buf.
+
+\returns TRUE if buf holds at least 8 bytes, which are my EUI64.
+*/
+bool isMyEui64(uint8_t* buf, uint8_t len) {
+   open_addr_t addr;
+   
+   if (len<LENGTH_ADDR64b) {
+      return FALSE;
+   }
+   packetfunctions_readAddress(buf,ADDR_64B,&addr,OW_LITTLE_ENDIAN);
+   return idmanager_isMyAddress(&addr);
+}
+
+/**
+\brief Prepend the auxiliary security header, with a 1-byte key index.
+
+\param[in,out] msg The message to prepend the header to.
+*/
+void prependAuxiliarySecurityHeader(OpenQueueEntry_t* msg) {
+   uint8_t temp_8b;
+   
+   // key index
+   packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+   *((uint8_t*)(msg->payload)) = msg->l2_keyIndex;
+   // frame counter, little endian
+   packetfunctions_reserveHeaderSize(msg,sizeof(uint32_t));
+   msg->payload[0] = (uint8_t)(msg->l2_frameCounter      );
+   msg->payload[1] = (uint8_t)(msg->l2_frameCounter >>  8);
+   msg->payload[2] = (uint8_t)(msg->l2_frameCounter >> 16);
+   msg->payload[3] = (uint8_t)(msg->l2_frameCounter >> 24);
+   // security control
+   packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+   temp_8b              = 0;
+   temp_8b             |= msg->l2_securityLevel           << IEEE154_ASH_SCF_SECURITY_LEVEL;
+   temp_8b             |= IEEE154_ASH_KEYIDMODE_INDEX     << IEEE154_ASH_SCF_KEY_IDENTIFIER_MODE;
+   *((uint8_t*)(msg->payload)) = temp_8b;
+}
+
+/**
+\brief Retrieve the auxiliary security header of a (just received) frame.
+
+The frame counter must be present, and the key identified by its index only,
+as in prependAuxiliarySecurityHeader().
+
+\param[in]     msg               The message just received.
+\param[in,out] ieee802514_header The internal header, parsed up to the
+   auxiliary security header.
+
+\returns TRUE if the auxiliary security header is valid, FALSE otherwise.
+*/
+bool retrieveAuxiliarySecurityHeader(OpenQueueEntry_t*      msg,
+                                     ieee802154_header_iht* ieee802514_header) {
+   uint8_t* buf;
+   uint8_t  temp_8b;
+   
+   buf = (uint8_t*)(msg->payload)+ieee802514_header->headerLength;
+   
+   // security control
+   if (ieee802514_header->headerLength+1>msg->length) { return FALSE; } // no more to read!
+   temp_8b = buf[0];
+   ieee802514_header->securityLevel = (temp_8b >> IEEE154_ASH_SCF_SECURITY_LEVEL     ) & 0x07;//3b
+   ieee802514_header->keyIdMode     = (temp_8b >> IEEE154_ASH_SCF_KEY_IDENTIFIER_MODE) & 0x03;//2b
+   if (
+         ((temp_8b >> IEEE154_ASH_SCF_FRAME_CNT_SUPPRESS) & 0x01)==1 ||
+         ((temp_8b >> IEEE154_ASH_SCF_ASN_IN_NONCE)       & 0x01)==1
+      ) {
+      openserial_printError(COMPONENT_IEEE802154,ERR_IEEE154_UNSUPPORTED,
+                            (errorparameter_t)3,
+                            (errorparameter_t)temp_8b);
+      return FALSE;
+   }
+   if (ieee802514_header->securityLevel==IEEE154_ASH_SLF_TYPE_NOSEC) {
+      return FALSE; // security enabled, but no security level
+   }
+   ieee802514_header->headerLength += 1;
+   
+   // frame counter, little endian
+   if (ieee802514_header->headerLength+4>msg->length) { return FALSE; } // no more to read!
+   ieee802514_header->frameCounter  = ((uint32_t)buf[1]      ) |
+                                      ((uint32_t)buf[2] <<  8) |
+                                      ((uint32_t)buf[3] << 16) |
+                                      ((uint32_t)buf[4] << 24);
+   ieee802514_header->headerLength += 4;
+   
+   // key identifier
+   switch (ieee802514_header->keyIdMode) {
+      case IEEE154_ASH_KEYIDMODE_IMPLICIT:
+         break;
+      case IEEE154_ASH_KEYIDMODE_INDEX:
+         if (ieee802514_header->headerLength+1>msg->length) { return FALSE; } // no more to read!
+         ieee802514_header->keyIndex      = buf[5];
+         ieee802514_header->headerLength += 1;
+         break;
+      default:
+         openserial_printError(COMPONENT_IEEE802154,ERR_IEEE154_UNSUPPORTED,
+                               (errorparameter_t)4,
+                               (errorparameter_t)ieee802514_header->keyIdMode);
+         return FALSE;
+   }
+   return TRUE;
+}
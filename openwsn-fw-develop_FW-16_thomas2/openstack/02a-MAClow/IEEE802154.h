@@ -18,6 +18,7 @@ enum IEEE802154_fcf_enums {
    IEEE154_FCF_FRAME_PENDING           = 4,
    IEEE154_FCF_ACK_REQ                 = 5,
    IEEE154_FCF_INTRAPAN                = 6,
+   IEEE154_FCF_SEQNUM_SUPPRESSION      = 0,
    IEEE154_FCF_IELIST_PRESENT          = 1,
    IEEE154_FCF_DEST_ADDR_MODE          = 2,
    IEEE154_FCF_FRAME_VERSION           = 4,
@@ -44,6 +45,32 @@ enum IEEE802154_fcf_sec_enums {
    IEEE154_SEC_YES_SECURITY            = 1,
 };
 
+// auxiliary security header, security control field
+enum IEEE802154_ash_scf_enums {
+   IEEE154_ASH_SCF_SECURITY_LEVEL      = 0,
+   IEEE154_ASH_SCF_KEY_IDENTIFIER_MODE = 3,
+   IEEE154_ASH_SCF_FRAME_CNT_SUPPRESS  = 5,
+   IEEE154_ASH_SCF_ASN_IN_NONCE        = 6,
+};
+
+enum IEEE802154_ash_slf_enums {
+   IEEE154_ASH_SLF_TYPE_NOSEC          = 0,
+   IEEE154_ASH_SLF_TYPE_MIC_32         = 1,
+   IEEE154_ASH_SLF_TYPE_MIC_64         = 2,
+   IEEE154_ASH_SLF_TYPE_MIC_128        = 3,
+   IEEE154_ASH_SLF_TYPE_ENC            = 4,
+   IEEE154_ASH_SLF_TYPE_ENC_MIC_32     = 5,
+   IEEE154_ASH_SLF_TYPE_ENC_MIC_64     = 6,
+   IEEE154_ASH_SLF_TYPE_ENC_MIC_128    = 7,
+};
+
+enum IEEE802154_ash_keyIdMode_enums {
+   IEEE154_ASH_KEYIDMODE_IMPLICIT      = 0, // no key identifier
+   IEEE154_ASH_KEYIDMODE_INDEX         = 1, // 1B key index
+   IEEE154_ASH_KEYIDMODE_SOURCE4       = 2, // 4B key source, 1B key index
+   IEEE154_ASH_KEYIDMODE_SOURCE8       = 3, // 8B key source, 1B key index
+};
+
 enum IEEE802154_fcf_ielist_enums {
    IEEE154_IELIST_NO                   = 0,
    IEEE154_IELIST_YES                  = 1,
@@ -64,6 +91,11 @@ enum IEEE802154_fcf_panid_enums {
    IEEE154_PANID_COMPRESSED            = 1,
 };
 
+enum IEEE802154_fcf_seqnum_enums {
+   IEEE154_SEQNUM_PRESENT              = 0,
+   IEEE154_SEQNUM_SUPPRESSED           = 1,
+};
+
 enum IEEE802154_fcf_addr_mode_enums {
    IEEE154_ADDR_NONE                   = 0,
    IEEE154_ADDR_SHORT                  = 2,
@@ -80,12 +112,18 @@ typedef struct {
    bool        framePending;
    bool        ackRequested;
    bool        panIDCompression;
+   bool        dsnSuppressed;
    bool        ieListPresent;
    uint8_t     frameVersion;
-   uint8_t     dsn;
-   open_addr_t panid;
+   uint8_t     dsn;             // 0 if suppressed
+   open_addr_t panid;           // of type ADDR_NONE if elided
    open_addr_t dest;
-   open_addr_t src;
+   open_addr_t src;             // the neighbor's EUI64, even if it used its short address
+   bool        srcShort;        // whether the neighbor used its short address
+   uint8_t     securityLevel;   // IEEE154_ASH_SLF_TYPE_NOSEC if security is not enabled
+   uint8_t     keyIdMode;
+   uint8_t     keyIndex;        // 0 if the key identifier mode is implicit
+   uint32_t    frameCounter;
 } ieee802154_header_iht; //iht for "internal header type"
 
 //=========================== variables =======================================
@@ -104,6 +142,10 @@ void ieee802154_prependHeader(OpenQueueEntry_t* msg,
 
 void ieee802154_retrieveHeader (OpenQueueEntry_t*      msg,
                                 ieee802154_header_iht* ieee802514_header);
+bool ieee802154_retrieveDestination(uint8_t*     header,
+                                    uint8_t      len,
+                                    open_addr_t* panid,
+                                    open_addr_t* dest);
 
 /**
 \}
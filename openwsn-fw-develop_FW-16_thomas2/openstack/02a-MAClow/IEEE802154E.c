@@ -15,6 +15,7 @@
 #include "sixtop.h"
 #include "adaptive_sync.h"
 #include "processIE.h"
+#include "energy.h"
 
 //=========================== variables =======================================
 
@@ -50,6 +51,7 @@ void     activity_rie1(void);
 void     activity_ri3(void);
 void     activity_rie2(void);
 void     activity_ri4(PORT_RADIOTIMER_WIDTH capturedTime);
+void     activity_ri4b(void);
 void     activity_rie3(void);
 void     activity_ri5(PORT_RADIOTIMER_WIDTH capturedTime);
 void     activity_ri6(void);
@@ -64,11 +66,18 @@ void     activity_ri9(PORT_RADIOTIMER_WIDTH capturedTime);
 bool     isValidRxFrame(ieee802154_header_iht* ieee802514_header);
 bool     isValidAck(ieee802154_header_iht*     ieee802514_header,
                     OpenQueueEntry_t*          packetSent);
+bool     isDuplicateFrame(OpenQueueEntry_t* pkt);
+// ACK template
+void     prepareAckTemplate(void);
+bool     isAckTemplateFor(open_addr_t* neighbor);
+void     buildAckTemplate(open_addr_t* neighbor);
 // IEs Handling
 bool     ieee154e_processIEs(OpenQueueEntry_t* pkt, uint16_t* lenIE);
 void     ieee154e_processSlotframeLinkIE(OpenQueueEntry_t* pkt,uint8_t * ptr);
 // ASN handling
 void     incrementAsnOffset(void);
+void     incrementAsnOffsetBy(uint16_t numSlots);
+void     readCurrentAsn(asn_t* asn);
 void     asnStoreFromAdv(uint8_t* asn);
 void     joinPriorityStoreFromAdv(uint8_t jp);
 // synchronization
@@ -84,6 +93,17 @@ void     updateStats(PORT_SIGNED_INT_WIDTH timeCorrection);
 // misc
 uint8_t  calculateFrequency(uint8_t channelOffset);
 void     changeState(ieee154e_state_t newstate);
+void     skipIdleSlots(void);
+PORT_RADIOTIMER_WIDTH getResyncGuard(cellType_t cellType);
+OpenQueueEntry_t* getDataPacket(open_addr_t* neighbor);
+void     prepareNextData(void);
+OpenQueueEntry_t* takePreparedData(open_addr_t* neighbor);
+void     releasePreparedData(void);
+void     raiseTxPower(OpenQueueEntry_t* pkt);
+void     retryOrDrop(bool aborted);
+#ifdef LEAF
+bool     leafSkipsListening(void);
+#endif
 void     endSlot(void);
 bool     debugPrint_asn(void);
 bool     debugPrint_isSync(void);
@@ -104,6 +124,8 @@ void ieee154e_init() {
    // initialize variables
    memset(&ieee154e_vars,0,sizeof(ieee154e_vars_t));
    memset(&ieee154e_dbg,0,sizeof(ieee154e_dbg_t));
+   ieee154e_vars.numOfSleepSlots = 1;
+   ieee154e_dbg.minTxAckMargin = maxTxAckPrepare;
    
    if (idmanager_getIsDAGroot()==TRUE) {
       changeIsSync(TRUE);
@@ -137,28 +159,68 @@ void ieee154e_init() {
 */
 PORT_RADIOTIMER_WIDTH ieee154e_asnDiff(asn_t* someASN) {
    PORT_RADIOTIMER_WIDTH diff;
-   INTERRUPT_DECLARATION();
-   DISABLE_INTERRUPTS();
-   if (ieee154e_vars.asn.byte4 != someASN->byte4) {
-      ENABLE_INTERRUPTS();
+   asn_t                 asn;
+   
+   readCurrentAsn(&asn);
+   if (asn.byte4 != someASN->byte4) {
       return (PORT_RADIOTIMER_WIDTH)0xFFFFFFFF;;
    }
    
    diff = 0;
-   if (ieee154e_vars.asn.bytes2and3 == someASN->bytes2and3) {
-      ENABLE_INTERRUPTS();
-      return ieee154e_vars.asn.bytes0and1-someASN->bytes0and1;
-   } else if (ieee154e_vars.asn.bytes2and3-someASN->bytes2and3==1) {
-      diff  = ieee154e_vars.asn.bytes0and1;
+   if (asn.bytes2and3 == someASN->bytes2and3) {
+      return asn.bytes0and1-someASN->bytes0and1;
+   } else if (asn.bytes2and3-someASN->bytes2and3==1) {
+      diff  = asn.bytes0and1;
       diff += 0xffff-someASN->bytes0and1;
       diff += 1;
    } else {
       diff = (PORT_RADIOTIMER_WIDTH)0xFFFFFFFF;;
    }
-   ENABLE_INTERRUPTS();
    return diff;
 }
 
+/**
+\brief Number of slots since my time source last corrected my clock.
+
+Both a frame received from the time source and an ACK it sent back with a
+time correction count.
+
+\returns The number of slots, or 0xffff if more than 65535
+*/
+PORT_RADIOTIMER_WIDTH ieee154e_slotsSinceSync() {
+   return ieee154e_asnDiff(&ieee154e_vars.asnLastSync);
+}
+
+/**
+\brief Time left before the MAC needs the CPU again.
+
+Between two active slots, the slot timer only fires when the next active slot
+starts. Work which keeps the CPU busy with interrupts held off, such as erasing
+the flash, can only run without breaking the schedule if it fits in this time.
+
+\returns The number of 32kHz ticks until the next active slot starts, 0 if a
+   slot is in progress or the mote is not synchronized.
+*/
+PORT_RADIOTIMER_WIDTH ieee154e_getTimeToNextSlot() {
+   PORT_RADIOTIMER_WIDTH currentValue;
+   PORT_RADIOTIMER_WIDTH currentPeriod;
+   bool                  sleeping;
+   INTERRUPT_DECLARATION();
+   
+   DISABLE_INTERRUPTS();
+   sleeping      = (ieee154e_vars.isSync==TRUE && ieee154e_vars.state==S_SLEEP);
+   currentValue  = radio_getTimerValue();
+   currentPeriod = radio_getTimerPeriod();
+   ENABLE_INTERRUPTS();
+   
+   // a small value may be a slot timer which wrapped while the interrupts were
+   // off, the new slot has not been handled yet
+   if (sleeping==FALSE || currentValue<TsTxOffset || currentValue>=currentPeriod) {
+      return 0;
+   }
+   return currentPeriod-currentValue;
+}
+
 //======= events
 
 /**
@@ -167,8 +229,12 @@ PORT_RADIOTIMER_WIDTH ieee154e_asnDiff(asn_t* someASN) {
 This function executes in ISR mode, when the new slot timer fires.
 */
 void isr_ieee154e_newSlot() {
+   // account for the slot which just ended, the period is about to change
+   energy_indicateNewPeriod(radio_getTimerPeriod());
+   energy_cpuEnter();
    radio_setTimerPeriod(TsSlotDuration);
    if (ieee154e_vars.isSync==FALSE) {
+      ieee154e_vars.numOfSleepSlots = 1;
       if (idmanager_getIsDAGroot()==TRUE) {
          changeIsSync(TRUE);
       } else {
@@ -180,6 +246,7 @@ void isr_ieee154e_newSlot() {
       activity_ti1ORri1();
    }
    ieee154e_dbg.num_newSlot++;
+   energy_cpuExit();
 }
 
 /**
@@ -188,6 +255,7 @@ void isr_ieee154e_newSlot() {
 This function executes in ISR mode, when the FSM timer fires.
 */
 void isr_ieee154e_timer() {
+   energy_cpuEnter();
    switch (ieee154e_vars.state) {
       case S_TXDATAOFFSET:
          activity_ti2();
@@ -231,6 +299,9 @@ void isr_ieee154e_timer() {
       case S_RXDATALISTEN:
          activity_rie2();
          break;
+      case S_RXDATAHEADER:
+         activity_ri4b();
+         break;
       case S_RXDATA:
          activity_rie3();
          break;
@@ -259,6 +330,7 @@ void isr_ieee154e_timer() {
          break;
    }
    ieee154e_dbg.num_timer++;
+   energy_cpuExit();
 }
 
 /**
@@ -267,6 +339,7 @@ void isr_ieee154e_timer() {
 This function executes in ISR mode.
 */
 void ieee154e_startOfFrame(PORT_RADIOTIMER_WIDTH capturedTime) {
+   energy_cpuEnter();
    if (ieee154e_vars.isSync==FALSE) {
      activity_synchronize_startOfFrame(capturedTime);
    } else {
@@ -307,6 +380,7 @@ void ieee154e_startOfFrame(PORT_RADIOTIMER_WIDTH capturedTime) {
       }
    }
    ieee154e_dbg.num_startOfFrame++;
+   energy_cpuExit();
 }
 
 /**
@@ -315,6 +389,7 @@ void ieee154e_startOfFrame(PORT_RADIOTIMER_WIDTH capturedTime) {
 This function executes in ISR mode.
 */
 void ieee154e_endOfFrame(PORT_RADIOTIMER_WIDTH capturedTime) {
+   energy_cpuEnter();
    if (ieee154e_vars.isSync==FALSE) {
       activity_synchronize_endOfFrame(capturedTime);
    } else {
@@ -325,6 +400,7 @@ void ieee154e_endOfFrame(PORT_RADIOTIMER_WIDTH capturedTime) {
          case S_RXACK:
             activity_ti9(capturedTime);
             break;
+         case S_RXDATAHEADER:
          case S_RXDATA:
             activity_ri5(capturedTime);
             break;
@@ -342,6 +418,7 @@ void ieee154e_endOfFrame(PORT_RADIOTIMER_WIDTH capturedTime) {
       }
    }
    ieee154e_dbg.num_endOfFrame++;
+   energy_cpuExit();
 }
 
 //======= misc
@@ -359,8 +436,7 @@ bool debugPrint_asn() {
    output.byte4         =  ieee154e_vars.asn.byte4;
    output.bytes2and3    =  ieee154e_vars.asn.bytes2and3;
    output.bytes0and1    =  ieee154e_vars.asn.bytes0and1;
-   openserial_printStatus(STATUS_ASN,(uint8_t*)&output,sizeof(output));
-   return TRUE;
+   return openserial_printStatusDelta(STATUS_ASN,NULL,(uint8_t*)&output,sizeof(output));
 }
 
 /**
@@ -374,8 +450,7 @@ status information about several modules in the OpenWSN stack.
 bool debugPrint_isSync() {
    uint8_t output=0;
    output = ieee154e_vars.isSync;
-   openserial_printStatus(STATUS_ISSYNC,(uint8_t*)&output,sizeof(uint8_t));
-   return TRUE;
+   return openserial_printStatusDelta(STATUS_ISSYNC,NULL,(uint8_t*)&output,sizeof(uint8_t));
 }
 
 /**
@@ -388,8 +463,7 @@ status information about several modules in the OpenWSN stack.
 */
 bool debugPrint_macStats() {
    // send current stats over serial
-   openserial_printStatus(STATUS_MACSTATS,(uint8_t*)&ieee154e_stats,sizeof(ieee154e_stats_t));
-   return TRUE;
+   return openserial_printStatusDelta(STATUS_MACSTATS,NULL,(uint8_t*)&ieee154e_stats,sizeof(ieee154e_stats_t));
 }
 
 //=========================== private =========================================
@@ -410,6 +484,7 @@ port_INLINE void activity_synchronize_newSlot() {
       
       // turn off the radio (in case it wasn't yet)
       radio_rfOff();
+      energy_radioState(ENERGY_RADIO_OFF);
       
       // configure the radio to listen to the default synchronizing channel
       radio_setFrequency(SYNCHRONIZING_CHANNEL);
@@ -419,22 +494,19 @@ port_INLINE void activity_synchronize_newSlot() {
       
       // switch on the radio in Rx mode.
       radio_rxEnable();
+      energy_radioState(ENERGY_RADIO_IDLE);
       ieee154e_vars.radioOnInit=radio_getTimerValue();
       ieee154e_vars.radioOnThisSlot=TRUE;
       radio_rxNow();
+      energy_radioState(ENERGY_RADIO_RX);
    }
    
-   // increment ASN (used only to schedule serial activity)
+   // increment ASN (used only to pace status printing)
    incrementAsnOffset();
    
-   // to be able to receive and transmist serial even when not synchronized
-   // take turns every 8 slots sending and receiving
-   if        ((ieee154e_vars.asn.bytes0and1&0x000f)==0x0000) {
-      openserial_stop();
-      openserial_startOutput();
-   } else if ((ieee154e_vars.asn.bytes0and1&0x000f)==0x0008) {
-      openserial_stop();
-      openserial_startInput();
+   // print status information every 16 slots while not synchronized
+   if ((ieee154e_vars.asn.bytes0and1&0x000f)==0x0000) {
+      openserial_triggerDebugPrint();
    }
 }
 
@@ -448,9 +520,6 @@ port_INLINE void activity_synchronize_startOfFrame(PORT_RADIOTIMER_WIDTH capture
    // change state
    changeState(S_SYNCRX);
    
-   // stop the serial
-   openserial_stop();
-   
    // record the captured time 
    ieee154e_vars.lastCapturedTime = capturedTime;
    
@@ -476,7 +545,7 @@ port_INLINE void activity_synchronize_endOfFrame(PORT_RADIOTIMER_WIDTH capturedT
    changeState(S_SYNCPROC);
    
    // get a buffer to put the (received) frame in
-   ieee154e_vars.dataReceived = openqueue_getFreePacketBuffer(COMPONENT_IEEE802154E);
+   ieee154e_vars.dataReceived = openqueue_getFreePacketBufferOfClass(COMPONENT_IEEE802154E,TRAFFIC_CLASS_CONTROL);
    if (ieee154e_vars.dataReceived==NULL) {
       // log the error
       openserial_printError(COMPONENT_IEEE802154E,ERR_NO_FREE_PACKET_BUFFER,
@@ -564,6 +633,7 @@ port_INLINE void activity_synchronize_endOfFrame(PORT_RADIOTIMER_WIDTH capturedT
       
       // turn off the radio
       radio_rfOff();
+      energy_radioState(ENERGY_RADIO_OFF);
       
       // compute radio duty cycle
       ieee154e_vars.radioOnTics += (radio_getTimerValue()-ieee154e_vars.radioOnInit);
@@ -606,142 +676,127 @@ port_INLINE void activity_synchronize_endOfFrame(PORT_RADIOTIMER_WIDTH capturedT
    changeState(S_SYNCLISTEN);
 }
 
+/**
+\brief Process the IEs of a received EB or ACK.
+
+The IE list is parsed once by processIE_parseIEs(); each IE is then handled
+by reading its content in place.
+
+\param[in]  pkt   The received packet, its payload starting with the IE list.
+\param[out] lenIE The length of the IE list, to be tossed.
+
+\returns TRUE if all IEs were recognized, FALSE otherwise.
+*/
 port_INLINE bool ieee154e_processIEs(OpenQueueEntry_t* pkt, uint16_t* lenIE) {
    uint8_t               ptr;
    uint8_t               byte0;
    uint8_t               byte1;
-   uint8_t               temp_8b;
-   uint8_t               gr_elem_id;
-   uint8_t               subid;
-   uint16_t              temp_16b;
-   uint16_t              len;
-   uint16_t              sublen;
+   uint8_t               i;
+   ie_descriptor_t*      ie;
    PORT_SIGNED_INT_WIDTH timeCorrection;
+   bool                  shortAddrPresent;
+   uint16_t              shortAddr;
+   uint8_t               capabilities;
    
-   ptr=0;
-   
-   //===== header or payload IE header
-   
-   //candidate IE header  if type ==0 header IE if type==1 payload IE
-   temp_8b    = *((uint8_t*)(pkt->payload)+ptr);
-   ptr++;
+   *lenIE           = 0;
+   shortAddrPresent = FALSE;
+   shortAddr        = 0;
+   capabilities     = 0;
    
-   temp_16b   = temp_8b + ((*((uint8_t*)(pkt->payload)+ptr))<< 8);
-   ptr++;
-   
-   *lenIE     = ptr;
-   
-   if ((temp_16b & IEEE802154E_DESC_TYPE_PAYLOAD_IE) == IEEE802154E_DESC_TYPE_PAYLOAD_IE){
-      // payload IE
-      
-      len          = (temp_16b & IEEE802154E_DESC_LEN_PAYLOAD_IE_MASK)>>IEEE802154E_DESC_LEN_PAYLOAD_IE_SHIFT;
-      gr_elem_id   = (temp_16b & IEEE802154E_DESC_GROUPID_PAYLOAD_IE_MASK)>>IEEE802154E_DESC_GROUPID_PAYLOAD_IE_SHIFT;
-   } else {
-      // header IE
-      
-      len          = (temp_16b & IEEE802154E_DESC_LEN_HEADER_IE_MASK)>>IEEE802154E_DESC_LEN_HEADER_IE_SHIFT;
-      gr_elem_id   = (temp_16b & IEEE802154E_DESC_ELEMENTID_HEADER_IE_MASK)>>IEEE802154E_DESC_ELEMENTID_HEADER_IE_SHIFT; 
+   if (processIE_parseIEs(pkt)==FALSE) {
+      return FALSE;
    }
+   *lenIE = pkt->l2_IEListLength;
    
-   *lenIE         += len;
-   
-   //===== sub-elements
-   
-   switch(gr_elem_id){
+   for (i=0;i<pkt->l2_numIEs;i++) {
+      ie  = &pkt->l2_IEs[i];
+      ptr = ie->offset;
       
-      case IEEE802154E_MLME_IE_GROUPID:
-         // MLME IE
+      switch (ie->id) {
          
-         do {
+         case IEEE802154E_MLME_SYNC_IE_SUBID:
+            // Sync IE: ASN and Join Priority 
             
-            //read sub IE header
-            temp_8b     = *((uint8_t*)(pkt->payload)+ptr);
-            ptr         = ptr + 1;
-            temp_16b    = temp_8b  +(*((uint8_t*)(pkt->payload)+ptr) << 8);
-            ptr         = ptr + 1;
+            if (idmanager_getIsDAGroot()==FALSE) {
+               // ASN
+               asnStoreFromAdv((uint8_t*)(pkt->payload)+ptr);
+               ptr = ptr + 5;
+               // join priority
+               joinPriorityStoreFromAdv(*((uint8_t*)(pkt->payload)+ptr));
+            }
+            break;
+         
+         case IEEE802154E_MLME_SLOTFRAME_LINK_IE_SUBID:
+            processIE_retrieveSlotframeLinkIE(pkt,&ptr);
+            break;
+         
+         case IEEE802154E_MLME_TIMESLOT_IE_SUBID:
+            //TODO
+            break;
+         
+         case IEEE802154E_MLME_SHORT_ADDRESS_IE_SUBID:
+            // Short Address IE: the sender's short address
             
-            len         = len - 2; //remove header fields len
+            if (ie->length==sizeof(shortAddr_IE_ht)) {
+               shortAddrPresent = TRUE;
+               shortAddr        = (uint16_t)*((uint8_t*)(pkt->payload)+ptr) |
+                                  (uint16_t)*((uint8_t*)(pkt->payload)+ptr+1)<<8;
+            }
+            break;
+         
+         case IEEE802154E_MLME_CAPABILITIES_IE_SUBID:
+            // Capabilities IE: what the sender understands
             
-            if ((temp_16b & IEEE802154E_DESC_TYPE_LONG) == IEEE802154E_DESC_TYPE_LONG){
-               // long sub-IE
-               
-               sublen   = (temp_16b & IEEE802154E_DESC_LEN_LONG_MLME_IE_MASK)>>IEEE802154E_DESC_LEN_LONG_MLME_IE_SHIFT;
-               subid    = (temp_16b & IEEE802154E_DESC_SUBID_LONG_MLME_IE_MASK)>>IEEE802154E_DESC_SUBID_LONG_MLME_IE_SHIFT; 
-            } else {
-               // short sub-IE
-               
-               sublen   = (temp_16b & IEEE802154E_DESC_LEN_SHORT_MLME_IE_MASK)>>IEEE802154E_DESC_LEN_SHORT_MLME_IE_SHIFT;
-               subid    = (temp_16b & IEEE802154E_DESC_SUBID_SHORT_MLME_IE_MASK)>>IEEE802154E_DESC_SUBID_SHORT_MLME_IE_SHIFT; 
+            if (ie->length==sizeof(capabilities_IE_ht)) {
+               capabilities = *((uint8_t*)(pkt->payload)+ptr);
             }
+            break;
+         
+         case IEEE802154E_ACK_SHORT_ADDRESS_ELEMENTID:
+            // Short Address Assignment IE: the short address my parent assigns me
             
-            switch(subid){
-               
-               case IEEE802154E_MLME_SYNC_IE_SUBID:
-                  // Sync IE: ASN and Join Priority 
-                  
-                  if (idmanager_getIsDAGroot()==FALSE) {
-                     // ASN
-                     asnStoreFromAdv((uint8_t*)(pkt->payload)+ptr);
-                     ptr = ptr + 5;
-                     // join priority
-                     joinPriorityStoreFromAdv(*((uint8_t*)(pkt->payload)+ptr));
-                     ptr = ptr + 1;
-                  }
-                  break;
+            if (ie->length==sizeof(shortAddrAssignment_IE_ht)) {
+               neighbors_indicateShortAddressOffer(
+                  &(pkt->l2_nextORpreviousHop),
+                  (uint16_t)*((uint8_t*)(pkt->payload)+ptr)   | (uint16_t)*((uint8_t*)(pkt->payload)+ptr+1)<<8,
+                  (uint16_t)*((uint8_t*)(pkt->payload)+ptr+2) | (uint16_t)*((uint8_t*)(pkt->payload)+ptr+3)<<8,
+                  *((uint8_t*)(pkt->payload)+ptr+4)
+               );
+            }
+            break;
+         
+         case IEEE802154E_ACK_NACK_TIMECORRECTION_ELEMENTID:
+            // timecorrection IE
+            
+            if (
+                  idmanager_getIsDAGroot()==FALSE &&
+                  neighbors_isPreferredParent(&(pkt->l2_nextORpreviousHop))
+               ) {
                
-               case IEEE802154E_MLME_SLOTFRAME_LINK_IE_SUBID:
-                  processIE_retrieveSlotframeLinkIE(pkt,&ptr);
-                  break;
+               byte0 = *((uint8_t*)(pkt->payload)+ptr);
+               ptr++;
+               byte1 = *((uint8_t*)(pkt->payload)+ptr);
                
-               case IEEE802154E_MLME_TIMESLOT_IE_SUBID:
-                  //TODO
-                  break;
+               timeCorrection  = (int16_t)((uint16_t)byte1<<8 | (uint16_t)byte0);
+               timeCorrection  = (timeCorrection / (PORT_SIGNED_INT_WIDTH)US_PER_TICK);
+               timeCorrection  = -timeCorrection;
                
-               default:
-                  return FALSE;
-                  break;
+               synchronizeAck(timeCorrection);
             }
-            
-            len = len - sublen;
-         } while(len>0);
-         
-         break;
-      
-      case IEEE802154E_ACK_NACK_TIMECORRECTION_ELEMENTID:
-         // timecorrection IE
-         
-         if (
-               idmanager_getIsDAGroot()==FALSE &&
-               neighbors_isPreferredParent(&(pkt->l2_nextORpreviousHop))
-            ) {
-            
-            byte0 = *((uint8_t*)(pkt->payload)+ptr);
-            ptr++;
-            byte1 = *((uint8_t*)(pkt->payload)+ptr);
-            ptr++;
-
-            timeCorrection  = (int16_t)((uint16_t)byte1<<8 | (uint16_t)byte0);
-            timeCorrection  = (timeCorrection / (PORT_SIGNED_INT_WIDTH)US_PER_TICK);
-            timeCorrection  = -timeCorrection;
-            
-            synchronizeAck(timeCorrection);
-         }
-         break;
+            break;
          
-      default:
-         *lenIE = 0; //no header or not recognized.
-         return FALSE;
+         default:
+            return FALSE;
+      }
    }
    
-   if(*lenIE>127) {
-      // log the error
-      openserial_printError(
-         COMPONENT_IEEE802154E,
-         ERR_HEADER_TOO_LONG,
-         (errorparameter_t)*lenIE,
-         (errorparameter_t)1
-      );
+   // an EB without Short Address IE tells its sender has no short address,
+   // without Capabilities IE that it has none
+   if (pkt->l2_frameType==IEEE154_TYPE_BEACON) {
+      neighbors_indicateShortAddressAdvertised(&(pkt->l2_nextORpreviousHop),shortAddrPresent,shortAddr);
+      neighbors_indicateCapabilities(&(pkt->l2_nextORpreviousHop),capabilities);
    }
+   
    return TRUE;
 }
 
@@ -750,21 +805,37 @@ port_INLINE bool ieee154e_processIEs(OpenQueueEntry_t* pkt, uint16_t* lenIE) {
 port_INLINE void activity_ti1ORri1() {
    cellType_t  cellType;
    open_addr_t neighbor;
-   uint8_t     i;
    sync_IE_ht  sync_IE;
+   uint16_t    numSlotsElapsed;
+   
+   // the timer period which just expired may have spanned several slots
+   numSlotsElapsed               = ieee154e_vars.numOfSleepSlots;
+   ieee154e_vars.numOfSleepSlots = 1;
 
    // increment ASN (do this first so debug pins are in sync)
-   incrementAsnOffset();
+   incrementAsnOffsetBy(numSlotsElapsed);
    
    // wiggle debug pins
    debugpins_slot_toggle();
-   if (ieee154e_vars.slotOffset==0) {
+   if (ieee154e_vars.slotOffset<numSlotsElapsed) {
+      // slot offset 0 was part of the elapsed slots
       debugpins_frame_toggle();
    }
    
    // desynchronize if needed
    if (idmanager_getIsDAGroot()==FALSE) {
-      ieee154e_vars.deSyncTimeout--;
+      if (ieee154e_vars.deSyncTimeout>numSlotsElapsed) {
+         ieee154e_vars.deSyncTimeout -= numSlotsElapsed;
+      } else {
+         ieee154e_vars.deSyncTimeout  = 0;
+      }
+      if (ieee154e_vars.deSyncTimeout==0 && ieee154e_vars.isResync==FALSE) {
+         // keep following my schedule and try to catch up with my time
+         // source, so the schedule and neighbors remain usable
+         ieee154e_vars.isResync      = TRUE;
+         ieee154e_vars.deSyncTimeout = WARMRESYNCTIMEOUT;
+         ieee154e_dbg.num_warmResync++;
+      }
       if (ieee154e_vars.deSyncTimeout==0) {
          // declare myself desynchronized
          changeIsSync(FALSE);
@@ -802,25 +873,42 @@ port_INLINE void activity_ti1ORri1() {
       
       // find the next one
       ieee154e_vars.nextActiveSlotOffset    = schedule_getNextActiveSlotOffset();
+      
+      // sleep through the idle slots after this one
+      skipIdleSlots();
    } else {
       // this is NOT the next active slot, abort
-      // stop using serial
-      openserial_stop();
+      // sleep until the next active slot
+      skipIdleSlots();
       // abort the slot
       endSlot();
-      //start outputing serial
-      openserial_startOutput();
+      // use the idle slot to print status information
+      openserial_triggerDebugPrint();
       return;
    }
    
    // check the schedule to see what type of slot this is
    cellType = schedule_getType();
+   
+   // while resynchronizing, listen longer where my time source may transmit
+   ieee154e_vars.resyncGuard = getResyncGuard(cellType);
+   
    switch (cellType) {
       case CELLTYPE_ADV:
-         // stop using serial
-         openserial_stop();
-         // look for an ADV packet in the queue
-         ieee154e_vars.dataToSend = openqueue_macGetAdvPacket();
+         // look for an ADV packet in the queue, unless my timing is not to be
+         // trusted, in which case I listen for my time source's
+         if (ieee154e_vars.isResync==FALSE) {
+            ieee154e_vars.dataToSend = openqueue_macGetAdvPacket();
+         } else {
+            ieee154e_vars.dataToSend = NULL;
+         }
+#ifdef LEAF
+         if (ieee154e_vars.dataToSend==NULL && leafSkipsListening()) {
+            // a leaf does not listen for its neighbors' ADVs
+            endSlot();
+            break;
+         }
+#endif
          if (ieee154e_vars.dataToSend==NULL) {   // I will be listening for an ADV
             // change state
             changeState(S_RXDATAOFFSET);
@@ -846,12 +934,13 @@ port_INLINE void activity_ti1ORri1() {
          break;
       case CELLTYPE_TXRX:
       case CELLTYPE_TX:
-         // stop using serial
-         openserial_stop();
          // check whether we can send
          if (schedule_getOkToSend()) {
             schedule_getNeighbor(&neighbor);
-            ieee154e_vars.dataToSend = openqueue_macGetDataPacket(&neighbor);
+            ieee154e_vars.dataToSend = takePreparedData(&neighbor);
+            if (ieee154e_vars.dataToSend==NULL) {
+               ieee154e_vars.dataToSend = getDataPacket(&neighbor);
+            }
          } else {
             ieee154e_vars.dataToSend = NULL;
          }
@@ -872,39 +961,22 @@ port_INLINE void activity_ti1ORri1() {
              (cellType==CELLTYPE_TXRX && ieee154e_vars.dataToSend!=NULL)) {
             break;
          }
+#ifdef LEAF
+         if (leafSkipsListening()) {
+            // a leaf only transmits in shared cells
+            endSlot();
+            break;
+         }
+#endif
       case CELLTYPE_RX:
-         // stop using serial
-         openserial_stop();
+         // building the ACK takes too long for the turnaround, do it now
+         prepareAckTemplate();
          // change state
          changeState(S_RXDATAOFFSET);
          // arm rt1
          radiotimer_schedule(DURATION_rt1);
          break;
-      case CELLTYPE_SERIALRX:
-         // stop using serial
-         openserial_stop();
-         // abort the slot
-         endSlot();
-         //start inputting serial data
-         openserial_startInput();
-         //this is to emulate a set of serial input slots without having the slotted structure.
-
-         radio_setTimerPeriod(TsSlotDuration*(NUMSERIALRX));
-         
-         //increase ASN by NUMSERIALRX-1 slots as at this slot is already incremented by 1
-         for (i=0;i<NUMSERIALRX-1;i++){
-            incrementAsnOffset();
-         }
-         // deal with the case when schedule multi slots
-         adaptive_sync_countCompensationTimeout_compoundSlots(NUMSERIALRX-1);
-         
-         break;
-      case CELLTYPE_MORESERIALRX:
-         // do nothing (not even endSlot())
-         break;
       default:
-         // stop using serial
-         openserial_stop();
          // log the error
          openserial_printCritical(COMPONENT_IEEE802154E,ERR_WRONG_CELLTYPE,
                                (errorparameter_t)cellType,
@@ -925,12 +997,20 @@ port_INLINE void activity_ti2() {
    // configure the radio for that frequency
    radio_setFrequency(ieee154e_vars.freq);
    
-   // load the packet in the radio's Tx buffer
-   radio_loadPacket(ieee154e_vars.dataToSend->payload,
-                    ieee154e_vars.dataToSend->length);
+   // and for the power picked for that packet
+   radio_setTxPower(ieee154e_vars.dataToSend->l1_txPower);
+   energy_radioTxPower(ieee154e_vars.dataToSend->l1_txPower);
+   
+   // load the packet in the radio's Tx buffer, unless done at the end of the
+   // previous slot
+   if (ieee154e_vars.dataPreloaded==FALSE) {
+      radio_loadPacket(ieee154e_vars.dataToSend->payload,
+                       ieee154e_vars.dataToSend->length);
+   }
    
    // enable the radio in Tx mode. This does not send the packet.
    radio_txEnable();
+   energy_radioState(ENERGY_RADIO_IDLE);
    ieee154e_vars.radioOnInit=radio_getTimerValue();
    ieee154e_vars.radioOnThisSlot=TRUE;
    // arm tt2
@@ -959,6 +1039,7 @@ port_INLINE void activity_ti3() {
    
    // give the 'go' to transmit
    radio_txNow();
+   energy_radioState(ENERGY_RADIO_TX);
 }
 
 port_INLINE void activity_tie2() {
@@ -1007,6 +1088,7 @@ port_INLINE void activity_ti5(PORT_RADIOTIMER_WIDTH capturedTime) {
    
    // turn off the radio
     radio_rfOff();
+   energy_radioState(ENERGY_RADIO_OFF);
    ieee154e_vars.radioOnTics+=(radio_getTimerValue()-ieee154e_vars.radioOnInit);
    
    // record the captured time
@@ -1046,6 +1128,7 @@ port_INLINE void activity_ti6() {
    
    // enable the radio in Rx mode. The radio is not actively listening yet.
    radio_rxEnable();
+   energy_radioState(ENERGY_RADIO_IDLE);
    //caputre init of radio for duty cycle calculation
    ieee154e_vars.radioOnInit=radio_getTimerValue();
    ieee154e_vars.radioOnThisSlot=TRUE;
@@ -1072,6 +1155,7 @@ port_INLINE void activity_ti7() {
    
    // start listening
    radio_rxNow();
+   energy_radioState(ENERGY_RADIO_RX);
    
    // arm tt7
    radiotimer_schedule(DURATION_tt7);
@@ -1081,19 +1165,8 @@ port_INLINE void activity_tie5() {
    // indicate transmit failed to schedule to keep stats
    schedule_indicateTx(&ieee154e_vars.asn,FALSE);
    
-   // decrement transmits left counter
-   ieee154e_vars.dataToSend->l2_retriesLeft--;
-   
-   if (ieee154e_vars.dataToSend->l2_retriesLeft==0) {
-      // indicate tx fail if no more retries left
-      notif_sendDone(ieee154e_vars.dataToSend,E_FAIL);
-   } else {
-      // return packet to the virtual COMPONENT_SIXTOP_TO_IEEE802154E component
-      ieee154e_vars.dataToSend->owner = COMPONENT_SIXTOP_TO_IEEE802154E;
-   }
-   
-   // reset local variable
-   ieee154e_vars.dataToSend = NULL;
+   // retry later, or give up
+   retryOrDrop(FALSE);
    
    // abort
    endSlot();
@@ -1130,6 +1203,7 @@ port_INLINE void activity_ti9(PORT_RADIOTIMER_WIDTH capturedTime) {
    
    // turn off the radio
    radio_rfOff();
+   energy_radioState(ENERGY_RADIO_OFF);
    //compute tics radio on.
    ieee154e_vars.radioOnTics+=(radio_getTimerValue()-ieee154e_vars.radioOnInit);
    
@@ -1137,7 +1211,7 @@ port_INLINE void activity_ti9(PORT_RADIOTIMER_WIDTH capturedTime) {
    ieee154e_vars.lastCapturedTime = capturedTime;
    
    // get a buffer to put the (received) ACK in
-   ieee154e_vars.ackReceived = openqueue_getFreePacketBuffer(COMPONENT_IEEE802154E);
+   ieee154e_vars.ackReceived = openqueue_getFreePacketBufferOfClass(COMPONENT_IEEE802154E,TRAFFIC_CLASS_CONTROL);
    if (ieee154e_vars.ackReceived==NULL) {
       // log the error
       openserial_printError(COMPONENT_IEEE802154E,ERR_NO_FREE_PACKET_BUFFER,
@@ -1200,6 +1274,11 @@ port_INLINE void activity_ti9(PORT_RADIOTIMER_WIDTH capturedTime) {
          break;
       }
       
+      // an ACK without source address comes from the neighbor I just sent to
+      if (ieee802514_header.src.type==ADDR_NONE) {
+         memcpy(&(ieee802514_header.src),&(ieee154e_vars.dataToSend->l2_nextORpreviousHop),sizeof(open_addr_t));
+      }
+      
       // store header details in packet buffer
       ieee154e_vars.ackReceived->l2_frameType  = ieee802514_header.frameType;
       ieee154e_vars.ackReceived->l2_dsn        = ieee802514_header.dsn;
@@ -1260,6 +1339,7 @@ port_INLINE void activity_ri2() {
    
    // enable the radio in Rx mode. The radio does not actively listen yet.
    radio_rxEnable();
+   energy_radioState(ENERGY_RADIO_IDLE);
    ieee154e_vars.radioOnInit=radio_getTimerValue();
    ieee154e_vars.radioOnThisSlot=TRUE;
    
@@ -1286,6 +1366,7 @@ port_INLINE void activity_ri3() {
    
    // give the 'go' to receive
    radio_rxNow();
+   energy_radioState(ENERGY_RADIO_RX);
    
    // arm rt3 
    radiotimer_schedule(DURATION_rt3);
@@ -1299,7 +1380,7 @@ port_INLINE void activity_rie2() {
 port_INLINE void activity_ri4(PORT_RADIOTIMER_WIDTH capturedTime) {
 
    // change state
-   changeState(S_RXDATA);
+   changeState(S_RXDATAHEADER);
    
    // cancel rt3
    radiotimer_cancel();
@@ -1310,6 +1391,52 @@ port_INLINE void activity_ri4(PORT_RADIOTIMER_WIDTH capturedTime) {
    // record the captured time to sync
    ieee154e_vars.syncCapturedTime = capturedTime;
 
+   // arm rt4a
+   radiotimer_schedule(DURATION_rt4a);
+}
+
+/**
+\brief Decide whether to keep receiving, from the destination of the frame.
+
+Unicast frames for someone else are dropped by isValidRxFrame() once
+received. Stopping here instead keeps the radio off for the rest of the frame.
+This only works with radios which let me read the frame while receiving it,
+otherwise I keep listening until the end of the frame.
+*/
+port_INLINE void activity_ri4b() {
+   uint8_t     header[LENGTH_IEEE154_DEST];
+   uint8_t     len;
+   open_addr_t panid;
+   open_addr_t dest;
+   
+   // change state
+   changeState(S_RXDATA);
+   
+   len = radio_peekReceivedFrame(header,sizeof(header));
+   if (
+         len>0                                                                   &&
+         ieee802154_retrieveDestination(header,len,&panid,&dest)==TRUE           &&
+         (
+            (
+               panid.type!=ADDR_NONE                                             &&
+               packetfunctions_sameAddress(&panid,idmanager_getMyID(ADDR_PANID))==FALSE
+            )                                                                    ||
+            (
+               dest.type!=ADDR_NONE                                              &&
+               idmanager_isMyAddress(&dest)==FALSE                               &&
+               packetfunctions_isBroadcastMulticast(&dest)==FALSE
+            )
+         )
+      ) {
+      // not for me, no ACK to send either
+      ieee154e_dbg.num_rxHeaderAbort++;
+      
+      // abort
+      endSlot();
+      return;
+   }
+   
+   // arm rt4
    radiotimer_schedule(DURATION_rt4);
 }
 
@@ -1336,9 +1463,10 @@ port_INLINE void activity_ri5(PORT_RADIOTIMER_WIDTH capturedTime) {
 
    // turn off the radio
    radio_rfOff();
+   energy_radioState(ENERGY_RADIO_OFF);
    ieee154e_vars.radioOnTics+=radio_getTimerValue()-ieee154e_vars.radioOnInit;
    // get a buffer to put the (received) data in
-   ieee154e_vars.dataReceived = openqueue_getFreePacketBuffer(COMPONENT_IEEE802154E);
+   ieee154e_vars.dataReceived = openqueue_getFreePacketBufferOfClass(COMPONENT_IEEE802154E,TRAFFIC_CLASS_CONTROL);
    if (ieee154e_vars.dataReceived==NULL) {
       // log the error
       openserial_printError(COMPONENT_IEEE802154E,ERR_NO_FREE_PACKET_BUFFER,
@@ -1405,6 +1533,10 @@ port_INLINE void activity_ri5(PORT_RADIOTIMER_WIDTH capturedTime) {
       ieee154e_vars.dataReceived->l2_frameType      = ieee802514_header.frameType;
       ieee154e_vars.dataReceived->l2_dsn            = ieee802514_header.dsn;
       ieee154e_vars.dataReceived->l2_IEListPresent  = ieee802514_header.ieListPresent;
+      ieee154e_vars.dataReceived->l2_securityLevel  = ieee802514_header.securityLevel;
+      ieee154e_vars.dataReceived->l2_keyIndex       = ieee802514_header.keyIndex;
+      ieee154e_vars.dataReceived->l2_frameCounter   = ieee802514_header.frameCounter;
+      ieee154e_vars.dataReceived->l2_headerLength   = ieee802514_header.headerLength;
       memcpy(&(ieee154e_vars.dataReceived->l2_nextORpreviousHop),&(ieee802514_header.src),sizeof(open_addr_t));
       
       // toss the IEEE802.15.4 header
@@ -1437,6 +1569,10 @@ port_INLINE void activity_ri5(PORT_RADIOTIMER_WIDTH capturedTime) {
       if (ieee802514_header.ackRequested==1) {
          // arm rt5
          radiotimer_schedule(DURATION_rt5);
+         // a child still using its EUI64 is offered a short address in the ACK
+         if (ieee802514_header.srcShort==FALSE) {
+            neighbors_indicateRxLongAddress(&(ieee154e_vars.dataReceived->l2_nextORpreviousHop));
+         }
       } else {
          // synchronize to the received packet iif I'm not a DAGroot and this is my preferred parent
          if (idmanager_getIsDAGroot()==FALSE && neighbors_isPreferredParent(&(ieee154e_vars.dataReceived->l2_nextORpreviousHop))) {
@@ -1467,20 +1603,24 @@ port_INLINE void activity_ri5(PORT_RADIOTIMER_WIDTH capturedTime) {
 
 port_INLINE void activity_ri6() {
    PORT_SIGNED_INT_WIDTH timeCorrection;
-   header_IE_ht header_desc;
+   PORT_SIGNED_INT_WIDTH margin;
    
    // change state
    changeState(S_TXACKPREPARE);
    
    // get a buffer to put the ack to send in
-   ieee154e_vars.ackToSend = openqueue_getFreePacketBuffer(COMPONENT_IEEE802154E);
+   ieee154e_vars.ackToSend = openqueue_getFreePacketBufferOfClass(COMPONENT_IEEE802154E,TRAFFIC_CLASS_CONTROL);
    if (ieee154e_vars.ackToSend==NULL) {
       // log the error
       openserial_printError(COMPONENT_IEEE802154E,ERR_NO_FREE_PACKET_BUFFER,
                             (errorparameter_t)0,
                             (errorparameter_t)0);
       // indicate we received a packet anyway (we don't want to loose any)
-      notif_receive(ieee154e_vars.dataReceived);
+      if (isDuplicateFrame(ieee154e_vars.dataReceived)==TRUE) {
+         openqueue_freePacketBuffer(ieee154e_vars.dataReceived);
+      } else {
+         notif_receive(ieee154e_vars.dataReceived);
+      }
       // free local variable
       ieee154e_vars.dataReceived = NULL;
       // abort
@@ -1494,33 +1634,26 @@ port_INLINE void activity_ri6() {
    
    // calculate the time timeCorrection (this is the time when the packet arrive w.r.t the time it should be.
    timeCorrection = (PORT_SIGNED_INT_WIDTH)((PORT_SIGNED_INT_WIDTH)ieee154e_vars.syncCapturedTime-(PORT_SIGNED_INT_WIDTH)TsTxOffset);
-    
-   // add the payload to the ACK (i.e. the timeCorrection)
-   packetfunctions_reserveHeaderSize(ieee154e_vars.ackToSend,sizeof(timecorrection_IE_ht));
    timeCorrection  = -timeCorrection;
    timeCorrection *= US_PER_TICK;
-   ieee154e_vars.ackToSend->payload[0] = (uint8_t)((((uint16_t)timeCorrection)   ) & 0xff);
-   ieee154e_vars.ackToSend->payload[1] = (uint8_t)((((uint16_t)timeCorrection)>>8) & 0xff);
    
-   // add header IE header -- xv poipoi -- pkt is filled in reverse order..
-   packetfunctions_reserveHeaderSize(ieee154e_vars.ackToSend,sizeof(header_IE_ht));
-   //create the header for ack IE
-   header_desc.length_elementid_type=(sizeof(timecorrection_IE_ht)<< IEEE802154E_DESC_LEN_HEADER_IE_SHIFT)|
-                                     (IEEE802154E_ACK_NACK_TIMECORRECTION_ELEMENTID << IEEE802154E_DESC_ELEMENTID_HEADER_IE_SHIFT)|
-                                     IEEE802154E_DESC_TYPE_SHORT; 
-   memcpy(ieee154e_vars.ackToSend->payload,&header_desc,sizeof(header_IE_ht));
+   // the template was built at the start of the slot, unless a neighbor other
+   // than the expected one sent the frame in a shared cell
+   if (isAckTemplateFor(&(ieee154e_vars.dataReceived->l2_nextORpreviousHop))==FALSE) {
+      buildAckTemplate(&(ieee154e_vars.dataReceived->l2_nextORpreviousHop));
+      ieee154e_dbg.num_ackTemplateMiss++;
+   }
    
-   // prepend the IEEE802.15.4 header to the ACK
+   // copy the template, patching in the DSN (unless suppressed) and the timeCorrection
+   packetfunctions_reserveHeaderSize(ieee154e_vars.ackToSend,ieee154e_vars.ackTemplate.length);
+   memcpy(ieee154e_vars.ackToSend->payload,ieee154e_vars.ackTemplate.payload,ieee154e_vars.ackTemplate.length);
+   if (((ieee154e_vars.ackTemplate.payload[1]>>IEEE154_FCF_SEQNUM_SUPPRESSION) & 0x01)==IEEE154_SEQNUM_PRESENT) {
+      ieee154e_vars.ackToSend->payload[ACK_TEMPLATE_DSN_OFFSET]               = ieee154e_vars.dataReceived->l2_dsn;
+   }
+   ieee154e_vars.ackToSend->payload[ieee154e_vars.ackTemplate.length-2]       = (uint8_t)((((uint16_t)timeCorrection)   ) & 0xff);
+   ieee154e_vars.ackToSend->payload[ieee154e_vars.ackTemplate.length-1]       = (uint8_t)((((uint16_t)timeCorrection)>>8) & 0xff);
    ieee154e_vars.ackToSend->l2_frameType = IEEE154_TYPE_ACK;
    ieee154e_vars.ackToSend->l2_dsn       = ieee154e_vars.dataReceived->l2_dsn;
-   ieee802154_prependHeader(ieee154e_vars.ackToSend,
-                            ieee154e_vars.ackToSend->l2_frameType,
-                            IEEE154_IELIST_YES,//ie in ack
-                            IEEE154_FRAMEVERSION,//enhanced ack
-                            IEEE154_SEC_NO_SECURITY,
-                            ieee154e_vars.dataReceived->l2_dsn,
-                            &(ieee154e_vars.dataReceived->l2_nextORpreviousHop)
-                            );
    
    // space for 2-byte CRC
    packetfunctions_reserveFooterSize(ieee154e_vars.ackToSend,2);
@@ -1531,21 +1664,148 @@ port_INLINE void activity_ri6() {
    // configure the radio for that frequency
    radio_setFrequency(ieee154e_vars.freq);
    
+   // ACKs are always sent at the default power
+   radio_setTxPower(TX_POWER);
+   energy_radioTxPower(TX_POWER);
+   
    // load the packet in the radio's Tx buffer
    radio_loadPacket(ieee154e_vars.ackToSend->payload,
                     ieee154e_vars.ackToSend->length);
    
    // enable the radio in Tx mode. This does not send that packet.
    radio_txEnable();
+   energy_radioState(ENERGY_RADIO_IDLE);
    ieee154e_vars.radioOnInit=radio_getTimerValue();
    ieee154e_vars.radioOnThisSlot=TRUE;
    // arm rt6
    radiotimer_schedule(DURATION_rt6);
    
+   // record how much of the maxTxAckPrepare budget was left
+   margin = (PORT_SIGNED_INT_WIDTH)(DURATION_rt6-radio_getTimerValue());
+   if (margin<ieee154e_dbg.minTxAckMargin) {
+      ieee154e_dbg.minTxAckMargin = margin;
+   }
+   
    // change state
    changeState(S_TXACKREADY);
 }
 
+/**
+\brief Have the ACK template ready before listening in an RX cell.
+
+Building the template takes much longer than patching it, so it is done at the
+start of the slot, rather than within the maxTxAckPrepare budget. In a dedicated
+cell, the template is built for the neighbor of the cell. In a shared cell, any
+neighbor may send; the template is kept up to date for the neighbor it was last
+built for.
+*/
+void prepareAckTemplate() {
+   open_addr_t       neighbor;
+   
+   schedule_getNeighbor(&neighbor);
+   if (neighbor.type==ADDR_ANYCAST) {
+      if (ieee154e_vars.ackTemplate.length==0) {
+         return;
+      }
+      memcpy(&neighbor,&ieee154e_vars.ackTemplateNeighbor,sizeof(open_addr_t));
+   }
+   if (isAckTemplateFor(&neighbor)==TRUE) {
+      return;
+   }
+   
+   buildAckTemplate(&neighbor);
+}
+
+/**
+\brief Whether the ACK template is addressed to a neighbor, and up to date.
+
+The template only depends on the neighbor, its short address and its
+capabilities, identified by neighbors_getHeaderVersion().
+*/
+bool isAckTemplateFor(open_addr_t* neighbor) {
+   return ieee154e_vars.ackTemplate.length!=0                              &&
+          ieee154e_vars.ackTemplateVersion==neighbors_getHeaderVersion()   &&
+          packetfunctions_sameAddress(&ieee154e_vars.ackTemplateNeighbor,neighbor);
+}
+
+/**
+\brief Build the header and IEs of an ACK to a neighbor.
+
+The Short Address Assignment IE is only added while the neighbor has not used
+the short address I assigned it; the TimeCorrection IE is always last.
+
+They are built in ieee154e_vars.ackTemplate, a buffer of the MAC's own rather
+than one from openqueue, and copied into each ACK to that neighbor, as long as
+isAckTemplateFor() holds; the DSN and the timeCorrection are patched in at the
+offsets they take in every ACK.
+The header has no DSN if the neighbor understands the IEEE802.15.4-2015 field
+elision. The CRC is computed by the radio.
+
+\param[in] neighbor The neighbor the ACKs are sent to.
+*/
+void buildAckTemplate(open_addr_t* neighbor) {
+   OpenQueueEntry_t* pkt;
+   header_IE_ht      header_desc;
+   uint16_t          assigned;
+   uint8_t           depth;
+   open_addr_t*      myShortAddr;
+   
+   // start from an empty buffer, filled in from its end
+   pkt                              = &ieee154e_vars.ackTemplate;
+   pkt->creator                     = COMPONENT_IEEE802154E;
+   pkt->owner                       = COMPONENT_IEEE802154E;
+   pkt->payload                     = &(pkt->packet[127]);
+   pkt->length                      = 0;
+   
+   ieee154e_vars.ackTemplateVersion = neighbors_getHeaderVersion();
+   
+   // add the payload to the ACK (i.e. the timeCorrection, patched in later)
+   packetfunctions_reserveHeaderSize(pkt,sizeof(timecorrection_IE_ht));
+   pkt->payload[0] = 0;
+   pkt->payload[1] = 0;
+   
+   // add header IE header -- xv poipoi -- pkt is filled in reverse order..
+   packetfunctions_reserveHeaderSize(pkt,sizeof(header_IE_ht));
+   //create the header for ack IE
+   header_desc.length_elementid_type=(sizeof(timecorrection_IE_ht)<< IEEE802154E_DESC_LEN_HEADER_IE_SHIFT)|
+                                     (IEEE802154E_ACK_NACK_TIMECORRECTION_ELEMENTID << IEEE802154E_DESC_ELEMENTID_HEADER_IE_SHIFT)|
+                                     IEEE802154E_DESC_TYPE_SHORT; 
+   memcpy(pkt->payload,&header_desc,sizeof(header_IE_ht));
+   
+   // add the short address I assigned the neighbor, if it hasn't used it yet
+   myShortAddr = idmanager_getMyShortAddress();
+   if (
+         myShortAddr->type==ADDR_16B &&
+         neighbors_getShortAddressOffer(neighbor,&assigned,&depth)==TRUE
+      ) {
+      packetfunctions_reserveHeaderSize(pkt,sizeof(shortAddrAssignment_IE_ht));
+      pkt->payload[0] = (uint8_t)(assigned & 0xff);
+      pkt->payload[1] = (uint8_t)(assigned>>8);
+      pkt->payload[2] = myShortAddr->addr_16b[1];
+      pkt->payload[3] = myShortAddr->addr_16b[0];
+      pkt->payload[4] = depth;
+      
+      packetfunctions_reserveHeaderSize(pkt,sizeof(header_IE_ht));
+      header_desc.length_elementid_type=(sizeof(shortAddrAssignment_IE_ht)<< IEEE802154E_DESC_LEN_HEADER_IE_SHIFT)|
+                                        (IEEE802154E_ACK_SHORT_ADDRESS_ELEMENTID << IEEE802154E_DESC_ELEMENTID_HEADER_IE_SHIFT)|
+                                        IEEE802154E_DESC_TYPE_SHORT; 
+      memcpy(pkt->payload,&header_desc,sizeof(header_IE_ht));
+   }
+   
+   // prepend the IEEE802.15.4 header to the ACK (DSN patched in later)
+   ieee802154_prependHeader(pkt,
+                            IEEE154_TYPE_ACK,
+                            IEEE154_IELIST_YES,//ie in ack
+                            IEEE154_FRAMEVERSION,//enhanced ack
+                            IEEE154_SEC_NO_SECURITY,
+                            0,
+                            neighbor
+                            );
+   
+   // it is addressed to that neighbor
+   memcpy(&ieee154e_vars.ackTemplateNeighbor,neighbor,sizeof(open_addr_t));
+}
+
 port_INLINE void activity_rie4() {
    // log the error
    openserial_printError(COMPONENT_IEEE802154E,ERR_MAXTXACKPREPARE_OVERFLOWS,
@@ -1565,6 +1825,7 @@ port_INLINE void activity_ri7() {
    
    // give the 'go' to transmit
    radio_txNow(); 
+   energy_radioState(ENERGY_RADIO_TX);
 }
 
 port_INLINE void activity_rie5() {
@@ -1622,8 +1883,13 @@ port_INLINE void activity_ri9(PORT_RADIOTIMER_WIDTH capturedTime) {
       synchronizePacket(ieee154e_vars.syncCapturedTime);
    }
    
-   // inform upper layer of reception (after ACK sent)
-   notif_receive(ieee154e_vars.dataReceived);
+   // inform upper layer of reception (after ACK sent), unless the sender
+   // retransmitted a frame I already passed up because it missed my ACK
+   if (isDuplicateFrame(ieee154e_vars.dataReceived)==TRUE) {
+      openqueue_freePacketBuffer(ieee154e_vars.dataReceived);
+   } else {
+      notif_receive(ieee154e_vars.dataReceived);
+   }
    
    // clear local variable
    ieee154e_vars.dataReceived = NULL;
@@ -1640,7 +1906,7 @@ port_INLINE void activity_ri9(PORT_RADIOTIMER_WIDTH capturedTime) {
 A valid Rx frame satisfies the following constraints:
 - its IEEE802.15.4 header is well formatted
 - it's a DATA of BEACON frame (i.e. not ACK and not COMMAND)
-- it's sent on the same PANid as mine
+- it's sent on the same PANid as mine, or the PANid is elided
 - it's for me (unicast or broadcast)
 
 \param[in] ieee802514_header IEEE802.15.4 header of the packet I just received
@@ -1653,7 +1919,10 @@ port_INLINE bool isValidRxFrame(ieee802154_header_iht* ieee802514_header) {
              ieee802514_header->frameType==IEEE154_TYPE_DATA                   ||
              ieee802514_header->frameType==IEEE154_TYPE_BEACON
           )                                                                                        && \
-          packetfunctions_sameAddress(&ieee802514_header->panid,idmanager_getMyID(ADDR_PANID))     && \
+          (
+             ieee802514_header->panid.type==ADDR_NONE                          ||
+             packetfunctions_sameAddress(&ieee802514_header->panid,idmanager_getMyID(ADDR_PANID))
+          )                                                                                        && \
           (
              idmanager_isMyAddress(&ieee802514_header->dest)                   ||
              packetfunctions_isBroadcastMulticast(&ieee802514_header->dest)
@@ -1667,10 +1936,13 @@ A packet is a valid ACK if it satisfies the following conditions:
 - the IEEE802.15.4 header is valid
 - the frame type is 'ACK'
 - the sequence number in the ACK matches the sequence number of the packet sent
-- the ACK contains my PANid
-- the packet is unicast to me
+- the ACK contains my PANid, or the PANid is elided
+- the packet is unicast to me, or the destination is elided
 - the packet comes from the neighbor I sent the data to
 
+An ACK with elided addresses is sent right after the frame it acknowledges, its
+source has been set to the neighbor I sent the data to.
+
 \param[in] ieee802514_header IEEE802.15.4 header of the packet I just received
 \param[in] packetSent points to the packet I just sent
 
@@ -1688,34 +1960,138 @@ port_INLINE bool isValidAck(ieee802154_header_iht* ieee802514_header, OpenQueueE
    // poipoi don't check for seq num
    return ieee802514_header->valid==TRUE                                                           && \
           ieee802514_header->frameType==IEEE154_TYPE_ACK                                           && \
-          packetfunctions_sameAddress(&ieee802514_header->panid,idmanager_getMyID(ADDR_PANID))     && \
-          idmanager_isMyAddress(&ieee802514_header->dest)                                          && \
+          (
+             ieee802514_header->panid.type==ADDR_NONE                          ||
+             packetfunctions_sameAddress(&ieee802514_header->panid,idmanager_getMyID(ADDR_PANID))
+          )                                                                                        && \
+          (
+             ieee802514_header->dest.type==ADDR_NONE                           ||
+             idmanager_isMyAddress(&ieee802514_header->dest)
+          )                                                                                        && \
           packetfunctions_sameAddress(&ieee802514_header->src,&packetSent->l2_nextORpreviousHop);
 }
 
+/**
+\brief Decides whether a frame I ACKed is a retransmission of the previous
+   frame from the same neighbor, and remembers its DSN otherwise.
+
+The sender keeps the DSN when retransmitting, and increments it for every new
+frame. Only called for frames which requested an ACK, as those are the only
+ones retransmitted.
+
+\param[in] pkt The frame received.
+
+\returns TRUE if the frame is a duplicate, FALSE otherwise.
+*/
+port_INLINE bool isDuplicateFrame(OpenQueueEntry_t* pkt) {
+   uint8_t i;
+   
+   for (i=0;i<DUPLICATE_CACHE_SIZE;i++) {
+      if (
+            ieee154e_vars.duplicateCache[i].neighbor.type!=ADDR_NONE &&
+            packetfunctions_sameAddress(&ieee154e_vars.duplicateCache[i].neighbor,&pkt->l2_nextORpreviousHop)
+         ) {
+         if (ieee154e_vars.duplicateCache[i].dsn==pkt->l2_dsn) {
+            ieee154e_dbg.num_duplicate++;
+            return TRUE;
+         }
+         ieee154e_vars.duplicateCache[i].dsn = pkt->l2_dsn;
+         return FALSE;
+      }
+   }
+   
+   // first frame from this neighbor in a while, take over the oldest entry
+   i = ieee154e_vars.duplicateCacheNext;
+   memcpy(&ieee154e_vars.duplicateCache[i].neighbor,&pkt->l2_nextORpreviousHop,sizeof(open_addr_t));
+   ieee154e_vars.duplicateCache[i].dsn = pkt->l2_dsn;
+   ieee154e_vars.duplicateCacheNext    = (i+1)%DUPLICATE_CACHE_SIZE;
+   return FALSE;
+}
+
 //======= ASN handling
 
 port_INLINE void incrementAsnOffset() {
+   incrementAsnOffsetBy(1);
+}
+
+port_INLINE void incrementAsnOffsetBy(uint16_t numSlots) {
+   uint16_t bytes0and1;
+   
    // increment the asn
-   ieee154e_vars.asn.bytes0and1++;
-   if (ieee154e_vars.asn.bytes0and1==0) {
+   bytes0and1                     = ieee154e_vars.asn.bytes0and1;
+   ieee154e_vars.asn.bytes0and1  += numSlots;
+   if (ieee154e_vars.asn.bytes0and1<bytes0and1) {
       ieee154e_vars.asn.bytes2and3++;
       if (ieee154e_vars.asn.bytes2and3==0) {
          ieee154e_vars.asn.byte4++;
       }
    }
    // increment the offsets
-   ieee154e_vars.slotOffset  = (ieee154e_vars.slotOffset+1)%schedule_getFrameLength();
-   ieee154e_vars.asnOffset   = (ieee154e_vars.asnOffset+1)%16;
+   ieee154e_vars.slotOffset  = (ieee154e_vars.slotOffset+numSlots)%schedule_getFrameLength();
+   ieee154e_vars.asnOffset   = (ieee154e_vars.asnOffset+numSlots)%16;
 }
 
 //from upper layer that want to send the ASN to compute timing or latency
 port_INLINE void ieee154e_getAsn(uint8_t* array) {
-   array[0]         = (ieee154e_vars.asn.bytes0and1     & 0xff);
-   array[1]         = (ieee154e_vars.asn.bytes0and1/256 & 0xff);
-   array[2]         = (ieee154e_vars.asn.bytes2and3     & 0xff);
-   array[3]         = (ieee154e_vars.asn.bytes2and3/256 & 0xff);
-   array[4]         =  ieee154e_vars.asn.byte4;
+   asn_t asn;
+   
+   readCurrentAsn(&asn);
+   array[0]         = (asn.bytes0and1     & 0xff);
+   array[1]         = (asn.bytes0and1/256 & 0xff);
+   array[2]         = (asn.bytes2and3     & 0xff);
+   array[3]         = (asn.bytes2and3/256 & 0xff);
+   array[4]         =  asn.byte4;
+}
+
+/**
+\brief The ASN of the slot the mote is in right now.
+
+The ASN is only incremented when the mote wakes up, by the number of slots the
+timer period which just ended spanned (numOfSleepSlots). While sleeping through
+idle slots, it lags behind: the slots elapsed in the current period, the timer
+value divided by the slot duration, are added here.
+
+When synchronizePacket() lengthened the period by a skipped slot, it already
+added that slot to the ASN; the period is then one slot longer than
+numOfSleepSlots, and its first slot is one before the ASN.
+*/
+void readCurrentAsn(asn_t* asn) {
+   PORT_RADIOTIMER_WIDTH currentValue;
+   PORT_RADIOTIMER_WIDTH currentPeriod;
+   int16_t               numSleepSlots;
+   int16_t               numSlotsPeriod;
+   int16_t               numSlots;
+   uint16_t              bytes0and1;
+   INTERRUPT_DECLARATION();
+   
+   DISABLE_INTERRUPTS();
+   memcpy(asn,&ieee154e_vars.asn,sizeof(asn_t));
+   currentValue   = radio_getTimerValue();
+   currentPeriod  = radio_getTimerPeriod();
+   numSleepSlots  = ieee154e_vars.numOfSleepSlots;
+   ENABLE_INTERRUPTS();
+   
+   // the period is off a whole number of slots by the time correction only
+   numSlotsPeriod = (currentPeriod+TsSlotDuration/2)/TsSlotDuration;
+   numSlots       = currentValue/TsSlotDuration;
+   numSlots      -= numSlotsPeriod-numSleepSlots;
+   if (numSlots>numSleepSlots-1) {
+      numSlots    = numSleepSlots-1;
+   }
+   
+   bytes0and1       = asn->bytes0and1;
+   asn->bytes0and1 += numSlots;
+   if (numSlots>0 && asn->bytes0and1<bytes0and1) {
+      asn->bytes2and3++;
+      if (asn->bytes2and3==0) {
+         asn->byte4++;
+      }
+   } else if (numSlots<0 && asn->bytes0and1>bytes0and1) {
+      if (asn->bytes2and3==0) {
+         asn->byte4--;
+      }
+      asn->bytes2and3--;
+   }
 }
 
 port_INLINE void joinPriorityStoreFromAdv(uint8_t jp){
@@ -1756,6 +2132,7 @@ void synchronizePacket(PORT_RADIOTIMER_WIDTH timeReceived) {
    PORT_RADIOTIMER_WIDTH newPeriod;
    PORT_RADIOTIMER_WIDTH currentValue;
    PORT_RADIOTIMER_WIDTH currentPeriod;
+   uint8_t               numSlotsSkipped;
    
    // record the current timer value and period
    currentValue                   =  radio_getTimerValue();
@@ -1764,25 +2141,30 @@ void synchronizePacket(PORT_RADIOTIMER_WIDTH timeReceived) {
    // calculate new period
    timeCorrection                 =  (PORT_SIGNED_INT_WIDTH)((PORT_SIGNED_INT_WIDTH)timeReceived-(PORT_SIGNED_INT_WIDTH)TsTxOffset);
 
-   newPeriod                      =  TsSlotDuration;
+   newPeriod                      =  TsSlotDuration*ieee154e_vars.numOfSleepSlots;
    
    // detect whether I'm too close to the edge of the slot, in that case,
    // skip a slot and increase the temporary slot length to be 2 slots long
+   numSlotsSkipped                =  0;
    if (currentValue<timeReceived || currentPeriod-currentValue<RESYNCHRONIZATIONGUARD) {
       newPeriod                  +=  TsSlotDuration;
       incrementAsnOffset();
+      numSlotsSkipped             =  1;
    }
    newPeriod                      =  (PORT_RADIOTIMER_WIDTH)((PORT_SIGNED_INT_WIDTH)newPeriod+timeCorrection);
    
    // resynchronize by applying the new period
    radio_setTimerPeriod(newPeriod);
    
-   // reset the de-synchronization timeout
-   ieee154e_vars.deSyncTimeout    = DESYNCTIMEOUT;
+   // reset the de-synchronization timeout, the skipped slot elapses after the
+   // synchronization but is not counted when the period ends
+   ieee154e_vars.deSyncTimeout    = DESYNCTIMEOUT-numSlotsSkipped;
+   memcpy(&ieee154e_vars.asnLastSync,&ieee154e_vars.asn,sizeof(asn_t));
    
-   // log a large timeCorrection
+   // log a large timeCorrection, expected when resynchronizing
    if (
-         ieee154e_vars.isSync==TRUE &&
+         ieee154e_vars.isSync==TRUE   &&
+         ieee154e_vars.isResync==FALSE &&
          (
             timeCorrection<-LIMITLARGETIMECORRECTION ||
             timeCorrection> LIMITLARGETIMECORRECTION
@@ -1792,6 +2174,7 @@ void synchronizePacket(PORT_RADIOTIMER_WIDTH timeReceived) {
                             (errorparameter_t)timeCorrection,
                             (errorparameter_t)0);
    }
+   ieee154e_vars.isResync         = FALSE;
    
    // update the stats
    ieee154e_stats.numSyncPkt++;
@@ -1817,9 +2200,11 @@ void synchronizeAck(PORT_SIGNED_INT_WIDTH timeCorrection) {
    radio_setTimerPeriod(newPeriod);
    // reset the de-synchronization timeout
    ieee154e_vars.deSyncTimeout    = DESYNCTIMEOUT;
-   // log a large timeCorrection
+   memcpy(&ieee154e_vars.asnLastSync,&ieee154e_vars.asn,sizeof(asn_t));
+   // log a large timeCorrection, expected when resynchronizing
    if (
-         ieee154e_vars.isSync==TRUE &&
+         ieee154e_vars.isSync==TRUE   &&
+         ieee154e_vars.isResync==FALSE &&
          (
             timeCorrection<-LIMITLARGETIMECORRECTION ||
             timeCorrection> LIMITLARGETIMECORRECTION
@@ -1829,6 +2214,7 @@ void synchronizeAck(PORT_SIGNED_INT_WIDTH timeCorrection) {
                             (errorparameter_t)timeCorrection,
                             (errorparameter_t)1);
    }
+   ieee154e_vars.isResync         = FALSE;
    // update the stats
    ieee154e_stats.numSyncAck++;
    updateStats(timeCorrection);
@@ -1843,7 +2229,8 @@ void synchronizeAck(PORT_SIGNED_INT_WIDTH timeCorrection) {
 }
 
 void changeIsSync(bool newIsSync) {
-   ieee154e_vars.isSync = newIsSync;
+   ieee154e_vars.isSync   = newIsSync;
+   ieee154e_vars.isResync = FALSE;
    
    if (ieee154e_vars.isSync==TRUE) {
       leds_sync_on();
@@ -1859,6 +2246,13 @@ void changeIsSync(bool newIsSync) {
 void notif_sendDone(OpenQueueEntry_t* packetSent, owerror_t error) {
    // record the outcome of the trasmission attempt
    packetSent->l2_sendDoneError   = error;
+   // a leaf listens for the response, if one is expected, as long as the
+   // sender waits for it
+   if (error==E_SUCCESS && packetSent->l2_responseTimeout>0) {
+      ieee154e_vars.leafListening   = TRUE;
+      ieee154e_vars.leafListenUntil = ieee154e_vars.asn.bytes0and1+
+         (uint16_t)(((uint32_t)packetSent->l2_responseTimeout*32768/1000)/TsSlotDuration)+1;
+   }
    // record the current ASN
    memcpy(&packetSent->l2_asn,&ieee154e_vars.asn,sizeof(asn_t));
    // associate this packet with the virtual component
@@ -1970,6 +2364,7 @@ void changeState(ieee154e_state_t newstate) {
       case S_RXDATAPREPARE:
       case S_RXDATAREADY:
       case S_RXDATALISTEN:
+      case S_RXDATAHEADER:
       case S_RXDATA:
       case S_TXACKOFFSET:
       case S_TXACKPREPARE:
@@ -1982,6 +2377,300 @@ void changeState(ieee154e_state_t newstate) {
    }
 }
 
+/**
+\brief Have the slot timer fire next at the next active slot.
+
+Rather than waking up at every slot only to find out it is not active, the
+current timer period is stretched over the idle slots which follow. It is
+bounded so it fits the radio timer, and so the desynchronization timeout is
+still checked on time.
+*/
+port_INLINE void skipIdleSlots() {
+   uint16_t numSlots;
+   
+   if (ieee154e_vars.nextActiveSlotOffset>ieee154e_vars.slotOffset) {
+      numSlots = ieee154e_vars.nextActiveSlotOffset-ieee154e_vars.slotOffset;
+   } else {
+      numSlots = schedule_getFrameLength()-ieee154e_vars.slotOffset+ieee154e_vars.nextActiveSlotOffset;
+   }
+   if (numSlots>MAXSLEEPSLOTS) {
+      numSlots = MAXSLEEPSLOTS;
+   }
+   if (idmanager_getIsDAGroot()==FALSE && numSlots>ieee154e_vars.deSyncTimeout) {
+      numSlots = ieee154e_vars.deSyncTimeout;
+   }
+   if (numSlots<=1) {
+      // the next slot is active
+      return;
+   }
+   
+   ieee154e_vars.numOfSleepSlots = numSlots;
+   radio_setTimerPeriod(radio_getTimerPeriod()+TsSlotDuration*(numSlots-1));
+   
+   // the skipped slots count towards clock drift compensation
+   adaptive_sync_countCompensationTimeout_compoundSlots(numSlots-1);
+}
+
+/**
+\brief Extra RX guard time for the current cell while resynchronizing.
+
+After deSyncTimeout expires, I keep following my schedule but my clock may
+have drifted further from my time source's than TsLongGT covers. In the cells
+my time source may transmit in (ADV, shared, or dedicated to it), the listening
+window widens by WARMRESYNC_GUARDSTEP every WARMRESYNC_WIDENPERIOD slots, up
+to WARMRESYNC_MAXGUARD on each side. Any frame or ACK from my time source then
+resynchronizes me.
+
+\param[in] cellType The type of the current cell.
+
+\returns The number of ticks to start listening earlier and stop later.
+*/
+port_INLINE PORT_RADIOTIMER_WIDTH getResyncGuard(cellType_t cellType) {
+   open_addr_t           neighbor;
+   PORT_RADIOTIMER_WIDTH guard;
+   
+   if (ieee154e_vars.isResync==FALSE) {
+      return 0;
+   }
+   
+   schedule_getNeighbor(&neighbor);
+   if (
+         cellType!=CELLTYPE_ADV                         &&
+         neighbor.type!=ADDR_ANYCAST                    &&
+         neighbors_isPreferredParent(&neighbor)==FALSE
+      ) {
+      // my children follow my clock, drifted or not
+      return 0;
+   }
+   
+   guard  = 1+(WARMRESYNCTIMEOUT-ieee154e_vars.deSyncTimeout)/WARMRESYNC_WIDENPERIOD;
+   guard *= WARMRESYNC_GUARDSTEP;
+   if (guard>WARMRESYNC_MAXGUARD) {
+      guard = WARMRESYNC_MAXGUARD;
+   }
+   return guard;
+}
+
+/**
+\brief Get the next packet to send to a neighbor from the queue.
+
+Packets past their deadline are not worth the cell: they are reported as
+failed to the upper layers without being sent.
+
+\param[in] neighbor The neighbor of the cell.
+
+\returns The packet to send, or NULL if none is waiting.
+*/
+port_INLINE OpenQueueEntry_t* getDataPacket(open_addr_t* neighbor) {
+   OpenQueueEntry_t* pkt;
+   
+   pkt = openqueue_macGetDataPacket(neighbor);
+   while (pkt!=NULL && openqueue_isExpired(pkt)) {
+      pkt->owner = COMPONENT_IEEE802154E;
+      ieee154e_dbg.num_expired++;
+      notif_sendDone(pkt,E_FAIL);
+      pkt = openqueue_macGetDataPacket(neighbor);
+   }
+   return pkt;
+}
+
+/**
+\brief Prepare the frame for the next active cell while the radio is idle.
+
+If the next active cell is a dedicated cell I can transmit in and a packet is
+waiting for its neighbor, that packet is claimed and loaded in the radio now,
+rather than in the TX prepare window of its slot, which is then shortened to
+maxTxDataPreparePreloaded. Nothing uses the radio in between: the slot timer
+next fires at that cell, so no RX cell comes before it.
+
+Only called on boards which define BOARD_RADIO_KEEPS_TXBUFFER, i.e. whose
+radio keeps the TX buffer through radio_rfOff() and sleep, and does not share
+it with reception (the AT86RF231/233 receive into the same frame buffer).
+*/
+port_INLINE void prepareNextData() {
+   open_addr_t       neighbor;
+   OpenQueueEntry_t* pkt;
+   
+   if (ieee154e_vars.isSync==FALSE || ieee154e_vars.dataPrepared!=NULL) {
+      return;
+   }
+   if (schedule_getNextTxNeighbor(&neighbor)==FALSE) {
+      return;
+   }
+   pkt = getDataPacket(&neighbor);
+   if (pkt==NULL) {
+      return;
+   }
+   
+   // claim it, so no-one else hands it to the MAC or withdraws it
+   pkt->owner                    = COMPONENT_IEEE802154E;
+   ieee154e_vars.dataPrepared    = pkt;
+   ieee154e_vars.dataPreparedAsn = ieee154e_vars.asn.bytes0and1+ieee154e_vars.numOfSleepSlots;
+   
+   radio_loadPacket(pkt->payload,pkt->length);
+}
+
+/**
+\brief Use the frame prepared at the end of the previous slot, if still valid.
+
+It is only valid if it was prepared for this ASN, to the neighbor of this
+cell (the schedule may have changed since), and was not freed meanwhile. It
+is given back to the queue if a packet of a more urgent class was queued since,
+or if it expired.
+
+\param[in] neighbor The neighbor of the current cell.
+
+\returns The packet to send, or NULL if none was prepared for this cell.
+*/
+port_INLINE OpenQueueEntry_t* takePreparedData(open_addr_t* neighbor) {
+   OpenQueueEntry_t* pkt;
+   OpenQueueEntry_t* urgentPkt;
+   
+   pkt = ieee154e_vars.dataPrepared;
+   if (
+         pkt!=NULL                                                          &&
+         pkt->owner==COMPONENT_IEEE802154E                                  &&
+         pkt->creator!=COMPONENT_IEEE802154E                                &&
+         ieee154e_vars.asn.bytes0and1==ieee154e_vars.dataPreparedAsn        &&
+         packetfunctions_sameAddress(neighbor,&pkt->l2_nextORpreviousHop)
+      ) {
+      // a more urgent packet queued since then is sent instead
+      urgentPkt = openqueue_macGetDataPacket(neighbor);
+      if (
+            (urgentPkt!=NULL && urgentPkt->trafficClass<pkt->trafficClass) ||
+            openqueue_isExpired(pkt)
+         ) {
+         releasePreparedData();
+         return NULL;
+      }
+      ieee154e_vars.dataPrepared  = NULL;
+      ieee154e_vars.dataPreloaded = TRUE;
+      return pkt;
+   }
+   
+   // left for endSlot() to release
+   return NULL;
+}
+
+#ifdef LEAF
+/**
+\brief Whether a leaf skips listening in the current shared or ADV cell.
+
+A leaf listens as any other mote until it has joined the DODAG through a
+parent, and while catching up with its time source. It then only listens in
+the wake windows at the start of each LEAF_WAKEPERIOD, which all leaves share
+as they are aligned on the ASN, and after sending a frame expecting a response,
+for the l2_responseTimeout of that frame. The DAG root never skips.
+
+\returns TRUE if the radio stays off during this cell.
+*/
+port_INLINE bool leafSkipsListening() {
+   if (
+         ieee154e_vars.isResync==TRUE                ||
+         idmanager_getIsDAGroot()==TRUE              ||
+         neighbors_getMyDAGrank()==DEFAULTDAGRANK
+      ) {
+      return FALSE;
+   }
+   if ((ieee154e_vars.asn.bytes0and1 & (LEAF_WAKEPERIOD-1))<LEAF_WAKEWINDOW) {
+      return FALSE;
+   }
+   if (ieee154e_vars.leafListening==TRUE) {
+      if ((int16_t)(ieee154e_vars.leafListenUntil-ieee154e_vars.asn.bytes0and1)>=0) {
+         return FALSE;
+      }
+      ieee154e_vars.leafListening = FALSE;
+   }
+   return TRUE;
+}
+#endif
+
+/**
+\brief Give a prepared frame which was not used back to the queue.
+*/
+port_INLINE void releasePreparedData() {
+   OpenQueueEntry_t* pkt;
+   
+   pkt = ieee154e_vars.dataPrepared;
+   if (pkt==NULL) {
+      return;
+   }
+   // unless it was freed while prepared
+   if (pkt->owner==COMPONENT_IEEE802154E && pkt->creator!=COMPONENT_IEEE802154E) {
+      pkt->owner = COMPONENT_SIXTOP_TO_IEEE802154E;
+   }
+   ieee154e_vars.dataPrepared = NULL;
+}
+
+/**
+\brief Raise the power a packet is retransmitted at, after a failed attempt.
+
+The link may have degraded since sixtop picked the power. neighbors keeps what
+it learns from the outcome once the packet is done.
+*/
+port_INLINE void raiseTxPower(OpenQueueEntry_t* pkt) {
+   if (pkt->l1_txPower<=TX_POWER-NEIGHBOR_TXPOWER_STEPUP) {
+      pkt->l1_txPower += NEIGHBOR_TXPOWER_STEPUP;
+   } else {
+      pkt->l1_txPower  = TX_POWER;
+   }
+}
+
+/**
+\brief Handle a failed transmission attempt of dataToSend.
+
+The packet is retried in a later cell until it used its budget of attempts,
+set by sixtop for a dedicated cell. In a shared cell, the smaller budget of
+shared cells applies.
+
+\param[in] aborted TRUE if the slot was aborted before an ACK could be
+   expected, FALSE if no valid ACK was received in time.
+*/
+void retryOrDrop(bool aborted) {
+   OpenQueueEntry_t* pkt;
+   bool              sharedLimit;
+   
+   pkt = ieee154e_vars.dataToSend;
+   
+   // decrement transmits left counter
+   pkt->l2_retriesLeft--;
+   
+   sharedLimit = FALSE;
+   if (
+         pkt->l2_retriesLeft>0                                     &&
+         schedule_getShared()==TRUE                                &&
+         pkt->l2_numTxAttempts>=neighbors_getRetryBudget(
+            &(pkt->l2_nextORpreviousHop),
+            pkt->trafficClass,
+            TRUE
+         )
+      ) {
+      pkt->l2_retriesLeft = 0;
+      sharedLimit         = TRUE;
+   }
+   
+   if (pkt->l2_retriesLeft==0) {
+      // keep track of why packets are dropped
+      if (sharedLimit==TRUE) {
+         ieee154e_dbg.num_retriesShared++;
+      } else if (aborted==TRUE) {
+         ieee154e_dbg.num_retriesAborted++;
+      } else {
+         ieee154e_dbg.num_retriesNoAck++;
+      }
+      // indicate tx fail if no more retries left
+      notif_sendDone(pkt,E_FAIL);
+   } else {
+      // retry louder
+      raiseTxPower(pkt);
+      // return packet to the virtual COMPONENT_SIXTOP_TO_IEEE802154E component
+      pkt->owner = COMPONENT_SIXTOP_TO_IEEE802154E;
+   }
+   
+   // reset local variable
+   ieee154e_vars.dataToSend = NULL;
+}
+
 /**
 \brief Housekeeping tasks to do at the end of each slot.
 
@@ -1998,6 +2687,7 @@ void endSlot() {
   
    // turn off the radio
    radio_rfOff();
+   energy_radioState(ENERGY_RADIO_OFF);
    // compute the duty cycle if radio has been turned on
    if (ieee154e_vars.radioOnThisSlot==TRUE){  
       ieee154e_vars.radioOnTics+=(radio_getTimerValue()-ieee154e_vars.radioOnInit);
@@ -2030,19 +2720,8 @@ void endSlot() {
       // indicate Tx fail to schedule to update stats
       schedule_indicateTx(&ieee154e_vars.asn,FALSE);
       
-      //decrement transmits left counter
-      ieee154e_vars.dataToSend->l2_retriesLeft--;
-      
-      if (ieee154e_vars.dataToSend->l2_retriesLeft==0) {
-         // indicate tx fail if no more retries left
-         notif_sendDone(ieee154e_vars.dataToSend,E_FAIL);
-      } else {
-         // return packet to the virtual COMPONENT_SIXTOP_TO_IEEE802154E component
-         ieee154e_vars.dataToSend->owner = COMPONENT_SIXTOP_TO_IEEE802154E;
-      }
-      
-      // reset local variable
-      ieee154e_vars.dataToSend = NULL;
+      // retry later, or give up
+      retryOrDrop(TRUE);
    }
    
    // clean up dataReceived
@@ -2050,7 +2729,11 @@ void endSlot() {
       // assume something went wrong. If everything went well, dataReceived
       // would have been set to NULL in ri9.
       // indicate  "received packet" to upper layer since we don't want to loose packets
-      notif_receive(ieee154e_vars.dataReceived);
+      if (isDuplicateFrame(ieee154e_vars.dataReceived)==TRUE) {
+         openqueue_freePacketBuffer(ieee154e_vars.dataReceived);
+      } else {
+         notif_receive(ieee154e_vars.dataReceived);
+      }
       // reset local variable
       ieee154e_vars.dataReceived = NULL;
    }
@@ -2074,6 +2757,20 @@ void endSlot() {
    
    // change state
    changeState(S_SLEEP);
+   
+   // give back a prepared frame this slot did not use, then prepare the one
+   // for the next active cell
+   ieee154e_vars.dataPreloaded = FALSE;
+   releasePreparedData();
+#ifdef BOARD_RADIO_KEEPS_TXBUFFER
+   prepareNextData();
+#endif
+   
+   // the slots I sleep through until the next wakeup are idle, use them to
+   // print status information
+   if (ieee154e_vars.numOfSleepSlots>1) {
+      openserial_triggerDebugPrintSlots(ieee154e_vars.numOfSleepSlots-1);
+   }
 }
 
 bool ieee154e_isSynch(){
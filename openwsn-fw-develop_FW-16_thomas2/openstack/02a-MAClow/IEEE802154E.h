@@ -18,15 +18,23 @@
 //=========================== define ==========================================
 
 #define SYNCHRONIZING_CHANNEL       20 // channel the mote listens on to synchronize
-#define TXRETRIES                    3 // number of MAC retries before declaring failed
-#define TX_POWER                    31 // 1=-25dBm, 31=0dBm (max value)
+#define TXRETRIES                    3 // number of MAC retries before declaring failed, while the ETX of the neighbor is unknown
+#define TX_POWER                     0 // in dBm. Default and max value, for broadcast frames and ACKs
 #define RESYNCHRONIZATIONGUARD       5 // in 32kHz ticks. min distance to the end of the slot to successfully synchronize
+#define MAXSLEEPSLOTS             ((0xffff/PORT_TsSlotDuration)-2) // in slots: longest timer period, fits a 16-bit radio timer with one slot to spare for resynchronization
 #define US_PER_TICK                 30 // number of us per 32kHz clock tick
 #define ADVTIMEOUT                  30 // in seconds: sending ADV every 30 seconds
 #define MAXKAPERIOD               2000 // in slots: @15ms per slot -> ~30 seconds. Max value used by adaptive synchronization.
 #define DESYNCTIMEOUT             2333 // in slots: @15ms per slot -> ~35 seconds. A larger DESYNCTIMEOUT is needed if using a larger KATIMEOUT.
+#define WARMRESYNCTIMEOUT         1333 // in slots: @15ms per slot -> ~20 seconds. How long to try catching up with the time source before listening for EBs.
+#define WARMRESYNC_WIDENPERIOD     200 // in slots: @15ms per slot -> ~3 seconds. How often the RX guard time widens while resynchronizing.
+#define WARMRESYNC_GUARDSTEP         8 // in 32kHz ticks: how much the RX guard time widens each time
+#define WARMRESYNC_MAXGUARD         40 // in 32kHz ticks: widest extra RX guard time, listening still starts after maxRxDataPrepare
+#define LEAF_WAKEPERIOD           4096 // in slots: @15ms per slot -> ~60 seconds, a power of 2. A leaf listens in shared cells at the start of each period.
+#define LEAF_WAKEWINDOW            128 // in slots: @15ms per slot -> ~2 seconds. How long a leaf listens at the start of each wake period.
 #define LIMITLARGETIMECORRECTION     5 // threshold number of ticks to declare a timeCorrection "large"
 #define LENGTH_IEEE154_MAX         128 // max length of a valid radio packet  
+#define LENGTH_IEEE154_DEST         13 // bytes up to the end of the destination address: fcf, dsn, panid and 64-bit address
 #define DUTY_CYCLE_WINDOW_LIMIT    (0xFFFFFFFF>>1) // limit of the dutycycle window
 
 //15.4e information elements related
@@ -71,9 +79,14 @@
 #define IEEE802154E_MLME_SLOTFRAME_LINK_IE_SUBID_SHIFT     1
 #define IEEE802154E_MLME_TIMESLOT_IE_SUBID                 0x1c
 #define IEEE802154E_MLME_TIMESLOT_IE_SUBID_SHIFT           1
+#define IEEE802154E_MLME_SHORT_ADDRESS_IE_SUBID            0x45 // not standard
+#define IEEE802154E_MLME_SHORT_ADDRESS_IE_SUBID_SHIFT      1
+#define IEEE802154E_MLME_CAPABILITIES_IE_SUBID             0x46 // not standard
+#define IEEE802154E_MLME_CAPABILITIES_IE_SUBID_SHIFT       1
 
 #define IEEE802154E_MLME_IE_GROUPID                        0x01
 #define IEEE802154E_ACK_NACK_TIMECORRECTION_ELEMENTID      0x1E
+#define IEEE802154E_ACK_SHORT_ADDRESS_ELEMENTID            0x2A // not standard
 
 /**
 When a packet is received, it is written inside the OpenQueueEntry_t->packet
@@ -112,6 +125,7 @@ typedef enum {
    S_RXDATAPREPARE           = 0x10,   // preparing for Rx data
    S_RXDATAREADY             = 0x11,   // ready to Rx data, waiting for 'go'
    S_RXDATALISTEN            = 0x12,   // idle listening for data
+   S_RXDATAHEADER            = 0x1a,   // data SFD received, waiting for the MAC header
    S_RXDATA                  = 0x13,   // data SFD received, receiving more bytes
    S_TXACKOFFSET             = 0x14,   // waiting to prepare for Tx ACK
    S_TXACKPREPARE            = 0x15,   // preparing for Tx ACK
@@ -134,12 +148,16 @@ enum ieee154e_atomicdurations_enum {
    TsSlotDuration            =  PORT_TsSlotDuration,  // 15000us
    // execution speed related
    maxTxDataPrepare          =  PORT_maxTxDataPrepare,
+#ifdef BOARD_RADIO_KEEPS_TXBUFFER
+   maxTxDataPreparePreloaded =  PORT_maxTxDataPreparePreloaded, // frame loaded by prepareNextData()
+#endif
    maxRxAckPrepare           =  PORT_maxRxAckPrepare,
    maxRxDataPrepare          =  PORT_maxRxDataPrepare,
    maxTxAckPrepare           =  PORT_maxTxAckPrepare,
    // radio speed related
    delayTx                   =  PORT_delayTx,         // between GO signal and SFD
    delayRx                   =  PORT_delayRx,         // between GO signal and start listening
+   delayRxHeader             =   16,                  //   488us between SFD and destination received (PHR and LENGTH_IEEE154_DEST bytes)
    // radio watchdog
    wdRadioTx                 =   33,                  //  1000us (needs to be >delayTx)
    wdDataDuration            =  164,                  //  5000us (measured 4280us with max payload)
@@ -156,7 +174,11 @@ enum ieee154e_linkOption_enum {
 
 // FSM timer durations (combinations of atomic durations)
 // TX
+#ifdef BOARD_RADIO_KEEPS_TXBUFFER
+#define DURATION_tt1 ieee154e_vars.lastCapturedTime+TsTxOffset-delayTx-(ieee154e_vars.dataPreloaded?maxTxDataPreparePreloaded:maxTxDataPrepare)
+#else
 #define DURATION_tt1 ieee154e_vars.lastCapturedTime+TsTxOffset-delayTx-maxTxDataPrepare
+#endif
 #define DURATION_tt2 ieee154e_vars.lastCapturedTime+TsTxOffset-delayTx
 #define DURATION_tt3 ieee154e_vars.lastCapturedTime+TsTxOffset-delayTx+wdRadioTx
 #define DURATION_tt4 ieee154e_vars.lastCapturedTime+wdDataDuration
@@ -165,9 +187,10 @@ enum ieee154e_linkOption_enum {
 #define DURATION_tt7 ieee154e_vars.lastCapturedTime+TsTxAckDelay+TsShortGT
 #define DURATION_tt8 ieee154e_vars.lastCapturedTime+wdAckDuration
 // RX
-#define DURATION_rt1 ieee154e_vars.lastCapturedTime+TsTxOffset-TsLongGT-delayRx-maxRxDataPrepare
-#define DURATION_rt2 ieee154e_vars.lastCapturedTime+TsTxOffset-TsLongGT-delayRx
-#define DURATION_rt3 ieee154e_vars.lastCapturedTime+TsTxOffset+TsLongGT
+#define DURATION_rt1 ieee154e_vars.lastCapturedTime+TsTxOffset-TsLongGT-ieee154e_vars.resyncGuard-delayRx-maxRxDataPrepare
+#define DURATION_rt2 ieee154e_vars.lastCapturedTime+TsTxOffset-TsLongGT-ieee154e_vars.resyncGuard-delayRx
+#define DURATION_rt3 ieee154e_vars.lastCapturedTime+TsTxOffset+TsLongGT+ieee154e_vars.resyncGuard
+#define DURATION_rt4a ieee154e_vars.lastCapturedTime+delayRxHeader
 #define DURATION_rt4 ieee154e_vars.lastCapturedTime+wdDataDuration
 #define DURATION_rt5 ieee154e_vars.lastCapturedTime+TsTxAckDelay-delayTx-maxTxAckPrepare
 #define DURATION_rt6 ieee154e_vars.lastCapturedTime+TsTxAckDelay-delayTx
@@ -181,6 +204,13 @@ typedef struct {
    PORT_SIGNED_INT_WIDTH timeCorrection;
 } IEEE802154E_ACK_ht;
 
+// ACK template: IEEE802.15.4 header (at most 21B), Short Address Assignment IE
+// (7B) and TimeCorrection IE (4B)
+#define ACK_TEMPLATE_DSN_OFFSET   2    // after the 2-byte frame control field, if not suppressed
+
+// number of neighbors whose last received DSN is remembered
+#define DUPLICATE_CACHE_SIZE      4
+
 // includes payload header IE short + MLME short Header + Sync IE
 #define ADV_PAYLOAD_LENGTH sizeof(payload_IE_ht) + \
                            sizeof(mlme_IE_ht)     + \
@@ -188,19 +218,31 @@ typedef struct {
 
 //=========================== module variables ================================
 
+typedef struct {
+   open_addr_t               neighbor;                // sender of the frame, ADDR_NONE if unused
+   uint8_t                   dsn;                     // DSN of the last frame received from it
+} duplicateCacheEntry_t;
+
 typedef struct {
    // misc
    asn_t                     asn;                     // current absolute slot number
    slotOffset_t              slotOffset;              // current slot offset
    slotOffset_t              nextActiveSlotOffset;    // next active slot offset
+   uint16_t                  numOfSleepSlots;         // slots spanned by the current timer period
    PORT_RADIOTIMER_WIDTH     deSyncTimeout;           // how many slots left before looses sync
+   asn_t                     asnLastSync;             // ASN of the last time correction from the time source
    bool                      isSync;                  // TRUE iff mote is synchronized to network
+   bool                      isResync;                // TRUE while catching up with the time source after deSyncTimeout expired
+   PORT_RADIOTIMER_WIDTH     resyncGuard;             // extra RX guard time in the current slot while resynchronizing
    // as shown on the chronogram
    ieee154e_state_t          state;                   // state of the FSM
    OpenQueueEntry_t*         dataToSend;              // pointer to the data to send
    OpenQueueEntry_t*         dataReceived;            // pointer to the data received
    OpenQueueEntry_t*         ackToSend;               // pointer to the ack to send
    OpenQueueEntry_t*         ackReceived;             // pointer to the ack received
+   OpenQueueEntry_t*         dataPrepared;            // data claimed and loaded for the next active cell
+   uint16_t                  dataPreparedAsn;         // bytes0and1 of the ASN dataPrepared is meant for
+   bool                      dataPreloaded;           // dataToSend is already in the radio's TX buffer
    PORT_RADIOTIMER_WIDTH     lastCapturedTime;        // last captured time
    PORT_RADIOTIMER_WIDTH     syncCapturedTime;        // captured time used to sync
    // channel hopping
@@ -210,6 +252,16 @@ typedef struct {
    PORT_RADIOTIMER_WIDTH     radioOnInit;             // when within the slot the radio turns on
    PORT_RADIOTIMER_WIDTH     radioOnTics;             // how many tics within the slot the radio is on
    bool                      radioOnThisSlot;         // to control if the radio has been turned on in a slot.
+   // ACK template
+   OpenQueueEntry_t          ackTemplate;             // header and IEs of the last ACK built, length 0 if none
+   open_addr_t               ackTemplateNeighbor;     // neighbor ackTemplate is addressed to
+   uint8_t                   ackTemplateVersion;      // neighbors' header version ackTemplate was built with
+   // duplicate detection
+   duplicateCacheEntry_t     duplicateCache[DUPLICATE_CACHE_SIZE]; // last DSN received per neighbor
+   uint8_t                   duplicateCacheNext;      // next entry to overwrite when none matches
+   // leaf
+   bool                      leafListening;           // a leaf listens in shared cells for a response
+   uint16_t                  leafListenUntil;         // bytes0and1 of the last ASN it does so
 } ieee154e_vars_t;
 
 BEGIN_PACK
@@ -229,6 +281,15 @@ typedef struct {
    PORT_RADIOTIMER_WIDTH     num_timer;
    PORT_RADIOTIMER_WIDTH     num_startOfFrame;
    PORT_RADIOTIMER_WIDTH     num_endOfFrame;
+   PORT_SIGNED_INT_WIDTH     minTxAckMargin;          // least time left between ACK ready and rt6
+   PORT_RADIOTIMER_WIDTH     num_duplicate;           // retransmitted frames ACKed but not passed up
+   PORT_RADIOTIMER_WIDTH     num_rxHeaderAbort;       // frames for someone else, stopped receiving after the header
+   PORT_RADIOTIMER_WIDTH     num_warmResync;          // times deSyncTimeout expired and warm resynchronization started
+   PORT_RADIOTIMER_WIDTH     num_expired;             // packets dropped past their deadline, instead of being sent
+   PORT_RADIOTIMER_WIDTH     num_retriesNoAck;        // packets dropped after their last attempt was not ACK'ed
+   PORT_RADIOTIMER_WIDTH     num_retriesAborted;      // packets dropped after their last attempt was aborted
+   PORT_RADIOTIMER_WIDTH     num_retriesShared;       // packets dropped on reaching the budget of shared cells
+   PORT_RADIOTIMER_WIDTH     num_ackTemplateMiss;     // ACK templates built within the ACK turnaround
 } ieee154e_dbg_t;
 
 //=========================== prototypes ======================================
@@ -237,6 +298,8 @@ typedef struct {
 void               ieee154e_init(void);
 // public
 PORT_RADIOTIMER_WIDTH   ieee154e_asnDiff(asn_t* someASN);
+PORT_RADIOTIMER_WIDTH   ieee154e_slotsSinceSync(void);
+PORT_RADIOTIMER_WIDTH   ieee154e_getTimeToNextSlot(void);
 bool               ieee154e_isSynch(void);
 void               ieee154e_getAsn(uint8_t* array);
 // events
@@ -0,0 +1,502 @@
+#include "opendefs.h"
+#include "IEEE802154_security.h"
+#include "IEEE802154.h"
+#include "IEEE802154E.h"
+#include "packetfunctions.h"
+#include "idmanager.h"
+#include "openserial.h"
+#include "neighbors.h"
+#include "radio.h"
+#ifdef BOARD_CRYPTOENGINE_ENABLED
+#include "cryptoengine.h"
+#endif
+
+//=========================== defines =========================================
+
+#define CCM_STAR_L                2     // bytes of the length field, with a 13-byte nonce
+
+//=========================== variables =======================================
+
+ieee802154_security_vars_t ieee802154_security_vars;
+
+static const uint8_t ieee802154_security_defaultKey[IEEE802154_SECURITY_KEY_LEN] = IEEE802154_SECURITY_DEFAULT_KEY;
+
+//=========================== prototypes ======================================
+
+uint8_t ieee802154_security_getKeyRow(uint8_t index);
+uint8_t ieee802154_security_micLength(uint8_t securityLevel);
+void    ieee802154_security_buildNonce(uint8_t*     nonce,
+                                       open_addr_t* src,
+                                       uint32_t     frameCounter,
+                                       uint8_t      securityLevel);
+bool    ieee802154_security_ccmEncrypt(uint8_t  keyRow,
+                                       uint8_t* a, uint8_t lenA,
+                                       uint8_t* m, uint8_t lenM,
+                                       uint8_t* nonce,
+                                       uint8_t  micLength);
+bool    ieee802154_security_ccmDecrypt(uint8_t  keyRow,
+                                       uint8_t* a, uint8_t lenA,
+                                       uint8_t* c, uint8_t lenC,
+                                       uint8_t* nonce,
+                                       uint8_t  micLength);
+#ifndef BOARD_CRYPTOENGINE_ENABLED
+void    ieee802154_security_cbcMac(aes128_key_t* key,
+                                   uint8_t* a, uint8_t lenA,
+                                   uint8_t* m, uint8_t lenM,
+                                   uint8_t* nonce,
+                                   uint8_t  micLength,
+                                   uint8_t* mic);
+void    ieee802154_security_ctr(aes128_key_t* key,
+                                uint8_t* nonce,
+                                uint8_t  counter,
+                                uint8_t* buf,
+                                uint8_t  len);
+#endif
+
+//=========================== public ==========================================
+
+/**
+\brief Initialize this module, with the default key.
+*/
+void ieee802154_security_init() {
+   
+   // clear module variables
+   memset(&ieee802154_security_vars,0,sizeof(ieee802154_security_vars_t));
+   
+#ifdef BOARD_CRYPTOENGINE_ENABLED
+   cryptoengine_init();
+#endif
+   
+   ieee802154_security_setKey(IEEE802154_SECURITY_KEYINDEX,(uint8_t*)ieee802154_security_defaultKey);
+}
+
+/**
+\brief Set the key of a given index, replacing the previous one if any.
+
+The key is expanded here, once, rather than each time a frame is secured.
+
+\param[in] index The key index, as in the auxiliary security header.
+\param[in] key   The 16-byte key.
+
+\returns E_SUCCESS if the key was set, E_FAIL if the key table is full.
+*/
+owerror_t ieee802154_security_setKey(uint8_t index, uint8_t* key) {
+   uint8_t row;
+   
+   row = ieee802154_security_getKeyRow(index);
+   if (row==IEEE802154_SECURITY_MAXNUMKEYS) {
+      for (row=0;row<IEEE802154_SECURITY_MAXNUMKEYS;row++) {
+         if (ieee802154_security_vars.keys[row].used==FALSE) {
+            break;
+         }
+      }
+      if (row==IEEE802154_SECURITY_MAXNUMKEYS) {
+         return E_FAIL;
+      }
+   }
+   
+#ifdef BOARD_CRYPTOENGINE_ENABLED
+   if (cryptoengine_loadKey(row,key)==FALSE) {
+      return E_FAIL;
+   }
+#else
+   aes128_setKey(&ieee802154_security_vars.keys[row].key,key);
+#endif
+   ieee802154_security_vars.keys[row].index = index;
+   ieee802154_security_vars.keys[row].used  = TRUE;
+   return E_SUCCESS;
+}
+
+//===== outgoing
+
+/**
+\brief Decide how a frame about to be sent is secured.
+
+Called before its IEEE802.15.4 header is prepended, which contains the
+auxiliary security header. Only data frames are secured.
+
+The frame counter is incremented for each frame, starting from the low 4
+bytes of the ASN at which I secure my first frame once synchronized. As I send
+less than a frame per slot, it never goes back after a reboot, without having
+to be saved. It does not follow the ASN afterwards, so that frames sent out of
+order, e.g. a broadcast queued behind unicast frames, stay within the replay
+window of the receiver, see neighbors_updateRxFrameCounter().
+
+\param[in,out] msg The frame about to be sent.
+*/
+void ieee802154_security_prepareOutgoingFrame(OpenQueueEntry_t* msg) {
+   uint8_t  asn[5];
+   uint32_t asnCounter;
+   
+   if (msg->l2_frameType!=IEEE154_TYPE_DATA) {
+      msg->l2_securityLevel = IEEE154_ASH_SLF_TYPE_NOSEC;
+      return;
+   }
+   
+   if (ieee802154_security_vars.frameCounterSeeded==FALSE && ieee154e_isSynch()==TRUE) {
+      ieee154e_getAsn(asn);
+      asnCounter = ((uint32_t)asn[0]      ) |
+                   ((uint32_t)asn[1] <<  8) |
+                   ((uint32_t)asn[2] << 16) |
+                   ((uint32_t)asn[3] << 24);
+      if (asnCounter>ieee802154_security_vars.frameCounter) {
+         ieee802154_security_vars.frameCounter = asnCounter;
+      }
+      ieee802154_security_vars.frameCounterSeeded = TRUE;
+   }
+   ieee802154_security_vars.frameCounter++;
+   
+   msg->l2_securityLevel = IEEE802154_SECURITY_LEVEL;
+   msg->l2_keyIndex      = IEEE802154_SECURITY_KEYINDEX;
+   msg->l2_frameCounter  = ieee802154_security_vars.frameCounter;
+}
+
+/**
+\brief Secure a frame, once its IEEE802.15.4 header is prepended.
+
+The header, up to msg->l2_payload, is authenticated. The rest of the frame is
+encrypted in place, and the MIC is appended to it. Without encryption, the
+whole frame is authenticated.
+
+\param[in,out] msg The frame, with l2_securityLevel set by
+   ieee802154_security_prepareOutgoingFrame().
+
+\returns E_SUCCESS if the frame is secured, E_FAIL otherwise.
+*/
+owerror_t ieee802154_security_outgoingFrame(OpenQueueEntry_t* msg) {
+   uint8_t nonce[IEEE802154_SECURITY_NONCE_LEN];
+   uint8_t keyRow;
+   uint8_t micLength;
+   uint8_t lenA;
+   uint8_t lenM;
+   
+   keyRow = ieee802154_security_getKeyRow(msg->l2_keyIndex);
+   if (keyRow==IEEE802154_SECURITY_MAXNUMKEYS) {
+      openserial_printError(COMPONENT_IEEE802154_SECURITY,ERR_SECURITY_UNKNOWN_KEY,
+                            (errorparameter_t)msg->l2_keyIndex,
+                            (errorparameter_t)IEEE154_ASH_KEYIDMODE_INDEX);
+      return E_FAIL;
+   }
+   micLength = ieee802154_security_micLength(msg->l2_securityLevel);
+   // the PHY payload is at most 127 bytes
+   if (msg->length+micLength+LENGTH_CRC>127) {
+      openserial_printError(COMPONENT_IEEE802154_SECURITY,ERR_HEADER_TOO_LONG,
+                            (errorparameter_t)0,
+                            (errorparameter_t)(msg->length+micLength));
+      return E_FAIL;
+   }
+   
+   lenA = msg->l2_payload-msg->payload;
+   lenM = msg->length-lenA;
+   if (msg->l2_securityLevel<IEEE154_ASH_SLF_TYPE_ENC) {
+      lenA += lenM;
+      lenM  = 0;
+   }
+   
+   ieee802154_security_buildNonce(nonce,
+                                  idmanager_getMyID(ADDR_64B),
+                                  msg->l2_frameCounter,
+                                  msg->l2_securityLevel);
+   
+   // the MIC goes right after the payload
+   packetfunctions_reserveFooterSize(msg,micLength);
+   if (ieee802154_security_ccmEncrypt(keyRow,msg->payload,lenA,msg->payload+lenA,lenM,nonce,micLength)==FALSE) {
+      return E_FAIL;
+   }
+   return E_SUCCESS;
+}
+
+//===== incoming
+
+/**
+\brief Verify and decrypt a received frame, then toss its MIC.
+
+The frame was parsed by ieee802154_retrieveHeader(), and its header tossed,
+msg->l2_headerLength bytes of it. Data frames must be secured, EBs must not.
+The frame counter is checked for replays after the MIC, so a forged frame
+cannot move the neighbor's counter forward.
+
+\param[in,out] msg The received frame, its payload starting after the header.
+
+\returns E_SUCCESS if the frame can be passed up the stack, E_FAIL if it must
+   be dropped.
+*/
+owerror_t ieee802154_security_incomingFrame(OpenQueueEntry_t* msg) {
+   uint8_t  nonce[IEEE802154_SECURITY_NONCE_LEN];
+   uint8_t  keyRow;
+   uint8_t  micLength;
+   uint8_t* a;
+   uint8_t  lenA;
+   uint8_t  lenC;
+   
+   if (msg->l2_frameType==IEEE154_TYPE_BEACON) {
+      // the IEs of EBs were used before we get here, when still in the slot
+      if (msg->l2_securityLevel==IEEE154_ASH_SLF_TYPE_NOSEC) {
+         return E_SUCCESS;
+      }
+      return E_FAIL;
+   }
+   
+   if (msg->l2_securityLevel==IEEE154_ASH_SLF_TYPE_NOSEC) {
+      openserial_printError(COMPONENT_IEEE802154_SECURITY,ERR_SECURITY_UNSECURED,
+                            (errorparameter_t)msg->l2_frameType,
+                            (errorparameter_t)msg->l2_nextORpreviousHop.addr_64b[7]);
+      return E_FAIL;
+   }
+   if (msg->l2_securityLevel!=IEEE802154_SECURITY_LEVEL) {
+      // don't let a neighbor downgrade the protection
+      openserial_printError(COMPONENT_IEEE802154_SECURITY,ERR_SECURITY_AUTH_FAILED,
+                            (errorparameter_t)msg->l2_frameCounter,
+                            (errorparameter_t)0);
+      return E_FAIL;
+   }
+   keyRow = ieee802154_security_getKeyRow(msg->l2_keyIndex);
+   if (keyRow==IEEE802154_SECURITY_MAXNUMKEYS) {
+      openserial_printError(COMPONENT_IEEE802154_SECURITY,ERR_SECURITY_UNKNOWN_KEY,
+                            (errorparameter_t)msg->l2_keyIndex,
+                            (errorparameter_t)IEEE154_ASH_KEYIDMODE_INDEX);
+      return E_FAIL;
+   }
+   micLength = ieee802154_security_micLength(msg->l2_securityLevel);
+   if (msg->length<micLength || msg->l2_nextORpreviousHop.type!=ADDR_64B) {
+      openserial_printError(COMPONENT_IEEE802154_SECURITY,ERR_SECURITY_AUTH_FAILED,
+                            (errorparameter_t)msg->l2_frameCounter,
+                            (errorparameter_t)1);
+      return E_FAIL;
+   }
+   
+   a    = msg->payload-msg->l2_headerLength;
+   lenA = msg->l2_headerLength;
+   lenC = msg->length;
+   if (msg->l2_securityLevel<IEEE154_ASH_SLF_TYPE_ENC) {
+      lenA += lenC-micLength;
+      lenC  = micLength;
+   }
+   
+   ieee802154_security_buildNonce(nonce,
+                                  &(msg->l2_nextORpreviousHop),
+                                  msg->l2_frameCounter,
+                                  msg->l2_securityLevel);
+   
+   if (ieee802154_security_ccmDecrypt(keyRow,a,lenA,a+lenA,lenC,nonce,micLength)==FALSE) {
+      openserial_printError(COMPONENT_IEEE802154_SECURITY,ERR_SECURITY_AUTH_FAILED,
+                            (errorparameter_t)msg->l2_frameCounter,
+                            (errorparameter_t)2);
+      return E_FAIL;
+   }
+   packetfunctions_tossFooter(msg,micLength);
+   
+   if (neighbors_updateRxFrameCounter(&(msg->l2_nextORpreviousHop),msg->l2_frameCounter)==FALSE) {
+      openserial_printError(COMPONENT_IEEE802154_SECURITY,ERR_SECURITY_REPLAY,
+                            (errorparameter_t)msg->l2_frameCounter,
+                            (errorparameter_t)msg->l2_nextORpreviousHop.addr_64b[7]);
+      return E_FAIL;
+   }
+   return E_SUCCESS;
+}
+
+//=========================== private =========================================
+
+/**
+\brief Find the row of the key table holding the key of a given index.
+
+\returns The row, IEEE802154_SECURITY_MAXNUMKEYS if there is no such key.
+*/
+uint8_t ieee802154_security_getKeyRow(uint8_t index) {
+   uint8_t row;
+   
+   for (row=0;row<IEEE802154_SECURITY_MAXNUMKEYS;row++) {
+      if (
+            ieee802154_security_vars.keys[row].used==TRUE &&
+            ieee802154_security_vars.keys[row].index==index
+         ) {
+         break;
+      }
+   }
+   return row;
+}
+
+/**
+\brief Length of the MIC of a security level: 0, 4, 8 or 16 bytes.
+*/
+uint8_t ieee802154_security_micLength(uint8_t securityLevel) {
+   if ((securityLevel & 0x03)==0) {
+      return 0;
+   }
+   return 2 << (securityLevel & 0x03);
+}
+
+/**
+\brief Build the CCM* nonce: source EUI64, frame counter and security level.
+*/
+void ieee802154_security_buildNonce(uint8_t*     nonce,
+                                    open_addr_t* src,
+                                    uint32_t     frameCounter,
+                                    uint8_t      securityLevel) {
+   memcpy(nonce,src->addr_64b,LENGTH_ADDR64b);
+   nonce[ 8] = (uint8_t)(frameCounter >> 24);
+   nonce[ 9] = (uint8_t)(frameCounter >> 16);
+   nonce[10] = (uint8_t)(frameCounter >>  8);
+   nonce[11] = (uint8_t)(frameCounter      );
+   nonce[12] = securityLevel;
+}
+
+/**
+\brief CCM* authentication of a and m, and encryption of m in place.
+
+The MIC is written right after m.
+*/
+bool ieee802154_security_ccmEncrypt(uint8_t  keyRow,
+                                    uint8_t* a, uint8_t lenA,
+                                    uint8_t* m, uint8_t lenM,
+                                    uint8_t* nonce,
+                                    uint8_t  micLength) {
+#ifdef BOARD_CRYPTOENGINE_ENABLED
+   return cryptoengine_aesCcmEncrypt(a,lenA,m,lenM,nonce,keyRow,micLength);
+#else
+   aes128_key_t* key;
+   
+   key = &ieee802154_security_vars.keys[keyRow].key;
+   
+   // the MIC is computed over the plaintext, then encrypted with counter 0
+   ieee802154_security_cbcMac(key,a,lenA,m,lenM,nonce,micLength,m+lenM);
+   ieee802154_security_ctr(key,nonce,0,m+lenM,micLength);
+   ieee802154_security_ctr(key,nonce,1,m,lenM);
+   return TRUE;
+#endif
+}
+
+/**
+\brief CCM* decryption of c in place, and verification of the MIC at its end.
+
+\returns TRUE if the MIC matches, FALSE otherwise.
+*/
+bool ieee802154_security_ccmDecrypt(uint8_t  keyRow,
+                                    uint8_t* a, uint8_t lenA,
+                                    uint8_t* c, uint8_t lenC,
+                                    uint8_t* nonce,
+                                    uint8_t  micLength) {
+#ifdef BOARD_CRYPTOENGINE_ENABLED
+   return cryptoengine_aesCcmDecrypt(a,lenA,c,lenC,nonce,keyRow,micLength);
+#else
+   aes128_key_t* key;
+   uint8_t       mic[IEEE802154_SECURITY_MAX_MIC_LEN];
+   uint8_t       lenM;
+   uint8_t       diff;
+   uint8_t       i;
+   
+   key  = &ieee802154_security_vars.keys[keyRow].key;
+   lenM = lenC-micLength;
+   
+   // decrypt the received MIC and the data, then compute the MIC again
+   ieee802154_security_ctr(key,nonce,0,c+lenM,micLength);
+   ieee802154_security_ctr(key,nonce,1,c,lenM);
+   ieee802154_security_cbcMac(key,a,lenA,c,lenM,nonce,micLength,mic);
+   
+   // compare all bytes, not to tell how many match
+   diff = 0;
+   for (i=0;i<micLength;i++) {
+      diff |= mic[i] ^ c[lenM+i];
+   }
+   return diff==0;
+#endif
+}
+
+#ifndef BOARD_CRYPTOENGINE_ENABLED
+
+/**
+\brief CBC-MAC of CCM*, over B0, the length of a, a and m.
+
+Both a and m are padded with zeros to a block boundary.
+*/
+void ieee802154_security_cbcMac(aes128_key_t* key,
+                                uint8_t* a, uint8_t lenA,
+                                uint8_t* m, uint8_t lenM,
+                                uint8_t* nonce,
+                                uint8_t  micLength,
+                                uint8_t* mic) {
+   uint8_t x[AES128_BLOCK_SIZE];
+   uint8_t pos;
+   uint8_t i;
+   
+   if (micLength==0) {
+      return;
+   }
+   
+   // B0: flags, nonce and length of m
+   x[0]  = 0;
+   if (lenA>0) {
+      x[0] |= 0x40;
+   }
+   x[0] |= ((micLength-2)/2) << 3;
+   x[0] |= CCM_STAR_L-1;
+   memcpy(&x[1],nonce,IEEE802154_SECURITY_NONCE_LEN);
+   x[14] = 0;
+   x[15] = lenM;
+   aes128_encrypt(key,x);
+   
+   // the length of a, then a
+   if (lenA>0) {
+      x[1] ^= lenA;
+      pos   = 2;
+      for (i=0;i<lenA;i++) {
+         x[pos++] ^= a[i];
+         if (pos==AES128_BLOCK_SIZE) {
+            aes128_encrypt(key,x);
+            pos = 0;
+         }
+      }
+      if (pos>0) {
+         aes128_encrypt(key,x);
+      }
+   }
+   
+   // m
+   pos = 0;
+   for (i=0;i<lenM;i++) {
+      x[pos++] ^= m[i];
+      if (pos==AES128_BLOCK_SIZE) {
+         aes128_encrypt(key,x);
+         pos = 0;
+      }
+   }
+   if (pos>0) {
+      aes128_encrypt(key,x);
+   }
+   
+   memcpy(mic,x,micLength);
+}
+
+/**
+\brief Encrypt or decrypt in place with the CCM* key stream.
+
+\param[in] counter The counter of the first block, 0 for the MIC, 1 for the
+   data.
+*/
+void ieee802154_security_ctr(aes128_key_t* key,
+                             uint8_t* nonce,
+                             uint8_t  counter,
+                             uint8_t* buf,
+                             uint8_t  len) {
+   uint8_t ai[AES128_BLOCK_SIZE];
+   uint8_t chunk;
+   uint8_t i;
+   
+   while (len>0) {
+      // Ai: flags, nonce and counter
+      ai[0]  = CCM_STAR_L-1;
+      memcpy(&ai[1],nonce,IEEE802154_SECURITY_NONCE_LEN);
+      ai[14] = 0;
+      ai[15] = counter++;
+      aes128_encrypt(key,ai);
+      
+      chunk = len<AES128_BLOCK_SIZE ? len : AES128_BLOCK_SIZE;
+      for (i=0;i<chunk;i++) {
+         buf[i] ^= ai[i];
+      }
+      buf += chunk;
+      len -= chunk;
+   }
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef __IEEE802154_SECURITY_H
+#define __IEEE802154_SECURITY_H
+
+/**
+\addtogroup MAClow
+\{
+\addtogroup IEEE802154_security
+\{
+
+\brief Link-layer security of IEEE802.15.4 frames, with CCM*.
+
+Built in with the l2_security=1 build option (L2_SECURITY_ACTIVE). Data frames
+are then all secured, with IEEE802154_SECURITY_LEVEL and the key of index
+IEEE802154_SECURITY_KEYINDEX. EBs and ACKs are sent in the clear, so motes can
+join, and ACKs can be sent within the slot.
+
+Frames are secured when handed to the MAC, and verified after the ACK, so
+neither the AES nor the key expansion happens within the slot. Keys are
+expanded once, when set, either into round keys for the software AES, or into
+a key slot of the board's AES engine (BOARD_CRYPTOENGINE_ENABLED).
+*/
+
+#include "opendefs.h"
+#include "IEEE802154.h"
+#ifndef BOARD_CRYPTOENGINE_ENABLED
+#include "aes128.h"
+#endif
+
+//=========================== define ==========================================
+
+#define IEEE802154_SECURITY_LEVEL         IEEE154_ASH_SLF_TYPE_ENC_MIC_32 // of data frames
+#define IEEE802154_SECURITY_KEYINDEX      1     // of the key securing data frames
+#define IEEE802154_SECURITY_MAXNUMKEYS    2
+#define IEEE802154_SECURITY_KEY_LEN       16
+#define IEEE802154_SECURITY_NONCE_LEN     13    // source EUI64, frame counter, security level
+#define IEEE802154_SECURITY_MAX_MIC_LEN   16
+
+// the network-wide key, until keys are distributed when joining
+#define IEEE802154_SECURITY_DEFAULT_KEY   {0xde,0xad,0xbe,0xef,0xfa,0xce,0xca,0xfe, \
+                                           0xde,0xad,0xbe,0xef,0xfa,0xce,0xca,0xfe}
+
+//=========================== typedef =========================================
+
+typedef struct {
+   bool             used;
+   uint8_t          index;                // key index, as in the auxiliary security header
+#ifndef BOARD_CRYPTOENGINE_ENABLED
+   aes128_key_t     key;                  // round keys, expanded when the key is set
+#endif
+} ieee802154_security_key_t;
+
+//=========================== module variables ================================
+
+typedef struct {
+   ieee802154_security_key_t keys[IEEE802154_SECURITY_MAXNUMKEYS]; // the engine's key slot is the row
+   uint32_t         frameCounter;         // of the last frame I secured
+   bool             frameCounterSeeded;   // frameCounter was set from the ASN since boot
+} ieee802154_security_vars_t;
+
+//=========================== prototypes ======================================
+
+void      ieee802154_security_init(void);
+owerror_t ieee802154_security_setKey(uint8_t index, uint8_t* key);
+// outgoing
+void      ieee802154_security_prepareOutgoingFrame(OpenQueueEntry_t* msg);
+owerror_t ieee802154_security_outgoingFrame(OpenQueueEntry_t* msg);
+// incoming
+owerror_t ieee802154_security_incomingFrame(OpenQueueEntry_t* msg);
+
+/**
+\}
+\}
+*/
+
+#endif
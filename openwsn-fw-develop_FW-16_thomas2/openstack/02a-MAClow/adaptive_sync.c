@@ -197,13 +197,16 @@ void adaptive_sync_countCompensationTimeout() {
 /**
 \brief update compensationTimeout when compound slots are scheduled and adjust the slot when the elapsed slots rearch to compensation interval(e.g. SERIALRX slots)
 
+The current timer period must already span the compound slots; it is only
+adjusted by the compensation they call for.
+
 \param[in] compoundSlots how many slots will be elapsed before wakeup next time.
 */
 void adaptive_sync_countCompensationTimeout_compoundSlots(uint16_t compoundSlots) {
    uint16_t counter;
    uint8_t  compensateTicks;
    uint16_t newSlotDuration;
-   newSlotDuration  = TsSlotDuration*(compoundSlots+1);
+   newSlotDuration  = radio_getTimerPeriod();
    // if clockState is not set yet, don't compensate.
    if(adaptive_sync_vars.clockState == S_NONE) {
      return;
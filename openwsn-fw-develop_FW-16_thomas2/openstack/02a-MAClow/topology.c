@@ -54,6 +54,11 @@ bool topology_isAcceptablePacket(ieee802154_header_iht* ieee802514_header) {
 #ifdef PLUGFEST
    bool returnVal;
    
+   // an ACK without source address is only sent for a frame which was accepted
+   if (ieee802514_header->src.type==ADDR_NONE) {
+      return TRUE;
+   }
+   
    returnVal=FALSE;
    switch (idmanager_getMyID(ADDR_64B)->addr_64b[7]) {
       case 0x4c:
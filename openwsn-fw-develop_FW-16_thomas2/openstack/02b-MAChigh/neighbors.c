@@ -25,6 +25,14 @@ bool isThisRowMatching(
         open_addr_t* address,
         uint8_t      rowNumber
      );
+void dropShortAddress(void);
+void assignRootShortAddress(void);
+uint16_t shortAddrBlockSize(uint8_t depth);
+bool shortAddrFreeBlock(uint16_t* addr);
+uint16_t readShortAddress(open_addr_t* addr_16b);
+void writeShortAddress(open_addr_t* addr_16b, uint16_t addr);
+bool hasCapability(open_addr_t* neighbor, uint8_t capability);
+void updateTxPower(uint8_t row, uint8_t numTxAttempts, bool was_finally_acked);
 
 //=========================== public ==========================================
 
@@ -39,6 +47,7 @@ void neighbors_init() {
    // set myDAGrank
    if (idmanager_getIsDAGroot()==TRUE) {
       neighbors_vars.myDAGrank=0;
+      assignRootShortAddress();
    } else {
       neighbors_vars.myDAGrank=DEFAULTDAGRANK;
    }
@@ -178,6 +187,31 @@ open_addr_t* neighbors_getKANeighbor(uint16_t kaPeriod) {
    }
 }
 
+/**
+\brief Retrieve the routing information kept about some neighbor.
+
+\param[in]  index            The row of the neighbor table.
+\param[out] address          Where to write the neighbor's 64-bit address.
+\param[out] DAGrank          Where to write the DAGrank the neighbor advertised.
+\param[out] parentPreference Where to write the neighbor's parent preference.
+
+\returns TRUE if that row is in use, FALSE otherwise.
+*/
+bool neighbors_getNeighborInfo(
+      uint8_t      index,
+      open_addr_t* address,
+      dagrank_t*   DAGrank,
+      uint8_t*     parentPreference
+   ) {
+   if (index>=MAXNUMNEIGHBORS || neighbors_vars.neighbors[index].used==FALSE) {
+      return FALSE;
+   }
+   memcpy(address,&neighbors_vars.neighbors[index].addr_64b,sizeof(open_addr_t));
+   *DAGrank          = neighbors_vars.neighbors[index].DAGrank;
+   *parentPreference = neighbors_vars.neighbors[index].parentPreference;
+   return TRUE;
+}
+
 //===== interrogators
 
 /**
@@ -381,6 +415,7 @@ The fields which are updated are:
 - numTx
 - numTxACK
 - asn
+- the power to transmit to this neighbor at
 
 \param[in] l2_dest MAC destination address of the packet, i.e. the neighbor
    who I just sent the packet to.
@@ -415,7 +450,13 @@ void neighbors_indicateTx(open_addr_t* l2_dest,
         if (was_finally_acked==TRUE) {
             neighbors_vars.neighbors[i].numTxACK++;
             memcpy(&neighbors_vars.neighbors[i].asn,asnTs,sizeof(asn_t));
+        } else if (neighbors_vars.shortAddr[i].state==SHORTADDR_PARENT) {
+            // my parent may have forgotten my short address, use my EUI64
+            // until it offers it again
+            neighbors_vars.shortAddr[i].state = SHORTADDR_NONE;
+            neighbors_vars.headerVersion++;
         }
+        updateTxPower(i,numTxAttempts,was_finally_acked);
         break;
       }
    }
@@ -464,6 +505,39 @@ void neighbors_indicateRxDIO(OpenQueueEntry_t* msg) {
    neighbors_updateMyDAGrankAndNeighborPreference(); 
 }
 
+/**
+\brief Re-create a neighbor remembered from before a reboot.
+
+The neighbor is entered as if just heard, so it is not aged out before it had a
+chance to be heard again. The DAGrank it advertised is only used until its next
+DIO, and never overwrites a DAGrank learnt since the reboot.
+
+\param[in] address The neighbor's 64-bit address.
+\param[in] DAGrank The DAGrank the neighbor advertised before the reboot.
+*/
+void neighbors_restoreNeighbor(open_addr_t* address, dagrank_t DAGrank) {
+   uint8_t array[5];
+   asn_t   asn;
+   uint8_t i;
+   
+   // the neighbor is considered heard now
+   ieee154e_getAsn(array);
+   asn.bytes0and1 = ((uint16_t) array[1] << 8) | ((uint16_t) array[0]);
+   asn.bytes2and3 = ((uint16_t) array[3] << 8) | ((uint16_t) array[2]);
+   asn.byte4      = array[4];
+   
+   registerNewNeighbor(address, 0, &asn, FALSE, 0);
+   
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      if (isThisRowMatching(address,i)) {
+         if (neighbors_vars.neighbors[i].DAGrank==DEFAULTDAGRANK) {
+            neighbors_vars.neighbors[i].DAGrank = DAGrank;
+         }
+         break;
+      }
+   }
+}
+
 //===== write addresses
 
 /**
@@ -483,6 +557,483 @@ void  neighbors_getNeighbor(open_addr_t* address, uint8_t addr_type, uint8_t ind
    }
 }
 
+//===== short addresses
+
+/**
+\brief Get the short address of a neighbor, if frames to it can use short
+   addresses.
+
+Short addresses are only used between a mote and the parent which assigned it
+its short address, as those are the only two motes which know both.
+
+\param[in]  neighbor The EUI64 address of the neighbor.
+\param[out] addr_16b Where to write the neighbor's short address to.
+
+\returns TRUE if frames to that neighbor can use short addresses, FALSE
+   otherwise.
+*/
+bool neighbors_getShortAddress(open_addr_t* neighbor, open_addr_t* addr_16b) {
+   uint8_t i;
+   bool    returnVal;
+   
+   INTERRUPT_DECLARATION();
+   DISABLE_INTERRUPTS();
+   
+   returnVal = FALSE;
+   if (idmanager_getMyShortAddress()->type==ADDR_16B) {
+      for (i=0;i<MAXNUMNEIGHBORS;i++) {
+         if (isThisRowMatching(neighbor,i)) {
+            if (
+                  neighbors_vars.shortAddr[i].state==SHORTADDR_CHILD ||
+                  neighbors_vars.shortAddr[i].state==SHORTADDR_PARENT
+               ) {
+               writeShortAddress(addr_16b,neighbors_vars.shortAddr[i].addr);
+               returnVal = TRUE;
+            }
+            break;
+         }
+      }
+   }
+   
+   ENABLE_INTERRUPTS();
+   return returnVal;
+}
+
+/**
+\brief Get the short address I assigned a neighbor which hasn't used it yet.
+
+It is carried in the ACKs I send to that neighbor, until it uses it.
+
+\param[in]  neighbor The EUI64 address of the neighbor.
+\param[out] assigned Where to write the short address I assigned it.
+\param[out] depth    Where to write its depth in the tree of short addresses.
+
+\returns TRUE if there is a short address to offer, FALSE otherwise.
+*/
+bool neighbors_getShortAddressOffer(open_addr_t* neighbor,
+                                    uint16_t*    assigned,
+                                    uint8_t*     depth) {
+   uint8_t i;
+   
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      if (isThisRowMatching(neighbor,i)) {
+         if (neighbors_vars.shortAddr[i].state==SHORTADDR_OFFERED) {
+            *assigned = neighbors_vars.shortAddr[i].addr;
+            *depth    = neighbors_vars.shortAddrDepth+1;
+            return TRUE;
+         }
+         break;
+      }
+   }
+   return FALSE;
+}
+
+/**
+\brief Get a number which changes each time the header of frames to a
+   neighbor may change.
+
+That is when a short address is assigned, used or dropped, or when a neighbor
+advertises different capabilities. Lets the MAC know when what it built from
+them is stale.
+*/
+uint8_t neighbors_getHeaderVersion() {
+   return neighbors_vars.headerVersion;
+}
+
+/**
+\brief Indicate a frame was received from a short address.
+
+Called while parsing the header, so the rest of the stack only sees the
+neighbor's EUI64. A child using the short address I offered it confirms it
+received it.
+
+\param[in]  addr_16b The short source address of the frame.
+\param[out] addr_64b Where to write the EUI64 of that neighbor to.
+
+\returns TRUE if the short address is the one of a neighbor, FALSE otherwise.
+*/
+bool neighbors_indicateRxShortAddress(open_addr_t* addr_16b, open_addr_t* addr_64b) {
+   uint8_t  i;
+   uint16_t addr;
+   
+   addr = readShortAddress(addr_16b);
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      if (
+            neighbors_vars.neighbors[i].used==TRUE                  &&
+            neighbors_vars.shortAddr[i].state!=SHORTADDR_NONE       &&
+            neighbors_vars.shortAddr[i].addr==addr
+         ) {
+         memcpy(addr_64b,&(neighbors_vars.neighbors[i].addr_64b),sizeof(open_addr_t));
+         if (neighbors_vars.shortAddr[i].state==SHORTADDR_OFFERED) {
+            neighbors_vars.shortAddr[i].state = SHORTADDR_CHILD;
+            neighbors_vars.headerVersion++;
+         }
+         return TRUE;
+      }
+   }
+   return FALSE;
+}
+
+/**
+\brief Indicate a unicast frame to me was received from an EUI64.
+
+The only neighbors sending me unicast frames, other than my preferred parent,
+are my children. I assign them a free block of my own block of short
+addresses, and offer it again to a child which stopped using it.
+
+\param[in] l2_src The EUI64 source address of the frame.
+*/
+void neighbors_indicateRxLongAddress(open_addr_t* l2_src) {
+   uint8_t  i;
+   uint16_t addr;
+   
+   if (idmanager_getMyShortAddress()->type!=ADDR_16B) {
+      return;
+   }
+   
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      if (isThisRowMatching(l2_src,i)) {
+         switch (neighbors_vars.shortAddr[i].state) {
+            case SHORTADDR_CHILD:
+               neighbors_vars.shortAddr[i].state = SHORTADDR_OFFERED;
+               neighbors_vars.headerVersion++;
+               break;
+            case SHORTADDR_NONE:
+               if (
+                     neighbors_vars.neighbors[i].parentPreference==MAXPREFERENCE ||
+                     shortAddrFreeBlock(&addr)==FALSE
+                  ) {
+                  // my children keep using their EUI64
+                  break;
+               }
+               neighbors_vars.shortAddr[i].addr  = addr;
+               neighbors_vars.shortAddr[i].state = SHORTADDR_OFFERED;
+               neighbors_vars.headerVersion++;
+               break;
+            default:
+               break;
+         }
+         break;
+      }
+   }
+}
+
+/**
+\brief Indicate my preferred parent offered me a short address.
+
+If it differs from the one I have, my children's short addresses, carved out
+of mine, are dropped as well.
+
+\param[in] l2_src       The EUI64 of the neighbor which sent the offer.
+\param[in] assigned     The short address it assigned me.
+\param[in] assignerAddr Its own short address.
+\param[in] depth        My depth in the tree of short addresses.
+*/
+void neighbors_indicateShortAddressOffer(open_addr_t* l2_src,
+                                         uint16_t     assigned,
+                                         uint16_t     assignerAddr,
+                                         uint8_t      depth) {
+   uint8_t     i;
+   open_addr_t newAddr;
+   
+   if (idmanager_getIsDAGroot()==TRUE || depth>=SHORTADDR_MAXDEPTH) {
+      return;
+   }
+   
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      if (isThisRowMatching(l2_src,i)) {
+         if (neighbors_vars.neighbors[i].parentPreference!=MAXPREFERENCE) {
+            break;
+         }
+         if (
+               idmanager_getMyShortAddress()->type!=ADDR_16B ||
+               readShortAddress(idmanager_getMyShortAddress())!=assigned
+            ) {
+            dropShortAddress();
+            writeShortAddress(&newAddr,assigned);
+            idmanager_setMyShortAddress(&newAddr);
+            neighbors_vars.shortAddrDepth = depth;
+            openserial_printInfo(COMPONENT_NEIGHBORS,ERR_SHORTADDR_ASSIGNED,
+                                 (errorparameter_t)assigned,
+                                 (errorparameter_t)depth);
+         }
+         if (
+               neighbors_vars.shortAddr[i].state!=SHORTADDR_PARENT ||
+               neighbors_vars.shortAddr[i].addr!=assignerAddr
+            ) {
+            neighbors_vars.shortAddr[i].addr  = assignerAddr;
+            neighbors_vars.shortAddr[i].state = SHORTADDR_PARENT;
+            neighbors_vars.headerVersion++;
+         }
+         break;
+      }
+   }
+}
+
+/**
+\brief Indicate an EB was received, advertising its sender's short address
+   or not.
+
+Detects that my parent lost the short address mine was carved out of, that a
+child dropped the one I assigned it, and that another mote uses mine.
+
+\param[in] l2_src  The EUI64 of the sender of the EB.
+\param[in] present Whether the EB advertises a short address.
+\param[in] addr    The short address advertised, if present.
+*/
+void neighbors_indicateShortAddressAdvertised(open_addr_t* l2_src,
+                                              bool         present,
+                                              uint16_t     addr) {
+   uint8_t i;
+   
+   if (
+         present==TRUE                                           &&
+         idmanager_getIsDAGroot()==FALSE                         &&
+         idmanager_getMyShortAddress()->type==ADDR_16B           &&
+         readShortAddress(idmanager_getMyShortAddress())==addr
+      ) {
+      // e.g. assigned by my parent before it rebooted
+      openserial_printError(COMPONENT_NEIGHBORS,ERR_SHORTADDR_CONFLICT,
+                            (errorparameter_t)addr,
+                            (errorparameter_t)0);
+      dropShortAddress();
+      return;
+   }
+   
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      if (isThisRowMatching(l2_src,i)) {
+         switch (neighbors_vars.shortAddr[i].state) {
+            case SHORTADDR_PARENT:
+               if (present==FALSE || addr!=neighbors_vars.shortAddr[i].addr) {
+                  dropShortAddress();
+               }
+               break;
+            case SHORTADDR_CHILD:
+               if (present==FALSE || addr!=neighbors_vars.shortAddr[i].addr) {
+                  neighbors_vars.shortAddr[i].state = SHORTADDR_OFFERED;
+                  neighbors_vars.headerVersion++;
+               }
+               break;
+            case SHORTADDR_OFFERED:
+               if (present==TRUE && addr==neighbors_vars.shortAddr[i].addr) {
+                  neighbors_vars.shortAddr[i].state = SHORTADDR_CHILD;
+                  neighbors_vars.headerVersion++;
+               }
+               break;
+            default:
+               break;
+         }
+         break;
+      }
+   }
+}
+
+//===== capabilities
+
+/**
+\brief Tell whether a neighbor understands the IEEE802.15.4-2015 field elision.
+
+\param[in] neighbor The EUI64 address of the neighbor.
+
+\returns TRUE if the neighbor advertised NEIGHBOR_CAP_COMPACT_HEADER in its
+   last EB, FALSE otherwise.
+*/
+bool neighbors_supportsCompactHeader(open_addr_t* neighbor) {
+   return hasCapability(neighbor,NEIGHBOR_CAP_COMPACT_HEADER);
+}
+
+/**
+\brief Tell whether a neighbor understands the 6LoWPAN routing headers.
+
+\param[in] neighbor The EUI64 address of the neighbor.
+
+\returns TRUE if the neighbor advertised NEIGHBOR_CAP_6LORH in its last EB,
+   FALSE otherwise.
+*/
+bool neighbors_supports6LoRH(open_addr_t* neighbor) {
+   return hasCapability(neighbor,NEIGHBOR_CAP_6LORH);
+}
+
+/**
+\brief Indicate the capabilities advertised in an EB.
+
+\param[in] l2_src       The EUI64 of the sender of the EB.
+\param[in] capabilities The NEIGHBOR_CAP_* it advertises, 0 for an EB without
+   Capabilities IE.
+*/
+void neighbors_indicateCapabilities(open_addr_t* l2_src, uint8_t capabilities) {
+   uint8_t i;
+   
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      if (isThisRowMatching(l2_src,i)) {
+         if (neighbors_vars.capabilities[i]!=capabilities) {
+            neighbors_vars.capabilities[i] = capabilities;
+            neighbors_vars.headerVersion++;
+         }
+         break;
+      }
+   }
+}
+
+//===== link-layer security
+
+/**
+\brief Check the frame counter of a secured frame from a neighbor, and record it.
+
+Frames from a neighbor may arrive out of order, e.g. a broadcast queued behind
+unicast frames, so any of the last NEIGHBOR_RXFRAMEWINDOW frame counters is
+accepted, once.
+
+Frames from a mote which isn't my neighbor yet are accepted, and their frame
+counter is not recorded, as there is no row to record it in.
+
+\param[in] l2_src       The EUI64 of the sender.
+\param[in] frameCounter The frame counter of the frame, once authenticated.
+
+\returns FALSE if the frame is a replay, TRUE otherwise.
+*/
+bool neighbors_updateRxFrameCounter(open_addr_t* l2_src, uint32_t frameCounter) {
+   uint8_t  i;
+   uint32_t diff;
+   
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      if (isThisRowMatching(l2_src,i)) {
+         if (neighbors_vars.rxFrameWindow[i]==0) {
+            // first secured frame from this neighbor
+            neighbors_vars.rxFrameCounter[i] = frameCounter;
+            neighbors_vars.rxFrameWindow[i]  = 1;
+            return TRUE;
+         }
+         if (frameCounter>neighbors_vars.rxFrameCounter[i]) {
+            // slide the window
+            diff = frameCounter-neighbors_vars.rxFrameCounter[i];
+            if (diff<NEIGHBOR_RXFRAMEWINDOW) {
+               neighbors_vars.rxFrameWindow[i] = (neighbors_vars.rxFrameWindow[i] << diff) | 1;
+            } else {
+               neighbors_vars.rxFrameWindow[i] = 1;
+            }
+            neighbors_vars.rxFrameCounter[i] = frameCounter;
+            return TRUE;
+         }
+         diff = neighbors_vars.rxFrameCounter[i]-frameCounter;
+         if (
+               diff>=NEIGHBOR_RXFRAMEWINDOW ||
+               (neighbors_vars.rxFrameWindow[i] & ((uint32_t)1 << diff))!=0
+            ) {
+            return FALSE;
+         }
+         neighbors_vars.rxFrameWindow[i] |= (uint32_t)1 << diff;
+         return TRUE;
+      }
+   }
+   return TRUE;
+}
+
+//===== transmit power control
+
+/**
+\brief Get the power to transmit a frame to a neighbor at.
+
+\param[in] neighbor The next hop of the frame.
+
+\returns The power, in dBm. TX_POWER for broadcast frames and for motes which
+   aren't my neighbor yet.
+*/
+int8_t neighbors_getTxPower(open_addr_t* neighbor) {
+   uint8_t i;
+   
+   if (packetfunctions_isBroadcastMulticast(neighbor)==TRUE) {
+      return TX_POWER;
+   }
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      if (isThisRowMatching(neighbor,i)) {
+         return neighbors_vars.txPower[i];
+      }
+   }
+   return TX_POWER;
+}
+
+//===== retries
+
+/**
+\brief Get the number of transmission attempts of a unicast frame to a neighbor.
+
+Just enough attempts for the frame to be lost with at most the probability
+accepted for its traffic class, given the neighbor's ETX. Good links thus
+spend fewer attempts, and marginal ones more, up to NEIGHBOR_RETRIES_MAX.
+
+In shared cells, failures are mostly collisions with other contenders, which
+retrying only makes worse, so the budget is capped lower, the more so the less
+urgent the frame.
+
+\param[in] neighbor     The next hop of the frame.
+\param[in] trafficClass The TRAFFIC_CLASS_* of the frame.
+\param[in] shared       Whether the frame is sent in a shared cell.
+
+\returns The number of attempts, TXRETRIES while the ETX is unknown.
+*/
+uint8_t neighbors_getRetryBudget(open_addr_t* neighbor,
+                                 uint8_t      trafficClass,
+                                 bool         shared) {
+   uint8_t  i;
+   uint8_t  maxAttempts;
+   uint8_t  attempts;
+   uint32_t targetLoss;
+   uint32_t failure;
+   uint32_t loss;
+   
+   switch (trafficClass) {
+      case TRAFFIC_CLASS_CONTROL:
+         targetLoss  = NEIGHBOR_RETRIES_LOSS_CONTROL;
+         maxAttempts = NEIGHBOR_RETRIES_SHARED_CONTROL;
+         break;
+      case TRAFFIC_CLASS_ALARM:
+         targetLoss  = NEIGHBOR_RETRIES_LOSS_ALARM;
+         maxAttempts = NEIGHBOR_RETRIES_SHARED_ALARM;
+         break;
+      case TRAFFIC_CLASS_NORMAL:
+         targetLoss  = NEIGHBOR_RETRIES_LOSS_NORMAL;
+         maxAttempts = NEIGHBOR_RETRIES_SHARED_NORMAL;
+         break;
+      default:
+         targetLoss  = NEIGHBOR_RETRIES_LOSS_BULK;
+         maxAttempts = NEIGHBOR_RETRIES_SHARED_BULK;
+         break;
+   }
+   if (shared==FALSE) {
+      maxAttempts = NEIGHBOR_RETRIES_MAX;
+   }
+   
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      if (isThisRowMatching(neighbor,i)) {
+         break;
+      }
+   }
+   if (
+         i==MAXNUMNEIGHBORS                                             ||
+         neighbors_vars.neighbors[i].numTx<NEIGHBOR_RETRIES_MINSAMPLES  ||
+         neighbors_vars.neighbors[i].numTxACK==0
+      ) {
+      return TXRETRIES<maxAttempts ? TXRETRIES : maxAttempts;
+   }
+   
+   // probability an attempt fails, out of 65536
+   failure  = neighbors_vars.neighbors[i].numTx-neighbors_vars.neighbors[i].numTxACK;
+   failure  = (failure<<16)/neighbors_vars.neighbors[i].numTx;
+   
+   // add attempts until the frame is lost with at most targetLoss
+   attempts = 1;
+   loss     = failure;
+   while (loss>targetLoss && attempts<maxAttempts) {
+      loss  = (loss*failure)>>16;
+      attempts++;
+   }
+   if (attempts<NEIGHBOR_RETRIES_MIN && NEIGHBOR_RETRIES_MIN<=maxAttempts) {
+      attempts = NEIGHBOR_RETRIES_MIN;
+   }
+   return attempts;
+}
+
 //===== managing routing info
 
 /**
@@ -504,6 +1055,8 @@ void neighbors_updateMyDAGrankAndNeighborPreference() {
    // if I'm a DAGroot, my DAGrank is always 0
    if ((idmanager_getIsDAGroot())==TRUE) {
       neighbors_vars.myDAGrank=0;
+      // I'm also the origin of the short addresses
+      assignRootShortAddress();
       return;
    }
    
@@ -546,6 +1099,22 @@ void neighbors_updateMyDAGrankAndNeighborPreference() {
       neighbors_vars.neighbors[prefParentIdx].stableNeighbor         = TRUE;
       neighbors_vars.neighbors[prefParentIdx].switchStabilityCounter = 0;
    }
+   
+   // my short address is only valid while the mote which assigned it is my
+   // preferred parent
+   if (idmanager_getMyShortAddress()->type==ADDR_16B) {
+      for (i=0;i<MAXNUMNEIGHBORS;i++) {
+         if (
+               neighbors_vars.shortAddr[i].state==SHORTADDR_PARENT &&
+               neighbors_vars.neighbors[i].parentPreference==MAXPREFERENCE
+            ) {
+            break;
+         }
+      }
+      if (i==MAXNUMNEIGHBORS) {
+         dropShortAddress();
+      }
+   }
 }
 
 //===== maintenance
@@ -553,11 +1122,17 @@ void neighbors_updateMyDAGrankAndNeighborPreference() {
 void  neighbors_removeOld() {
    uint8_t    i;
    uint16_t   timeSinceHeard;
+   uint16_t   timeout;
    
    for (i=0;i<MAXNUMNEIGHBORS;i++) {
       if (neighbors_vars.neighbors[i].used==1) {
          timeSinceHeard = ieee154e_asnDiff(&neighbors_vars.neighbors[i].asn);
-         if (timeSinceHeard>DESYNCTIMEOUT) {
+         timeout        = DESYNCTIMEOUT;
+         // keep my time source while the MAC tries to resynchronize to it
+         if (neighbors_vars.neighbors[i].parentPreference==MAXPREFERENCE) {
+            timeout    += WARMRESYNCTIMEOUT;
+         }
+         if (timeSinceHeard>timeout) {
             removeNeighbor(i);
          }
       }
@@ -572,15 +1147,24 @@ void  neighbors_removeOld() {
 debugPrint_* functions are used by the openserial module to continuously print
 status information about several modules in the OpenWSN stack.
 
+Prints the next row which changed since it was last printed.
+
 \returns TRUE if this function printed something, FALSE otherwise.
 */
 bool debugPrint_neighbors() {
    debugNeighborEntry_t temp;
-   neighbors_vars.debugRow=(neighbors_vars.debugRow+1)%MAXNUMNEIGHBORS;
-   temp.row=neighbors_vars.debugRow;
-   temp.neighborEntry=neighbors_vars.neighbors[neighbors_vars.debugRow];
-   openserial_printStatus(STATUS_NEIGHBORS,(uint8_t*)&temp,sizeof(debugNeighborEntry_t));
-   return TRUE;
+   uint8_t              i;
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      neighbors_vars.debugRow=(neighbors_vars.debugRow+1)%MAXNUMNEIGHBORS;
+      temp.row=neighbors_vars.debugRow;
+      temp.neighborEntry=neighbors_vars.neighbors[neighbors_vars.debugRow];
+      if (openserial_printStatusDelta(STATUS_NEIGHBORS,
+                                      &neighbors_vars.debugRowSignature[neighbors_vars.debugRow],
+                                      (uint8_t*)&temp,sizeof(debugNeighborEntry_t))==TRUE) {
+         return TRUE;
+      }
+   }
+   return FALSE;
 }
 
 //=========================== private =========================================
@@ -618,6 +1202,8 @@ void registerNewNeighbor(open_addr_t* address,
             neighbors_vars.neighbors[i].numTx                  = 0;
             neighbors_vars.neighbors[i].numTxACK               = 0;
             memcpy(&neighbors_vars.neighbors[i].asn,asnTimestamp,sizeof(asn_t));
+            neighbors_vars.txPower[i]                          = TX_POWER;
+            neighbors_vars.txPowerRun[i]                       = 0;
             //update jp
             if (joinPrioPresent==TRUE){
                neighbors_vars.neighbors[i].joinPrio=joinPrio;
@@ -673,6 +1259,119 @@ void removeNeighbor(uint8_t neighborIndex) {
    neighbors_vars.neighbors[neighborIndex].asn.bytes0and1            = 0;
    neighbors_vars.neighbors[neighborIndex].asn.bytes2and3            = 0;
    neighbors_vars.neighbors[neighborIndex].asn.byte4                 = 0;
+   neighbors_vars.shortAddr[neighborIndex].state                     = SHORTADDR_NONE;
+   neighbors_vars.capabilities[neighborIndex]                        = 0;
+   neighbors_vars.rxFrameCounter[neighborIndex]                      = 0;
+   neighbors_vars.rxFrameWindow[neighborIndex]                       = 0;
+   neighbors_vars.txPower[neighborIndex]                             = TX_POWER;
+   neighbors_vars.txPowerRun[neighborIndex]                          = 0;
+   neighbors_vars.headerVersion++;
+}
+
+void dropShortAddress() {
+   uint8_t i;
+   
+   INTERRUPT_DECLARATION();
+   DISABLE_INTERRUPTS();
+   
+   // the short addresses of my children were carved out of mine
+   idmanager_setMyShortAddress(NULL);
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      neighbors_vars.shortAddr[i].state = SHORTADDR_NONE;
+   }
+   neighbors_vars.headerVersion++;
+   
+   ENABLE_INTERRUPTS();
+}
+
+void assignRootShortAddress() {
+   open_addr_t rootAddr;
+   
+   if (
+         idmanager_getMyShortAddress()->type==ADDR_16B &&
+         readShortAddress(idmanager_getMyShortAddress())==SHORTADDR_ROOT
+      ) {
+      return;
+   }
+   dropShortAddress();
+   writeShortAddress(&rootAddr,SHORTADDR_ROOT);
+   idmanager_setMyShortAddress(&rootAddr);
+   neighbors_vars.shortAddrDepth = 0;
+}
+
+bool hasCapability(open_addr_t* neighbor, uint8_t capability) {
+   uint8_t i;
+   bool    returnVal;
+   
+   INTERRUPT_DECLARATION();
+   DISABLE_INTERRUPTS();
+   
+   returnVal = FALSE;
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      if (isThisRowMatching(neighbor,i)) {
+         returnVal = (neighbors_vars.capabilities[i] & capability)!=0;
+         break;
+      }
+   }
+   
+   ENABLE_INTERRUPTS();
+   return returnVal;
+}
+
+/**
+\brief Adapt the power to transmit to a neighbor at, after sending it a frame.
+
+Each failed attempt raises the power by NEIGHBOR_TXPOWER_STEPUP, so a degrading
+link recovers within a few frames. The power only decreases, by the smaller
+NEIGHBOR_TXPOWER_STEPDOWN, after NEIGHBOR_TXPOWER_SUCCESSRUN frames in a row
+were ACK'ed on the first attempt, and only while the neighbor would still hear
+me NEIGHBOR_TXPOWER_MARGIN above its sensitivity.
+
+The path loss is estimated from the RSSI of the last frame received from the
+neighbor, assumed sent at TX_POWER. Its frames sent at a lower power only make
+this estimate conservative.
+
+\param[in] row               The row of the neighbor.
+\param[in] numTxAttempts     Number of transmission attempts of the frame.
+\param[in] was_finally_acked TRUE iff the last attempt was ACK'ed.
+*/
+void updateTxPower(uint8_t row, uint8_t numTxAttempts, bool was_finally_acked) {
+   int16_t  power;
+   int16_t  margin;
+   uint8_t  numFailed;
+   
+   power     = neighbors_vars.txPower[row];
+   numFailed = numTxAttempts;
+   if (was_finally_acked==TRUE && numFailed>0) {
+      numFailed--;
+   }
+   
+   if (numFailed>0) {
+      // back off quickly
+      neighbors_vars.txPowerRun[row] = 0;
+      power += (int16_t)numFailed*NEIGHBOR_TXPOWER_STEPUP;
+      if (power>TX_POWER) {
+         power = TX_POWER;
+      }
+   } else {
+      // decrease slowly, while the margin allows it
+      if (neighbors_vars.txPowerRun[row]<NEIGHBOR_TXPOWER_SUCCESSRUN) {
+         neighbors_vars.txPowerRun[row]++;
+      }
+      margin = (int16_t)neighbors_vars.neighbors[row].rssi-TX_POWER
+               +power-NEIGHBOR_TXPOWER_STEPDOWN
+               -NEIGHBOR_TXPOWER_SENSITIVITY;
+      if (
+            neighbors_vars.txPowerRun[row]>=NEIGHBOR_TXPOWER_SUCCESSRUN &&
+            margin>=NEIGHBOR_TXPOWER_MARGIN                             &&
+            power-NEIGHBOR_TXPOWER_STEPDOWN>=NEIGHBOR_TXPOWER_MIN
+         ) {
+         neighbors_vars.txPowerRun[row] = 0;
+         power -= NEIGHBOR_TXPOWER_STEPDOWN;
+      }
+   }
+   
+   neighbors_vars.txPower[row] = (int8_t)power;
 }
 
 //=========================== helpers =========================================
@@ -689,3 +1388,76 @@ bool isThisRowMatching(open_addr_t* address, uint8_t rowNumber) {
          return FALSE;
    }
 }
+
+/**
+\brief Number of short addresses in the block assigned to a child of a mote
+   at some depth, the child's own included.
+
+Blocks are sized so the tree of SHORTADDR_MAXDEPTH levels, with up to
+SHORTADDR_MAXCHILDREN children per mote, never runs out of addresses.
+
+\returns The size of the block, 0 if a mote at that depth can't have children.
+*/
+uint16_t shortAddrBlockSize(uint8_t depth) {
+   uint16_t size;
+   uint8_t  d;
+   
+   size = 0;
+   for (d=depth+1;d<SHORTADDR_MAXDEPTH;d++) {
+      size = size*SHORTADDR_MAXCHILDREN+1;
+   }
+   return size;
+}
+
+/**
+\brief Find the first block of my block of short addresses no child uses.
+
+The block of a child is freed when its row is removed, so blocks are reused
+rather than running out as children come and go.
+
+\param[out] addr The first short address of the free block.
+
+\returns TRUE if a block is free, FALSE if I can't have more children.
+*/
+bool shortAddrFreeBlock(uint16_t* addr) {
+   uint16_t blockSize;
+   uint8_t  block;
+   uint8_t  i;
+   bool     used;
+   
+   blockSize = shortAddrBlockSize(neighbors_vars.shortAddrDepth);
+   if (blockSize==0) {
+      return FALSE;
+   }
+   
+   for (block=0;block<SHORTADDR_MAXCHILDREN;block++) {
+      *addr = readShortAddress(idmanager_getMyShortAddress())+1+block*blockSize;
+      used  = FALSE;
+      for (i=0;i<MAXNUMNEIGHBORS;i++) {
+         if (
+               (
+                  neighbors_vars.shortAddr[i].state==SHORTADDR_OFFERED ||
+                  neighbors_vars.shortAddr[i].state==SHORTADDR_CHILD
+               ) &&
+               neighbors_vars.shortAddr[i].addr==*addr
+            ) {
+            used = TRUE;
+            break;
+         }
+      }
+      if (used==FALSE) {
+         return TRUE;
+      }
+   }
+   return FALSE;
+}
+
+uint16_t readShortAddress(open_addr_t* addr_16b) {
+   return ((uint16_t)addr_16b->addr_16b[0]<<8) | addr_16b->addr_16b[1];
+}
+
+void writeShortAddress(open_addr_t* addr_16b, uint16_t addr) {
+   addr_16b->type        = ADDR_16B;
+   addr_16b->addr_16b[0] = (uint8_t)(addr>>8);
+   addr_16b->addr_16b[1] = (uint8_t)(addr & 0xff);
+}
@@ -23,6 +23,45 @@
 #define DEFAULTDAGRANK            MAXDAGRANK
 #define MINHOPRANKINCREASE        256  //default value in RPL and Minimal 6TiSCH draft
 
+#define SHORTADDR_ROOT            0x0000 // short address of the DAG root
+#define SHORTADDR_MAXCHILDREN     6      // number of children a mote assigns a short address to
+#define SHORTADDR_MAXDEPTH        6      // number of levels of the tree of short addresses
+
+// capabilities a neighbor advertises in its EBs
+#define NEIGHBOR_CAP_COMPACT_HEADER  0x01   // understands the IEEE802.15.4-2015 field elision
+#define NEIGHBOR_CAP_6LORH           0x02   // understands the 6LoWPAN routing headers of RFC8138
+#define NEIGHBOR_MY_CAPABILITIES     (NEIGHBOR_CAP_COMPACT_HEADER | NEIGHBOR_CAP_6LORH)
+
+#define NEIGHBOR_RXFRAMEWINDOW    32     // link-layer frame counters accepted below the highest one
+
+// transmit power control, per neighbor
+#define NEIGHBOR_TXPOWER_MIN         -24 // dBm, lowest power to transmit to a neighbor at
+#define NEIGHBOR_TXPOWER_STEPDOWN      1 // dB, decrease after NEIGHBOR_TXPOWER_SUCCESSRUN ACKs
+#define NEIGHBOR_TXPOWER_STEPUP        3 // dB, increase for each failed transmission attempt
+#define NEIGHBOR_TXPOWER_SUCCESSRUN    8 // frames in a row ACK'ed on the first attempt before decreasing
+#define NEIGHBOR_TXPOWER_SENSITIVITY -94 // dBm, receiver sensitivity
+#define NEIGHBOR_TXPOWER_MARGIN       10 // dB, margin kept above the sensitivity when decreasing
+
+// budget of transmission attempts of a unicast frame
+#define NEIGHBOR_RETRIES_MINSAMPLES       8 // attempts to a neighbor before trusting its ETX, TXRETRIES until then
+#define NEIGHBOR_RETRIES_MIN              2 // attempts, at least
+#define NEIGHBOR_RETRIES_MAX              8 // attempts, at most, in dedicated cells
+#define NEIGHBOR_RETRIES_SHARED_CONTROL   4 // attempts, at most, in shared cells
+#define NEIGHBOR_RETRIES_SHARED_ALARM     4
+#define NEIGHBOR_RETRIES_SHARED_NORMAL    3
+#define NEIGHBOR_RETRIES_SHARED_BULK      1
+#define NEIGHBOR_RETRIES_LOSS_CONTROL    66 // out of 65536, loss accepted after all attempts (0.1%)
+#define NEIGHBOR_RETRIES_LOSS_ALARM      66 // (0.1%)
+#define NEIGHBOR_RETRIES_LOSS_NORMAL    655 // (1%)
+#define NEIGHBOR_RETRIES_LOSS_BULK     6554 // (10%)
+
+enum {
+   SHORTADDR_NONE                 = 0,   // no short address used with this neighbor
+   SHORTADDR_OFFERED              = 1,   // I assigned it a short address, it hasn't used it yet
+   SHORTADDR_CHILD                = 2,   // it uses the short address I assigned it
+   SHORTADDR_PARENT               = 3,   // it assigned me my short address
+};
+
 //=========================== typedef =========================================
 
 BEGIN_PACK
@@ -43,6 +82,11 @@ typedef struct {
 } neighborRow_t;
 END_PACK
 
+typedef struct {
+   uint16_t         addr;             // the neighbor's short address
+   uint8_t          state;            // SHORTADDR_NONE, SHORTADDR_OFFERED, ...
+} neighborShortAddr_t;
+
 BEGIN_PACK
 typedef struct {
    uint8_t         row;
@@ -66,7 +110,16 @@ typedef struct {
    neighborRow_t        neighbors[MAXNUMNEIGHBORS];
    dagrank_t            myDAGrank;
    uint8_t              debugRow;
+   uint16_t             debugRowSignature[MAXNUMNEIGHBORS]; // of the last status record sent, per row
    icmpv6rpl_dio_ht*    dio; //keep it global to be able to debug correctly.
+   neighborShortAddr_t  shortAddr[MAXNUMNEIGHBORS];         // per row, apart from neighbors not to change the status layout
+   uint8_t              shortAddrDepth;                     // my depth in the tree of short addresses
+   uint8_t              capabilities[MAXNUMNEIGHBORS];      // per row, NEIGHBOR_CAP_* advertised in the neighbor's EBs
+   uint8_t              headerVersion;                      // incremented each time the header of frames to a neighbor changes
+   uint32_t             rxFrameCounter[MAXNUMNEIGHBORS];    // per row, highest link-layer frame counter received
+   uint32_t             rxFrameWindow[MAXNUMNEIGHBORS];     // per row, bit i set if rxFrameCounter-i was received
+   int8_t               txPower[MAXNUMNEIGHBORS];           // per row, dBm, power unicast frames are sent at
+   uint8_t              txPowerRun[MAXNUMNEIGHBORS];        // per row, frames ACK'ed on the first attempt in a row
 } neighbors_vars_t;
 
 //=========================== prototypes ======================================
@@ -78,6 +131,12 @@ dagrank_t     neighbors_getMyDAGrank(void);
 uint8_t       neighbors_getNumNeighbors(void);
 bool          neighbors_getPreferredParentEui64(open_addr_t* addressToWrite);
 open_addr_t*  neighbors_getKANeighbor(uint16_t kaPeriod);
+bool          neighbors_getNeighborInfo(
+   uint8_t              index,
+   open_addr_t*         address,
+   dagrank_t*           DAGrank,
+   uint8_t*             parentPreference
+);
 
 // interrogators
 bool          neighbors_isStableNeighbor(open_addr_t* address);
@@ -100,9 +159,45 @@ void          neighbors_indicateTx(
    asn_t*               asnTimestamp
 );
 void          neighbors_indicateRxDIO(OpenQueueEntry_t* msg);
+void          neighbors_restoreNeighbor(open_addr_t* address, dagrank_t DAGrank);
 
 // get addresses
 void          neighbors_getNeighbor(open_addr_t* address,uint8_t addr_type,uint8_t index);
+// short addresses
+bool          neighbors_getShortAddress(open_addr_t* neighbor, open_addr_t* addr_16b);
+bool          neighbors_getShortAddressOffer(
+   open_addr_t*         neighbor,
+   uint16_t*            assigned,
+   uint8_t*             depth
+);
+uint8_t       neighbors_getHeaderVersion(void);
+bool          neighbors_indicateRxShortAddress(open_addr_t* addr_16b, open_addr_t* addr_64b);
+void          neighbors_indicateRxLongAddress(open_addr_t* l2_src);
+void          neighbors_indicateShortAddressOffer(
+   open_addr_t*         l2_src,
+   uint16_t             assigned,
+   uint16_t             assignerAddr,
+   uint8_t              depth
+);
+void          neighbors_indicateShortAddressAdvertised(
+   open_addr_t*         l2_src,
+   bool                 present,
+   uint16_t             addr
+);
+// capabilities
+bool          neighbors_supportsCompactHeader(open_addr_t* neighbor);
+bool          neighbors_supports6LoRH(open_addr_t* neighbor);
+void          neighbors_indicateCapabilities(open_addr_t* l2_src, uint8_t capabilities);
+// link-layer security
+bool          neighbors_updateRxFrameCounter(open_addr_t* l2_src, uint32_t frameCounter);
+// transmit power control
+int8_t        neighbors_getTxPower(open_addr_t* neighbor);
+// retries
+uint8_t       neighbors_getRetryBudget(
+   open_addr_t*         neighbor,
+   uint8_t              trafficClass,
+   bool                 shared
+);
 // managing routing info
 void          neighbors_updateMyDAGrankAndNeighborPreference(void);
 // maintenance
@@ -382,6 +382,217 @@ port_INLINE uint8_t processIE_prependSheduleIE(
    return len;
 }
 
+/**
+\brief Prepend the Short Address IE, if I have a short address.
+
+\returns The number of bytes prepended, 0 if I don't have a short address.
+*/
+port_INLINE uint8_t processIE_prependShortAddressIE(OpenQueueEntry_t* pkt){
+   mlme_IE_ht   mlme_subHeader;
+   open_addr_t* myShortAddr;
+   
+   myShortAddr = idmanager_getMyShortAddress();
+   if (myShortAddr->type!=ADDR_16B) {
+      return 0;
+   }
+   
+   //=== short address IE
+   
+   packetfunctions_reserveHeaderSize(pkt,sizeof(shortAddr_IE_ht));
+   pkt->payload[0] = myShortAddr->addr_16b[1];
+   pkt->payload[1] = myShortAddr->addr_16b[0];
+   
+   //=== MLME IE
+   
+   packetfunctions_reserveHeaderSize(pkt,sizeof(mlme_IE_ht));
+   mlme_subHeader.length_subID_type = 
+      sizeof(shortAddr_IE_ht) << IEEE802154E_DESC_LEN_SHORT_MLME_IE_SHIFT;
+   mlme_subHeader.length_subID_type |= 
+      (IEEE802154E_MLME_SHORT_ADDRESS_IE_SUBID << IEEE802154E_MLME_SHORT_ADDRESS_IE_SUBID_SHIFT)|
+      IEEE802154E_DESC_TYPE_SHORT;
+   pkt->payload[0] = mlme_subHeader.length_subID_type & 0xFF;
+   pkt->payload[1] = (mlme_subHeader.length_subID_type >> 8) & 0xFF;
+   
+   return sizeof(mlme_IE_ht)+sizeof(shortAddr_IE_ht);
+}
+
+/**
+\brief Prepend the Capabilities IE.
+
+\returns The number of bytes prepended.
+*/
+port_INLINE uint8_t processIE_prependCapabilitiesIE(OpenQueueEntry_t* pkt){
+   mlme_IE_ht   mlme_subHeader;
+   
+   //=== capabilities IE
+   
+   packetfunctions_reserveHeaderSize(pkt,sizeof(capabilities_IE_ht));
+   pkt->payload[0] = NEIGHBOR_MY_CAPABILITIES;
+   
+   //=== MLME IE
+   
+   packetfunctions_reserveHeaderSize(pkt,sizeof(mlme_IE_ht));
+   mlme_subHeader.length_subID_type = 
+      sizeof(capabilities_IE_ht) << IEEE802154E_DESC_LEN_SHORT_MLME_IE_SHIFT;
+   mlme_subHeader.length_subID_type |= 
+      (IEEE802154E_MLME_CAPABILITIES_IE_SUBID << IEEE802154E_MLME_CAPABILITIES_IE_SUBID_SHIFT)|
+      IEEE802154E_DESC_TYPE_SHORT;
+   pkt->payload[0] = mlme_subHeader.length_subID_type & 0xFF;
+   pkt->payload[1] = (mlme_subHeader.length_subID_type >> 8) & 0xFF;
+   
+   return sizeof(mlme_IE_ht)+sizeof(capabilities_IE_ht);
+}
+
+//===== parse IEs
+
+/**
+\brief Parse the IE list at the start of the payload of a received packet.
+
+The IE descriptor and the descriptors of its MLME sub-IEs are decoded in a
+single pass. The position and length of the content of each (sub-)IE are
+recorded in pkt->l2_IEs, so consumers read the content in place without
+re-walking the list. The only header IEs recognized are the TimeCorrection IE
+and the Short Address Assignment IE, which run until the end of the ACK they
+are found in; their element IDs do not collide with any MLME sub-IE ID.
+
+\returns TRUE if the IE list was recognized, FALSE otherwise.
+*/
+bool processIE_parseIEs(OpenQueueEntry_t* pkt) {
+   uint8_t          ptr;
+   uint8_t          gr_elem_id;
+   uint8_t          subid;
+   uint16_t         temp_16b;
+   uint16_t         len;
+   uint16_t         sublen;
+   ie_descriptor_t* ie;
+   
+   pkt->l2_IEListLength = 0;
+   pkt->l2_numIEs       = 0;
+   
+   if (pkt->length<2) {
+      return FALSE;
+   }
+   
+   //===== header or payload IE header
+   
+   temp_16b = pkt->payload[0] + (pkt->payload[1] << 8);
+   ptr      = 2;
+   
+   if ((temp_16b & IEEE802154E_DESC_TYPE_PAYLOAD_IE) == IEEE802154E_DESC_TYPE_PAYLOAD_IE){
+      // payload IE
+      
+      len          = (temp_16b & IEEE802154E_DESC_LEN_PAYLOAD_IE_MASK)>>IEEE802154E_DESC_LEN_PAYLOAD_IE_SHIFT;
+      gr_elem_id   = (temp_16b & IEEE802154E_DESC_GROUPID_PAYLOAD_IE_MASK)>>IEEE802154E_DESC_GROUPID_PAYLOAD_IE_SHIFT;
+   } else {
+      // header IE
+      
+      len          = (temp_16b & IEEE802154E_DESC_LEN_HEADER_IE_MASK)>>IEEE802154E_DESC_LEN_HEADER_IE_SHIFT;
+      gr_elem_id   = (temp_16b & IEEE802154E_DESC_ELEMENTID_HEADER_IE_MASK)>>IEEE802154E_DESC_ELEMENTID_HEADER_IE_SHIFT;
+   }
+   
+   if (ptr+len>pkt->length) {
+      // log the error
+      openserial_printError(
+         COMPONENT_IEEE802154E,
+         ERR_HEADER_TOO_LONG,
+         (errorparameter_t)(ptr+len),
+         (errorparameter_t)1
+      );
+      return FALSE;
+   }
+   
+   //===== sub-elements
+   
+   switch (gr_elem_id) {
+      
+      case IEEE802154E_MLME_IE_GROUPID:
+         // MLME IE
+         
+         while (len>0) {
+            if (len<2) {
+               return FALSE;
+            }
+            
+            // read sub IE header
+            temp_16b    = pkt->payload[ptr] + (pkt->payload[ptr+1] << 8);
+            ptr        += 2;
+            len        -= 2;
+            
+            if ((temp_16b & IEEE802154E_DESC_TYPE_LONG) == IEEE802154E_DESC_TYPE_LONG){
+               // long sub-IE
+               
+               sublen   = (temp_16b & IEEE802154E_DESC_LEN_LONG_MLME_IE_MASK)>>IEEE802154E_DESC_LEN_LONG_MLME_IE_SHIFT;
+               subid    = (temp_16b & IEEE802154E_DESC_SUBID_LONG_MLME_IE_MASK)>>IEEE802154E_DESC_SUBID_LONG_MLME_IE_SHIFT;
+            } else {
+               // short sub-IE
+               
+               sublen   = (temp_16b & IEEE802154E_DESC_LEN_SHORT_MLME_IE_MASK)>>IEEE802154E_DESC_LEN_SHORT_MLME_IE_SHIFT;
+               subid    = (temp_16b & IEEE802154E_DESC_SUBID_SHORT_MLME_IE_MASK)>>IEEE802154E_DESC_SUBID_SHORT_MLME_IE_SHIFT;
+            }
+            
+            if (sublen>len || pkt->l2_numIEs==MAXNUMIES) {
+               return FALSE;
+            }
+            
+            // record the sub-IE
+            ie          = &pkt->l2_IEs[pkt->l2_numIEs++];
+            ie->id      = subid;
+            ie->offset  = ptr;
+            ie->length  = sublen;
+            
+            ptr        += sublen;
+            len        -= sublen;
+         }
+         break;
+      
+      case IEEE802154E_ACK_SHORT_ADDRESS_ELEMENTID:
+      case IEEE802154E_ACK_NACK_TIMECORRECTION_ELEMENTID:
+         // header IEs, one after the other
+         
+         while (TRUE) {
+            ie          = &pkt->l2_IEs[pkt->l2_numIEs++];
+            ie->id      = gr_elem_id;
+            ie->offset  = ptr;
+            ie->length  = len;
+            
+            ptr        += len;
+            
+            if (ptr==pkt->length) {
+               break;
+            }
+            if (ptr+2>pkt->length || pkt->l2_numIEs==MAXNUMIES) {
+               return FALSE;
+            }
+            
+            temp_16b    = pkt->payload[ptr] + (pkt->payload[ptr+1] << 8);
+            ptr        += 2;
+            
+            if ((temp_16b & IEEE802154E_DESC_TYPE_PAYLOAD_IE) == IEEE802154E_DESC_TYPE_PAYLOAD_IE) {
+               return FALSE;
+            }
+            len         = (temp_16b & IEEE802154E_DESC_LEN_HEADER_IE_MASK)>>IEEE802154E_DESC_LEN_HEADER_IE_SHIFT;
+            gr_elem_id  = (temp_16b & IEEE802154E_DESC_ELEMENTID_HEADER_IE_MASK)>>IEEE802154E_DESC_ELEMENTID_HEADER_IE_SHIFT;
+            if (
+                  ptr+len>pkt->length ||
+                  (
+                     gr_elem_id!=IEEE802154E_ACK_SHORT_ADDRESS_ELEMENTID &&
+                     gr_elem_id!=IEEE802154E_ACK_NACK_TIMECORRECTION_ELEMENTID
+                  )
+               ) {
+               return FALSE;
+            }
+         }
+         break;
+      
+      default:
+         // no header or not recognized
+         return FALSE;
+   }
+   
+   pkt->l2_IEListLength = ptr;
+   return TRUE;
+}
+
 //===== retrieve IEs
 
 port_INLINE void processIE_retrieveSlotframeLinkIE(
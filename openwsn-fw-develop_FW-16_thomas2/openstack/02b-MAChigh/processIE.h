@@ -58,6 +58,17 @@ typedef struct {
    int16_t        timesync_info;
 } timecorrection_IE_ht;
 
+/**
+\brief Short Address Assignment IE (not standard)
+
+Carried in the ACKs a parent sends to a child, until the child uses it.
+*/
+typedef struct {
+   uint16_t       assigned;          // short address assigned to the child
+   uint16_t       assignerAddr;      // short address of the parent
+   uint8_t        depth;             // depth of the child in the tree of short addresses
+} shortAddrAssignment_IE_ht;
+
 //======= payload IEs
 
 /**
@@ -90,6 +101,24 @@ typedef struct {
    uint8_t         numlinks;
 } slotframeLink_IE_ht;
 
+/**
+\brief Short Address IE (not standard)
+
+Carried in EBs, advertises the short address of the sender.
+*/
+typedef struct {
+   uint16_t        addr;
+} shortAddr_IE_ht;
+
+/**
+\brief Capabilities IE (not standard)
+
+Carried in EBs, advertises the NEIGHBOR_CAP_* the sender understands.
+*/
+typedef struct {
+   uint8_t         capabilities;
+} capabilities_IE_ht;
+
 /**
 \brief 6top Opcode IE
 
@@ -142,6 +171,12 @@ uint8_t          processIE_prependSyncIE(
 uint8_t          processIE_prependSlotframeLinkIE(
    OpenQueueEntry_t*    pkt
 );
+uint8_t          processIE_prependShortAddressIE(
+   OpenQueueEntry_t*    pkt
+);
+uint8_t          processIE_prependCapabilitiesIE(
+   OpenQueueEntry_t*    pkt
+);
 uint8_t          processIE_prependOpcodeIE(
    OpenQueueEntry_t*    pkt,
    uint8_t              uResCommandID
@@ -159,6 +194,12 @@ uint8_t          processIE_prependSheduleIE(
    cellInfo_ht*         cellList
 );
 
+//===== parse IEs
+
+bool             processIE_parseIEs(
+   OpenQueueEntry_t*    pkt
+);
+
 //===== retrieve IEs
 
 void             processIE_retrieveSlotframeLinkIE(
@@ -66,17 +66,6 @@ void schedule_init() {
       );
       running_slotOffset++;
    }
-   
-   // serial RX slot(s)
-   memset(&temp_neighbor,0,sizeof(temp_neighbor));
-   schedule_addActiveSlot(
-      running_slotOffset,         // slot offset
-      CELLTYPE_SERIALRX,          // type of slot
-      FALSE,                      // shared?
-      0,                          // channel offset
-      &temp_neighbor              // neighbor
-   );
-   running_slotOffset++;
 }
 
 /**
@@ -85,49 +74,46 @@ void schedule_init() {
 debugPrint_* functions are used by the openserial module to continuously print
 status information about several modules in the OpenWSN stack.
 
+Prints the next row which changed since it was last printed.
+
 \returns TRUE if this function printed something, FALSE otherwise.
 */
 bool debugPrint_schedule() {
    debugScheduleEntry_t temp;
+   scheduleEntry_t*     entry;
+   uint8_t              i;
    
-   // increment the row just printed
-   schedule_vars.debugPrintRow         = (schedule_vars.debugPrintRow+1)%MAXACTIVESLOTS;
-   
-   // gather status data
-   temp.row                            = schedule_vars.debugPrintRow;
-   temp.slotOffset                     = \
-      schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].slotOffset;
-   temp.type                           = \
-      schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].type;
-   temp.shared                         = \
-      schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].shared;
-   temp.channelOffset                  = \
-      schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].channelOffset;
-   memcpy(
-      &temp.neighbor,
-      &schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].neighbor,
-      sizeof(open_addr_t)
-   );
-   temp.numRx                          = \
-      schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].numRx;
-   temp.numTx                          = \
-      schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].numTx;
-   temp.numTxACK                       = \
-      schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].numTxACK;
-   memcpy(
-      &temp.lastUsedAsn,
-      &schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].lastUsedAsn,
-      sizeof(asn_t)
-   );
-   
-   // send status data over serial port
-   openserial_printStatus(
-      STATUS_SCHEDULE,
-      (uint8_t*)&temp,
-      sizeof(debugScheduleEntry_t)
-   );
+   for (i=0;i<MAXACTIVESLOTS;i++) {
+      // increment the row just printed
+      schedule_vars.debugPrintRow      = (schedule_vars.debugPrintRow+1)%MAXACTIVESLOTS;
+      entry                            = &schedule_vars.scheduleBuf[schedule_vars.debugPrintRow];
+      
+      // gather status data
+      temp.row                         = schedule_vars.debugPrintRow;
+      temp.slotOffset                  = entry->slotOffset;
+      temp.type                        = entry->type;
+      temp.shared                      = entry->shared;
+      temp.channelOffset               = entry->channelOffset;
+      memcpy(&temp.neighbor,&entry->neighbor,sizeof(open_addr_t));
+      temp.numRx                       = entry->numRx;
+      temp.numTx                       = entry->numTx;
+      temp.numTxACK                    = entry->numTxACK;
+      memcpy(&temp.lastUsedAsn,&entry->lastUsedAsn,sizeof(asn_t));
+      
+      // send status data over serial port, if it changed
+      if (
+            openserial_printStatusDelta(
+               STATUS_SCHEDULE,
+               &schedule_vars.debugRowSignature[schedule_vars.debugPrintRow],
+               (uint8_t*)&temp,
+               sizeof(debugScheduleEntry_t)
+            )==TRUE
+         ) {
+         return TRUE;
+      }
+   }
    
-   return TRUE;
+   return FALSE;
 }
 
 /**
@@ -146,13 +132,12 @@ bool debugPrint_backoff() {
    temp[1] = schedule_vars.backoff;
    
    // send status data over serial port
-   openserial_printStatus(
+   return openserial_printStatusDelta(
       STATUS_BACKOFF,
+      NULL,
       (uint8_t*)&temp,
       sizeof(temp)
    );
-   
-   return TRUE;
 }
 
 //=== from 6top (writing the schedule)
@@ -206,6 +191,53 @@ void  schedule_getSlotInfo(
    info->channelOffset             = 0;//set to zero if not set.                          
 }
 
+/**
+\brief Get the information of a dedicated cell, by row in the schedule table.
+
+A cell is dedicated when it is a non-shared TX, RX or TXRX cell to a specific
+neighbor, i.e. a cell negotiated through 6top rather than installed at boot.
+
+\param row  The row of the schedule table, between 0 and MAXACTIVESLOTS-1.
+\param info Where to write the cell's information.
+
+\returns TRUE if that row holds a dedicated cell, FALSE otherwise.
+*/
+bool schedule_getDedicatedCell(uint8_t row, slotinfo_element_t* info) {
+   scheduleEntry_t* entry;
+   bool             returnVal;
+   
+   INTERRUPT_DECLARATION();
+   
+   if (row>=MAXACTIVESLOTS) {
+      return FALSE;
+   }
+   
+   DISABLE_INTERRUPTS();
+   
+   entry     = &schedule_vars.scheduleBuf[row];
+   returnVal = FALSE;
+   if (
+         entry->shared==FALSE              &&
+         entry->neighbor.type==ADDR_64B    &&
+         (
+            entry->type==CELLTYPE_TX       ||
+            entry->type==CELLTYPE_RX       ||
+            entry->type==CELLTYPE_TXRX
+         )
+      ) {
+      memcpy(info->address,entry->neighbor.addr_64b,LENGTH_ADDR64b);
+      info->link_type     = entry->type;
+      info->shared        = entry->shared;
+      info->slotOffset    = entry->slotOffset;
+      info->channelOffset = entry->channelOffset;
+      returnVal           = TRUE;
+   }
+   
+   ENABLE_INTERRUPTS();
+   
+   return returnVal;
+}
+
 /**
 \brief Add a new active slot into the schedule.
 
@@ -299,6 +331,10 @@ owerror_t schedule_addActiveSlot(
    }
    
    ENABLE_INTERRUPTS();
+   
+   // advertise the new schedule quickly
+   sixtop_ebTrickleReset();
+   
    return E_SUCCESS;
 }
 
@@ -377,6 +413,9 @@ owerror_t schedule_removeActiveSlot(slotOffset_t slotOffset, open_addr_t* neighb
    
    ENABLE_INTERRUPTS();
    
+   // advertise the new schedule quickly
+   sixtop_ebTrickleReset();
+   
    return E_SUCCESS;
 }
 
@@ -494,6 +533,24 @@ void schedule_getNeighbor(open_addr_t* addrToWrite) {
    ENABLE_INTERRUPTS();
 }
 
+/**
+\brief Get whether the current schedule entry is a shared cell.
+
+\returns TRUE if other motes may transmit in the current cell too.
+*/
+bool schedule_getShared() {
+   bool returnVal;
+   
+   INTERRUPT_DECLARATION();
+   DISABLE_INTERRUPTS();
+   
+   returnVal = schedule_vars.currentScheduleEntry->shared;
+   
+   ENABLE_INTERRUPTS();
+   
+   return returnVal;
+}
+
 /**
 \brief Get the channel offset of the current schedule entry.
 
@@ -512,6 +569,36 @@ channelOffset_t schedule_getChannelOffset() {
    return returnVal;
 }
 
+/**
+\brief Get the neighbor of the next active cell, if it is a dedicated cell I
+   can transmit in.
+
+Lets the MAC prepare the frame for that cell ahead of time. Shared cells do
+not qualify, their backoff is only decided when the cell starts.
+
+\param[out] addrToWrite Where to write the neighbor's address.
+
+\returns TRUE if the next active cell is a non-shared TX or TXRX cell.
+*/
+bool schedule_getNextTxNeighbor(open_addr_t* addrToWrite) {
+   scheduleEntry_t* nextEntry;
+   bool             returnVal;
+   
+   INTERRUPT_DECLARATION();
+   DISABLE_INTERRUPTS();
+   
+   nextEntry = (scheduleEntry_t*)(schedule_vars.currentScheduleEntry->next);
+   returnVal = nextEntry->shared==FALSE &&
+               (nextEntry->type==CELLTYPE_TX || nextEntry->type==CELLTYPE_TXRX);
+   if (returnVal==TRUE) {
+      memcpy(addrToWrite,&(nextEntry->neighbor),sizeof(open_addr_t));
+   }
+   
+   ENABLE_INTERRUPTS();
+   
+   return returnVal;
+}
+
 /**
 \brief Check whether I can send on this slot.
 
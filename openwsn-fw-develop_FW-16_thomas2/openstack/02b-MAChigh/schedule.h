@@ -21,7 +21,6 @@ The superframe repears over time and can be arbitrarly long.
 
 #define NUMADVSLOTS          1
 #define NUMSHAREDTXRX        5 
-#define NUMSERIALRX          3
 
 /**
 \brief Maximum number of active slots in a superframe.
@@ -33,7 +32,7 @@ in that table; a slot is "active" when it is not of type CELLTYPE_OFF.
 Set this number to the exact number of active slots you are planning on having
 in your schedule, so not to waste RAM.
 */
-#define MAXACTIVESLOTS       (NUMADVSLOTS+NUMSHAREDTXRX+NUMSERIALRX)
+#define MAXACTIVESLOTS       (NUMADVSLOTS+NUMSHAREDTXRX)
 
 /**
 \brief Minimum backoff exponent.
@@ -68,9 +67,7 @@ typedef enum {
    CELLTYPE_ADV              = 1,
    CELLTYPE_TX               = 2,
    CELLTYPE_RX               = 3,
-   CELLTYPE_TXRX             = 4,
-   CELLTYPE_SERIALRX         = 5,
-   CELLTYPE_MORESERIALRX     = 6
+   CELLTYPE_TXRX             = 4
 } cellType_t;
 
 typedef struct {
@@ -118,6 +115,7 @@ typedef struct {
    uint8_t          backoffExponent;
    uint8_t          backoff;
    uint8_t          debugPrintRow;
+   uint16_t         debugRowSignature[MAXACTIVESLOTS]; // of the last status record sent, per row
 } schedule_vars_t;
 
 //=========================== prototypes ======================================
@@ -142,6 +140,10 @@ void               schedule_getSlotInfo(
    open_addr_t*         neighbor,
    slotinfo_element_t*  info
 );
+bool               schedule_getDedicatedCell(
+   uint8_t              row,
+   slotinfo_element_t*  info
+);
 
 owerror_t          schedule_removeActiveSlot(
    slotOffset_t         slotOffset,
@@ -157,7 +159,9 @@ frameLength_t      schedule_getFrameLength(void);
 cellType_t         schedule_getType(void);
 void               schedule_getNeighbor(open_addr_t* addrToWrite);
 channelOffset_t    schedule_getChannelOffset(void);
+bool               schedule_getShared(void);
 bool               schedule_getOkToSend(void);
+bool               schedule_getNextTxNeighbor(open_addr_t* addrToWrite);
 void               schedule_resetBackoff(void);
 void               schedule_indicateRx(asn_t*   asnTimestamp);
 void               schedule_indicateTx(
@@ -16,6 +16,7 @@
 #include "IEEE802154.h"
 #include "idmanager.h"
 #include "schedule.h"
+#include "IEEE802154_security.h"
 
 //=========================== variables =======================================
 
@@ -37,6 +38,9 @@ void          sixtop_timeout_timer_cb(void);
 //=== EB/KA task
 
 void          timer_sixtop_management_fired(void);
+void          sixtop_ebTrickleStart(uint8_t interval);
+void          sixtop_ebTrickleTick(void);
+void          sixtop_ebReceived(uint8_t joinPriority);
 void          sixtop_sendEB(void);
 void          sixtop_sendKA(void);
 
@@ -123,6 +127,11 @@ void sixtop_init() {
    sixtop_vars.dsn                = 0;
    sixtop_vars.mgtTaskCounter     = 0;
    sixtop_vars.kaPeriod           = MAXKAPERIOD;
+   sixtop_vars.kaPkt              = NULL;
+   sixtop_vars.numKASent          = 0;
+   sixtop_vars.numKASuppressed    = 0;
+   sixtop_vars.ebBodyLength       = 0;
+   sixtop_ebTrickleStart(EB_TRICKLE_IMIN);
    
    sixtop_vars.maintenanceTimerId = opentimers_start(
       sixtop_vars.periodMaintenance,
@@ -147,6 +156,17 @@ void sixtop_setKaPeriod(uint16_t kaPeriod) {
    } 
 }
 
+/**
+\brief Reset the Trickle timer governing EB emission.
+
+Called when something worth advertising quickly changed, e.g. the schedule.
+*/
+void sixtop_ebTrickleReset() {
+   if (sixtop_vars.ebTrickleI!=EB_TRICKLE_IMIN) {
+      sixtop_ebTrickleStart(EB_TRICKLE_IMIN);
+   }
+}
+
 //======= scheduling
 
 void sixtop_addCells(open_addr_t* neighbor, uint16_t numCells){
@@ -182,7 +202,7 @@ void sixtop_addCells(open_addr_t* neighbor, uint16_t numCells){
    }
    
    // get a free packet buffer
-   pkt = openqueue_getFreePacketBuffer(COMPONENT_SIXTOP_RES);
+   pkt = openqueue_getFreePacketBufferOfClass(COMPONENT_SIXTOP_RES,TRAFFIC_CLASS_CONTROL);
    if (pkt==NULL) {
       openserial_printError(
          COMPONENT_SIXTOP_RES,
@@ -200,6 +220,9 @@ void sixtop_addCells(open_addr_t* neighbor, uint16_t numCells){
    pkt->creator = COMPONENT_SIXTOP_RES;
    pkt->owner   = COMPONENT_SIXTOP_RES;
    
+   // the response may come in a shared cell
+   pkt->l2_responseTimeout = SIX2SIX_TIMEOUT_MS;
+   
    memcpy(
       &(pkt->l2_nextORpreviousHop),
       neighbor,
@@ -263,7 +286,7 @@ void sixtop_removeCell(open_addr_t* neighbor){
    }
    
    // get a free packet buffer
-   pkt = openqueue_getFreePacketBuffer(COMPONENT_SIXTOP_RES);
+   pkt = openqueue_getFreePacketBufferOfClass(COMPONENT_SIXTOP_RES,TRAFFIC_CLASS_CONTROL);
    if(pkt==NULL) {
       openserial_printError(
          COMPONENT_SIXTOP_RES,
@@ -280,6 +303,9 @@ void sixtop_removeCell(open_addr_t* neighbor){
    // declare ownership over that packet
    pkt->creator = COMPONENT_SIXTOP_RES;
    pkt->owner   = COMPONENT_SIXTOP_RES;
+   
+   // the response may come in a shared cell
+   pkt->l2_responseTimeout = SIX2SIX_TIMEOUT_MS;
       
    memcpy(
       &(pkt->l2_nextORpreviousHop),
@@ -363,7 +389,8 @@ void task_sixtopNotifSendDone() {
          TRUE,
          &msg->l2_asn
       );
-   } else {
+   } else if (msg->l2_numTxAttempts>0) {
+      // not for a packet dropped past its deadline before it was ever sent
       neighbors_indicateTx(
          &(msg->l2_nextORpreviousHop),
          msg->l2_numTxAttempts,
@@ -386,6 +413,7 @@ void task_sixtopNotifSendDone() {
             
             // not busy sending KA anymore
             sixtop_vars.busySendingKA = FALSE;
+            sixtop_vars.numKASent++;
          }
          // discard packets
          openqueue_freePacketBuffer(msg);
@@ -429,6 +457,15 @@ void task_sixtopNotifReceive() {
    // take ownership
    msg->owner = COMPONENT_SIXTOP;
    
+#ifdef L2_SECURITY_ACTIVE
+   // authenticate and decrypt, before anything in the frame is used
+   if (ieee802154_security_incomingFrame(msg)==E_FAIL) {
+      // free the packet's RAM memory
+      openqueue_freePacketBuffer(msg);
+      return;
+   }
+#endif
+   
    // process the header IEs
    lenIE=0;
    if(
@@ -454,6 +491,14 @@ void task_sixtopNotifReceive() {
       msg->l2_joinPriority
    );
    
+   // count EBs towards Trickle suppression of my own
+   if (
+         msg->l2_frameType==IEEE154_TYPE_BEACON &&
+         msg->l2_joinPriorityPresent==TRUE
+      ) {
+      sixtop_ebReceived(msg->l2_joinPriority);
+   }
+   
    // reset it to avoid race conditions with this var.
    msg->l2_joinPriorityPresent = FALSE; 
    
@@ -501,8 +546,7 @@ bool debugPrint_myDAGrank() {
    output = 0;
    
    output = neighbors_getMyDAGrank();
-   openserial_printStatus(STATUS_DAGRANK,(uint8_t*)&output,sizeof(uint16_t));
-   return TRUE;
+   return openserial_printStatusDelta(STATUS_DAGRANK,NULL,(uint8_t*)&output,sizeof(uint16_t));
 }
 
 /**
@@ -518,12 +562,12 @@ bool debugPrint_kaPeriod() {
    
    output = sixtop_vars.kaPeriod;
    
-   openserial_printStatus(
+   return openserial_printStatusDelta(
        STATUS_KAPERIOD,
+       NULL,
        (uint8_t*)&output,
        sizeof(output)
    );
-   return TRUE;
 }
 
 //=========================== private =========================================
@@ -554,25 +598,43 @@ owerror_t sixtop_send_internal(
       ) {
       msg->l2_retriesLeft = 1;
    } else {
-      msg->l2_retriesLeft = TXRETRIES;
+      // as if sent in a dedicated cell, the MAC lowers it in shared cells
+      msg->l2_retriesLeft = neighbors_getRetryBudget(
+         &(msg->l2_nextORpreviousHop),
+         msg->trafficClass,
+         FALSE
+      );
    }
    // record this packet's dsn (for matching the ACK)
    msg->l2_dsn = sixtop_vars.dsn++;
    // this is a new packet which I never attempted to send
    msg->l2_numTxAttempts = 0;
-   // transmit with the default TX power
-   msg->l1_txPower = TX_POWER;
+   // transmit with the power adapted to the next hop
+   msg->l1_txPower = neighbors_getTxPower(&(msg->l2_nextORpreviousHop));
    // record the location, in the packet, where the l2 payload starts
    msg->l2_payload = msg->payload;
+#ifdef L2_SECURITY_ACTIVE
+   // pick the security level, key and frame counter
+   ieee802154_security_prepareOutgoingFrame(msg);
+#endif
    // add a IEEE802.15.4 header
    ieee802154_prependHeader(msg,
                             msg->l2_frameType,
                             iePresent,
                             frameVersion,
-                            IEEE154_SEC_NO_SECURITY,
+                            msg->l2_securityLevel!=IEEE154_ASH_SLF_TYPE_NOSEC,
                             msg->l2_dsn,
                             &(msg->l2_nextORpreviousHop)
                             );
+#ifdef L2_SECURITY_ACTIVE
+   // secure the frame here, rather than within the slot
+   if (
+         msg->l2_securityLevel!=IEEE154_ASH_SLF_TYPE_NOSEC &&
+         ieee802154_security_outgoingFrame(msg)==E_FAIL
+      ) {
+      return E_FAIL;
+   }
+#endif
    // reserve space for 2-byte CRC
    packetfunctions_reserveFooterSize(msg,2);
    // change owner to IEEE802154E fetches it from queue
@@ -598,27 +660,95 @@ void sixtop_timeout_timer_cb() {
 This function is called in task context by the scheduler after the RES timer
 has fired. This timer is set to fire every second, on average.
 
-The body of this function executes one of the MAC management task.
+The body of this function advances the Trickle timer governing EBs, and
+executes one of the other MAC management tasks.
 */
 void timer_sixtop_management_fired(void) {
    sixtop_vars.mgtTaskCounter = (sixtop_vars.mgtTaskCounter+1)%ADVTIMEOUT;
    
+   // called every second, sends an EB when Trickle says so; a leaf sends
+   // none, as no mote should join through it
+#ifndef LEAF
+   sixtop_ebTrickleTick();
+#endif
+   
    switch (sixtop_vars.mgtTaskCounter) {
       case 0:
-         // called every ADVTIMEOUT seconds
-         sixtop_sendEB();
-         break;
-      case 1:
          // called every ADVTIMEOUT seconds
          neighbors_removeOld();
          break;
       default:
-         // called every second, except twice every ADVTIMEOUT seconds
+         // called every second, except once every ADVTIMEOUT seconds
          sixtop_sendKA();
          break;
    }
 }
 
+/**
+\brief Start a new Trickle interval for EB emission.
+
+\param[in] interval The length of the interval, in maintenance ticks.
+*/
+void sixtop_ebTrickleStart(uint8_t interval) {
+   sixtop_vars.ebTrickleI    = interval;
+   sixtop_vars.ebTrickleTick = 0;
+   sixtop_vars.ebTrickleC    = 0;
+   // pick the transmission time in the second half of the interval
+   sixtop_vars.ebTrickleT    = interval/2+(openrandom_get16b()%(interval/2));
+}
+
+/**
+\brief Advance the Trickle timer governing EB emission by one tick.
+
+An EB is sent at the chosen time of the interval, unless EB_TRICKLE_K
+consistent EBs were heard since the interval started. The interval doubles
+up to EB_TRICKLE_IMAX each time it expires. While not synchronized, the timer
+is held at EB_TRICKLE_IMIN, so a mote which (re)joins advertises quickly.
+*/
+port_INLINE void sixtop_ebTrickleTick() {
+   if (ieee154e_isSynch()==FALSE) {
+      sixtop_ebTrickleStart(EB_TRICKLE_IMIN);
+      // flushes the EBs and KAs left over from when I was synchronized
+      sixtop_sendEB();
+      return;
+   }
+   
+   sixtop_vars.ebTrickleTick++;
+   
+   if (
+         sixtop_vars.ebTrickleTick==sixtop_vars.ebTrickleT &&
+         sixtop_vars.ebTrickleC<EB_TRICKLE_K
+      ) {
+      sixtop_sendEB();
+   }
+   
+   if (sixtop_vars.ebTrickleTick>=sixtop_vars.ebTrickleI) {
+      // interval expired, double it
+      if (sixtop_vars.ebTrickleI<=EB_TRICKLE_IMAX/2) {
+         sixtop_ebTrickleStart(2*sixtop_vars.ebTrickleI);
+      } else {
+         sixtop_ebTrickleStart(EB_TRICKLE_IMAX);
+      }
+   }
+}
+
+/**
+\brief Account for an EB received from a neighbor.
+
+The EB is consistent with mine if the neighbor is at least as close to the
+DAGroot as I am, i.e. if its join priority is equal or lower than mine.
+
+\param[in] joinPriority The join priority advertised in the EB.
+*/
+port_INLINE void sixtop_ebReceived(uint8_t joinPriority) {
+   if (
+         joinPriority<=neighbors_getMyDAGrank()/(2*MINHOPRANKINCREASE) &&
+         sixtop_vars.ebTrickleC<0xff
+      ) {
+      sixtop_vars.ebTrickleC++;
+   }
+}
+
 /**
 \brief Send an advertisement.
 
@@ -647,12 +777,13 @@ port_INLINE void sixtop_sendEB() {
    
    if (sixtop_vars.busySendingEB==TRUE) {
       // don't continue if I'm still sending a previous ADV
+      return;
    }
    
    // if I get here, I will send an ADV
    
    // get a free packet buffer
-   adv = openqueue_getFreePacketBuffer(COMPONENT_SIXTOP);
+   adv = openqueue_getFreePacketBufferOfClass(COMPONENT_SIXTOP,TRAFFIC_CLASS_CONTROL);
    if (adv==NULL) {
       openserial_printError(COMPONENT_SIXTOP,ERR_NO_FREE_PACKET_BUFFER,
                             (errorparameter_t)0,
@@ -664,13 +795,35 @@ port_INLINE void sixtop_sendEB() {
    adv->creator = COMPONENT_SIXTOP;
    adv->owner   = COMPONENT_SIXTOP;
    
-   // reserve space for ADV-specific header
-   // reserving for IEs.
-   len += processIE_prependSlotframeLinkIE(adv);
-   len += processIE_prependSyncIE(adv);
-   
-   //add IE header 
-   processIE_prependMLMEIE(adv,len);
+   if (
+         sixtop_vars.ebBodyLength==0 ||
+         memcmp(&sixtop_vars.ebShortAddr,idmanager_getMyShortAddress(),sizeof(open_addr_t))!=0
+      ) {
+      // reserve space for ADV-specific header
+      // reserving for IEs.
+      len += processIE_prependSlotframeLinkIE(adv);
+      len += processIE_prependSyncIE(adv);
+      len += processIE_prependShortAddressIE(adv);
+      len += processIE_prependCapabilitiesIE(adv);
+      
+      //add IE header 
+      processIE_prependMLMEIE(adv,len);
+      
+      // keep the IEs for the next EBs
+      if (adv->length<=EB_BODY_MAXLEN) {
+         memcpy(sixtop_vars.ebBody,adv->payload,adv->length);
+         sixtop_vars.ebBodyLength = adv->length;
+         sixtop_vars.ebASNOffset  = (uint8_t)(adv->l2_ASNpayload-adv->payload);
+         memcpy(&sixtop_vars.ebShortAddr,idmanager_getMyShortAddress(),sizeof(open_addr_t));
+      }
+   } else {
+      // the IEs only advertise the minimal schedule, my short address and my
+      // capabilities; the ASN and join priority are written by the MAC when
+      // transmitting, through l2_ASNpayload
+      packetfunctions_reserveHeaderSize(adv,sixtop_vars.ebBodyLength);
+      memcpy(adv->payload,sixtop_vars.ebBody,sixtop_vars.ebBodyLength);
+      adv->l2_ASNpayload = adv->payload+sixtop_vars.ebASNOffset;
+   }
   
    // some l2 information about this packet
    adv->l2_frameType                     = IEEE154_TYPE_BEACON;
@@ -713,6 +866,18 @@ port_INLINE void sixtop_sendKA() {
    }
    
    if (sixtop_vars.busySendingKA==TRUE) {
+      // withdraw the KA if it has not been transmitted yet and my time source
+      // has corrected my clock since, by ACKing data or sending me a frame.
+      // A KA which already failed once is left to finish its retries: the
+      // next KA would otherwise be due again one kaPeriod later.
+      if (
+            sixtop_vars.kaPkt->l2_numTxAttempts==0 &&
+            ieee154e_slotsSinceSync()<sixtop_vars.kaPeriod &&
+            openqueue_sixtopWithdrawPacket(sixtop_vars.kaPkt)==E_SUCCESS
+         ) {
+         sixtop_vars.busySendingKA = FALSE;
+         sixtop_vars.numKASuppressed++;
+      }
       // don't proceed if I'm still sending a KA
       return;
    }
@@ -723,10 +888,21 @@ port_INLINE void sixtop_sendKA() {
       return;
    }
    
+   if (
+         ieee154e_slotsSinceSync()<sixtop_vars.kaPeriod ||
+         openqueue_sixtopHasPacketTo(kaNeighAddr)==TRUE
+      ) {
+      // don't proceed if I resynchronized since the neighbor table was last
+      // updated, or if a data packet to that neighbor is already queued: its
+      // ACK will carry the time correction the KA would have fetched
+      sixtop_vars.numKASuppressed++;
+      return;
+   }
+   
    // if I get here, I will send a KA
    
    // get a free packet buffer
-   kaPkt = openqueue_getFreePacketBuffer(COMPONENT_SIXTOP);
+   kaPkt = openqueue_getFreePacketBufferOfClass(COMPONENT_SIXTOP,TRAFFIC_CLASS_CONTROL);
    if (kaPkt==NULL) {
       openserial_printError(COMPONENT_SIXTOP,ERR_NO_FREE_PACKET_BUFFER,
                             (errorparameter_t)1,
@@ -747,6 +923,7 @@ port_INLINE void sixtop_sendKA() {
    
    // I'm now busy sending a KA
    sixtop_vars.busySendingKA = TRUE;
+   sixtop_vars.kaPkt         = kaPkt;
 
 #ifdef OPENSIM
    debugpins_ka_set();
@@ -824,104 +1001,42 @@ void sixtop_six2six_sendDone(OpenQueueEntry_t* msg, owerror_t error){
 
 port_INLINE bool sixtop_processIEs(OpenQueueEntry_t* pkt, uint16_t * lenIE) {
    uint8_t ptr;
-   uint8_t temp_8b,gr_elem_id,subid;
-   uint16_t temp_16b,len,sublen;
+   uint8_t i;
+   ie_descriptor_t* ie;
    opcode_IE_ht opcode_ie;
    bandwidth_IE_ht bandwidth_ie;
    schedule_IE_ht schedule_ie;
  
-   ptr=0; 
    memset(&opcode_ie,0,sizeof(opcode_IE_ht));
    memset(&bandwidth_ie,0,sizeof(bandwidth_IE_ht));
    memset(&schedule_ie,0,sizeof(schedule_IE_ht));  
-  
-   //candidate IE header  if type ==0 header IE if type==1 payload IE
-   temp_8b = *((uint8_t*)(pkt->payload)+ptr);
-   ptr++;
-   temp_16b = temp_8b + ((*((uint8_t*)(pkt->payload)+ptr))<< 8);
-   ptr++;
-   *lenIE = ptr;
-   if(
-      (temp_16b & IEEE802154E_DESC_TYPE_PAYLOAD_IE) == 
-      IEEE802154E_DESC_TYPE_PAYLOAD_IE
-   ){
-   //payload IE - last bit is 1
-      len = 
-         (temp_16b & IEEE802154E_DESC_LEN_PAYLOAD_IE_MASK) >> 
-         IEEE802154E_DESC_LEN_PAYLOAD_IE_SHIFT;
-      gr_elem_id = 
-         (temp_16b & IEEE802154E_DESC_GROUPID_PAYLOAD_IE_MASK)>>
-         IEEE802154E_DESC_GROUPID_PAYLOAD_IE_SHIFT;
-   }else {
-   //header IE - last bit is 0
-      len = 
-         (temp_16b & IEEE802154E_DESC_LEN_HEADER_IE_MASK)>>
-         IEEE802154E_DESC_LEN_HEADER_IE_SHIFT;
-      gr_elem_id = (temp_16b & IEEE802154E_DESC_ELEMENTID_HEADER_IE_MASK)>>
-         IEEE802154E_DESC_ELEMENTID_HEADER_IE_SHIFT; 
-   }
-  
-   *lenIE += len;
-   //now determine sub elements if any
-   switch(gr_elem_id){
-      //this is the only groupID that we parse. See page 82.  
-      case IEEE802154E_MLME_IE_GROUPID:
-        //IE content can be any of the sub-IEs. Parse and see which
-        do{
-           //read sub IE header
-           temp_8b = *((uint8_t*)(pkt->payload)+ptr);
-           ptr = ptr + 1;
-           temp_16b = temp_8b  +(*((uint8_t*)(pkt->payload)+ptr) << 8);
-           ptr = ptr + 1;
-           len = len - 2; //remove header fields len
-           if(
-              (temp_16b & IEEE802154E_DESC_TYPE_LONG) == 
-              IEEE802154E_DESC_TYPE_LONG
-              ){
-              //long sub-IE - last bit is 1
-              sublen =
-                 (temp_16b & IEEE802154E_DESC_LEN_LONG_MLME_IE_MASK)>>
-                 IEEE802154E_DESC_LEN_LONG_MLME_IE_SHIFT;
-              subid= 
-                 (temp_16b & IEEE802154E_DESC_SUBID_LONG_MLME_IE_MASK)>>
-                 IEEE802154E_DESC_SUBID_LONG_MLME_IE_SHIFT; 
-           } else {
-              //short IE - last bit is 0
-              sublen = 
-                 (temp_16b & IEEE802154E_DESC_LEN_SHORT_MLME_IE_MASK)>>
-                 IEEE802154E_DESC_LEN_SHORT_MLME_IE_SHIFT;
-              subid = (temp_16b & IEEE802154E_DESC_SUBID_SHORT_MLME_IE_MASK)>>
-                 IEEE802154E_DESC_SUBID_SHORT_MLME_IE_SHIFT; 
-           }
-           switch(subid){
-              case MLME_IE_SUBID_OPCODE:
-              processIE_retrieveOpcodeIE(pkt,&ptr,&opcode_ie);
-              break;
-              case MLME_IE_SUBID_BANDWIDTH:
-              processIE_retrieveBandwidthIE(pkt,&ptr,&bandwidth_ie);
-              break;
-              case MLME_IE_SUBID_TRACKID:
-              break;
-              case MLME_IE_SUBID_SCHEDULE:
-              processIE_retrieveSheduleIE(pkt,&ptr,&schedule_ie);
-              break;
-          default:
-             return FALSE;
-             break;
-        }
-        len = len - sublen;
-      } while(len>0);
-      
-      break;
-    default:
-      *lenIE = 0;//no header or not recognized.
-       return FALSE;
+   
+   *lenIE = 0;
+   
+   // parse the IE list once, then read each IE in place
+   if (processIE_parseIEs(pkt)==FALSE) {
+      return FALSE;
    }
-   if (*lenIE>127) {
-         // log the error
-     openserial_printError(COMPONENT_IEEE802154E,ERR_HEADER_TOO_LONG,
-                           (errorparameter_t)*lenIE,
-                           (errorparameter_t)1);
+   *lenIE = pkt->l2_IEListLength;
+   
+   for (i=0;i<pkt->l2_numIEs;i++) {
+      ie  = &pkt->l2_IEs[i];
+      ptr = ie->offset;
+      switch(ie->id){
+         case MLME_IE_SUBID_OPCODE:
+            processIE_retrieveOpcodeIE(pkt,&ptr,&opcode_ie);
+            break;
+         case MLME_IE_SUBID_BANDWIDTH:
+            processIE_retrieveBandwidthIE(pkt,&ptr,&bandwidth_ie);
+            break;
+         case MLME_IE_SUBID_TRACKID:
+            break;
+         case MLME_IE_SUBID_SCHEDULE:
+            processIE_retrieveSheduleIE(pkt,&ptr,&schedule_ie);
+            break;
+         default:
+            return FALSE;
+      }
    }
   
    if(*lenIE>0) {
@@ -1023,7 +1138,7 @@ void sixtop_linkResponse(
    cellList = schedule_ie->cellList;
   
    // get a free packet buffer
-   sixtopPkt = openqueue_getFreePacketBuffer(COMPONENT_SIXTOP_RES);
+   sixtopPkt = openqueue_getFreePacketBufferOfClass(COMPONENT_SIXTOP_RES,TRAFFIC_CLASS_CONTROL);
   
    if(sixtopPkt==NULL) {
       openserial_printError(COMPONENT_SIXTOP_RES,ERR_NO_FREE_PACKET_BUFFER,
@@ -42,6 +42,15 @@ typedef enum {
 
 #define SIX2SIX_TIMEOUT_MS 2000
 
+// EB body: MLME IE header, Capabilities IE, Short Address IE, Sync IE and
+// Slotframe and Link IE (54B with the minimal schedule)
+#define EB_BODY_MAXLEN     64
+
+// Trickle timer (RFC6206) governing EB emission, in maintenance ticks (~1s)
+#define EB_TRICKLE_IMIN    4       // shortest interval, used after a reset
+#define EB_TRICKLE_IMAX    32      // longest interval
+#define EB_TRICKLE_K       2       // consistent EBs heard which suppress mine
+
 //=========================== module variables ================================
 
 typedef struct {
@@ -53,8 +62,19 @@ typedef struct {
    opentimer_id_t       maintenanceTimerId;
    opentimer_id_t       timeoutTimerId;          // TimeOut timer id
    uint16_t             kaPeriod;                // period of sending KA
+   OpenQueueEntry_t*    kaPkt;                   // KA being sent, valid while busySendingKA
+   uint16_t             numKASent;               // number of KAs handed back by the MAC after sending
+   uint16_t             numKASuppressed;         // number of due KAs not sent, or withdrawn before sending
    six2six_state_t      six2six_state;
    uint8_t              commandID;
+   uint8_t              ebBody[EB_BODY_MAXLEN];  // IEs of the last EB built, ASN and JP excluded
+   uint8_t              ebBodyLength;            // number of bytes in ebBody, 0 if none
+   uint8_t              ebASNOffset;             // offset of the Sync IE content in ebBody
+   open_addr_t          ebShortAddr;             // my short address when ebBody was built
+   uint8_t              ebTrickleI;              // current Trickle interval, in maintenance ticks
+   uint8_t              ebTrickleT;              // tick within the interval at which to send an EB
+   uint8_t              ebTrickleTick;           // ticks elapsed in the current interval
+   uint8_t              ebTrickleC;              // consistent EBs heard in the current interval
 } sixtop_vars_t;
 
 //=========================== prototypes ======================================
@@ -62,6 +82,7 @@ typedef struct {
 // admin
 void      sixtop_init(void);
 void      sixtop_setKaPeriod(uint16_t kaPeriod);
+void      sixtop_ebTrickleReset(void);
 // scheduling
 void      sixtop_addCells(open_addr_t* neighbor, uint16_t numCells);
 void      sixtop_removeCell(open_addr_t*  neighbor);
@@ -7,6 +7,7 @@
 #include "forwarding.h"
 #include "neighbors.h"
 #include "openbridge.h"
+#include "openqueue.h"
 
 //=========================== variables =======================================
 
@@ -46,6 +47,27 @@ void iphc_retrieveIPv6HopByHopHeader(
    rpl_option_ht*       rpl_option
 );
 
+//===== 6LoWPAN routing headers
+void iphc_prependRpi6LoRH(OpenQueueEntry_t* msg, rpl_option_ht* rpl_option);
+owerror_t iphc_retrieve6LoRH(
+   OpenQueueEntry_t*    msg,
+   lowpan_6lorh_iht*    lorh,
+   rpl_option_ht*       rpl_option
+);
+bool iphc_compressSourceRoute(OpenQueueEntry_t* msg, uint8_t iphcLen);
+void iphc_expandSourceRoute(
+   OpenQueueEntry_t*    msg,
+   ipv6_header_iht*     ipv6_header,
+   lowpan_6lorh_iht*    lorh
+);
+void iphc_expandRpi6LoRH(
+   OpenQueueEntry_t*    msg,
+   ipv6_header_iht*     ipv6_header,
+   rpl_option_ht*       rpl_option
+);
+uint8_t iphc_nextHeaderOffset(uint8_t* iphc);
+void iphc_reverseHops(uint8_t* hops, uint8_t numHops, uint8_t hopSize);
+
 //=========================== public ==========================================
 
 void      iphc_init() {
@@ -70,6 +92,10 @@ owerror_t iphc_sendFromForwarding(
    uint8_t      nh;
    uint8_t      next_header;
    uint8_t      tf=IPHC_TF_ELIDED;
+   uint8_t      lengthBefore;
+   bool         use6LoRH;
+   bool         rpi6LoRH;
+   bool         lorhPresent;
    //option header
   
    // take ownership over the packet
@@ -149,6 +175,10 @@ owerror_t iphc_sendFromForwarding(
    // decrement the packet's hop limit
    ipv6_header->hop_limit--;
    
+   // the 6LoWPAN routing headers are only used toward a neighbor which understands them
+   use6LoRH = neighbors_supports6LoRH(&(msg->l2_nextORpreviousHop));
+   rpi6LoRH = FALSE;
+   
    //prepend Option hop by hop header except when src routing and dst is not 0xffff
    //-- this is a little trick as src routing is using an option header set to 0x00
    next_header=msg->l4_protocol;
@@ -156,9 +186,14 @@ owerror_t iphc_sendFromForwarding(
    if (rpl_option->optionType==RPL_HOPBYHOP_HEADER_OPTION_TYPE 
        && packetfunctions_isBroadcastMulticast(&(msg->l3_destinationAdd))==FALSE
        ){
-      iphc_prependIPv6HopByHopHeader(msg, msg->l4_protocol, nh, rpl_option);
-      //change nh to point to the newly added header
-      next_header=IANA_IPv6HOPOPT;// use 0x00 as NH to indicate option header -- see rfc 2460
+      if (use6LoRH) {
+         // carried in an RPI-6LoRH in front of the IPv6 header, see below
+         rpi6LoRH = TRUE;
+      } else {
+         iphc_prependIPv6HopByHopHeader(msg, msg->l4_protocol, nh, rpl_option);
+         //change nh to point to the newly added header
+         next_header=IANA_IPv6HOPOPT;// use 0x00 as NH to indicate option header -- see rfc 2460
+      }
    }
    #endif
    //then regular header
@@ -172,6 +207,7 @@ owerror_t iphc_sendFromForwarding(
    }
 #endif
 
+   lengthBefore = msg->length;
    if (iphc_prependIPv6Header(msg,
             tf,
             *flow_label, // value_flowlabel
@@ -192,11 +228,28 @@ owerror_t iphc_sendFromForwarding(
       return E_FAIL;
    }
    
+   // 6LoWPAN routing headers (RFC8138)
+   lorhPresent = FALSE;
+   if (use6LoRH && next_header==IANA_IPv6ROUTE && nh==IPHC_NH_INLINE) {
+      lorhPresent = iphc_compressSourceRoute(msg,msg->length-lengthBefore);
+   }
+   if (rpi6LoRH) {
+      iphc_prependRpi6LoRH(msg,rpl_option);
+      lorhPresent = TRUE;
+   }
+   if (lorhPresent) {
+      packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+      *((uint8_t*)(msg->payload)) = LOWPAN_DISPATCH_PAGE1;
+   }
+   
    return sixtop_send(msg);
 }
 
 //send from bridge: 6LoWPAN header already added by OpenLBR, send as is
 owerror_t iphc_sendFromBridge(OpenQueueEntry_t *msg) {
+   ipv6_header_iht      ipv6_header;
+   rpl_routing_ht*      rpl_routing_hdr;
+   
    msg->owner = COMPONENT_IPHC;
    // error checking
    if (idmanager_getIsDAGroot()==FALSE) {
@@ -205,6 +258,23 @@ owerror_t iphc_sendFromBridge(OpenQueueEntry_t *msg) {
                             (errorparameter_t)0);
       return E_FAIL;
    }
+   
+   // compress the source route toward a first hop which understands 6LoRHs
+   if (neighbors_supports6LoRH(&(msg->l2_nextORpreviousHop))) {
+      iphc_retrieveIPv6Header(msg,&ipv6_header);
+      rpl_routing_hdr = (rpl_routing_ht*)(msg->payload+ipv6_header.header_length);
+      // the IPv6 destination written by OpenLBR is only valid with a route left
+      if (
+            ipv6_header.next_header==IANA_IPv6ROUTE                &&
+            ipv6_header.next_header_compressed==FALSE               &&
+            rpl_routing_hdr->SegmentsLeft>0                         &&
+            iphc_compressSourceRoute(msg,ipv6_header.header_length)==TRUE
+         ) {
+         packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+         *((uint8_t*)(msg->payload)) = LOWPAN_DISPATCH_PAGE1;
+      }
+   }
+   
    return sixtop_send(msg);
 }
 
@@ -221,9 +291,21 @@ void iphc_receive(OpenQueueEntry_t* msg) {
    ipv6_header_iht      ipv6_header;
    ipv6_hopbyhop_iht    ipv6_hop_header;
    rpl_option_ht        rpl_option;
+   lowpan_6lorh_iht     lorh;
    
    msg->owner      = COMPONENT_IPHC;
    
+   // 6LoWPAN routing headers, if any
+   lorh.rpiPresent = FALSE;
+   lorh.srhNumAddr = 0;
+   if (*((uint8_t*)(msg->payload))==LOWPAN_DISPATCH_PAGE1) {
+      if (iphc_retrieve6LoRH(msg,&lorh,&rpl_option)==E_FAIL) {
+         openqueue_freePacketBuffer(msg);
+         return;
+      }
+      packetfunctions_tossHeader(msg,lorh.header_length);
+   }
+   
    // then regular header
    iphc_retrieveIPv6Header(msg,&ipv6_header);
    
@@ -247,6 +329,21 @@ void iphc_receive(OpenQueueEntry_t* msg) {
          );
       }
       
+      // the forwarding module only knows the uncompressed source routing header
+      if (lorh.srhNumAddr>0) {
+         if (ipv6_header.next_header_compressed==TRUE) {
+            openserial_printError(
+               COMPONENT_IPHC,
+               ERR_6LOWPAN_UNSUPPORTED,
+               (errorparameter_t)16,
+               (errorparameter_t)ipv6_header.next_header
+            );
+            openqueue_freePacketBuffer(msg);
+            return;
+         }
+         iphc_expandSourceRoute(msg,&ipv6_header,&lorh);
+      }
+      
       // send up the stack
       forwarding_receive(
          msg,
@@ -255,6 +352,10 @@ void iphc_receive(OpenQueueEntry_t* msg) {
          &rpl_option
       );
    } else {
+      // OpenVisualizer only knows the uncompressed hop-by-hop header
+      if (lorh.rpiPresent) {
+         iphc_expandRpi6LoRH(msg,&ipv6_header,&rpl_option);
+      }
       openbridge_receive(msg);                   //out to the OpenVisualizer
    }
 }
@@ -847,3 +948,343 @@ void iphc_retrieveIPv6HopByHopHeader(
    }
 #endif
 }
+
+//===== 6LoWPAN routing headers
+
+/**
+\brief Prepend an RPI-6LoRH to a message.
+
+This carries the RPL option in 2 to 5 bytes instead of the 8 bytes of the
+compressed hop-by-hop header, see http://tools.ietf.org/html/rfc8138#section-6.3.
+
+\note The field are written in reverse order.
+
+\param[in,out] msg             The message to prepend the header to.
+\param[in]     rpl_option      The RPL option to include.
+*/
+void iphc_prependRpi6LoRH(OpenQueueEntry_t* msg, rpl_option_ht* rpl_option) {
+   uint8_t temp_8b;
+   
+   temp_8b    = LOWPAN_6LORH_ID;
+   // the O, R and F flags are the bits right after the critical 6LoRH prefix
+   temp_8b   |= (rpl_option->flags & (O_FLAG | R_FLAG | F_FLAG)) >> 3;
+   
+   // sender rank, on a single byte when that loses nothing
+   if ((rpl_option->senderRank & 0x00ff)==0) {
+      packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+      *((uint8_t*)(msg->payload)) = (uint8_t)(rpl_option->senderRank >> 8);
+      temp_8b |= 1 << LOWPAN_6LORH_RPI_K;
+   } else {
+      packetfunctions_reserveHeaderSize(msg,sizeof(uint16_t));
+      packetfunctions_htons(rpl_option->senderRank,(uint8_t*)(msg->payload));
+   }
+   
+   // RPL instance ID, elided when it is the default one
+   if (rpl_option->rplInstanceID==0) {
+      temp_8b |= 1 << LOWPAN_6LORH_RPI_I;
+   } else {
+      packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+      *((uint8_t*)(msg->payload)) = rpl_option->rplInstanceID;
+   }
+   
+   // 6LoRH type
+   packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+   *((uint8_t*)(msg->payload)) = LOWPAN_6LORH_TYPE_RPI;
+   
+   // flags
+   packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+   *((uint8_t*)(msg->payload)) = temp_8b;
+}
+
+/**
+\brief Retrieve the 6LoWPAN routing headers from a message.
+
+The message starts with the page 1 dispatch. The headers are parsed up to the
+IPHC header, but not tossed.
+
+\param[in]  msg             The message to retrieve the headers from.
+\param[out] lorh            Pointer to the structure to hold what was found.
+\param[out] rpl_option      Pointer to the structure to hold the RPL option
+   carried in an RPI-6LoRH, if any.
+
+\returns E_SUCCESS if all the critical 6LoRHs are understood, E_FAIL otherwise,
+   in which case the packet must be dropped.
+*/
+owerror_t iphc_retrieve6LoRH(
+      OpenQueueEntry_t*      msg,
+      lowpan_6lorh_iht*      lorh,
+      rpl_option_ht*         rpl_option
+   ) {
+   uint8_t temp_8b;
+   uint8_t type;
+   
+   lorh->header_length  = sizeof(uint8_t);      // page dispatch
+   lorh->rpiPresent     = FALSE;
+   lorh->srhNumAddr     = 0;
+   lorh->srhAddrSize    = 0;
+   lorh->srhAddr        = NULL;
+   
+   while (
+         lorh->header_length+2*sizeof(uint8_t)<=msg->length &&
+         (*((uint8_t*)(msg->payload)+lorh->header_length) & LOWPAN_6LORH_MASK)==LOWPAN_6LORH_ID
+      ) {
+      temp_8b              = *((uint8_t*)(msg->payload)+lorh->header_length);
+      type                 = *((uint8_t*)(msg->payload)+lorh->header_length+1);
+      lorh->header_length += 2*sizeof(uint8_t);
+      
+      if ((temp_8b & LOWPAN_6LORH_ELECTIVE)!=0) {
+         // an elective 6LoRH can be skipped, its length is in the TSE field
+         lorh->header_length += temp_8b & LOWPAN_6LORH_LEN_MASK;
+         continue;
+      }
+      
+      switch (type) {
+         case LOWPAN_6LORH_TYPE_SRH_8B:
+         case LOWPAN_6LORH_TYPE_SRH_16B:
+            if (lorh->srhNumAddr!=0) {
+               // a route mixing address sizes is not supported
+               openserial_printError(
+                  COMPONENT_IPHC,
+                  ERR_6LOWPAN_UNSUPPORTED,
+                  (errorparameter_t)15,
+                  (errorparameter_t)type
+               );
+               return E_FAIL;
+            }
+            lorh->srhNumAddr     = (temp_8b & LOWPAN_6LORH_LEN_MASK)+1;
+            if (type==LOWPAN_6LORH_TYPE_SRH_8B) {
+               lorh->srhAddrSize = LENGTH_ADDR64b;
+            } else {
+               lorh->srhAddrSize = LENGTH_ADDR128b;
+            }
+            lorh->srhAddr        = (uint8_t*)(msg->payload)+lorh->header_length;
+            lorh->header_length += lorh->srhNumAddr*lorh->srhAddrSize;
+            break;
+         case LOWPAN_6LORH_TYPE_RPI:
+            lorh->rpiPresent          = TRUE;
+            rpl_option->optionType    = RPL_HOPBYHOP_HEADER_OPTION_TYPE;
+            rpl_option->optionLen     = 0x04;
+            rpl_option->flags         = (temp_8b << 3) & (O_FLAG | R_FLAG | F_FLAG);
+            if ((temp_8b & (1 << LOWPAN_6LORH_RPI_I))!=0) {
+               rpl_option->rplInstanceID = 0;
+            } else {
+               rpl_option->rplInstanceID = *((uint8_t*)(msg->payload)+lorh->header_length);
+               lorh->header_length      += sizeof(uint8_t);
+            }
+            if ((temp_8b & (1 << LOWPAN_6LORH_RPI_K))!=0) {
+               rpl_option->senderRank    = ((uint16_t)*((uint8_t*)(msg->payload)+lorh->header_length)) << 8;
+               lorh->header_length      += sizeof(uint8_t);
+            } else {
+               rpl_option->senderRank    = packetfunctions_ntohs((uint8_t*)(msg->payload)+lorh->header_length);
+               lorh->header_length      += sizeof(uint16_t);
+            }
+            break;
+         default:
+            // a critical 6LoRH which is not understood: the packet is dropped
+            openserial_printError(
+               COMPONENT_IPHC,
+               ERR_6LOWPAN_UNSUPPORTED,
+               (errorparameter_t)15,
+               (errorparameter_t)type
+            );
+            return E_FAIL;
+      }
+   }
+   
+   return E_SUCCESS;
+}
+
+/**
+\brief Replace the source routing header behind the IPHC header by an SRH-6LoRH.
+
+The SRH-6LoRH only holds the hops still to visit after the next one, in the
+order they are visited, and no fixed part. When no hop is left, the routing
+header is removed altogether: the IPv6 destination, elided, is the next hop.
+
+\param[in,out] msg             The message, starting with the IPHC header.
+\param[in]     iphcLen         Length of the IPHC header, in bytes.
+
+\returns TRUE if an SRH-6LoRH was prepended, FALSE otherwise. The routing
+   header is left untouched if it cannot be compressed.
+*/
+bool iphc_compressSourceRoute(OpenQueueEntry_t* msg, uint8_t iphcLen) {
+   uint8_t              iphc[IPHC_MAX_HEADER_LEN];
+   rpl_routing_ht*      rpl_routing_hdr;
+   uint8_t*             hops;
+   uint8_t              hopSize;
+   uint8_t              numAddr;
+   uint8_t              numLeft;
+   uint8_t              tf;
+   
+   tf = (*((uint8_t*)(msg->payload)) >> IPHC_TF) & 0x03;
+   if (
+         iphcLen>IPHC_MAX_HEADER_LEN                                       ||
+         (tf!=IPHC_TF_ELIDED && tf!=IPHC_TF_3B)                            ||
+         ((*((uint8_t*)(msg->payload)+1) >> IPHC_CID) & 0x01)==IPHC_CID_YES
+      ) {
+      return FALSE;
+   }
+   
+   rpl_routing_hdr = (rpl_routing_ht*)(msg->payload+iphcLen);
+   hops            = (uint8_t*)(msg->payload)+iphcLen+sizeof(rpl_routing_ht);
+   hopSize         = LENGTH_ADDR128b-(rpl_routing_hdr->CmprICmprE & 0x0f);
+   
+   // only routes of all EUI64s or all full addresses fit in an SRH-6LoRH
+   if (
+         rpl_routing_hdr->RoutingType!=RPL_ROUTING_TYPE_SOURCE_ROUTE        ||
+         rpl_routing_hdr->PadRes!=0                                         ||
+         (rpl_routing_hdr->CmprICmprE >> 4)!=(rpl_routing_hdr->CmprICmprE & 0x0f) ||
+         (hopSize!=LENGTH_ADDR64b && hopSize!=LENGTH_ADDR128b)
+      ) {
+      return FALSE;
+   }
+   numAddr         = (rpl_routing_hdr->HdrExtLen*8)/hopSize;
+   numLeft         = rpl_routing_hdr->SegmentsLeft;
+   if (numLeft>numAddr || numLeft>LOWPAN_6LORH_LEN_MASK+1) {
+      return FALSE;
+   }
+   
+   // the IPHC header now announces what follows the routing header
+   memcpy(iphc,msg->payload,iphcLen);
+   iphc[iphc_nextHeaderOffset(iphc)] = rpl_routing_hdr->nextHeader;
+   
+   // rewrite, in place: hops still to visit, then the IPHC header
+   packetfunctions_tossHeader(msg,iphcLen+sizeof(rpl_routing_ht)+numAddr*hopSize);
+   packetfunctions_reserveHeaderSize(msg,numLeft*hopSize+iphcLen);
+   memmove(msg->payload,hops,numLeft*hopSize);
+   iphc_reverseHops((uint8_t*)(msg->payload),numLeft,hopSize);
+   memcpy((uint8_t*)(msg->payload)+numLeft*hopSize,iphc,iphcLen);
+   
+   if (numLeft==0) {
+      return FALSE;
+   }
+   
+   // 6LoRH type
+   packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+   if (hopSize==LENGTH_ADDR64b) {
+      *((uint8_t*)(msg->payload)) = LOWPAN_6LORH_TYPE_SRH_8B;
+   } else {
+      *((uint8_t*)(msg->payload)) = LOWPAN_6LORH_TYPE_SRH_16B;
+   }
+   
+   // number of hops
+   packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+   *((uint8_t*)(msg->payload)) = LOWPAN_6LORH_ID | (numLeft-1);
+   
+   return TRUE;
+}
+
+/**
+\brief Rebuild the source routing header from an SRH-6LoRH.
+
+The forwarding module then handles the packet as if it had been received with
+an uncompressed routing header.
+
+\param[in,out] msg             The message, the IPv6 header already tossed.
+\param[in,out] ipv6_header     The IPv6 header, its next header is updated.
+\param[in]     lorh            The 6LoRHs, which still lie in the packet buffer.
+*/
+void iphc_expandSourceRoute(
+      OpenQueueEntry_t*      msg,
+      ipv6_header_iht*       ipv6_header,
+      lowpan_6lorh_iht*      lorh
+   ) {
+   rpl_routing_ht*      rpl_routing_hdr;
+   uint8_t              hopsLen;
+   
+   hopsLen = lorh->srhNumAddr*lorh->srhAddrSize;
+   
+   // hops, last one to visit first
+   packetfunctions_reserveHeaderSize(msg,hopsLen);
+   memmove(msg->payload,lorh->srhAddr,hopsLen);
+   iphc_reverseHops((uint8_t*)(msg->payload),lorh->srhNumAddr,lorh->srhAddrSize);
+   
+   // fixed part
+   packetfunctions_reserveHeaderSize(msg,sizeof(rpl_routing_ht));
+   rpl_routing_hdr                 = (rpl_routing_ht*)(msg->payload);
+   rpl_routing_hdr->nextHeader     = ipv6_header->next_header;
+   rpl_routing_hdr->HdrExtLen      = hopsLen/8;
+   rpl_routing_hdr->RoutingType    = RPL_ROUTING_TYPE_SOURCE_ROUTE;
+   rpl_routing_hdr->SegmentsLeft   = lorh->srhNumAddr;
+   rpl_routing_hdr->CmprICmprE     = ((LENGTH_ADDR128b-lorh->srhAddrSize) << 4) |
+                                      (LENGTH_ADDR128b-lorh->srhAddrSize);
+   rpl_routing_hdr->PadRes         = 0;
+   rpl_routing_hdr->Reserved       = 0;
+   
+   ipv6_header->next_header        = IANA_IPv6ROUTE;
+}
+
+/**
+\brief Turn the RPL option of an RPI-6LoRH back into a hop-by-hop header.
+
+The hop-by-hop header is inserted between the IPHC header and what follows it,
+and the IPHC header is updated to announce it.
+
+\param[in,out] msg             The message, starting with the IPHC header.
+\param[in]     ipv6_header     The IPv6 header retrieved from the message.
+\param[in]     rpl_option      The RPL option retrieved from the RPI-6LoRH.
+*/
+void iphc_expandRpi6LoRH(
+      OpenQueueEntry_t*      msg,
+      ipv6_header_iht*       ipv6_header,
+      rpl_option_ht*         rpl_option
+   ) {
+   uint8_t              iphc[IPHC_MAX_HEADER_LEN];
+   uint8_t              iphcLen;
+   uint8_t              nhOffset;
+   
+   iphcLen = ipv6_header->header_length;
+   if (iphcLen>IPHC_MAX_HEADER_LEN) {
+      return;
+   }
+   memcpy(iphc,msg->payload,iphcLen);
+   nhOffset = iphc_nextHeaderOffset(iphc);
+   packetfunctions_tossHeader(msg,iphcLen);
+   
+   // the hop-by-hop header takes over how the next header is encoded
+   if (ipv6_header->next_header_compressed==TRUE) {
+      iphc_prependIPv6HopByHopHeader(msg,ipv6_header->next_header,IPHC_NH_COMPRESSED,rpl_option);
+      
+      // the IPHC header now carries its next header inline
+      iphc[0] &= ~(1 << IPHC_NH);
+      packetfunctions_reserveHeaderSize(msg,iphcLen-nhOffset);
+      memcpy(msg->payload,&iphc[nhOffset],iphcLen-nhOffset);
+      packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+      *((uint8_t*)(msg->payload)) = IANA_IPv6HOPOPT;
+      packetfunctions_reserveHeaderSize(msg,nhOffset);
+      memcpy(msg->payload,iphc,nhOffset);
+   } else {
+      iphc_prependIPv6HopByHopHeader(msg,ipv6_header->next_header,IPHC_NH_INLINE,rpl_option);
+      
+      iphc[nhOffset] = IANA_IPv6HOPOPT;
+      packetfunctions_reserveHeaderSize(msg,iphcLen);
+      memcpy(msg->payload,iphc,iphcLen);
+   }
+}
+
+/**
+\brief Offset of the inline next header field in an IPHC header.
+
+\note This module only writes IPHC headers without context identifier, with the
+   traffic class and flow label elided or on 3 bytes.
+*/
+uint8_t iphc_nextHeaderOffset(uint8_t* iphc) {
+   if (((iphc[0] >> IPHC_TF) & 0x03)==IPHC_TF_3B) {
+      return 2+3;
+   }
+   return 2;
+}
+
+/**
+\brief Reverse, in place, the order of a list of hops.
+*/
+void iphc_reverseHops(uint8_t* hops, uint8_t numHops, uint8_t hopSize) {
+   uint8_t temp[LENGTH_ADDR128b];
+   uint8_t i;
+   
+   for (i=0;i<numHops/2;i++) {
+      memcpy(temp,                            hops+i*hopSize,              hopSize);
+      memcpy(hops+i*hopSize,                  hops+(numHops-1-i)*hopSize,  hopSize);
+      memcpy(hops+(numHops-1-i)*hopSize,      temp,                        hopSize);
+   }
+}
@@ -14,6 +14,7 @@
 
 #define IPHC_DEFAULT_HOP_LIMIT    65
 #define IPv6HOP_HDR_LEN           3
+#define IPHC_MAX_HEADER_LEN       40          // longest IPHC header this module writes
 
 enum IPHC_enums {
    IPHC_DISPATCH             = 5,
@@ -53,6 +54,33 @@ enum NHC_enums {
    NHC_UDP_ID                = 0xf0,          // b1111 0000
 };
 
+// 6LoWPAN routing headers, see http://tools.ietf.org/html/rfc8138
+enum LOWPAN_DISPATCH_enums {
+   LOWPAN_DISPATCH_PAGE1     = 0xf1,          // b1111 0001, page 1 holds the 6LoRHs
+};
+
+enum LOWPAN_6LORH_enums {
+   // 6LoRH starts with b10xx xxxx
+   LOWPAN_6LORH_MASK         = 0xc0,          // b1100 0000
+   LOWPAN_6LORH_ID           = 0x80,          // b1000 0000
+   LOWPAN_6LORH_ELECTIVE     = 0x20,          // b0010 0000, clear in a critical 6LoRH
+   LOWPAN_6LORH_LEN_MASK     = 0x1f,          // b0001 1111, TSE or Size field
+};
+
+enum LOWPAN_6LORH_TYPE_enums {
+   LOWPAN_6LORH_TYPE_SRH_8B  = 3,             // SRH-6LoRH, 8-byte addresses
+   LOWPAN_6LORH_TYPE_SRH_16B = 4,             // SRH-6LoRH, 16-byte addresses
+   LOWPAN_6LORH_TYPE_RPI     = 5,             // RPI-6LoRH
+};
+
+enum LOWPAN_6LORH_RPI_enums {
+   LOWPAN_6LORH_RPI_O        = 4,
+   LOWPAN_6LORH_RPI_R        = 3,
+   LOWPAN_6LORH_RPI_F        = 2,
+   LOWPAN_6LORH_RPI_I        = 1,             // RPLInstanceID elided, it is 0
+   LOWPAN_6LORH_RPI_K        = 0,             // SenderRank on 1 byte, low byte is 0
+};
+
 enum NHC_IPv6HOP_enums {
    NHC_IPv6HOP_MASK          = 0x0e,
    NHC_IPv6HOP_VAL           = 0x0e,
@@ -169,6 +197,19 @@ typedef struct {
 } rpl_option_ht;
 END_PACK
 
+/**
+\brief 6LoWPAN routing headers found in front of an IPHC header.
+
+Described in http://tools.ietf.org/html/rfc8138
+*/
+typedef struct {
+   uint8_t     header_length;          ///< Counter for internal use, includes the page dispatch
+   bool        rpiPresent;             ///< An RPI-6LoRH was found
+   uint8_t     srhNumAddr;             ///< Number of hops in the SRH-6LoRH, 0 if none
+   uint8_t     srhAddrSize;            ///< Size of each of those hops, in bytes
+   uint8_t*    srhAddr;                ///< First hop to visit, inside the packet
+} lowpan_6lorh_iht;
+
 //=========================== variables =======================================
 
 //=========================== prototypes ======================================
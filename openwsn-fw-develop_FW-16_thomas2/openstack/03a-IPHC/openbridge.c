@@ -5,54 +5,60 @@
 #include "iphc.h"
 #include "idmanager.h"
 #include "openqueue.h"
+#include "IEEE802154E.h"
 
 //=========================== variables =======================================
 
+openbridge_vars_t openbridge_vars;
+
 //=========================== prototypes ======================================
 //=========================== public ==========================================
 
 void openbridge_init() {
+   memset(&openbridge_vars,0,sizeof(openbridge_vars_t));
 }
 
+/**
+\brief Bridge the frame openserial has just received into the mesh.
+
+The frame (8B of next hop followed by the packet) is copied straight from the
+serial input ring into a packet buffer.
+*/
 void openbridge_triggerData() {
-   uint8_t           input_buffer[136];//worst case: 8B of next hop + 128B of data
    OpenQueueEntry_t* pkt;
    uint8_t           numDataBytes;
   
    numDataBytes = openserial_getNumDataBytes();
   
-   //poipoi xv
-   //this is a temporal workaround as we are never supposed to get chunks of data
-   //longer than input buffer size.. I assume that HDLC will solve that.
    // MAC header is 13B + 8 next hop so we cannot accept packets that are longer than 118B
    if (numDataBytes>(136 - 21) || numDataBytes<8){
    //to prevent too short or too long serial frames to kill the stack  
        openserial_printError(COMPONENT_OPENBRIDGE,ERR_INPUTBUFFER_LENGTH,
                    (errorparameter_t)numDataBytes,
                    (errorparameter_t)0);
+       openbridge_vars.stats.numDropped++;
        return;
    }
   
-   //copying the buffer once we know it is not too big
-   openserial_getInputBuffer(&(input_buffer[0]),numDataBytes);
-  
    if (idmanager_getIsDAGroot()==TRUE && numDataBytes>0) {
       pkt = openqueue_getFreePacketBuffer(COMPONENT_OPENBRIDGE);
       if (pkt==NULL) {
          openserial_printError(COMPONENT_OPENBRIDGE,ERR_NO_FREE_PACKET_BUFFER,
                                (errorparameter_t)0,
                                (errorparameter_t)0);
+         openbridge_vars.stats.numDropped++;
          return;
       }
       //admin
       pkt->creator  = COMPONENT_OPENBRIDGE;
       pkt->owner    = COMPONENT_OPENBRIDGE;
+      //copy next hop and payload from the serial input ring
+      packetfunctions_reserveHeaderSize(pkt,numDataBytes);
+      openserial_getInputBuffer(pkt->payload,numDataBytes);
       //l2
       pkt->l2_nextORpreviousHop.type = ADDR_64B;
-      memcpy(&(pkt->l2_nextORpreviousHop.addr_64b[0]),&(input_buffer[0]),8);
-      //payload
-      packetfunctions_reserveHeaderSize(pkt,numDataBytes-8);
-      memcpy(pkt->payload,&(input_buffer[8]),numDataBytes-8);
+      memcpy(&(pkt->l2_nextORpreviousHop.addr_64b[0]),pkt->payload,8);
+      packetfunctions_tossHeader(pkt,8);
       
       //this is to catch the too short packet. remove it after fw-103 is solved.
       if (numDataBytes<16){
@@ -63,6 +69,9 @@ void openbridge_triggerData() {
       //send
       if ((iphc_sendFromBridge(pkt))==E_FAIL) {
          openqueue_freePacketBuffer(pkt);
+         openbridge_vars.stats.numDropped++;
+      } else {
+         openbridge_vars.stats.numToMesh++;
       }
    }
 }
@@ -92,9 +101,26 @@ void openbridge_receive(OpenQueueEntry_t* msg) {
    
    // send packet over serial (will be memcopied into serial buffer)
    openserial_printData((uint8_t*)(msg->payload),msg->length);
+   openbridge_vars.stats.numToSerial++;
    
    // free packet
    openqueue_freePacketBuffer(msg);
 }
 
+/**
+\brief Trigger this module to print status information, over serial.
+
+debugPrint_* functions are used by the openserial module to continuously print
+status information about several modules in the OpenWSN stack.
+
+The counters are stamped with the current ASN, so the bridged packet rate can
+be computed from two consecutive prints, also in simulation.
+
+\returns TRUE if this function printed something, FALSE otherwise.
+*/
+bool debugPrint_bridgeStats() {
+   ieee154e_getAsn(openbridge_vars.stats.asn);
+   return openserial_printStatusDelta(STATUS_BRIDGESTATS,NULL,(uint8_t*)&openbridge_vars.stats,sizeof(openbridge_stats_t));
+}
+
 //=========================== private =========================================
@@ -8,18 +8,34 @@
 \{
 */
 
+#include "opendefs.h"
+
 //=========================== define ==========================================
 
 //=========================== typedef =========================================
 
+BEGIN_PACK
+typedef struct {
+   uint16_t   numToMesh;         // frames received over serial, sent into the mesh
+   uint16_t   numToSerial;       // frames received from the mesh, sent over serial
+   uint16_t   numDropped;        // frames received over serial which could not be sent
+   uint8_t    asn[5];            // ASN when these counters were printed
+} openbridge_stats_t;
+END_PACK
+
 //=========================== variables =======================================
 
+typedef struct {
+   openbridge_stats_t   stats;
+} openbridge_vars_t;
+
 //=========================== prototypes ======================================
 
 void openbridge_init(void);
 void openbridge_triggerData(void);
 void openbridge_sendDone(OpenQueueEntry_t* msg, owerror_t error);
 void openbridge_receive(OpenQueueEntry_t* msg);
+bool debugPrint_bridgeStats(void);
 
 /**
 \}
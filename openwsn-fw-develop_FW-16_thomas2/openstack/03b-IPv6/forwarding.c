@@ -166,6 +166,7 @@ void forwarding_receive(
    ) {
    uint8_t flags;
    uint16_t senderRank;
+   uint8_t trafficClass;
    
    // take ownership
    msg->owner                     = COMPONENT_FORWARDING;
@@ -227,6 +228,28 @@ void forwarding_receive(
       // change the creator of the packet
       msg->creator = COMPONENT_FORWARDING;
       
+      // relayed RPL messages remain network control, the rest is normal data
+      if (
+            msg->l4_protocol==IANA_ICMPv6 &&
+            msg->length>0                 &&
+            msg->payload[0]==IANA_ICMPv6_RPL
+         ) {
+         trafficClass = TRAFFIC_CLASS_CONTROL;
+      } else {
+         trafficClass = TRAFFIC_CLASS_NORMAL;
+      }
+      if (openqueue_setTrafficClass(msg,trafficClass)==E_FAIL) {
+         // it holds an entry kept for more urgent packets
+         openserial_printError(
+            COMPONENT_FORWARDING,
+            ERR_NO_FREE_PACKET_BUFFER,
+            (errorparameter_t)0,
+            (errorparameter_t)0
+         );
+         openqueue_freePacketBuffer(msg);
+         return;
+      }
+      
       if (ipv6_header->next_header!=IANA_IPv6ROUTE) {
          // no source routing header present
          //check if flow label rpl header
@@ -354,6 +377,17 @@ owerror_t forwarding_send_internal_RoutingTable(
       uint8_t                fw_SendOrfw_Rcv
    ) {
    
+   // a packet past its deadline is not worth the cells
+   if (openqueue_isExpired(msg)) {
+      openserial_printError(
+         COMPONENT_FORWARDING,
+         ERR_PACKET_EXPIRED,
+         (errorparameter_t)msg->trafficClass,
+         (errorparameter_t)0
+      );
+      return E_FAIL;
+   }
+   
    // retrieve the next hop from the routing table
    forwarding_getNextHop(&(msg->l3_destinationAdd),&(msg->l2_nextORpreviousHop));
    if (msg->l2_nextORpreviousHop.type==ADDR_NONE) {
@@ -13,6 +13,7 @@
 //=========================== define ==========================================
 
 #define RPL_HOPBYHOP_HEADER_OPTION_TYPE  0x63
+#define RPL_ROUTING_TYPE_SOURCE_ROUTE    3
 
 enum {
    PCKTFORWARD     = 1, // used by the node to indicate is forwarding a packet  -- either upstream or downstream
@@ -118,6 +118,57 @@ uint8_t icmpv6rpl_getRPLIntanceID(){
 	return icmpv6rpl_vars.dao.rplinstanceId;
 }
 
+/**
+\brief Retrieve the DODAGID of the DODAG this mote has joined.
+
+\param[out] DODAGID Where to write the 16-byte DODAGID.
+
+\returns TRUE if a DODAGID is known, FALSE otherwise.
+*/
+bool icmpv6rpl_getDODAGID(uint8_t* DODAGID) {
+   if (icmpv6rpl_vars.DODAGIDFlagSet==0) {
+      return FALSE;
+   }
+   memcpy(DODAGID,icmpv6rpl_vars.dio.DODAGID,sizeof(icmpv6rpl_vars.dio.DODAGID));
+   return TRUE;
+}
+
+/**
+\brief Set the DODAGID of the DODAG this mote belongs to.
+
+The DODAGID is used in the DIOs and DAOs this mote sends, and its first 8 bytes
+become this mote's prefix.
+
+\param[in] DODAGID The 16-byte DODAGID.
+*/
+void icmpv6rpl_setDODAGID(uint8_t* DODAGID) {
+   open_addr_t  myPrefix;
+   
+   // update DODAGID in DIO/DAO
+   memcpy(
+      &(icmpv6rpl_vars.dio.DODAGID[0]),
+      DODAGID,
+      sizeof(icmpv6rpl_vars.dio.DODAGID)
+   );
+   memcpy(
+      &(icmpv6rpl_vars.dao.DODAGID[0]),
+      DODAGID,
+      sizeof(icmpv6rpl_vars.dao.DODAGID)
+   );
+   
+   // remember I got a DODAGID
+   icmpv6rpl_vars.DODAGIDFlagSet=1;
+   
+   // update my prefix
+   myPrefix.type = ADDR_PREFIX;
+   memcpy(
+      myPrefix.prefix,
+      DODAGID,
+      sizeof(myPrefix.prefix)
+   );
+   idmanager_setMyID(&myPrefix);
+}
+
 /**
 \brief Called when DIO/DAO was sent.
 
@@ -150,7 +201,6 @@ void icmpv6rpl_sendDone(OpenQueueEntry_t* msg, owerror_t error) {
 */
 void icmpv6rpl_receive(OpenQueueEntry_t* msg) {
    uint8_t      icmpv6code;
-   open_addr_t  myPrefix;
    
    // take ownership
    msg->owner      = COMPONENT_ICMPv6RPL;
@@ -173,29 +223,8 @@ void icmpv6rpl_receive(OpenQueueEntry_t* msg) {
          // update neighbor table
          neighbors_indicateRxDIO(msg);
          
-         // update DODAGID in DIO/DAO
-         memcpy(
-            &(icmpv6rpl_vars.dio.DODAGID[0]),
-            &(((icmpv6rpl_dio_ht*)(msg->payload))->DODAGID[0]),
-            sizeof(icmpv6rpl_vars.dio.DODAGID)
-         );
-         memcpy(
-            &(icmpv6rpl_vars.dao.DODAGID[0]),
-            &(((icmpv6rpl_dio_ht*)(msg->payload))->DODAGID[0]),
-            sizeof(icmpv6rpl_vars.dao.DODAGID)
-         );
-         
-         // remember I got a DODAGID
-         icmpv6rpl_vars.DODAGIDFlagSet=1;
-         
-         // update my prefix
-         myPrefix.type = ADDR_PREFIX;
-         memcpy(
-            myPrefix.prefix,
-            &((icmpv6rpl_dio_ht*)(msg->payload))->DODAGID[0],
-            sizeof(myPrefix.prefix)
-         );
-         idmanager_setMyID(&myPrefix);
+         // update DODAGID in DIO/DAO, and my prefix
+         icmpv6rpl_setDODAGID(&(((icmpv6rpl_dio_ht*)(msg->payload))->DODAGID[0]));
          
          break;
       
@@ -246,8 +275,10 @@ void icmpv6rpl_timer_DIO_task() {
    // check whether we need to send DIO
    if (icmpv6rpl_vars.delayDIO==0) {
       
-      // send DIO
+      // send DIO, unless I'm a leaf, as no mote should pick me as parent
+#ifndef LEAF
       sendDIO();
+#endif
       
       // pick a new pseudo-random periodDIO
       icmpv6rpl_vars.periodDIO = TIMER_DIO_TIMEOUT+(openrandom_get16b()&0xff);
@@ -301,7 +332,7 @@ void sendDIO() {
    icmpv6rpl_vars.busySending = TRUE;
    
    // reserve a free packet buffer for DIO
-   msg = openqueue_getFreePacketBuffer(COMPONENT_ICMPv6RPL);
+   msg = openqueue_getFreePacketBufferOfClass(COMPONENT_ICMPv6RPL,TRAFFIC_CLASS_CONTROL);
    if (msg==NULL) {
       openserial_printError(COMPONENT_ICMPv6RPL,ERR_NO_FREE_PACKET_BUFFER,
                             (errorparameter_t)0,
@@ -428,7 +459,7 @@ void sendDAO() {
    // if you get here, you start construct DAO
    
    // reserve a free packet buffer for DAO
-   msg = openqueue_getFreePacketBuffer(COMPONENT_ICMPv6RPL);
+   msg = openqueue_getFreePacketBufferOfClass(COMPONENT_ICMPv6RPL,TRAFFIC_CLASS_CONTROL);
    if (msg==NULL) {
       openserial_printError(COMPONENT_ICMPv6RPL,ERR_NO_FREE_PACKET_BUFFER,
                             (errorparameter_t)0,
@@ -158,6 +158,8 @@ void icmpv6rpl_init(void);
 void icmpv6rpl_sendDone(OpenQueueEntry_t* msg, owerror_t error);
 void icmpv6rpl_receive(OpenQueueEntry_t* msg);
 uint8_t icmpv6rpl_getRPLIntanceID(void);
+bool    icmpv6rpl_getDODAGID(uint8_t* DODAGID);
+void    icmpv6rpl_setDODAGID(uint8_t* DODAGID);
 
 /**
 \}
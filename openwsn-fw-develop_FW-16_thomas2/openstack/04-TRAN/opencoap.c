@@ -426,6 +426,9 @@ owerror_t opencoap_send(
    
    // fill in packet metadata
    msg->l4_sourcePortORicmpv6Type   = WKP_UDP_COAP;
+   if (type==COAP_TYPE_CON) {
+      msg->l2_responseTimeout       = COAP_RESPONSE_TIMEOUT_MS;
+   }
    
    // pre-pend CoAP header (version,type,TKL,code,messageID,Token)
    packetfunctions_reserveHeaderSize(msg,5);
@@ -33,6 +33,17 @@ static const uint8_t ipAddr_motedata[]  = {0x20, 0x01, 0x04, 0x70, 0x00, 0x66, 0
 
 #define COAP_VERSION                   1
 
+/**
+\brief How long the response to a confirmable request may take, in ms.
+
+ACK_TIMEOUT times ACK_RANDOM_FACTOR (RFC7252), after which the request would
+be retransmitted. A leaf listens in shared cells this long after sending a
+confirmable request, which covers a piggybacked response. A separate response,
+or one which takes longer over several hops, only reaches a leaf in its wake
+window: a leaf expecting those needs a dedicated RX cell to its parent.
+*/
+#define COAP_RESPONSE_TIMEOUT_MS       3000
+
 typedef enum {
    COAP_TYPE_CON                       = 0,
    COAP_TYPE_NON                       = 1,
@@ -0,0 +1,40 @@
+#ifndef __AES128_H
+#define __AES128_H
+
+/**
+\addtogroup cross-layers
+\{
+\addtogroup AES128
+\{
+
+\brief Software AES-128 block cipher, encryption only.
+
+CCM* only ever runs the cipher forward, so there is no decryption. The round
+keys are expanded once per key by aes128_setKey(); encrypting a block is then
+10 rounds of table lookups, with no key expansion.
+*/
+
+#include "opendefs.h"
+
+//=========================== define ==========================================
+
+#define AES128_BLOCK_SIZE         16
+#define AES128_NUM_ROUNDS         10
+
+//=========================== typedef =========================================
+
+typedef struct {
+   uint32_t         roundKeys[4*(AES128_NUM_ROUNDS+1)]; // one 4-word key per round, and the initial one
+} aes128_key_t;
+
+//=========================== prototypes ======================================
+
+void aes128_setKey(aes128_key_t* key, uint8_t* rawKey);
+void aes128_encrypt(aes128_key_t* key, uint8_t* block);
+
+/**
+\}
+\}
+*/
+
+#endif
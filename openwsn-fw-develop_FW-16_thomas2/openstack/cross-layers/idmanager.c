@@ -40,6 +40,10 @@ void idmanager_init() {
 
    eui64_get(idmanager_vars.my64bID.addr_64b);
    packetfunctions_mac64bToMac16b(&idmanager_vars.my64bID,&idmanager_vars.my16bID);
+   
+   // my16bID identifies me over serial; a short address is only used on the
+   // air once my parent assigned me one
+   idmanager_vars.myShortAddr.type     = ADDR_NONE;
 }
 
 bool idmanager_getIsDAGroot() {
@@ -119,6 +123,31 @@ owerror_t idmanager_setMyID(open_addr_t* newID) {
    return E_SUCCESS;
 }
 
+/**
+\brief Get the short address assigned to me.
+
+\returns My short address, of type ADDR_NONE if I don't have one.
+*/
+open_addr_t* idmanager_getMyShortAddress() {
+   return &idmanager_vars.myShortAddr;
+}
+
+/**
+\brief Set the short address assigned to me.
+
+\param[in] newAddr My new short address, NULL to drop the one I have.
+*/
+void idmanager_setMyShortAddress(open_addr_t* newAddr) {
+   INTERRUPT_DECLARATION();
+   DISABLE_INTERRUPTS();
+   if (newAddr==NULL) {
+      idmanager_vars.myShortAddr.type = ADDR_NONE;
+   } else {
+      memcpy(&idmanager_vars.myShortAddr,newAddr,sizeof(open_addr_t));
+   }
+   ENABLE_INTERRUPTS();
+}
+
 bool idmanager_isMyAddress(open_addr_t* addr) {
    open_addr_t temp_my128bID;
    bool res;
@@ -127,7 +156,8 @@ bool idmanager_isMyAddress(open_addr_t* addr) {
 
    switch (addr->type) {
      case ADDR_16B:
-        res= packetfunctions_sameAddress(addr,&idmanager_vars.my16bID);
+        // only the assigned short address is unique in the network
+        res= packetfunctions_sameAddress(addr,&idmanager_vars.myShortAddr);
         ENABLE_INTERRUPTS();
         return res;
      case ADDR_64B:
@@ -207,8 +237,7 @@ bool debugPrint_id() {
    memcpy(output.my64bID,idmanager_vars.my64bID.addr_64b,8);
    memcpy(output.myPrefix,idmanager_vars.myPrefix.prefix,8);
    
-   openserial_printStatus(STATUS_ID,(uint8_t*)&output,sizeof(debugIDManagerEntry_t));
-   return TRUE;
+   return openserial_printStatusDelta(STATUS_ID,NULL,(uint8_t*)&output,sizeof(debugIDManagerEntry_t));
 }
 
 
@@ -38,6 +38,7 @@ typedef struct {
    open_addr_t   my16bID;
    open_addr_t   my64bID;
    open_addr_t   myPrefix;
+   open_addr_t   myShortAddr;  // short address used on the air, ADDR_NONE until assigned
 } idmanager_vars_t;
 
 //=========================== prototypes ======================================
@@ -47,6 +48,8 @@ bool         idmanager_getIsDAGroot(void);
 void         idmanager_setIsDAGroot(bool newRole);
 open_addr_t* idmanager_getMyID(uint8_t type);
 owerror_t    idmanager_setMyID(open_addr_t* newID);
+open_addr_t* idmanager_getMyShortAddress(void);
+void         idmanager_setMyShortAddress(open_addr_t* newAddr);
 bool         idmanager_isMyAddress(open_addr_t* addr);
 void         idmanager_triggerAboutRoot(void);
 
@@ -11,6 +11,12 @@ openqueue_vars_t openqueue_vars;
 //=========================== prototypes ======================================
 
 void openqueue_reset_entry(OpenQueueEntry_t* entry);
+bool openqueue_admits(uint8_t trafficClass, OpenQueueEntry_t* pkt);
+bool openqueue_isMoreUrgent(OpenQueueEntry_t* pkt, OpenQueueEntry_t* than);
+OpenQueueEntry_t* openqueue_pickVictim(uint8_t trafficClass);
+void openqueue_setDefaultLifetime(OpenQueueEntry_t* pkt);
+void openqueue_getCurrentAsn(asn_t* asn);
+bool openqueue_isPast(asn_t* deadline, asn_t* now);
 
 //=========================== public ==========================================
 
@@ -24,6 +30,7 @@ void openqueue_init() {
    for (i=0;i<QUEUELENGTH;i++){
       openqueue_reset_entry(&(openqueue_vars.queue[i]));
    }
+   openqueue_vars.allocSeqNum = 0;
 }
 
 /**
@@ -41,8 +48,7 @@ bool debugPrint_queue() {
       output[i].creator = openqueue_vars.queue[i].creator;
       output[i].owner   = openqueue_vars.queue[i].owner;
    }
-   openserial_printStatus(STATUS_QUEUE,(uint8_t*)&output,QUEUELENGTH*sizeof(debugOpenQueueEntry_t));
-   return TRUE;
+   return openserial_printStatusDelta(STATUS_QUEUE,NULL,(uint8_t*)&output,QUEUELENGTH*sizeof(debugOpenQueueEntry_t));
 }
 
 //======= called by any component
@@ -51,7 +57,8 @@ bool debugPrint_queue() {
 \brief Request a new (free) packet buffer.
 
 Component throughout the protocol stack can call this function is they want to
-get a new packet buffer to start creating a new packet.
+get a new packet buffer to start creating a new packet. The packet is of the
+TRAFFIC_CLASS_NORMAL class.
 
 \note Once a packet has been allocated, it is up to the creator of the packet
       to free it using the openqueue_freePacketBuffer() function.
@@ -60,6 +67,32 @@ get a new packet buffer to start creating a new packet.
          it could not be allocated (buffer full or not synchronized).
 */
 OpenQueueEntry_t* openqueue_getFreePacketBuffer(uint8_t creator) {
+   return openqueue_getFreePacketBufferOfClass(creator,TRAFFIC_CLASS_NORMAL);
+}
+
+/**
+\brief Request a new (free) packet buffer for a packet of a given class.
+
+The class decides in which order the MAC sends the packets, and how many
+entries the packet may find free: entries are kept for the more urgent classes,
+so a burst of bulk data cannot keep network control packets out of the queue.
+When no entry is left for the class, a packet waiting for the MAC is dropped
+to make room, see openqueue_pickVictim().
+
+The packet gets the default lifetime of its class, if any.
+
+\note A packet with a deadline may be dropped from the queue without its
+      creator being told, so its creator must not keep any state about it.
+
+\param creator      The identifier of the component, taken in COMPONENT_*.
+\param trafficClass The class of the packet, taken in TRAFFIC_CLASS_*.
+
+\returns A pointer to the queue entry when it could be allocated, or NULL when
+         it could not be allocated (no entry left for that class, or not
+         synchronized).
+*/
+OpenQueueEntry_t* openqueue_getFreePacketBufferOfClass(uint8_t creator, uint8_t trafficClass) {
+   OpenQueueEntry_t* victim;
    uint8_t i;
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
@@ -70,6 +103,24 @@ OpenQueueEntry_t* openqueue_getFreePacketBuffer(uint8_t creator) {
      return NULL;
    }
    
+   // the entries left are kept for more urgent classes, drop a less useful
+   // packet, if any, to make room
+   if (openqueue_admits(trafficClass,NULL)==FALSE) {
+     victim = openqueue_pickVictim(trafficClass);
+     if (victim==NULL) {
+        ENABLE_INTERRUPTS();
+        return NULL;
+     }
+     openserial_printError(COMPONENT_OPENQUEUE,ERR_PACKET_EVICTED,
+                           (errorparameter_t)victim->trafficClass,
+                           (errorparameter_t)trafficClass);
+     openqueue_reset_entry(victim);
+     if (openqueue_admits(trafficClass,NULL)==FALSE) {
+        ENABLE_INTERRUPTS();
+        return NULL;
+     }
+   }
+   
    // if you get here, I will try to allocate a buffer for you
    
    // walk through queue and find free entry
@@ -77,6 +128,9 @@ OpenQueueEntry_t* openqueue_getFreePacketBuffer(uint8_t creator) {
       if (openqueue_vars.queue[i].owner==COMPONENT_NULL) {
          openqueue_vars.queue[i].creator=creator;
          openqueue_vars.queue[i].owner=COMPONENT_OPENQUEUE;
+         openqueue_vars.queue[i].trafficClass=trafficClass;
+         openqueue_vars.queue[i].allocSeqNum=openqueue_vars.allocSeqNum++;
+         openqueue_setDefaultLifetime(&openqueue_vars.queue[i]);
          ENABLE_INTERRUPTS(); 
          return &openqueue_vars.queue[i];
       }
@@ -85,6 +139,77 @@ OpenQueueEntry_t* openqueue_getFreePacketBuffer(uint8_t creator) {
    return NULL;
 }
 
+/**
+\brief Change the class of an allocated packet.
+
+Used when relaying, as the entry of a received packet is allocated before its
+class is known. The packet must fit in the entries its new class may take. It
+gets the default lifetime of its new class, if any.
+
+\param pkt          A pointer to the allocated packet buffer.
+\param trafficClass The new class of the packet, taken in TRAFFIC_CLASS_*.
+
+\returns E_SUCCESS when the packet now belongs to that class.
+\returns E_FAIL when it uses an entry kept for a more urgent class; the packet
+   is left unchanged, and it is up to the caller to free it.
+*/
+owerror_t openqueue_setTrafficClass(OpenQueueEntry_t* pkt, uint8_t trafficClass) {
+   INTERRUPT_DECLARATION();
+   DISABLE_INTERRUPTS();
+   if (trafficClass>pkt->trafficClass && openqueue_admits(trafficClass,pkt)==FALSE) {
+      ENABLE_INTERRUPTS();
+      return E_FAIL;
+   }
+   pkt->trafficClass = trafficClass;
+   openqueue_setDefaultLifetime(pkt);
+   ENABLE_INTERRUPTS();
+   return E_SUCCESS;
+}
+
+/**
+\brief Set the deadline of a packet, relative to now.
+
+Creators which know an absolute deadline set the packet's \c deadline and
+\c hasDeadline fields directly.
+
+\param pkt      A pointer to the allocated packet buffer.
+\param lifetime Number of slots from now during which the packet is worth
+   sending.
+*/
+void openqueue_setLifetime(OpenQueueEntry_t* pkt, uint16_t lifetime) {
+   asn_t    now;
+   uint16_t bytes0and1;
+   
+   openqueue_getCurrentAsn(&now);
+   bytes0and1                  = now.bytes0and1+lifetime;
+   pkt->deadline.bytes0and1    = bytes0and1;
+   pkt->deadline.bytes2and3    = now.bytes2and3;
+   pkt->deadline.byte4         = now.byte4;
+   if (bytes0and1<now.bytes0and1) {
+      // carry
+      pkt->deadline.bytes2and3++;
+      if (pkt->deadline.bytes2and3==0) {
+         pkt->deadline.byte4++;
+      }
+   }
+   pkt->hasDeadline            = TRUE;
+}
+
+/**
+\brief Whether a packet is past its deadline.
+
+\returns TRUE if the packet has a deadline, and it has passed.
+*/
+bool openqueue_isExpired(OpenQueueEntry_t* pkt) {
+   asn_t now;
+   
+   if (pkt->hasDeadline==FALSE || ieee154e_isSynch()==FALSE) {
+      return FALSE;
+   }
+   openqueue_getCurrentAsn(&now);
+   return openqueue_isPast(&pkt->deadline,&now);
+}
+
 
 /**
 \brief Free a previously-allocated packet buffer.
@@ -185,19 +310,81 @@ OpenQueueEntry_t* openqueue_sixtopGetReceivedPacket() {
    return NULL;
 }
 
+/**
+\brief Check whether a packet from the upper layers is waiting to be sent to
+   some neighbor.
+
+Packets created by sixtop (EBs and KAs) are not considered. Packets the MAC
+already claimed for an upcoming cell are.
+
+\param toNeighbor The neighbor the packet is unicast to.
+
+\returns TRUE if such a packet is waiting for the MAC, FALSE otherwise.
+*/
+bool openqueue_sixtopHasPacketTo(open_addr_t* toNeighbor) {
+   uint8_t i;
+   INTERRUPT_DECLARATION();
+   DISABLE_INTERRUPTS();
+   for (i=0;i<QUEUELENGTH;i++) {
+      if ((openqueue_vars.queue[i].owner==COMPONENT_SIXTOP_TO_IEEE802154E ||
+           openqueue_vars.queue[i].owner==COMPONENT_IEEE802154E) &&
+          openqueue_vars.queue[i].creator!=COMPONENT_SIXTOP &&
+          openqueue_vars.queue[i].creator!=COMPONENT_IEEE802154E &&
+          packetfunctions_sameAddress(toNeighbor,&openqueue_vars.queue[i].l2_nextORpreviousHop)) {
+         ENABLE_INTERRUPTS();
+         return TRUE;
+      }
+   }
+   ENABLE_INTERRUPTS();
+   return FALSE;
+}
+
+/**
+\brief Free a packet handed to the MAC, unless the MAC is already sending it.
+
+\param pkt A pointer to the packet to withdraw.
+
+\returns E_SUCCESS when the packet was still waiting and was freed.
+\returns E_FAIL when the MAC owns the packet.
+*/
+owerror_t openqueue_sixtopWithdrawPacket(OpenQueueEntry_t* pkt) {
+   INTERRUPT_DECLARATION();
+   DISABLE_INTERRUPTS();
+   if (pkt->owner!=COMPONENT_SIXTOP_TO_IEEE802154E) {
+      ENABLE_INTERRUPTS();
+      return E_FAIL;
+   }
+   openqueue_reset_entry(pkt);
+   ENABLE_INTERRUPTS();
+   return E_SUCCESS;
+}
+
 //======= called by IEEE80215E
 
+/**
+\brief Pick the packet the MAC sends next to some neighbor.
+
+Of the packets waiting for that neighbor, the one of the most urgent class is
+picked, and the oldest one when several are of that class.
+
+\param toNeighbor The neighbor of the cell, or an anycast address for a
+   shared cell.
+
+\returns The packet to send, or NULL if no packet is waiting.
+*/
 OpenQueueEntry_t* openqueue_macGetDataPacket(open_addr_t* toNeighbor) {
+   OpenQueueEntry_t* pkt;
    uint8_t i;
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
+   pkt = NULL;
    if (toNeighbor->type==ADDR_64B) {
       // a neighbor is specified, look for a packet unicast to that neigbhbor
       for (i=0;i<QUEUELENGTH;i++) {
          if (openqueue_vars.queue[i].owner==COMPONENT_SIXTOP_TO_IEEE802154E &&
-            packetfunctions_sameAddress(toNeighbor,&openqueue_vars.queue[i].l2_nextORpreviousHop)) {
-            ENABLE_INTERRUPTS();
-            return &openqueue_vars.queue[i];
+            packetfunctions_sameAddress(toNeighbor,&openqueue_vars.queue[i].l2_nextORpreviousHop) &&
+            openqueue_isMoreUrgent(&openqueue_vars.queue[i],pkt)) {
+            pkt = &openqueue_vars.queue[i];
          }
       }
    } else if (toNeighbor->type==ADDR_ANYCAST) {
@@ -210,15 +397,15 @@ OpenQueueEntry_t* openqueue_macGetDataPacket(open_addr_t* toNeighbor) {
                    openqueue_vars.queue[i].creator==COMPONENT_SIXTOP &&
                    packetfunctions_isBroadcastMulticast(&(openqueue_vars.queue[i].l2_nextORpreviousHop))==FALSE
                 )
-             )
+             ) &&
+             openqueue_isMoreUrgent(&openqueue_vars.queue[i],pkt)
             ) {
-            ENABLE_INTERRUPTS();
-            return &openqueue_vars.queue[i];
+            pkt = &openqueue_vars.queue[i];
          }
       }
    }
    ENABLE_INTERRUPTS();
-   return NULL;
+   return pkt;
 }
 
 OpenQueueEntry_t* openqueue_macGetAdvPacket() {
@@ -245,6 +432,8 @@ void openqueue_reset_entry(OpenQueueEntry_t* entry) {
    entry->owner                        = COMPONENT_NULL;
    entry->payload                      = &(entry->packet[127]);
    entry->length                       = 0;
+   entry->trafficClass                 = TRAFFIC_CLASS_NORMAL;
+   entry->hasDeadline                  = FALSE;
    //l4
    entry->l4_protocol                  = IANA_UNDEFINED;
    //l3
@@ -254,5 +443,165 @@ void openqueue_reset_entry(OpenQueueEntry_t* entry) {
    entry->l2_nextORpreviousHop.type    = ADDR_NONE;
    entry->l2_frameType                 = IEEE154_TYPE_UNDEFINED;
    entry->l2_retriesLeft               = 0;
+   entry->l2_responseTimeout           = 0;
    entry->l2_IEListPresent             = 0;
+   entry->l2_securityLevel             = IEEE154_ASH_SLF_TYPE_NOSEC;
+}
+
+/**
+\brief Whether a packet of some class may take an entry.
+
+Taking the entry must leave free at least the entries kept for the classes
+more urgent than that class.
+
+\param trafficClass The class of the packet, taken in TRAFFIC_CLASS_*.
+\param pkt          The entry the packet already holds, counted as free, or
+   NULL for a new packet.
+*/
+bool openqueue_admits(uint8_t trafficClass, OpenQueueEntry_t* pkt) {
+   uint8_t numFree;
+   uint8_t numReserved;
+   uint8_t i;
+   
+   numFree = 0;
+   for (i=0;i<QUEUELENGTH;i++) {
+      if (openqueue_vars.queue[i].owner==COMPONENT_NULL || &openqueue_vars.queue[i]==pkt) {
+         numFree++;
+      }
+   }
+   
+   numReserved = 0;
+   if (trafficClass>TRAFFIC_CLASS_CONTROL) {
+      numReserved += QUEUE_RESERVED_CONTROL;
+   }
+   if (trafficClass>TRAFFIC_CLASS_NORMAL) {
+      numReserved += QUEUE_RESERVED_NORMAL;
+   }
+   
+   return numFree>numReserved;
+}
+
+/**
+\brief Whether the MAC should send a packet before another one.
+
+\param pkt  The candidate packet.
+\param than The best packet found so far, or NULL if none.
+*/
+bool openqueue_isMoreUrgent(OpenQueueEntry_t* pkt, OpenQueueEntry_t* than) {
+   if (than==NULL) {
+      return TRUE;
+   }
+   if (pkt->trafficClass!=than->trafficClass) {
+      return pkt->trafficClass<than->trafficClass;
+   }
+   // the sequence numbers wrap around, compare their distance
+   return (int16_t)(pkt->allocSeqNum-than->allocSeqNum)<0;
+}
+
+/**
+\brief Pick the packet to drop to make room for a new one.
+
+Only packets waiting for the MAC are dropped, and only those whose creator
+does not expect to be told: relayed packets, and packets with a deadline. A
+packet past its deadline is dropped first. Otherwise, the oldest packet of the
+least urgent class is, if that class is not more urgent than the new packet's.
+Network control packets are only dropped once past their deadline.
+
+\param trafficClass The class of the new packet, taken in TRAFFIC_CLASS_*.
+
+\returns The packet to drop, or NULL if none should be.
+*/
+OpenQueueEntry_t* openqueue_pickVictim(uint8_t trafficClass) {
+   OpenQueueEntry_t* victim;
+   OpenQueueEntry_t* entry;
+   asn_t             now;
+   bool              isSynch;
+   uint8_t           i;
+   
+   isSynch = ieee154e_isSynch();
+   if (isSynch==TRUE) {
+      openqueue_getCurrentAsn(&now);
+   }
+   
+   victim = NULL;
+   for (i=0;i<QUEUELENGTH;i++) {
+      entry = &openqueue_vars.queue[i];
+      if (
+            entry->owner!=COMPONENT_SIXTOP_TO_IEEE802154E ||
+            (entry->creator!=COMPONENT_FORWARDING && entry->hasDeadline==FALSE)
+         ) {
+         continue;
+      }
+      if (isSynch==TRUE && entry->hasDeadline==TRUE && openqueue_isPast(&entry->deadline,&now)) {
+         return entry;
+      }
+      if (
+            entry->trafficClass==TRAFFIC_CLASS_CONTROL ||
+            entry->trafficClass<trafficClass
+         ) {
+         continue;
+      }
+      if (
+            victim==NULL                                ||
+            entry->trafficClass>victim->trafficClass    ||
+            (
+               entry->trafficClass==victim->trafficClass &&
+               (int16_t)(entry->allocSeqNum-victim->allocSeqNum)<0
+            )
+         ) {
+         victim = entry;
+      }
+   }
+   return victim;
+}
+
+/**
+\brief Give a packet the default lifetime of its class.
+*/
+void openqueue_setDefaultLifetime(OpenQueueEntry_t* pkt) {
+   uint16_t lifetime;
+   
+   switch (pkt->trafficClass) {
+      case TRAFFIC_CLASS_CONTROL:
+         lifetime = QUEUE_LIFETIME_CONTROL;
+         break;
+      case TRAFFIC_CLASS_ALARM:
+         lifetime = QUEUE_LIFETIME_ALARM;
+         break;
+      case TRAFFIC_CLASS_NORMAL:
+         lifetime = QUEUE_LIFETIME_NORMAL;
+         break;
+      default:
+         lifetime = QUEUE_LIFETIME_BULK;
+         break;
+   }
+   if (lifetime>0) {
+      openqueue_setLifetime(pkt,lifetime);
+   } else {
+      pkt->hasDeadline = FALSE;
+   }
+}
+
+void openqueue_getCurrentAsn(asn_t* asn) {
+   uint8_t array[5];
+   
+   ieee154e_getAsn(array);
+   asn->bytes0and1 = ((uint16_t) array[1] << 8) | ((uint16_t) array[0]);
+   asn->bytes2and3 = ((uint16_t) array[3] << 8) | ((uint16_t) array[2]);
+   asn->byte4      = array[4];
+}
+
+/**
+\brief Whether a deadline has passed.
+
+\returns TRUE if \c now is after \c deadline.
+*/
+bool openqueue_isPast(asn_t* deadline, asn_t* now) {
+   if (now->byte4!=deadline->byte4) {
+      return now->byte4>deadline->byte4;
+   }
+   if (now->bytes2and3!=deadline->bytes2and3) {
+      return now->bytes2and3>deadline->bytes2and3;
+   }
+   return now->bytes0and1>deadline->bytes0and1;
 }
@@ -15,6 +15,16 @@
 
 #define QUEUELENGTH  10
 
+// entries kept free for the more urgent traffic classes, see openqueue_admits()
+#define QUEUE_RESERVED_CONTROL    2 // only network control can take these
+#define QUEUE_RESERVED_NORMAL     2 // bulk data cannot take these
+
+// default lifetime of a packet, in slots, 0 for no deadline
+#define QUEUE_LIFETIME_CONTROL    0
+#define QUEUE_LIFETIME_ALARM      0
+#define QUEUE_LIFETIME_NORMAL     0
+#define QUEUE_LIFETIME_BULK       2000 // 30s with 15ms slots
+
 //=========================== typedef =========================================
 
 typedef struct {
@@ -26,6 +36,7 @@ typedef struct {
 
 typedef struct {
    OpenQueueEntry_t queue[QUEUELENGTH];
+   uint16_t         allocSeqNum;          // stamps the entries in the order they are allocated
 } openqueue_vars_t;
 
 //=========================== prototypes ======================================
@@ -35,12 +46,18 @@ void               openqueue_init(void);
 bool               debugPrint_queue(void);
 // called by any component
 OpenQueueEntry_t*  openqueue_getFreePacketBuffer(uint8_t creator);
+OpenQueueEntry_t*  openqueue_getFreePacketBufferOfClass(uint8_t creator, uint8_t trafficClass);
+owerror_t          openqueue_setTrafficClass(OpenQueueEntry_t* pkt, uint8_t trafficClass);
+void               openqueue_setLifetime(OpenQueueEntry_t* pkt, uint16_t lifetime);
+bool               openqueue_isExpired(OpenQueueEntry_t* pkt);
 owerror_t         openqueue_freePacketBuffer(OpenQueueEntry_t* pkt);
 void               openqueue_removeAllCreatedBy(uint8_t creator);
 void               openqueue_removeAllOwnedBy(uint8_t owner);
 // called by res
 OpenQueueEntry_t*  openqueue_sixtopGetSentPacket(void);
 OpenQueueEntry_t*  openqueue_sixtopGetReceivedPacket(void);
+bool               openqueue_sixtopHasPacketTo(open_addr_t* toNeighbor);
+owerror_t          openqueue_sixtopWithdrawPacket(OpenQueueEntry_t* pkt);
 // called by IEEE80215E
 OpenQueueEntry_t*  openqueue_macGetDataPacket(open_addr_t* toNeighbor);
 OpenQueueEntry_t*  openqueue_macGetAdvPacket(void);
@@ -0,0 +1,458 @@
+#include "opendefs.h"
+#include "persist.h"
+#include "nvmem.h"
+#include "openserial.h"
+#include "openhdlc.h"
+#include "opentimers.h"
+#include "scheduler.h"
+#include "idmanager.h"
+#include "IEEE802154E.h"
+#include "schedule.h"
+#include "neighbors.h"
+#include "icmpv6rpl.h"
+
+//=========================== defines =========================================
+
+#define PERSIST_RECORDS_PER_PAGE  (PORT_NVMEM_PAGE_SIZE/sizeof(persistRecord_t))
+#define PERSIST_NUM_RECORDS       (PERSIST_RECORDS_PER_PAGE*PORT_NVMEM_NUM_PAGES)
+
+//=========================== variables =======================================
+
+persist_vars_t persist_vars;
+
+//=========================== prototypes ======================================
+
+void     persist_timer_cb(void);
+void     persist_timer_task(void);
+bool     persist_load(void);
+void     persist_restore(void);
+void     persist_restoreNeighbors(void);
+void     persist_checkpoint(void);
+void     persist_buildRecord(void);
+void     persist_tryWrite(void);
+owerror_t persist_write(void);
+bool     persist_isErased(uint16_t address);
+uint16_t persist_recordAddress(uint16_t index);
+uint16_t persist_signature(void);
+uint16_t persist_checksum(void);
+
+//=========================== public ==========================================
+
+/**
+\brief Initialize this module, restoring the state saved before the reboot.
+
+The dedicated cells and the DODAGID are restored right away. The neighbors are
+restored once the mote has synchronized, so their "last heard" ASN is
+meaningful.
+
+\note Call this function after all the modules it restores state into have
+   been initialized.
+*/
+void persist_init() {
+
+   // clear module variables
+   memset(&persist_vars,0,sizeof(persist_vars_t));
+
+   nvmem_init();
+
+   // restore the most recent record, if any
+   if (persist_load()==TRUE) {
+      persist_restore();
+   }
+
+   persist_vars.timerId = opentimers_start(
+      persist_vars.restorePending ? PERSIST_SYNC_PERIOD : PERSIST_CHECK_PERIOD,
+      TIMER_PERIODIC,
+      TIME_MS,
+      persist_timer_cb
+   );
+}
+
+//=========================== private =========================================
+
+/**
+\note This function is executed in interrupt context, and should only push a
+   task.
+*/
+void persist_timer_cb() {
+   scheduler_push_task(persist_timer_task,TASKPRIO_PERSIST);
+}
+
+/**
+\note This function is executed in task context, called by the scheduler.
+*/
+void persist_timer_task() {
+   if (persist_vars.restorePending==TRUE) {
+      if (ieee154e_isSynch()==FALSE) {
+         return;
+      }
+      persist_restoreNeighbors();
+      opentimers_setPeriod(
+         persist_vars.timerId,
+         TIME_MS,
+         PERSIST_CHECK_PERIOD
+      );
+      return;
+   }
+
+   if (persist_vars.writePending==TRUE) {
+      persist_tryWrite();
+      return;
+   }
+
+   persist_checkpoint();
+}
+
+//===== restoring
+
+/**
+\brief Find the most recent valid record, and read it into persist_vars.record.
+
+\returns TRUE if a valid record was found, FALSE otherwise.
+*/
+bool persist_load() {
+   uint16_t i;
+   uint16_t best;
+   uint16_t bestSeqNum;
+   bool     found;
+
+   found      = FALSE;
+   best       = 0;
+   bestSeqNum = 0;
+   for (i=0;i<PERSIST_NUM_RECORDS;i++) {
+      nvmem_read(
+         persist_recordAddress(i),
+         (uint8_t*)&persist_vars.record,
+         sizeof(persistRecord_t)
+      );
+      if (
+            persist_vars.record.magic!=PERSIST_MAGIC ||
+            persist_vars.record.checksum!=persist_checksum()
+         ) {
+         continue;
+      }
+      // sequence numbers wrap around
+      if (found==FALSE || (int16_t)(persist_vars.record.seqNum-bestSeqNum)>0) {
+         found      = TRUE;
+         best       = i;
+         bestSeqNum = persist_vars.record.seqNum;
+      }
+   }
+
+   if (found==FALSE) {
+      persist_vars.nextRecord = 0;
+      return FALSE;
+   }
+
+   nvmem_read(
+      persist_recordAddress(best),
+      (uint8_t*)&persist_vars.record,
+      sizeof(persistRecord_t)
+   );
+   persist_vars.haveWritten      = TRUE;
+   persist_vars.lastSeqNum       = bestSeqNum;
+   persist_vars.nextRecord       = (best+1)%PERSIST_NUM_RECORDS;
+   persist_vars.writtenSignature = persist_signature();
+   return TRUE;
+}
+
+/**
+\brief Restore the cells and DODAGID of persist_vars.record.
+*/
+void persist_restore() {
+   open_addr_t neighbor;
+   uint8_t     i;
+
+   // dedicated cells, which the neighbor at the other end still has
+   for (i=0;i<persist_vars.record.numCells && i<MAXACTIVESLOTS;i++) {
+      neighbor.type = ADDR_64B;
+      memcpy(neighbor.addr_64b,persist_vars.record.cells[i].neighbor,LENGTH_ADDR64b);
+      schedule_addActiveSlot(
+         persist_vars.record.cells[i].slotOffset,
+         (cellType_t)persist_vars.record.cells[i].type,
+         FALSE,
+         persist_vars.record.cells[i].channelOffset,
+         &neighbor
+      );
+   }
+
+   // DODAGID (the DAGroot sets its own)
+   if (
+         idmanager_getIsDAGroot()==FALSE &&
+         persist_vars.record.DODAGIDSet==TRUE
+      ) {
+      icmpv6rpl_setDODAGID(persist_vars.record.DODAGID);
+   }
+
+   if (persist_vars.record.numNeighbors>0) {
+      persist_vars.restorePending = TRUE;
+   } else {
+      openserial_printInfo(COMPONENT_PERSIST,ERR_PERSIST_RESTORED,
+                           (errorparameter_t)persist_vars.record.numCells,
+                           (errorparameter_t)0);
+   }
+}
+
+/**
+\brief Restore the neighbors of the record read at boot.
+
+\pre The mote is synchronized.
+*/
+void persist_restoreNeighbors() {
+   open_addr_t neighbor;
+   uint8_t     i;
+
+   // persist_vars.record still holds the record read at boot
+   for (i=0;i<persist_vars.record.numNeighbors && i<MAXNUMNEIGHBORS;i++) {
+      neighbor.type = ADDR_64B;
+      memcpy(neighbor.addr_64b,persist_vars.record.neighbors[i].addr_64b,LENGTH_ADDR64b);
+      neighbors_restoreNeighbor(&neighbor,persist_vars.record.neighbors[i].DAGrank);
+   }
+   neighbors_updateMyDAGrankAndNeighborPreference();
+
+   persist_vars.restorePending = FALSE;
+
+   openserial_printInfo(COMPONENT_PERSIST,ERR_PERSIST_RESTORED,
+                        (errorparameter_t)persist_vars.record.numCells,
+                        (errorparameter_t)persist_vars.record.numNeighbors);
+}
+
+//===== saving
+
+/**
+\brief Save the state if it changed, and has not changed since the last check.
+
+Waiting for the state to be stable over a full check period filters out the
+short-lived changes of a network being formed, which would otherwise wear the
+non-volatile memory out for nothing.
+*/
+void persist_checkpoint() {
+   uint16_t signature;
+
+   // the state of a mote which is not part of the network is not worth keeping
+   if (ieee154e_isSynch()==FALSE) {
+      return;
+   }
+
+   persist_buildRecord();
+   if (
+         idmanager_getIsDAGroot()==FALSE &&
+         (
+            persist_vars.record.DODAGIDSet==FALSE ||
+            persist_vars.record.numNeighbors==0
+         )
+      ) {
+      return;
+   }
+
+   signature = persist_signature();
+   if (
+         signature==persist_vars.checkedSignature &&
+         (
+            persist_vars.haveWritten==FALSE ||
+            signature!=persist_vars.writtenSignature
+         )
+      ) {
+      persist_tryWrite();
+   }
+   persist_vars.checkedSignature    = signature;
+}
+
+/**
+\brief Gather the current state into persist_vars.record.
+*/
+void persist_buildRecord() {
+   slotinfo_element_t  cell;
+   open_addr_t         address;
+   dagrank_t           DAGrank;
+   uint8_t             parentPreference;
+   persistNeighbor_t*  entry;
+   uint8_t             i;
+
+   // unused entries are all 0's, so they do not change the signature
+   memset(&persist_vars.record,0,sizeof(persistRecord_t));
+
+   for (i=0;i<MAXACTIVESLOTS;i++) {
+      if (schedule_getDedicatedCell(i,&cell)==FALSE) {
+         continue;
+      }
+      persist_vars.record.cells[persist_vars.record.numCells].slotOffset    = cell.slotOffset;
+      persist_vars.record.cells[persist_vars.record.numCells].type          = cell.link_type;
+      persist_vars.record.cells[persist_vars.record.numCells].channelOffset = cell.channelOffset;
+      memcpy(
+         persist_vars.record.cells[persist_vars.record.numCells].neighbor,
+         cell.address,
+         LENGTH_ADDR64b
+      );
+      persist_vars.record.numCells++;
+   }
+
+   // only the neighbors I heard a DIO from can be routing parents
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      if (
+            neighbors_getNeighborInfo(i,&address,&DAGrank,&parentPreference)==FALSE ||
+            DAGrank==DEFAULTDAGRANK
+         ) {
+         continue;
+      }
+      entry = &persist_vars.record.neighbors[persist_vars.record.numNeighbors];
+      memcpy(entry->addr_64b,address.addr_64b,LENGTH_ADDR64b);
+      entry->DAGrank  = DAGrank;
+      entry->isParent = (parentPreference==MAXPREFERENCE);
+      persist_vars.record.numNeighbors++;
+   }
+
+   persist_vars.record.DODAGIDSet = icmpv6rpl_getDODAGID(persist_vars.record.DODAGID);
+}
+
+/**
+\brief Write persist_vars.record, or keep trying until the MAC leaves time for it.
+
+While a write is pending, the timer fires every PERSIST_RETRY_PERIOD and the
+record is left untouched, so the state written is the one found stable.
+*/
+void persist_tryWrite() {
+   if (persist_write()==E_SUCCESS) {
+      persist_vars.writtenSignature = persist_signature();
+      if (persist_vars.writePending==TRUE) {
+         persist_vars.writePending  = FALSE;
+         opentimers_setPeriod(
+            persist_vars.timerId,
+            TIME_MS,
+            PERSIST_CHECK_PERIOD
+         );
+      }
+   } else if (persist_vars.writePending==FALSE) {
+      persist_vars.writePending     = TRUE;
+      opentimers_setPeriod(
+         persist_vars.timerId,
+         TIME_MS,
+         PERSIST_RETRY_PERIOD
+      );
+   }
+}
+
+/**
+\brief Append persist_vars.record to the log in non-volatile memory.
+
+Records are written one after the other, and a page is erased only when the
+first record in it is about to be written, so the pages wear evenly and the
+most recent record is never erased.
+
+The CPU stalls while the flash is erased or programmed, with the interrupts of
+the MAC held off. The write is only done when the MAC sleeps long enough for
+it, so no slot is missed.
+
+\returns E_SUCCESS if the record was written, E_FAIL if the MAC needs the CPU
+   before the write would be done.
+*/
+owerror_t persist_write() {
+   uint16_t index;
+   bool     erase;
+   uint32_t duration;
+
+   index = persist_vars.nextRecord;
+   erase = FALSE;
+   if (index%PERSIST_RECORDS_PER_PAGE==0) {
+      erase = TRUE;
+   } else if (persist_isErased(persist_recordAddress(index))==FALSE) {
+      // a write was interrupted by a reset, start over on the next page
+      index = ((index/PERSIST_RECORDS_PER_PAGE+1)%PORT_NVMEM_NUM_PAGES)*PERSIST_RECORDS_PER_PAGE;
+      erase = TRUE;
+   }
+
+   // time the CPU is stalled, in us
+   duration = (sizeof(persistRecord_t)/4)*PORT_NVMEM_WRITE_US;
+   if (erase==TRUE) {
+      duration += PORT_NVMEM_ERASE_US;
+   }
+   if (ieee154e_getTimeToNextSlot()<duration/US_PER_TICK+PERSIST_GUARD) {
+      return E_FAIL;
+   }
+
+   if (erase==TRUE) {
+      nvmem_erasePage(index/PERSIST_RECORDS_PER_PAGE);
+   }
+
+   persist_vars.record.magic    = PERSIST_MAGIC;
+   persist_vars.record.seqNum   = persist_vars.lastSeqNum+1;
+   persist_vars.record.checksum = persist_checksum();
+   nvmem_write(
+      persist_recordAddress(index),
+      (uint8_t*)&persist_vars.record,
+      sizeof(persistRecord_t)
+   );
+
+   persist_vars.haveWritten     = TRUE;
+   persist_vars.lastSeqNum      = persist_vars.record.seqNum;
+   persist_vars.nextRecord      = (index+1)%PERSIST_NUM_RECORDS;
+   return E_SUCCESS;
+}
+
+//===== helpers
+
+bool persist_isErased(uint16_t address) {
+   uint8_t  buf[20];
+   uint16_t done;
+   uint16_t chunk;
+   uint8_t  i;
+
+   for (done=0;done<sizeof(persistRecord_t);done+=chunk) {
+      chunk = sizeof(persistRecord_t)-done;
+      if (chunk>sizeof(buf)) {
+         chunk = sizeof(buf);
+      }
+      nvmem_read(address+done,buf,chunk);
+      for (i=0;i<chunk;i++) {
+         if (buf[i]!=0xff) {
+            return FALSE;
+         }
+      }
+   }
+   return TRUE;
+}
+
+uint16_t persist_recordAddress(uint16_t index) {
+   return (index/PERSIST_RECORDS_PER_PAGE)*PORT_NVMEM_PAGE_SIZE+
+          (index%PERSIST_RECORDS_PER_PAGE)*sizeof(persistRecord_t);
+}
+
+/**
+\brief Signature of the part of the state worth saving.
+
+The DAGrank of the neighbors is left out: it changes all the time, and a stale
+value is corrected by the first DIO heard after a reboot.
+*/
+uint16_t persist_signature() {
+   uint16_t crc;
+   uint8_t  i;
+
+   crc = crcIteration(HDLC_CRCINIT,persist_vars.record.numCells);
+   crc = crcIteration(crc,persist_vars.record.numNeighbors);
+   crc = crcIteration(crc,persist_vars.record.DODAGIDSet);
+   crc = openhdlc_crc(crc,persist_vars.record.DODAGID,       sizeof(persist_vars.record.DODAGID));
+   crc = openhdlc_crc(crc,(uint8_t*)persist_vars.record.cells,sizeof(persist_vars.record.cells));
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      crc = openhdlc_crc(crc,persist_vars.record.neighbors[i].addr_64b,LENGTH_ADDR64b);
+      crc = crcIteration(crc,persist_vars.record.neighbors[i].isParent);
+   }
+   return crc;
+}
+
+/**
+\brief CRC of the record being read or written, up to its checksum field.
+
+The record is longer than what openhdlc_crc() takes at once.
+*/
+uint16_t persist_checksum() {
+   uint8_t* buf;
+   uint16_t crc;
+   uint16_t i;
+
+   buf = (uint8_t*)&persist_vars.record;
+   crc = HDLC_CRCINIT;
+   for (i=0;i<sizeof(persistRecord_t)-sizeof(uint16_t);i++) {
+      crc = crcIteration(crc,buf[i]);
+   }
+   return crc;
+}
@@ -0,0 +1,86 @@
+#ifndef __PERSIST_H
+#define __PERSIST_H
+
+/**
+\addtogroup cross-layers
+\{
+\addtogroup Persist
+\{
+*/
+
+#include "opendefs.h"
+#include "opentimers.h"
+#include "schedule.h"
+#include "neighbors.h"
+
+//=========================== define ==========================================
+
+#define PERSIST_MAGIC             0x5057 // "WP", marks a written record
+#define PERSIST_SYNC_PERIOD       1000   // ms, polling for synchronization after boot
+#define PERSIST_CHECK_PERIOD      120000 // ms, between two checks of the state
+#define PERSIST_RETRY_PERIOD      1000   // ms, between two attempts at a deferred write
+#define PERSIST_GUARD             33     // 32kHz ticks, spare time left to the MAC after a write
+
+//=========================== typedef =========================================
+
+BEGIN_PACK
+
+typedef struct {
+   slotOffset_t     slotOffset;
+   uint8_t          type;
+   uint8_t          channelOffset;
+   uint8_t          neighbor[LENGTH_ADDR64b];
+} persistCell_t;
+
+typedef struct {
+   uint8_t          addr_64b[LENGTH_ADDR64b];
+   dagrank_t        DAGrank;
+   uint8_t          isParent;
+   uint8_t          reserved;
+} persistNeighbor_t;
+
+/**
+\brief One snapshot of the state needed to rejoin quickly after a reboot.
+
+Its size is a multiple of 4 bytes, as required by nvmem_write().
+*/
+typedef struct {
+   uint16_t          magic;
+   uint16_t          seqNum;
+   uint8_t           numCells;
+   uint8_t           numNeighbors;
+   uint8_t           DODAGIDSet;
+   uint8_t           reserved;
+   uint8_t           DODAGID[16];
+   persistCell_t     cells[MAXACTIVESLOTS];
+   persistNeighbor_t neighbors[MAXNUMNEIGHBORS];
+   uint16_t          reserved2;
+   uint16_t          checksum;             // over all the fields above
+} persistRecord_t;
+
+END_PACK
+
+//=========================== module variables ================================
+
+typedef struct {
+   persistRecord_t  record;               // record being read or written
+   opentimer_id_t   timerId;              // checks the state, periodically
+   bool             restorePending;       // neighbors still to be restored
+   bool             haveWritten;          // a record is in non-volatile memory
+   bool             writePending;         // the record waits for the MAC to leave time
+   uint16_t         lastSeqNum;           // sequence number of the last record
+   uint16_t         nextRecord;           // index where to write the next record
+   uint16_t         writtenSignature;     // of the state in the last record
+   uint16_t         checkedSignature;     // of the state at the last check
+} persist_vars_t;
+
+//=========================== prototypes ======================================
+
+void persist_init(void);
+
+/**
+\}
+\}
+*/
+
+#endif
@@ -7,6 +7,7 @@
 #include "opendefs.h"
 //===== drivers
 #include "openserial.h"
+#include "energy.h"
 //===== stack
 #include "openstack.h"
 //-- cross-layer
@@ -14,9 +15,11 @@
 #include "openqueue.h"
 #include "openrandom.h"
 #include "opentimers.h"
+#include "persist.h"
 //-- 02a-TSCH
 #include "adaptive_sync.h"
 #include "IEEE802154E.h"
+#include "IEEE802154_security.h"
 //-- 02b-RES
 #include "schedule.h"
 #include "sixtop.h"
@@ -48,6 +51,7 @@ void openstack_init(void) {
    
    //===== drivers
    openserial_init();
+   energy_init();
    
    //===== stack
    //-- cross-layer
@@ -58,6 +62,9 @@ void openstack_init(void) {
    //-- 02a-TSCH
    adaptive_sync_init();
    ieee154e_init();
+#ifdef L2_SECURITY_ACTIVE
+   ieee802154_security_init();
+#endif
    //-- 02b-RES
    schedule_init();
    sixtop_init();
@@ -74,6 +81,10 @@ void openstack_init(void) {
    opentcp_init();
    openudp_init();
    opencoap_init();     // initialize before any of the CoAP applications
+#ifdef PERSIST
+   //-- cross-layer
+   persist_init();      // call after the modules it restores state into
+#endif
    
    //===== applications
    openapps_init();
@@ -23,6 +23,8 @@ sure all is well.
 
 // driver modules required
 #include "openserial.h"
+// kernel
+#include "scheduler.h"
 
 //=========================== defines =========================================
 
@@ -32,7 +34,6 @@ sure all is well.
 
 typedef struct {
    uint8_t     timerFired;
-   uint8_t     outputting;
    open_addr_t addr;
 } app_vars_t;
 
@@ -61,13 +62,7 @@ int mote_main(void) {
       board_sleep();
       if (app_vars.timerFired==1) {
          app_vars.timerFired = 0;
-         if (app_vars.outputting==1) {
-            openserial_startInput();
-            app_vars.outputting = 0;
-         } else {
-            openserial_startOutput();
-            app_vars.outputting = 1;
-         }
+         openserial_triggerDebugPrint();
       }
    }
 }
@@ -81,6 +76,11 @@ void cb_compare(void) {
 
 //=========================== stub functions ==================================
 
+void scheduler_push_task(task_cbt task_cb, task_prio_t prio) {
+   // no kernel in this project, handle the received frame right away
+   task_cb();
+}
+
 open_addr_t* idmanager_getMyID(uint8_t type) {
    return &app_vars.addr;
 }
@@ -134,3 +134,6 @@ bool debugPrint_queue(void) {
 bool debugPrint_neighbors(void) {
    return FALSE;
 }
+bool debugPrint_bridgeStats(void) {
+   return FALSE;
+}
@@ -0,0 +1,286 @@
+/**
+\brief Cost of securing a frame with CCM*, in CPU cycles on the host.
+
+A 123-byte frame (21-byte header, 96-byte payload, MIC-32, FCS) is secured with:
+- ieee802154_security_ccmEncrypt(), the table-based AES of aes128.c with the
+  key expanded once, as the stack does;
+- a straightforward CCM* which expands the key for every block and computes
+  AES byte by byte, as a baseline.
+The cost of expanding the key alone is reported too. The best of many runs is
+kept, to leave the noise of the host out.
+*/
+
+#include <stdio.h>
+#include <x86intrin.h>
+#include "opendefs.h"
+#include "radio.h"
+#include "IEEE802154_security.h"
+#include "aes128.h"
+#include "idmanager.h"
+#include "openserial.h"
+
+//=========================== defines =========================================
+
+#define NUM_RUNS             2000
+#define HEADER_LEN           21
+#define PAYLOAD_LEN          96
+#define MIC_LEN              4
+
+//=========================== variables =======================================
+
+bool ieee802154_security_ccmEncrypt(uint8_t keyRow, uint8_t* a, uint8_t lenA,
+                                    uint8_t* m, uint8_t lenM, uint8_t* nonce,
+                                    uint8_t micLength);
+
+static const uint8_t key[IEEE802154_SECURITY_KEY_LEN] = IEEE802154_SECURITY_DEFAULT_KEY;
+static uint8_t       sbox[256];
+
+//=========================== stubs ===========================================
+
+owerror_t openserial_printError(uint8_t calling_component, uint8_t error_code,
+                                errorparameter_t arg1, errorparameter_t arg2) {
+   return E_SUCCESS;
+}
+
+void ieee154e_getAsn(uint8_t* array) {
+   memset(array,0,5);
+}
+
+bool ieee154e_isSynch(void) {
+   return TRUE;
+}
+
+open_addr_t* idmanager_getMyID(uint8_t type) {
+   static open_addr_t me;
+
+   return &me;
+}
+
+bool neighbors_updateRxFrameCounter(open_addr_t* l2_src, uint32_t frameCounter) {
+   return TRUE;
+}
+
+void packetfunctions_reserveFooterSize(OpenQueueEntry_t* pkt, uint8_t header_length) {
+   pkt->length += header_length;
+}
+
+void packetfunctions_tossFooter(OpenQueueEntry_t* pkt, uint8_t header_length) {
+   pkt->length -= header_length;
+}
+
+//=========================== baseline ========================================
+
+static uint8_t xtime(uint8_t a) {
+   return (uint8_t)((a << 1) ^ ((a & 0x80) ? 0x1b : 0x00));
+}
+
+static uint8_t gfMultiply(uint8_t a, uint8_t b) {
+   uint8_t p;
+
+   p = 0;
+   while (b) {
+      if (b & 1) {
+         p ^= a;
+      }
+      a   = xtime(a);
+      b >>= 1;
+   }
+   return p;
+}
+
+/**
+\brief The AES S-box, from the multiplicative inverse and the affine map.
+*/
+static void baseline_init(void) {
+   uint8_t inverse;
+   uint8_t s;
+   int     i;
+   int     j;
+
+   for (i=0;i<256;i++) {
+      inverse = 0;
+      for (j=1;i>0 && j<256;j++) {
+         if (gfMultiply(i,j)==1) {
+            inverse = j;
+            break;
+         }
+      }
+      s = inverse;
+      for (j=1;j<5;j++) {
+         s ^= (uint8_t)((inverse << j) | (inverse >> (8-j)));
+      }
+      sbox[i] = s ^ 0x63;
+   }
+}
+
+/**
+\brief AES-128, expanding the key on every call, one byte at a time.
+*/
+static void baseline_encrypt(const uint8_t* rawKey, uint8_t* state) {
+   uint8_t roundKeys[176];
+   uint8_t t[4];
+   uint8_t tmp[16];
+   uint8_t rcon;
+   uint8_t e;
+   uint8_t first;
+   int     round;
+   int     i;
+   int     j;
+
+   memcpy(roundKeys,rawKey,16);
+   rcon = 1;
+   for (i=16;i<176;i+=4) {
+      memcpy(t,&roundKeys[i-4],4);
+      if (i%16==0) {
+         first = t[0];
+         t[0]  = sbox[t[1]] ^ rcon;
+         t[1]  = sbox[t[2]];
+         t[2]  = sbox[t[3]];
+         t[3]  = sbox[first];
+         rcon  = xtime(rcon);
+      }
+      for (j=0;j<4;j++) {
+         roundKeys[i+j] = roundKeys[i-16+j] ^ t[j];
+      }
+   }
+
+   for (i=0;i<16;i++) {
+      state[i] ^= roundKeys[i];
+   }
+   for (round=1;round<=10;round++) {
+      // SubBytes and ShiftRows
+      for (i=0;i<16;i++) {
+         tmp[i] = sbox[state[(i+4*(i%4))%16]];
+      }
+      // MixColumns
+      if (round<10) {
+         for (i=0;i<16;i+=4) {
+            e        = tmp[i] ^ tmp[i+1] ^ tmp[i+2] ^ tmp[i+3];
+            first    = tmp[i];
+            tmp[i]   ^= e ^ xtime(tmp[i]   ^ tmp[i+1]);
+            tmp[i+1] ^= e ^ xtime(tmp[i+1] ^ tmp[i+2]);
+            tmp[i+2] ^= e ^ xtime(tmp[i+2] ^ tmp[i+3]);
+            tmp[i+3] ^= e ^ xtime(tmp[i+3] ^ first);
+         }
+      }
+      for (i=0;i<16;i++) {
+         state[i] = tmp[i] ^ roundKeys[16*round+i];
+      }
+   }
+}
+
+static void baseline_ccmStar(uint8_t* nonce, uint8_t* a, int lenA, uint8_t* m, int lenM) {
+   uint8_t x[16];
+   uint8_t ai[16];
+   int     pos;
+   int     i;
+   int     j;
+
+   x[0]  = 0x40 | (((MIC_LEN-2)/2) << 3) | 1;
+   memcpy(&x[1],nonce,IEEE802154_SECURITY_NONCE_LEN);
+   x[14] = 0;
+   x[15] = (uint8_t)lenM;
+   baseline_encrypt(key,x);
+   x[1] ^= (uint8_t)lenA;
+   pos   = 2;
+   for (i=0;i<lenA;i++) {
+      x[pos++] ^= a[i];
+      if (pos==16) {
+         baseline_encrypt(key,x);
+         pos = 0;
+      }
+   }
+   if (pos>0) {
+      baseline_encrypt(key,x);
+   }
+   pos = 0;
+   for (i=0;i<lenM;i++) {
+      x[pos++] ^= m[i];
+      if (pos==16) {
+         baseline_encrypt(key,x);
+         pos = 0;
+      }
+   }
+   if (pos>0) {
+      baseline_encrypt(key,x);
+   }
+
+   for (i=0;i<=(lenM+15)/16;i++) {
+      ai[0]  = 1;
+      memcpy(&ai[1],nonce,IEEE802154_SECURITY_NONCE_LEN);
+      ai[14] = 0;
+      ai[15] = (uint8_t)i;
+      baseline_encrypt(key,ai);
+      for (j=0;j<16;j++) {
+         if (i==0) {
+            if (j<MIC_LEN) {
+               m[lenM+j] = x[j] ^ ai[j];
+            }
+         } else if (16*(i-1)+j<lenM) {
+            m[16*(i-1)+j] ^= ai[j];
+         }
+      }
+   }
+}
+
+//=========================== main ============================================
+
+int main(void) {
+   uint8_t      nonce[IEEE802154_SECURITY_NONCE_LEN];
+   uint8_t      frame[HEADER_LEN+PAYLOAD_LEN+MIC_LEN];
+   uint8_t      baseline[HEADER_LEN+PAYLOAD_LEN+MIC_LEN];
+   aes128_key_t expanded;
+   uint64_t     start;
+   uint64_t     bestTable;
+   uint64_t     bestBaseline;
+   uint64_t     bestKey;
+   uint64_t     cycles;
+   int          run;
+   int          i;
+
+   ieee802154_security_init();
+   baseline_init();
+   memset(nonce,0x5a,sizeof(nonce));
+
+   bestTable    = ~0ull;
+   bestBaseline = ~0ull;
+   bestKey      = ~0ull;
+   for (run=0;run<NUM_RUNS;run++) {
+      for (i=0;i<HEADER_LEN+PAYLOAD_LEN;i++) {
+         frame[i] = i;
+      }
+      memcpy(baseline,frame,sizeof(frame));
+
+      start  = __rdtsc();
+      ieee802154_security_ccmEncrypt(0,frame,HEADER_LEN,frame+HEADER_LEN,PAYLOAD_LEN,nonce,MIC_LEN);
+      cycles = __rdtsc()-start;
+      if (cycles<bestTable) {
+         bestTable = cycles;
+      }
+
+      start  = __rdtsc();
+      baseline_ccmStar(nonce,baseline,HEADER_LEN,baseline+HEADER_LEN,PAYLOAD_LEN);
+      cycles = __rdtsc()-start;
+      if (cycles<bestBaseline) {
+         bestBaseline = cycles;
+      }
+
+      start  = __rdtsc();
+      aes128_setKey(&expanded,(uint8_t*)key);
+      cycles = __rdtsc()-start;
+      if (cycles<bestKey) {
+         bestKey = cycles;
+      }
+   }
+
+   if (memcmp(frame,baseline,sizeof(frame))!=0) {
+      printf("the baseline disagrees with the stack\n");
+      return 1;
+   }
+   printf("cycles per %d-byte frame, best of %d runs:\n",HEADER_LEN+PAYLOAD_LEN+MIC_LEN+LENGTH_CRC,NUM_RUNS);
+   printf("  table-based AES, key expanded once:  %llu\n",(unsigned long long)bestTable);
+   printf("  byte-wise AES, key expanded per use: %llu (x%.1f)\n",
+          (unsigned long long)bestBaseline,(double)bestBaseline/bestTable);
+   printf("  key expansion alone:                 %llu\n",(unsigned long long)bestKey);
+   return 0;
+}
@@ -0,0 +1,399 @@
+/**
+\brief Host test of the IEEE802.15.4 header elision.
+
+Two motes, A (the DAG root) and B (its child), are simulated by swapping the
+state of the neighbors and idmanager modules. Every frame A or B builds with
+ieee802154_prependHeader() is parsed by the other one with
+ieee802154_retrieveHeader() and ieee802154_retrieveDestination(), for each
+combination of:
+- the neighbor understanding the 2015 elision or not,
+- short addresses assigned or not,
+- direction (A to B, B to A),
+- EB, data (2006 and 2015) and ACK.
+
+The ambiguous 2015 EUI64-to-EUI64 frames with PAN ID compression are tested
+on their own: elided, with a PAN ID as sent by older firmware, and to another
+mote.
+*/
+
+#include <stdio.h>
+#include "opendefs.h"
+#include "neighbors.h"
+#include "idmanager.h"
+#include "IEEE802154.h"
+#include "IEEE802154E.h"
+#include "packetfunctions.h"
+#include "topology.h"
+#include "openserial.h"
+#include "eui64.h"
+
+//=========================== defines =========================================
+
+#define CHECK(cond) do {                                           \
+      numChecks++;                                                 \
+      if (!(cond)) {                                               \
+         numFailures++;                                            \
+         printf("  FAILED %s:%d: %s\n",__FILE__,__LINE__,#cond);   \
+      }                                                            \
+   } while (0)
+
+#define EUI64_A              1
+#define EUI64_B              2
+#define PAYLOAD_BYTE         0xab
+#define DSN                  0x5a
+
+//=========================== variables =======================================
+
+extern neighbors_vars_t neighbors_vars;
+extern idmanager_vars_t idmanager_vars;
+
+typedef struct {
+   neighbors_vars_t neighbors;
+   idmanager_vars_t idmanager;
+} mote_t;
+
+static mote_t      moteA;
+static mote_t      moteB;
+static uint8_t     myEui64LastByte;
+static int         numChecks;
+static int         numFailures;
+
+static const char* frameTypeName[] = {"EB","data","ACK"};
+
+//=========================== stubs ===========================================
+
+owerror_t openserial_printError(uint8_t calling_component, uint8_t error_code,
+                                errorparameter_t arg1, errorparameter_t arg2) {
+   return E_SUCCESS;
+}
+
+owerror_t openserial_printInfo(uint8_t calling_component, uint8_t error_code,
+                               errorparameter_t arg1, errorparameter_t arg2) {
+   return E_SUCCESS;
+}
+
+owerror_t openserial_printCritical(uint8_t calling_component, uint8_t error_code,
+                                   errorparameter_t arg1, errorparameter_t arg2) {
+   return E_SUCCESS;
+}
+
+owerror_t openserial_printStatus(uint8_t statusElement, uint8_t* buffer, uint8_t length) {
+   return E_SUCCESS;
+}
+
+bool openserial_printStatusDelta(uint8_t statusElement, uint16_t* signature,
+                                 uint8_t* buffer, uint8_t length) {
+   return FALSE;
+}
+
+uint8_t openserial_getInputBuffer(uint8_t* bufferToWrite, uint8_t maxNumBytes) {
+   return 0;
+}
+
+void eui64_get(uint8_t* addressToWrite) {
+   memset(addressToWrite,0,LENGTH_ADDR64b);
+   addressToWrite[0] = 0x14;
+   addressToWrite[7] = myEui64LastByte;
+}
+
+PORT_RADIOTIMER_WIDTH ieee154e_asnDiff(asn_t* someASN) {
+   return 0;
+}
+
+void ieee154e_getAsn(uint8_t* array) {
+   memset(array,0,5);
+}
+
+bool topology_isAcceptablePacket(ieee802154_header_iht* ieee802514_header) {
+   return TRUE;
+}
+
+//=========================== helpers =========================================
+
+static void eui64(open_addr_t* addr, uint8_t lastByte) {
+   memset(addr,0,sizeof(open_addr_t));
+   addr->type         = ADDR_64B;
+   addr->addr_64b[0]  = 0x14;
+   addr->addr_64b[7]  = lastByte;
+}
+
+static void load(mote_t* mote) {
+   memcpy(&neighbors_vars,&mote->neighbors,sizeof(neighbors_vars_t));
+   memcpy(&idmanager_vars,&mote->idmanager,sizeof(idmanager_vars_t));
+}
+
+static void save(mote_t* mote) {
+   memcpy(&mote->neighbors,&neighbors_vars,sizeof(neighbors_vars_t));
+   memcpy(&mote->idmanager,&idmanager_vars,sizeof(idmanager_vars_t));
+}
+
+static void boot(mote_t* mote, uint8_t lastByte, bool isDAGroot) {
+   myEui64LastByte = lastByte;
+   idmanager_init();
+   idmanager_vars.isDAGroot = isDAGroot;
+   neighbors_init();
+   save(mote);
+}
+
+/**
+\brief A is the DAG root and B its child, each knowing the other as neighbor.
+*/
+static void setup(bool capable, bool shortAddresses) {
+   open_addr_t a;
+   open_addr_t b;
+   open_addr_t addr_16b;
+   asn_t       asn;
+   uint16_t    assigned;
+   uint8_t     depth;
+
+   eui64(&a,EUI64_A);
+   eui64(&b,EUI64_B);
+   memset(&asn,0,sizeof(asn_t));
+
+   boot(&moteA,EUI64_A,TRUE);
+   boot(&moteB,EUI64_B,FALSE);
+
+   load(&moteA);
+   neighbors_indicateRx(&b,-50,&asn,FALSE,0);
+   neighbors_indicateCapabilities(&b,capable ? NEIGHBOR_CAP_COMPACT_HEADER : 0);
+   if (shortAddresses) {
+      neighbors_indicateRxLongAddress(&b);
+      CHECK(neighbors_getShortAddressOffer(&b,&assigned,&depth)==TRUE);
+   }
+   save(&moteA);
+
+   load(&moteB);
+   neighbors_indicateRx(&a,-50,&asn,FALSE,0);
+   neighbors_indicateCapabilities(&a,capable ? NEIGHBOR_CAP_COMPACT_HEADER : 0);
+   if (shortAddresses) {
+      neighbors_indicateShortAddressOffer(&a,assigned,SHORTADDR_ROOT,depth);
+   }
+   save(&moteB);
+
+   if (shortAddresses) {
+      // A sees B using the short address it assigned
+      load(&moteA);
+      addr_16b.type        = ADDR_16B;
+      addr_16b.addr_16b[0] = (uint8_t)(assigned>>8);
+      addr_16b.addr_16b[1] = (uint8_t)(assigned & 0xff);
+      CHECK(neighbors_indicateRxShortAddress(&addr_16b,&b)==TRUE);
+      save(&moteA);
+   }
+}
+
+/**
+\brief Parse a raw header as mote B.
+
+\returns The number of header bytes, 0 if the header is invalid.
+*/
+static uint8_t parse(uint8_t* frame, uint8_t len, ieee802154_header_iht* header) {
+   OpenQueueEntry_t msg;
+
+   memset(&msg,0,sizeof(OpenQueueEntry_t));
+   msg.payload = msg.packet;
+   msg.length  = len;
+   memcpy(msg.payload,frame,len);
+   ieee802154_retrieveHeader(&msg,header);
+   return header->valid ? header->headerLength : 0;
+}
+
+//=========================== tests ===========================================
+
+static void test_roundTrip(void) {
+   OpenQueueEntry_t      msg;
+   ieee802154_header_iht header;
+   open_addr_t           a;
+   open_addr_t           b;
+   open_addr_t           broadcast;
+   open_addr_t           panid;
+   open_addr_t           dest;
+   open_addr_t*          nextHop;
+   open_addr_t*          sender;
+   mote_t*               tx;
+   mote_t*               rx;
+   uint8_t               frame[127];
+   uint8_t               headerLength;
+   int                   capable;
+   int                   shortAddresses;
+   int                   fromB;
+   int                   frameType;
+   int                   frameVersion;
+   int                   numCombinations;
+
+   eui64(&a,EUI64_A);
+   eui64(&b,EUI64_B);
+   broadcast.type        = ADDR_16B;
+   broadcast.addr_16b[0] = 0xff;
+   broadcast.addr_16b[1] = 0xff;
+
+   numCombinations = 0;
+   for (capable=0;capable<2;capable++) {
+      for (shortAddresses=0;shortAddresses<2;shortAddresses++) {
+         setup(capable,shortAddresses);
+         for (fromB=0;fromB<2;fromB++) {
+            for (frameType=IEEE154_TYPE_BEACON;frameType<=IEEE154_TYPE_ACK;frameType++) {
+               for (frameVersion=IEEE154_FRAMEVERSION_2006;frameVersion<=IEEE154_FRAMEVERSION;frameVersion++) {
+                  // EBs and ACKs are always 2015 frames
+                  if (frameType!=IEEE154_TYPE_DATA && frameVersion!=IEEE154_FRAMEVERSION) {
+                     continue;
+                  }
+                  tx      = fromB ? &moteB : &moteA;
+                  rx      = fromB ? &moteA : &moteB;
+                  sender  = fromB ? &b     : &a;
+                  nextHop = frameType==IEEE154_TYPE_BEACON ? &broadcast : (fromB ? &a : &b);
+
+                  // build, with one byte of payload
+                  load(tx);
+                  memset(&msg,0,sizeof(OpenQueueEntry_t));
+                  msg.payload = &msg.packet[127];
+                  packetfunctions_reserveHeaderSize(&msg,1);
+                  msg.payload[0] = PAYLOAD_BYTE;
+                  ieee802154_prependHeader(
+                     &msg,
+                     frameType,
+                     frameVersion==IEEE154_FRAMEVERSION && frameType!=IEEE154_TYPE_DATA,
+                     frameVersion,
+                     FALSE,
+                     DSN,
+                     nextHop
+                  );
+                  memcpy(frame,msg.payload,msg.length);
+                  headerLength = msg.length-1;
+                  save(tx);
+
+                  // parse
+                  load(rx);
+                  ieee802154_retrieveHeader(&msg,&header);
+                  CHECK(header.valid==TRUE);
+                  CHECK(header.headerLength==headerLength);
+                  CHECK(msg.payload[headerLength]==PAYLOAD_BYTE);
+                  CHECK(header.frameType==frameType);
+                  CHECK(header.ackRequested==(frameType==IEEE154_TYPE_DATA));
+                  if (frameType==IEEE154_TYPE_ACK && capable) {
+                     // attributed to the neighbor I just sent to, by the ACK window
+                     CHECK(header.src.type==ADDR_NONE);
+                     CHECK(header.dest.type==ADDR_NONE);
+                     CHECK(header.dsnSuppressed==TRUE);
+                  } else {
+                     CHECK(packetfunctions_sameAddress(&header.src,sender)==TRUE);
+                     CHECK(header.dsnSuppressed==FALSE && header.dsn==DSN);
+                     if (frameType==IEEE154_TYPE_BEACON) {
+                        CHECK(packetfunctions_isBroadcastMulticast(&header.dest)==TRUE);
+                     } else {
+                        CHECK(idmanager_isMyAddress(&header.dest)==TRUE);
+                     }
+                  }
+                  CHECK(
+                     header.panid.type==ADDR_NONE ||
+                     packetfunctions_sameAddress(&header.panid,idmanager_getMyID(ADDR_PANID))==TRUE
+                  );
+
+                  // the early-RX destination check agrees
+                  CHECK(ieee802154_retrieveDestination(frame,headerLength<13 ? headerLength : 13,&panid,&dest)==TRUE);
+                  CHECK(dest.type==header.dest.type);
+                  CHECK(panid.type==header.panid.type);
+                  save(rx);
+
+                  printf(
+                     "  capable=%d short=%d %s->%s %-4s %s: %2d header bytes%s%s\n",
+                     capable,
+                     shortAddresses,
+                     fromB ? "B" : "A",
+                     fromB ? "A" : "B",
+                     frameTypeName[frameType],
+                     frameVersion==IEEE154_FRAMEVERSION ? "2015" : "2006",
+                     headerLength,
+                     header.panid.type==ADDR_NONE ? ", no PAN ID" : "",
+                     header.dsnSuppressed ? ", no DSN" : ""
+                  );
+                  numCombinations++;
+               }
+            }
+         }
+      }
+   }
+   CHECK(numCombinations==32);
+}
+
+/**
+\brief 2015 EUI64-to-EUI64 data frames with PAN ID compression set.
+
+Whether a PAN ID follows is guessed from whether my EUI64 directly follows the
+sequence number.
+*/
+static void test_eui64PanIdCompression(void) {
+   ieee802154_header_iht header;
+   open_addr_t           a;
+   open_addr_t           panid;
+   open_addr_t           dest;
+   // FCF 0xec61: data, ACK request, PAN ID compression, ext/ext, 2015
+   uint8_t               elided[]   = {0x61,0xec,DSN,
+                                       EUI64_B,0,0,0,0,0,0,0x14,
+                                       EUI64_A,0,0,0,0,0,0,0x14,
+                                       PAYLOAD_BYTE};
+   // the same frame from older firmware, which still carries the PAN ID
+   uint8_t               withPanId[] = {0x61,0xec,DSN,0xcd,0xab,
+                                       EUI64_B,0,0,0,0,0,0,0x14,
+                                       EUI64_A,0,0,0,0,0,0,0x14,
+                                       PAYLOAD_BYTE};
+   // an elided frame to another mote
+   uint8_t               toOther[]  = {0x61,0xec,DSN,
+                                       3,0,0,0,0,0,0,0x14,
+                                       EUI64_A,0,0,0,0,0,0,0x14,
+                                       PAYLOAD_BYTE};
+
+   eui64(&a,EUI64_A);
+   setup(TRUE,FALSE);
+   load(&moteB);
+   idmanager_vars.myPANID.panid[0] = 0xab;
+   idmanager_vars.myPANID.panid[1] = 0xcd;
+
+   // my EUI64 follows the DSN: no PAN ID
+   CHECK(parse(elided,sizeof(elided),&header)==sizeof(elided)-1);
+   CHECK(header.panid.type==ADDR_NONE);
+   CHECK(idmanager_isMyAddress(&header.dest)==TRUE);
+   CHECK(packetfunctions_sameAddress(&header.src,&a)==TRUE);
+   CHECK(ieee802154_retrieveDestination(elided,13,&panid,&dest)==TRUE);
+   CHECK(panid.type==ADDR_NONE && idmanager_isMyAddress(&dest)==TRUE);
+
+   // it doesn't: a PAN ID is read first
+   CHECK(parse(withPanId,sizeof(withPanId),&header)==sizeof(withPanId)-1);
+   CHECK(packetfunctions_sameAddress(&header.panid,idmanager_getMyID(ADDR_PANID))==TRUE);
+   CHECK(idmanager_isMyAddress(&header.dest)==TRUE);
+   CHECK(packetfunctions_sameAddress(&header.src,&a)==TRUE);
+   CHECK(ieee802154_retrieveDestination(withPanId,13,&panid,&dest)==TRUE);
+   CHECK(panid.type==ADDR_PANID && idmanager_isMyAddress(&dest)==TRUE);
+
+   // to another mote, misread as carrying a PAN ID, but still not for me
+   parse(toOther,sizeof(toOther),&header);
+   CHECK(header.valid==FALSE || idmanager_isMyAddress(&header.dest)==FALSE);
+   CHECK(
+      ieee802154_retrieveDestination(toOther,13,&panid,&dest)==FALSE ||
+      idmanager_isMyAddress(&dest)==FALSE
+   );
+   save(&moteB);
+   printf("  2015 EUI64-to-EUI64 with PAN ID compression: elided, with PAN ID, to another mote\n");
+}
+
+static void test_ackRequestWithoutDsn(void) {
+   ieee802154_header_iht header;
+   // FCF 0x2122: ACK, ACK request, DSN suppressed, no addresses, 2015
+   uint8_t               frame[] = {0x22,0x21};
+
+   setup(TRUE,FALSE);
+   load(&moteB);
+   CHECK(parse(frame,sizeof(frame),&header)==0);
+   save(&moteB);
+   printf("  ACK request with a suppressed DSN refused\n");
+}
+
+//=========================== main ============================================
+
+int main(void) {
+   test_roundTrip();
+   test_eui64PanIdCompression();
+   test_ackRequestWithoutDsn();
+
+   printf("%s: %d checks, %d failures\n",numFailures ? "FAIL" : "PASS",numChecks,numFailures);
+   return numFailures!=0;
+}
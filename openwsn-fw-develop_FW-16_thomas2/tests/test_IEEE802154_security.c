@@ -0,0 +1,524 @@
+/**
+\brief Host test of the IEEE802.15.4 link-layer security, against OpenSSL.
+
+- AES-128: the FIPS-197 C.1 vector, and random keys and blocks against
+  OpenSSL AES-128-ECB.
+- CCM*: random frames at security levels 1 to 7 against a reference which
+  builds the nonce, B0 and the Ai blocks itself, on top of OpenSSL
+  AES-128-ECB, and against OpenSSL AES-128-CCM for the levels with a MIC.
+- Frames secured by ieee802154_security_outgoingFrame(): the nonce holds the
+  source EUI64, the frame counter and the security level, and the MIC and
+  ciphertext match the reference.
+- Tampering with any single bit of a secured frame is detected.
+- Replay window: frames received out of order within the window are accepted
+  once, replays and frames too old are rejected, as are unsecured and
+  downgraded data frames.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <openssl/evp.h>
+#include "opendefs.h"
+#include "IEEE802154.h"
+#include "IEEE802154E.h"
+#include "IEEE802154_security.h"
+#include "aes128.h"
+#include "neighbors.h"
+#include "idmanager.h"
+#include "packetfunctions.h"
+#include "topology.h"
+#include "openserial.h"
+#include "eui64.h"
+
+//=========================== defines =========================================
+
+#define CHECK(cond) do {                                           \
+      numChecks++;                                                 \
+      if (!(cond)) {                                               \
+         numFailures++;                                            \
+         printf("  FAILED %s:%d: %s\n",__FILE__,__LINE__,#cond);   \
+      }                                                            \
+   } while (0)
+
+#define NUM_AES_VECTORS      1000
+#define NUM_CCM_FRAMES       3000
+#define NUM_FRAMES           40     // secured, then received out of order
+#define HEADER_LEN           21     // of the frames secured by the stack
+#define PAYLOAD_LEN          60
+#define CCM_STAR_L           2      // bytes of the length field
+
+//=========================== variables =======================================
+
+extern ieee802154_security_vars_t ieee802154_security_vars;
+extern idmanager_vars_t           idmanager_vars;
+
+// private functions of IEEE802154_security.c
+bool ieee802154_security_ccmEncrypt(uint8_t keyRow, uint8_t* a, uint8_t lenA,
+                                    uint8_t* m, uint8_t lenM, uint8_t* nonce,
+                                    uint8_t micLength);
+bool ieee802154_security_ccmDecrypt(uint8_t keyRow, uint8_t* a, uint8_t lenA,
+                                    uint8_t* c, uint8_t lenC, uint8_t* nonce,
+                                    uint8_t micLength);
+
+static const uint8_t key[IEEE802154_SECURITY_KEY_LEN] = IEEE802154_SECURITY_DEFAULT_KEY;
+static uint8_t       asn[5];
+static int           numChecks;
+static int           numFailures;
+
+//=========================== stubs ===========================================
+
+owerror_t openserial_printError(uint8_t calling_component, uint8_t error_code,
+                                errorparameter_t arg1, errorparameter_t arg2) {
+   return E_SUCCESS;
+}
+
+owerror_t openserial_printInfo(uint8_t calling_component, uint8_t error_code,
+                               errorparameter_t arg1, errorparameter_t arg2) {
+   return E_SUCCESS;
+}
+
+owerror_t openserial_printCritical(uint8_t calling_component, uint8_t error_code,
+                                   errorparameter_t arg1, errorparameter_t arg2) {
+   return E_SUCCESS;
+}
+
+owerror_t openserial_printStatus(uint8_t statusElement, uint8_t* buffer, uint8_t length) {
+   return E_SUCCESS;
+}
+
+bool openserial_printStatusDelta(uint8_t statusElement, uint16_t* signature,
+                                 uint8_t* buffer, uint8_t length) {
+   return FALSE;
+}
+
+uint8_t openserial_getInputBuffer(uint8_t* bufferToWrite, uint8_t maxNumBytes) {
+   return 0;
+}
+
+void eui64_get(uint8_t* addressToWrite) {
+   uint8_t eui64[] = {0x14,0x15,0x92,0x00,0x00,0x00,0x00,0x01};
+
+   memcpy(addressToWrite,eui64,LENGTH_ADDR64b);
+}
+
+PORT_RADIOTIMER_WIDTH ieee154e_asnDiff(asn_t* someASN) {
+   return 0;
+}
+
+void ieee154e_getAsn(uint8_t* array) {
+   memcpy(array,asn,sizeof(asn));
+}
+
+bool ieee154e_isSynch(void) {
+   return TRUE;
+}
+
+bool topology_isAcceptablePacket(ieee802154_header_iht* ieee802514_header) {
+   return TRUE;
+}
+
+//=========================== reference =======================================
+
+static void ref_aesEcb(const uint8_t* k, uint8_t* in, uint8_t* out) {
+   EVP_CIPHER_CTX* ctx;
+   int             len;
+
+   ctx = EVP_CIPHER_CTX_new();
+   EVP_EncryptInit_ex(ctx,EVP_aes_128_ecb(),NULL,k,NULL);
+   EVP_CIPHER_CTX_set_padding(ctx,0);
+   EVP_EncryptUpdate(ctx,out,&len,in,AES128_BLOCK_SIZE);
+   EVP_CIPHER_CTX_free(ctx);
+}
+
+static void ref_xorEncrypt(uint8_t* x) {
+   uint8_t out[AES128_BLOCK_SIZE];
+
+   ref_aesEcb(key,x,out);
+   memcpy(x,out,AES128_BLOCK_SIZE);
+}
+
+/**
+\brief CCM* as in IEEE802.15.4 Annex B, on top of AES-128-ECB.
+
+Writes the ciphertext of m, then the encrypted MIC, to out.
+*/
+static void ref_ccmStar(uint8_t* nonce, uint8_t* a, int lenA, uint8_t* m, int lenM,
+                        int micLength, uint8_t* out) {
+   uint8_t x[AES128_BLOCK_SIZE];
+   uint8_t block[AES128_BLOCK_SIZE];
+   uint8_t ai[AES128_BLOCK_SIZE];
+   int     i;
+   int     j;
+
+   // authentication: B0, then l(a) || a, then m, each zero-padded
+   memset(x,0,sizeof(x));
+   if (micLength>0) {
+      x[0]  = (lenA>0 ? 0x40 : 0x00) | (((micLength-2)/2) << 3) | (CCM_STAR_L-1);
+      memcpy(&x[1],nonce,IEEE802154_SECURITY_NONCE_LEN);
+      x[14] = (uint8_t)(lenM >> 8);
+      x[15] = (uint8_t)(lenM     );
+      ref_xorEncrypt(x);
+      if (lenA>0) {
+         memset(block,0,sizeof(block));
+         block[0] = (uint8_t)(lenA >> 8);
+         block[1] = (uint8_t)(lenA     );
+         j = 2;
+         for (i=0;i<lenA;i++) {
+            block[j++] = a[i];
+            if (j==AES128_BLOCK_SIZE || i==lenA-1) {
+               for (j=0;j<AES128_BLOCK_SIZE;j++) {
+                  x[j] ^= block[j];
+               }
+               ref_xorEncrypt(x);
+               memset(block,0,sizeof(block));
+               j = 0;
+            }
+         }
+      }
+      for (i=0;i<lenM;i+=AES128_BLOCK_SIZE) {
+         for (j=0;j<AES128_BLOCK_SIZE && i+j<lenM;j++) {
+            x[j] ^= m[i+j];
+         }
+         ref_xorEncrypt(x);
+      }
+   }
+
+   // encryption: Ai = flags || nonce || i, A0 for the MIC
+   for (i=0;i<=(lenM+AES128_BLOCK_SIZE-1)/AES128_BLOCK_SIZE;i++) {
+      memset(block,0,sizeof(block));
+      block[0]  = CCM_STAR_L-1;
+      memcpy(&block[1],nonce,IEEE802154_SECURITY_NONCE_LEN);
+      block[15] = (uint8_t)i;
+      ref_aesEcb(key,block,ai);
+      for (j=0;j<AES128_BLOCK_SIZE;j++) {
+         if (i==0) {
+            if (j<micLength) {
+               out[lenM+j] = x[j] ^ ai[j];
+            }
+         } else if ((i-1)*AES128_BLOCK_SIZE+j<lenM) {
+            out[(i-1)*AES128_BLOCK_SIZE+j] = m[(i-1)*AES128_BLOCK_SIZE+j] ^ ai[j];
+         }
+      }
+   }
+}
+
+/**
+\brief OpenSSL AES-128-CCM, for the levels with a MIC.
+*/
+static void ref_ccm(uint8_t* nonce, uint8_t* a, int lenA, uint8_t* m, int lenM,
+                    int micLength, uint8_t* out) {
+   EVP_CIPHER_CTX* ctx;
+   int             len;
+
+   ctx = EVP_CIPHER_CTX_new();
+   EVP_EncryptInit_ex(ctx,EVP_aes_128_ccm(),NULL,NULL,NULL);
+   EVP_CIPHER_CTX_ctrl(ctx,EVP_CTRL_CCM_SET_IVLEN,IEEE802154_SECURITY_NONCE_LEN,NULL);
+   EVP_CIPHER_CTX_ctrl(ctx,EVP_CTRL_CCM_SET_TAG,micLength,NULL);
+   EVP_EncryptInit_ex(ctx,NULL,NULL,key,nonce);
+   EVP_EncryptUpdate(ctx,NULL,&len,NULL,lenM);
+   if (lenA>0) {
+      EVP_EncryptUpdate(ctx,NULL,&len,a,lenA);
+   }
+   EVP_EncryptUpdate(ctx,out,&len,m,lenM);
+   EVP_EncryptFinal_ex(ctx,out+lenM,&len);
+   EVP_CIPHER_CTX_ctrl(ctx,EVP_CTRL_CCM_GET_TAG,micLength,out+lenM);
+   EVP_CIPHER_CTX_free(ctx);
+}
+
+static uint8_t micLength(uint8_t securityLevel) {
+   return (securityLevel & 0x03)==0 ? 0 : 2 << (securityLevel & 0x03);
+}
+
+static void randomBytes(uint8_t* buf, int len) {
+   int i;
+
+   for (i=0;i<len;i++) {
+      buf[i] = (uint8_t)rand();
+   }
+}
+
+//=========================== helpers =========================================
+
+/**
+\brief Secure a data frame with the stack, as sixtop does.
+
+\returns The length of the secured frame, its MIC included.
+*/
+static uint8_t secureFrame(uint8_t* frame, uint32_t* frameCounter) {
+   OpenQueueEntry_t msg;
+   uint8_t          i;
+
+   memset(&msg,0,sizeof(OpenQueueEntry_t));
+   msg.l2_frameType = IEEE154_TYPE_DATA;
+   ieee802154_security_prepareOutgoingFrame(&msg);
+
+   msg.payload    = &msg.packet[10];
+   msg.length     = HEADER_LEN+PAYLOAD_LEN;
+   msg.l2_payload = msg.payload+HEADER_LEN;
+   for (i=0;i<msg.length;i++) {
+      msg.payload[i] = i;
+   }
+   CHECK(ieee802154_security_outgoingFrame(&msg)==E_SUCCESS);
+
+   memcpy(frame,msg.payload,msg.length);
+   *frameCounter = msg.l2_frameCounter;
+   return msg.length;
+}
+
+/**
+\brief Receive a secured frame, its header already parsed.
+
+\returns The result of ieee802154_security_incomingFrame().
+*/
+static owerror_t receiveFrame(uint8_t* frame, uint8_t len, uint32_t frameCounter,
+                              uint8_t securityLevel, OpenQueueEntry_t* msg) {
+   memset(msg,0,sizeof(OpenQueueEntry_t));
+   msg->payload              = &msg->packet[10];
+   memcpy(msg->payload,frame,len);
+   msg->payload             += HEADER_LEN;
+   msg->length               = len-HEADER_LEN;
+   msg->l2_headerLength      = HEADER_LEN;
+   msg->l2_frameType         = IEEE154_TYPE_DATA;
+   msg->l2_securityLevel     = securityLevel;
+   msg->l2_keyIndex          = IEEE802154_SECURITY_KEYINDEX;
+   msg->l2_frameCounter      = frameCounter;
+   memcpy(&msg->l2_nextORpreviousHop,idmanager_getMyID(ADDR_64B),sizeof(open_addr_t));
+   return ieee802154_security_incomingFrame(msg);
+}
+
+//=========================== tests ===========================================
+
+static void test_aes(void) {
+   // FIPS-197 C.1
+   uint8_t      fipsKey[16];
+   uint8_t      fipsCipher[16] = {0x69,0xc4,0xe0,0xd8,0x6a,0x7b,0x04,0x30,
+                                  0xd8,0xcd,0xb7,0x80,0x70,0xb4,0xc5,0x5a};
+   uint8_t      rawKey[16];
+   uint8_t      plain[16];
+   uint8_t      block[16];
+   uint8_t      expected[16];
+   aes128_key_t k;
+   int          i;
+
+   for (i=0;i<16;i++) {
+      fipsKey[i] = i;
+      plain[i]   = i*0x11;
+   }
+   aes128_setKey(&k,fipsKey);
+   memcpy(block,plain,16);
+   aes128_encrypt(&k,block);
+   CHECK(memcmp(block,fipsCipher,16)==0);
+
+   for (i=0;i<NUM_AES_VECTORS;i++) {
+      randomBytes(rawKey,16);
+      randomBytes(plain,16);
+      aes128_setKey(&k,rawKey);
+      memcpy(block,plain,16);
+      aes128_encrypt(&k,block);
+      ref_aesEcb(rawKey,plain,expected);
+      CHECK(memcmp(block,expected,16)==0);
+   }
+   printf("  AES-128: FIPS-197 C.1 and %d random blocks\n",NUM_AES_VECTORS);
+}
+
+static void test_ccmStar(void) {
+   uint8_t nonce[IEEE802154_SECURITY_NONCE_LEN];
+   uint8_t a[40];
+   uint8_t m[100];
+   uint8_t frame[160];
+   uint8_t expected[160];
+   uint8_t openssl[160];
+   uint8_t securityLevel;
+   uint8_t mic;
+   int     lenA;
+   int     lenM;
+   int     i;
+
+   for (i=0;i<NUM_CCM_FRAMES;i++) {
+      securityLevel = 1+rand()%7;
+      mic           = micLength(securityLevel);
+      lenA          = rand()%sizeof(a);
+      lenM          = rand()%(sizeof(m)-lenA);
+      randomBytes(nonce,sizeof(nonce));
+      randomBytes(a,lenA);
+      randomBytes(m,lenM);
+      if (securityLevel<IEEE154_ASH_SLF_TYPE_ENC) {
+         // MIC only: the whole frame is authenticated
+         memcpy(&a[lenA],m,lenM);
+         lenA += lenM;
+         lenM  = 0;
+      }
+
+      memcpy(frame,a,lenA);
+      memcpy(frame+lenA,m,lenM);
+      CHECK(ieee802154_security_ccmEncrypt(0,frame,lenA,frame+lenA,lenM,nonce,mic)==TRUE);
+      CHECK(memcmp(frame,a,lenA)==0);
+
+      ref_ccmStar(nonce,a,lenA,m,lenM,mic,expected);
+      CHECK(memcmp(frame+lenA,expected,lenM+mic)==0);
+      if (mic>0) {
+         ref_ccm(nonce,a,lenA,m,lenM,mic,openssl);
+         CHECK(memcmp(frame+lenA,openssl,lenM+mic)==0);
+      }
+
+      CHECK(ieee802154_security_ccmDecrypt(0,frame,lenA,frame+lenA,lenM+mic,nonce,mic)==TRUE);
+      CHECK(memcmp(frame+lenA,m,lenM)==0);
+   }
+   printf("  CCM*: %d random frames, levels 1 to 7\n",NUM_CCM_FRAMES);
+}
+
+static void test_outgoingFrame(void) {
+   OpenQueueEntry_t msg;
+   uint8_t          frame[127];
+   uint8_t          plain[HEADER_LEN+PAYLOAD_LEN];
+   uint8_t          expected[127];
+   uint8_t          nonce[IEEE802154_SECURITY_NONCE_LEN];
+   uint8_t          len;
+   uint32_t         frameCounter;
+   int              i;
+
+   ieee802154_security_init();
+   // the first frame counter follows the ASN
+   asn[0] = 0x10;
+   asn[1] = 0x27;
+   len    = secureFrame(frame,&frameCounter);
+   CHECK(frameCounter==0x2711);
+   CHECK(len==HEADER_LEN+PAYLOAD_LEN+micLength(IEEE802154_SECURITY_LEVEL));
+
+   // nonce: my EUI64, the frame counter (big endian) and the security level
+   memcpy(nonce,idmanager_getMyID(ADDR_64B)->addr_64b,LENGTH_ADDR64b);
+   nonce[ 8] = 0x00;
+   nonce[ 9] = 0x00;
+   nonce[10] = 0x27;
+   nonce[11] = 0x11;
+   nonce[12] = IEEE802154_SECURITY_LEVEL;
+   for (i=0;i<sizeof(plain);i++) {
+      plain[i] = i;
+   }
+   ref_ccmStar(nonce,plain,HEADER_LEN,plain+HEADER_LEN,PAYLOAD_LEN,
+               micLength(IEEE802154_SECURITY_LEVEL),expected);
+   CHECK(memcmp(frame,plain,HEADER_LEN)==0);
+   CHECK(memcmp(frame+HEADER_LEN,expected,len-HEADER_LEN)==0);
+
+   // then it is incremented once per frame
+   secureFrame(frame,&frameCounter);
+   CHECK(frameCounter==0x2712);
+
+   // received back
+   CHECK(receiveFrame(frame,len,frameCounter,IEEE802154_SECURITY_LEVEL,&msg)==E_SUCCESS);
+   CHECK(msg.length==PAYLOAD_LEN);
+   printf("  secured frame: nonce, frame counter, MIC and ciphertext\n");
+}
+
+static void test_tamper(void) {
+   OpenQueueEntry_t msg;
+   uint8_t          frame[127];
+   uint8_t          tampered[127];
+   uint8_t          len;
+   uint32_t         frameCounter;
+   int              numRejected;
+   int              bit;
+
+   ieee802154_security_init();
+   len = secureFrame(frame,&frameCounter);
+
+   numRejected = 0;
+   for (bit=0;bit<8*len;bit++) {
+      memcpy(tampered,frame,len);
+      tampered[bit/8] ^= 1 << (bit%8);
+      if (receiveFrame(tampered,len,frameCounter,IEEE802154_SECURITY_LEVEL,&msg)==E_FAIL) {
+         numRejected++;
+      }
+   }
+   CHECK(numRejected==8*len);
+
+   // nor can the frame counter be changed
+   CHECK(receiveFrame(frame,len,frameCounter+1,IEEE802154_SECURITY_LEVEL,&msg)==E_FAIL);
+   CHECK(receiveFrame(frame,len,frameCounter,IEEE802154_SECURITY_LEVEL,&msg)==E_SUCCESS);
+   printf("  tampering: %d of %d single-bit changes rejected\n",numRejected,8*len);
+}
+
+static void test_replayWindow(void) {
+   OpenQueueEntry_t msg;
+   asn_t            asnTimestamp;
+   uint8_t          frames[NUM_FRAMES][127];
+   uint8_t          len[NUM_FRAMES];
+   uint32_t         frameCounter[NUM_FRAMES];
+   uint8_t          oldFrame[127];
+   uint8_t          oldLen;
+   uint32_t         oldFrameCounter;
+   int              order[NUM_FRAMES];
+   int              numAccepted;
+   int              numRejected;
+   int              pass;
+   int              swap;
+   int              i;
+   int              j;
+
+   ieee802154_security_init();
+   neighbors_init();
+   memset(&asnTimestamp,0,sizeof(asn_t));
+   neighbors_indicateRx(idmanager_getMyID(ADDR_64B),-50,&asnTimestamp,FALSE,0);
+
+   oldLen = secureFrame(oldFrame,&oldFrameCounter);
+   for (i=0;i<NUM_FRAMES;i++) {
+      len[i] = secureFrame(frames[i],&frameCounter[i]);
+   }
+
+   // shuffled by at most 8 positions, well within the window
+   for (i=0;i<NUM_FRAMES;i++) {
+      order[i] = i;
+   }
+   for (i=0;i<NUM_FRAMES;i++) {
+      j        = i+rand()%(NUM_FRAMES-i<8 ? NUM_FRAMES-i : 8);
+      swap     = order[i];
+      order[i] = order[j];
+      order[j] = swap;
+   }
+
+   // each frame is accepted once, then rejected as a replay
+   numAccepted = 0;
+   numRejected = 0;
+   for (pass=0;pass<2;pass++) {
+      for (i=0;i<NUM_FRAMES;i++) {
+         j = order[i];
+         if (receiveFrame(frames[j],len[j],frameCounter[j],IEEE802154_SECURITY_LEVEL,&msg)==E_SUCCESS) {
+            numAccepted++;
+            CHECK(msg.length==PAYLOAD_LEN && msg.payload[0]==HEADER_LEN);
+         } else {
+            numRejected++;
+         }
+      }
+   }
+   CHECK(numAccepted==NUM_FRAMES);
+   CHECK(numRejected==NUM_FRAMES);
+
+   // a frame from before the window, never received
+   CHECK(receiveFrame(oldFrame,oldLen,oldFrameCounter,IEEE802154_SECURITY_LEVEL,&msg)==E_FAIL);
+
+   // unsecured or downgraded data frames, unsecured EBs
+   CHECK(receiveFrame(frames[0],len[0],frameCounter[0],IEEE154_ASH_SLF_TYPE_NOSEC,&msg)==E_FAIL);
+   CHECK(receiveFrame(frames[0],len[0],frameCounter[0],IEEE154_ASH_SLF_TYPE_MIC_32,&msg)==E_FAIL);
+   memset(&msg,0,sizeof(OpenQueueEntry_t));
+   msg.l2_frameType = IEEE154_TYPE_BEACON;
+   CHECK(ieee802154_security_incomingFrame(&msg)==E_SUCCESS);
+
+   printf("  replay window: %d frames out of order accepted, %d replays rejected\n",numAccepted,numRejected);
+}
+
+//=========================== main ============================================
+
+int main(void) {
+   srand(1);
+   idmanager_init();
+   ieee802154_security_init();
+
+   test_aes();
+   test_ccmStar();
+   test_outgoingFrame();
+   test_tamper();
+   test_replayWindow();
+
+   printf("%s: %d checks, %d failures\n",numFailures ? "FAIL" : "PASS",numChecks,numFailures);
+   return numFailures!=0;
+}